@@ -119,7 +119,11 @@ enum eng_flags
     ENG_FLAG_OPTIMIZEMEMORY = (1<<5),   /**< use fixed (but fast) allocators for common buffers,
                                         If you want to set this option, make sure you have profiled
                                         memory usage for each buffer and set them in init_params */
-    ENG_FLAG_DISABLEBGLOAD = (1<<6) /**< Disables background loading feature */
+    ENG_FLAG_DISABLEBGLOAD = (1<<6), /**< Disables background loading feature */
+    ENG_FLAG_PIPELINED = (1<<7), /**< Renders previous frame's snapshot while components of current
+                                 frame are updated, adds one frame of latency. Ignored in DEV mode */
+    ENG_FLAG_ANIMTRACKS = (1<<8) /**< Stores animation reels as per-bone tracks instead of frames,
+                                  masked animation layers only read the bones they use */
 };
 
 /**
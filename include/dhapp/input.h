@@ -35,7 +35,8 @@ enum input_mouse_key
 	INPUT_MOUSEKEY_RIGHT, /**< indicates that right button is pressed */
 	INPUT_MOUSEKEY_MIDDLE, /**< indicates that middle button is pressed */
 	INPUT_MOUSEKEY_PGUP, /**< indicates that page-up button is pressed */
-	INPUT_MOUSEKEY_PGDOWN /**< indicates that page-down button is pressed */
+	INPUT_MOUSEKEY_PGDOWN, /**< indicates that page-down button is pressed */
+	INPUT_MOUSEKEY_CNT   /* count of mouse key enums */
 };
 
 /**
@@ -147,6 +148,27 @@ enum input_key	{
 	INPUT_KEY_CNT   /* count of input key enums */
 };
 
+/**
+ * Raw input state of a single frame, as reported by the platform (before key locks are applied)
+ * @see input_set_capturefn
+ * @ingroup input
+ */
+struct input_rawstate
+{
+    int mousex; /**< cursor X position, relative to client area */
+    int mousey; /**< cursor Y position, relative to client area */
+    int active; /**< application window is active */
+    uint8 mkeys[INPUT_MOUSEKEY_CNT];    /**< pressed state of mouse keys */
+    uint8 keys[INPUT_KEY_CNT];  /**< pressed state of keyboard keys */
+};
+
+/**
+ * Input capture callback, called by `input_update` with the polled raw state of the frame.
+ * callback can read the state (record) or overwrite it (replay)
+ * @ingroup input
+ */
+typedef void (*pfn_input_capture)(INOUT struct input_rawstate* state, void* param);
+
 /* api */
 /**
  * Updates input system on each frame. should be called within frame progression normally before calling `input_get_XXX` functions
@@ -249,6 +271,15 @@ APP_API void input_mouse_unlockkey(enum input_mouse_key key);
  */
 APP_API void input_mouse_resetlocks();
 
+/**
+ * Sets input capture callback. While the callback is set, `input_update` polls the whole raw
+ * state once per frame and all input queries of that frame read from it, so the frame sees
+ * exactly the state that the callback has seen (or written). Pass NULL to return to live polling
+ * @see input_rawstate
+ * @ingroup input
+ */
+APP_API void input_set_capturefn(pfn_input_capture fn, void* param);
+
 /* internal */
 void input_zero();
 void input_init();
@@ -92,6 +92,9 @@ result_t anim_ctrl_set_reel(anim_ctrl_inst inst, reshandle_t reel_hdl);
 /* animation reel API */
 anim_reel anim_load(struct allocator* alloc, const char* h3da_filepath, uint thread_id);
 void anim_unload(anim_reel reel);
+/* reels that are loaded afterwards store poses in per-pose tracks instead of per-frame arrays,
+ * sampling masked layers then only reads the poses that are not masked out */
+void anim_set_tracklayout(int enable);
 
 void anim_update_clip_hierarchal(const anim_reel reel, uint clip_idx, float t,
     const uint* bindmap, const cmphandle_t* xforms, uint frame_force_idx,
@@ -63,6 +63,30 @@ ENGINE_API cmphandle_t cmp_create_instance(cmp_t c, struct cmp_obj* obj, uint fl
  */
 ENGINE_API cmphandle_t cmp_create_instance_forobj(const char* cmpname, struct cmp_obj* obj);
 
+/**
+ * Creates component instance for object and copies public values (@see cmp_value) from another
+ * instance data of the same component, then applies modify callbacks of the values
+ * (or queues them, if component has CMP_FLAG_DEFERREDMODIFY flag)\n
+ * Internal (non-value) data of the source is not copied, it is rebuilt by modify callbacks,
+ * so per-instance work (resource loads, model instances, child components, anim bindings) is
+ * still done for every copy. each distinct modify callback runs once per copy
+ * @param c Component object
+ * @param obj Parent host object
+ * @param src_data Source instance data, same layout as component data (see cmp_getstride)
+ * @return Handle to newly created component
+ * @see cmp_create_instance
+ * @ingroup cmp
+ */
+ENGINE_API cmphandle_t cmp_create_instance_copy(cmp_t c, struct cmp_obj* obj,
+    const void* src_data);
+
+/**
+ * Grows instance buffers of the component once, so that @e cnt more instances can be created
+ * without reallocation, useful before creating many instances at once
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_reserve_instances(cmp_t c, uint cnt);
+
 
 /**
  * Destroys component instance, and removes it from component chain of object
@@ -101,7 +125,8 @@ ENGINE_API const char* cmp_getname(cmp_t c);
 ENGINE_API uint cmp_getcount();
 
 /**
- * Find component instance in component chain by it's type
+ * Find component instance in component chain by it's type, walks the chain, so for objects
+ * prefer cmp_findinstance_bytype_inobj which is constant-time
  * @param chain Component chain, which mostly belongs to game-objects.
  * @param type Component type to find in the chain
  * @return Valid component handle or INVALID_HANDLE if not found
@@ -123,7 +148,8 @@ ENGINE_API cmphandle_t cmp_findinstance(cmp_chain chain, cmptype_t type);
 ENGINE_API cmphandle_t cmp_findinstance_inobj(struct cmp_obj* obj, const char* cmpname);
 
 /**
- * Find component instance in object by it's type
+ * Find component instance in object by it's type, lookup is constant-time through object's
+ * component slots (cmp_obj::cmps)
  * @param obj Component instance's owner object
  * @param type Component type to find in the chain
  * @return Valid component handle or @e INVALID_HANDLE if not found
@@ -139,6 +165,12 @@ ENGINE_API cmphandle_t cmp_findinstance_bytype_inobj(struct cmp_obj* obj, cmptyp
  */
 ENGINE_API cmptype_t cmp_gettype(cmp_t c);
 
+/**
+ * Get size of each instance data of the component in bytes
+ * @ingroup cmp
+ */
+ENGINE_API uint cmp_getstride(cmp_t c);
+
 /**
  * Get instance's owner component object
  * @see cmp_getbyidx
@@ -462,6 +494,89 @@ ENGINE_API result_t cmp_value_getsvi(OUT char* rs, uint rs_sz, cmphandle_t hdl,
 ENGINE_API result_t cmp_value_setsvp(cmphandle_t hdl, const char* name, uint cnt,
                                      const char** values);
 
+/*************************************************************************************************/
+/* value handles, modify the same value of many instances without name lookups */
+
+/**
+ * Resolves component value by name into a value handle, which can be kept and reused for all
+ * instances of the component
+ * @param type Component type
+ * @param name Value name
+ * @return Value handle or INVALID_INDEX if component or value is not found
+ * @see cmp_value
+ * @ingroup cmp
+ */
+ENGINE_API cmpvalhdl_t cmp_value_gethdl(cmptype_t type, const char* name);
+
+/**
+ * Modify float value of many component instances. if value is registered with @e 'modify'
+ * callback, it will be called for each instance @e after new value is set.
+ * @param vhdl Value handle, @see cmp_value_gethdl
+ * @param hdls Handles of component instances, must be instances of value handle's component
+ * @param hdl_cnt Number of instance handles
+ * @param value New value to be set
+ * @return RET_OK, or failed result of the last instance that could not be modified
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_setf_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                         uint hdl_cnt, float value);
+
+/**
+ * Modify integer value of many component instances. @see cmp_value_setf_batch
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_seti_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                         uint hdl_cnt, int value);
+
+/**
+ * Modify unsigned integer value of many component instances. @see cmp_value_setf_batch
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_setui_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                          uint hdl_cnt, uint value);
+
+/**
+ * Modify boolean value of many component instances. @see cmp_value_setf_batch
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_setb_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                         uint hdl_cnt, int value);
+
+/**
+ * Modify float2 value of many component instances. @see cmp_value_setf_batch
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_set2f_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                          uint hdl_cnt, const float* value);
+
+/**
+ * Modify float3 value of many component instances. @see cmp_value_setf_batch
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_set3f_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                          uint hdl_cnt, const float* value);
+
+/**
+ * Modify float4 value of many component instances. @see cmp_value_setf_batch
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_set4f_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                          uint hdl_cnt, const float* value);
+
+/**
+ * Modify matrix value of many component instances. @see cmp_value_setf_batch
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_set3m_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                          uint hdl_cnt, const struct mat3f* value);
+
+/**
+ * Modify string value of many component instances. @see cmp_value_setf_batch
+ * @ingroup cmp
+ */
+ENGINE_API result_t cmp_value_sets_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls,
+                                         uint hdl_cnt, const char* value);
+
 /*************************************************************************************************/
 /* internal */
 void cmp_zero();
@@ -476,9 +591,21 @@ void cmp_zeroobj(struct cmp_obj* obj);
 const struct cmp_instance_desc** cmp_get_updateinstances(cmp_t c, OUT uint* cnt);
 const struct cmp_instance_desc** cmp_get_allinstances(cmp_t c, OUT uint* cnt,
     struct allocator* alloc);
+/* handle of the instance that takes the handle of a destroyed instance (see cmp_destroy_instance),
+ * destroy callbacks can use it to fix their references to the moved instance */
+cmphandle_t cmp_get_lastinstance(cmp_t c);
+/* increased each time instance data is moved in memory (grow, packing or re-sort of packed
+ * instances), components that keep pointers to instance data check it before using them */
+uint cmp_get_datagen(cmp_t c);
+/* destroys instances of all component types that are hosted by objects with 'tmp_flag' set in
+ * their tmp_flags, used to release many objects together (see scn_clear)
+ * each instance is still destroyed separately (destroy callback + handle bookkeeping) */
+void cmp_destroy_hostinstances(uint tmp_flag);
 
 void cmp_debug(float dt, const struct gfx_view_params* params);
-void cmp_update(float dt, uint stage_id);
+void cmp_update(float dt, uint stage_id, uint thread_id);
+/* thread that runs current update stage, used by update callbacks to fetch temp allocator */
+uint cmp_get_updatethread();
 void cmp_clear_updates();
 
 
@@ -48,12 +48,26 @@ typedef uint64 cmphandle_t;
  */
 typedef uint16 cmptype_t;
 
+/**
+ * Component value handle (32bit integer), resolved once from component type and value name with
+ * @e cmp_value_gethdl, and used with batch value setters instead of value names
+ * @ingroup cmp
+ */
+typedef uint cmpvalhdl_t;
+
  /**
   * Component chain linked_list (owned by objects). data is cmp_chain_node
   * @ingroup cmp
   */
 typedef struct linked_list* cmp_chain;
 
+/**
+ * Number of per-object component slots, each registered component (by registration order) has a
+ * fixed slot in objects, so finding an instance by type doesn't need to walk the chain
+ * @ingroup cmp
+ */
+#define CMP_OBJ_SLOTCNT 32
+
 struct cmp_component;
 
 /**
@@ -81,13 +95,20 @@ typedef struct cmp_component* cmp_t;
 #define CMP_MAKE_HANDLE(type, c_idx, i_idx) ( (((uint64)((type)&0xffff))<<48) | \
     (((uint64)((c_idx)&0xffff))<<32) | ((uint64)((i_idx)&0xffffffff)) )
 
+/* component value handle macros */
+#define CMP_VALHDL_GETINDEX(vhdl)   (((vhdl)>>16)&0xffff)
+#define CMP_VALHDL_GETVALUE(vhdl)   ((vhdl)&0xffff)
+#define CMP_MAKE_VALHDL(c_idx, v_idx)   ((((uint)(c_idx)&0xffff)<<16) | ((uint)(v_idx)&0xffff))
+
 /* object flags */
 enum cmp_objflag
 {
-    CMP_OBJFLAG_VISIBLE = (1<<0), /* temp flag: object is visible in current frame */
+    CMP_OBJFLAG_VISIBLE = (1<<0), /* temp flag: object passed occlusion in its last query (vis_frame) */
     CMP_OBJFLAG_STATIC = (1<<3),    /* static flag: it means that it cannot be normally deleted */
     CMP_OBJFLAG_SPATIALVISIBLE = (1<<4), /* temp flag: for culling to dismiss duplicate vis obj */
-    CMP_OBJFLAG_SPATIALADD = (1<<5)    /* temp flag: for scene-mgr to dismiss duplicate add */
+    CMP_OBJFLAG_SPATIALADD = (1<<5),    /* temp flag: for scene-mgr to dismiss duplicate add */
+    CMP_OBJFLAG_SPATIALUPDATE = (1<<6), /* temp flag (tmp_flags): queued for spatial update */
+    CMP_OBJFLAG_RELEASING = (1<<7) /* temp flag (tmp_flags): released in bulk with its scene */
 };
 
 struct cmp_chain_node
@@ -127,8 +148,13 @@ struct cmp_obj
     enum cmp_obj_type type; /**< Object type, @see cmp_obj_type */
     uint flags;   /**< Object flags (cmp_objflag) */
     uint tmp_flags; /**< Perframe Temp flags (cmp_objflag) */
+    uint vis_frame; /**< Last occlusion query that object is visited in (used by scene-mgr) */
+
+    uint name_hash; /**< Hash of the name (hash_str), used by scene-mgr name index */
+    struct cmp_obj* name_next; /**< Next object with the same name hash (used by scene-mgr) */
 
     cmp_chain chain;  /**< Component chain (item=cmp_chain_node) */
+    cmphandle_t cmps[CMP_OBJ_SLOTCNT]; /**< Direct instance handles by component slot */
 
     /* commonly used component handles */
     cmphandle_t xform_cmp;  /**< Transform component handle (for fast/easy access) */
@@ -164,6 +190,14 @@ typedef result_t (*pfn_cmp_create)(struct cmp_obj* obj, void* data, cmphandle_t
  */
 typedef void (*pfn_cmp_destroy)(struct cmp_obj* obj, void* data, cmphandle_t cur_hdl);
 
+/**
+ * @b Release callback: optional callback that is called before component is unregistered (on
+ * component manager release), to free component-wide data that is not owned by any instance
+ * @param c Component itself
+ * @ingroup cmp
+ */
+typedef void (*pfn_cmp_release)(cmp_t c);
+
 /**
  * @b Modify callback: this callback is defined in value descriptor of component and is called
  * when the specified value is modified using cmp_modifyXXXX functions or in editor/serialization.
@@ -204,6 +238,24 @@ typedef void (*pfn_cmp_debug)(struct cmp_obj* obj, void* data, cmphandle_t cur_h
  */
 typedef void (*pfn_cmp_update)(cmp_t c, float dt, void* params);
 
+/**
+ * @b Range update callback: Optional alternative to @e pfn_cmp_update, processes only a range of
+ * update instances [start, end) (@see cmp_get_updateinstances), so component manager can split
+ * update list into chunks and run them on multiple threads (@see CMP_FLAG_THREADSAFE).\n
+ * Range callbacks must only modify their own instance data and should not call functions that
+ * change global state like @e cmp_updateinstance, if such work is needed, it should be done in the
+ * normal update callback of the same stage, which is called on main thread after all ranges are done
+ * @param c Component itself
+ * @param dt Time progress from the last frame.
+ * @param params custom parameters, same as @e pfn_cmp_update
+ * @param start First update instance index
+ * @param end Last update instance index (exclusive)
+ * @param thread_id Thread that runs the range, use it to fetch temp allocator (tsk_get_tmpalloc)
+ * @ingroup cmp
+ */
+typedef void (*pfn_cmp_update_range)(cmp_t c, float dt, void* params, uint start, uint end,
+    uint thread_id);
+
 /**
  * Component value type
  * @ingroup cmp
@@ -291,9 +343,15 @@ enum cmp_flag
 {
     CMP_FLAG_ALWAYSUPDATE = (1<<0),  /**< Updates all instances every frame unless un-triggered manually */
     CMP_FLAG_SINGLETON = (1<<1),    /**< Only one instance could be created from this component  */
-    CMP_FLAG_DEFERREDMODIFY = (1<<2) /**< Modify functions are called in deferred mode.
+    CMP_FLAG_DEFERREDMODIFY = (1<<2), /**< Modify functions are called in deferred mode.
                                        * This is useful for components that their init/modify needs
                                        * fully loaded scene or are dependent on other objects */
+    CMP_FLAG_THREADSAFE = (1<<3), /**< Range update callbacks can run concurrently on different
+                                   * ranges of update list. @see pfn_cmp_update_range */
+    CMP_FLAG_PACKED = (1<<4) /**< Instance data is kept contiguous and sorted by host objects, and
+                               * update list is sorted by data order before range updates.
+                               * Instance data pointers are only valid until the next instance
+                               * of the same component is destroyed, or until end of the frame */
 };
 
 /**
@@ -334,6 +392,15 @@ struct cmp_createparams
     uint grow_cnt; /**< Growth instance count, if initial count limit is reached */
     uint value_cnt;  /**< Number of (public) values inside component data. @see cmp_value */
     const struct cmp_value* values; /**< Actual value descriptors for component data. @see cmp_value */
+    pfn_cmp_update_range update_range_funcs[CMP_UPDATE_MAXSTAGE]; /**< Range update callbacks.
+                                                        * (or NULL), called before update_funcs of
+                                                        * the same stage. @see pfn_cmp_update_range */
+    uint update_batch; /**< Minimum number of instances that each thread updates with range
+                         * callbacks (=0 for default) */
+    uint dep_cnt; /**< Number of component types in @e deps */
+    const cmptype_t* deps; /**< Component types that must be updated before this component in each
+                             * stage, must be registered before this component */
+    pfn_cmp_release release_func; /**< Release callback (or NULL). @see pfn_cmp_release */
 };
 
 
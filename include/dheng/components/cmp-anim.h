@@ -36,6 +36,7 @@ struct cmp_anim
     float t; /* elapsed time */
     uint clip_id;
     int playing; /* keep play state */
+    int finished;   /* non-looped clip has ended in range update, it's stopped on main thread */
     struct gfx_model_posegpu* pose; /* pointer to gpupose of the binded skeletal model */
     const cmphandle_t* xform_hdls; /* pointer to xform components, used for hierarchal animation */
     struct mat3f root_mat;  /* root matrix which must be applied to root node after anim update */
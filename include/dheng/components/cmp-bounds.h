@@ -28,7 +28,8 @@ struct ALIGN16 cmp_bounds
 	struct sphere s;
 	struct sphere ws_s;
 	struct aabb ws_aabb;
-	struct linked_list* cell_list;  /* item-data: scn_grid_item */
+	int cell_range[4];  /* occupied cells in scene's grid/hash-grid: x_min, z_min, x_max, z_max */
+	int tree_node;  /* leaf node index in scene's aabb-tree, -1 if it's not in the tree */
 };
 
 ENGINE_API result_t cmp_bounds_modify(struct cmp_obj* obj, struct allocator* alloc,
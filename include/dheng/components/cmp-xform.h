@@ -26,7 +26,10 @@ struct ALIGN16 cmp_xform
 	struct vec4f vel_lin;	/* linear velocity */
 	struct vec4f vel_ang;	/* angular velocity */
 	struct mat3f ws_mat;	/* world-space transform */
-	cmphandle_t parent_hdl;	/* handle to parent xform component */
+	cmphandle_t parent_hdl;	/* handle to parent xform component, use cmp_xform_setparent */
+	cmphandle_t first_child;	/* first child xform (internal) */
+	cmphandle_t next_sibling;	/* next xform with the same parent (internal) */
+	uint node_idx;	/* node in flattened hierarchy (internal) */
 };
 
 
@@ -43,6 +46,11 @@ static const uint16 cmp_xform_type = 0x7887;
 result_t cmp_xform_register(struct allocator* alloc);
 void cmp_xform_updatedeps(struct cmp_obj* obj, uint flags);
 
+/* changes parent of the transform, all parent changes should go through this function, because
+ * it keeps the child links that the flattened hierarchy is built from. changing parent (or
+ * destroying a transform) rebuilds the hierarchy in next world-space update */
+ENGINE_API void cmp_xform_setparent(cmphandle_t xform_hdl, cmphandle_t parent_hdl);
+
 ENGINE_API void cmp_xform_setm(struct cmp_obj* obj, const struct mat3f* mat);
 ENGINE_API void cmp_xform_setpos(struct cmp_obj* obj, const struct vec3f* pos);
 ENGINE_API void cmp_xform_setposf(struct cmp_obj* obj, float x, float y, float z);
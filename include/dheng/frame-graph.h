@@ -0,0 +1,134 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#ifndef __FRAMEGRAPH_H__
+#define __FRAMEGRAPH_H__
+
+#include "dhcore/types.h"
+#include "engine-api.h"
+
+/**
+ * @defgroup fgr Frame graph
+ * Frame job graph, each frame stage declares the data it reads and writes\n
+ * Stages that do not conflict with each other are run concurrently on task workers, others are
+ * run in the order they are added to the graph
+ */
+
+#define FGR_STAGES_MAX 64
+#define FGR_NAME_MAX 32
+
+/**
+ * Data that frame stages can read or write, used to build stage dependencies\n
+ * Game stages can use bits starting from @e FGR_DATA_USER
+ * @ingroup fgr
+ */
+enum fgr_data
+{
+    FGR_DATA_FILES = (1<<0), /**< file monitor and virtual file-system */
+    FGR_DATA_RESOURCES = (1<<1), /**< resource database */
+    FGR_DATA_PHYSICS = (1<<2), /**< physics scenes and simulation */
+    FGR_DATA_SCRIPT = (1<<3), /**< script (lua) state */
+    FGR_DATA_COMPONENTS = (1<<4), /**< component instance data */
+    FGR_DATA_SCENE = (1<<5), /**< scene objects and spatial structures */
+    FGR_DATA_GFX = (1<<6), /**< graphics device and render queues */
+    FGR_DATA_HUD = (1<<7), /**< debug hud and console */
+    FGR_DATA_SNAPSHOT = (1<<8), /**< render snapshot of pipelined renderer */
+    FGR_DATA_USER = (1<<16) /**< first bit reserved for game specific data */
+};
+
+/**
+ * Frame stage flags
+ * @ingroup fgr
+ */
+enum fgr_stage_flag
+{
+    FGR_STAGEFLAG_MAINTHREAD = (1<<0), /**< stage must run on main thread (gfx context, lua, etc.) */
+    FGR_STAGEFLAG_DISABLED = (1<<1) /**< stage is skipped until it's enabled again */
+};
+
+/**
+ * Frame stage callback
+ * @param dt Frame delta time (seconds)
+ * @param thread_id Thread that runs the stage, use it to fetch the temp allocator (tsk_get_tmpalloc)
+ * @ingroup fgr
+ */
+typedef void (*pfn_fgr_stage)(float dt, uint thread_id, void* param);
+
+/**
+ * Range callback for @e fgr_parallel_for, processes items in [start, end)
+ * @ingroup fgr
+ */
+typedef void (*pfn_fgr_range)(uint start, uint end, uint thread_id, void* param);
+
+/**
+ * Frame stage descriptor
+ * @ingroup fgr
+ */
+struct fgr_stage_desc
+{
+    const char* name;
+    pfn_fgr_stage run_fn;
+    void* param;
+    uint reads; /**< combination of enum fgr_data */
+    uint writes; /**< combination of enum fgr_data */
+    uint flags; /**< combination of enum fgr_stage_flag */
+};
+
+_EXTERN_BEGIN_
+
+/**
+ * Adds a stage to frame graph, it will be scheduled after conflicting stages added before it
+ * @param before Name of the stage that new stage must be inserted before, NULL appends the stage
+ * @ingroup fgr
+ */
+ENGINE_API result_t fgr_add_stage(const struct fgr_stage_desc* desc, OPTIONAL const char* before);
+
+/**
+ * Removes a stage from frame graph
+ * @ingroup fgr
+ */
+ENGINE_API void fgr_remove_stage(const char* name);
+
+/**
+ * Enables/Disables a stage without changing it's place in the graph
+ * @ingroup fgr
+ */
+ENGINE_API void fgr_enable_stage(const char* name, int enable);
+
+/**
+ * Runs an item range in parallel on idle task workers and calling thread, returns when all items
+ * are done. Can be called from main thread or from stages that run on workers
+ * @param batch_min Minimum number of items that each thread processes
+ * @param thread_id Caller's thread, it processes the first chunk of the range
+ * @ingroup fgr
+ */
+ENGINE_API void fgr_parallel_for(pfn_fgr_range range_fn, uint item_cnt, uint batch_min,
+    void* param, uint thread_id);
+
+/**
+ * Returns number of threads (including main thread) available for frame jobs
+ * @ingroup fgr
+ */
+ENGINE_API uint fgr_get_threadcnt();
+
+/* internal */
+void fgr_zero();
+result_t fgr_initmgr(uint thread_cnt);
+void fgr_releasemgr();
+void fgr_run(float dt);
+
+_EXTERN_END_
+
+#endif /* __FRAMEGRAPH_H__ */
@@ -68,6 +68,7 @@ struct gfx_model_skeleton
     struct mat3f joints_rootmat;
 	struct gfx_model_joint* joints;
 	struct mat3f* init_pose;	/* count = joint_cnt */
+    uint* joint_order;  /* joint indexes sorted parents-first, count = joint_cnt */
 };
 
 struct gfx_model_geo
@@ -219,6 +220,8 @@ void gfx_model_unload(struct gfx_model* model);
 struct gfx_model_instance* gfx_model_createinstance(struct allocator* alloc,
 		struct allocator* tmp_alloc, reshandle_t model);
 void gfx_model_destroyinstance(struct gfx_model_instance* inst);
+/* destroys the instance even if it's still referenced by pipelined renderer */
+void gfx_model_destroyinstance_now(struct gfx_model_instance* inst);
 
 uint gfx_model_findnode(const struct gfx_model* model, const char* name);
 uint gfx_model_findjoint(const struct gfx_model_skeleton* skeleton, const char* name);
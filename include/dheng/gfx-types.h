@@ -26,7 +26,8 @@ struct camera;
 /* include mostly enums that their values may be different in each API */
 #if defined(_D3D_)
 #include "d3d/gfx-types-d3d.h"
-#elif defined(_GL_)
+#elif defined(_GL_) || defined(_NULL_)
+/* null device mimics GL (glsl shaders, GL constant types) */
 #include "gl/gfx-types-gl.h"
 #endif
 
@@ -329,7 +330,7 @@ struct gfx_displaytarget_desc
 
 struct gfx_shader_binary_data
 {
-#if defined(_GL_)
+#if defined(_GL_) || defined(_NULL_)
 	void* prog_data;
 	uint prog_size;
 	uint fmt;
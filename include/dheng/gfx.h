@@ -37,6 +37,7 @@
 struct gfx_model_mtl;
 struct gfx_model_geo;
 struct gfx_model_posegpu;
+struct gfx_model_instance;
 struct scn_render_query;
 struct scn_render_light;
 struct gfx_shader;
@@ -134,6 +135,14 @@ void gfx_release();
 
 /* render/display */
 void gfx_render();
+
+/* pipelined render: gfx_render draws the snapshot that is taken by gfx_render_snapshot in the
+ * previous frame, so component updates can run in parallel with rendering */
+result_t gfx_set_pipelined(int enable);
+int gfx_is_pipelined();
+void gfx_render_snapshot();
+/* returns TRUE if instance is referenced by render snapshot, it will be destroyed later */
+int gfx_snapshot_holdinstance(struct gfx_model_instance* inst);
 _EXTERN_ gfx_cmdqueue gfx_get_cmdqueue(OPTIONAL uint id);
 
 /* render-path */
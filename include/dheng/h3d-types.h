@@ -207,6 +207,33 @@ struct _GCCPACKED_ h3d_anim_channel
 #endif
 };
 
+#define H3D_ANIM_QPOS_MAX 65535.0f /* max quantized position/scale value */
+#define H3D_ANIM_QROT_MAX 32767.0f /* max quantized rotation component (15 bits) */
+
+/* compressed channel data (H3D_VERSION_12 anims), comes after each h3d_anim_channel
+ * keys are quantized to 16 bits and only stored on frames that can't be interpolated from
+ * neighbour keys within error bounds, tracks with a single key are constant */
+struct _GCCPACKED_ h3d_anim_ctrack
+{
+    uint pos_cnt;   /* key count */
+    uint rot_cnt;
+    uint scale_cnt; /* =0 if animation doesn't have scale */
+    float pos_min[3];   /* quantization range: pos = pos_min + pos_extent*(key/65535) */
+    float pos_extent[3];
+    float scale_min;
+    float scale_extent;
+
+#if 0
+    /* data comes after in the file (all arrays are uint16) */
+    uint16 pos_frames[pos_cnt];
+    uint16 poss[pos_cnt*3];
+    uint16 rot_frames[rot_cnt];
+    uint16 rots[rot_cnt*3];  /* smallest-three, index of dropped component in bit 15 of [0] & [1] */
+    uint16 scale_frames[scale_cnt];
+    uint16 scales[scale_cnt];
+#endif
+};
+
 struct _GCCPACKED_ h3d_anim_clip
 {
     char name[32];
@@ -31,7 +31,8 @@ void phx_parseparams(struct phx_params* params, json_t j);
 result_t phx_init(const struct init_params* params);
 void phx_release();
 
-void phx_update_xforms(int simulated);
+/* gathers simulated transforms into xform components, thread_id: caller's thread (tmp memory) */
+void phx_update_xforms(int simulated, uint thread_id);
 
 /* simulation update: returns FALSE if simulation didn't need any update */
 int phx_update_sim(float dt);
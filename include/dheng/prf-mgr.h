@@ -48,4 +48,16 @@ void prf_closesample();
  */
 void prf_presentsamples(fl64 ft);
 
+/**
+ * callback for receiving samples of each finished frame, nodes are passed in depth-first order.
+ * times are in milliseconds, 'start_tm' is relative to the start of the frame
+ */
+typedef void (*pfn_prf_capture)(const char* name, uint depth, fl64 start_tm, fl64 tm, void* param);
+
+/**
+ * sets capture callback, it is called within prf_presentsamples (main thread) for all samples
+ * of the frame. pass NULL to remove it
+ */
+void prf_set_capturefn(pfn_prf_capture fn, void* param);
+
 #endif /* PRF_MGR_H_ */
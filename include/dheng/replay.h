@@ -0,0 +1,83 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#ifndef __REPLAY_H__
+#define __REPLAY_H__
+
+#include "dhcore/types.h"
+#include "engine-api.h"
+
+/**
+ * @defgroup rpl Record/Replay
+ * Records frame delta-times, raw input state and console commands to a file, and feeds them back
+ * to the engine on replay, so the same workload can be run again on different engine builds\n
+ * On replay, per-frame timings of the frame and all profiler samples (PRF_OPENSAMPLE) can be
+ * written to a report file (json or csv, chosen by file extension). Profiler samples are only
+ * available in _PROFILE_ builds\n
+ * Replays should start from the same state as their recording (same world loaded), for example
+ * by putting 'rpl_replay' command in init params console commands\n
+ * Console commands: rpl_record, rpl_replay, rpl_stop
+ */
+
+/**
+ * Record/Replay state
+ * @ingroup rpl
+ */
+enum rpl_state
+{
+    RPL_STATE_IDLE = 0, /**< not recording or replaying */
+    RPL_STATE_RECORD, /**< recording frames */
+    RPL_STATE_REPLAY /**< replaying frames */
+};
+
+/**
+ * Starts recording frames to a file, recording begins with the next frame
+ * @ingroup rpl
+ */
+ENGINE_API result_t rpl_record(const char* filepath);
+
+/**
+ * Starts replaying a recorded file, replay begins with the next frame
+ * @param fixed_dt If >0, all frames are replayed with this delta-time instead of recorded ones
+ * @param report_filepath Optional report file (.json or .csv) that receives per-frame timings
+ * @ingroup rpl
+ */
+ENGINE_API result_t rpl_replay(const char* filepath, float fixed_dt,
+                               OPTIONAL const char* report_filepath);
+
+/**
+ * Stops recording or replaying, and closes opened files
+ * @ingroup rpl
+ */
+ENGINE_API void rpl_stop();
+
+/**
+ * Returns current record/replay state, apps can poll it to quit after a replay is finished
+ * @ingroup rpl
+ */
+ENGINE_API enum rpl_state rpl_getstate();
+
+/* internal */
+void rpl_zero();
+result_t rpl_initmgr();
+void rpl_releasemgr();
+
+/* returns the tick that is used to update timers in current frame */
+uint64 rpl_beginframe(uint64 tick);
+void rpl_endframe(fl64 ft);
+/* called by con_exec for commands that were issued while recording */
+void rpl_addcmd(const char* cmd);
+
+#endif /* __REPLAY_H__ */
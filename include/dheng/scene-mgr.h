@@ -30,11 +30,69 @@ struct gfx_model;
 struct gfx_model_instance;
 struct gfx_shader;
 struct camera;
+struct cmp_light;
 struct gfx_view_params;
 struct variant;
 struct gfx_model_posegpu;
+struct scn_prefab;
 
 /* types */
+
+#define SCN_VIEW_MAX 32 /* maximum views in scn_create_queries */
+
+/* spatial structure that is used for culling scene objects */
+enum scn_spatial_type
+{
+    SCN_SPATIAL_GRID = 0,   /* uniform grid on XZ plane (default) */
+    SCN_SPATIAL_TREE,    /* dynamic AABB tree, for vertical or unevenly populated scenes */
+    SCN_SPATIAL_HASHGRID    /* sparse hashed grid on XZ plane, only occupied cells are allocated
+                               and scene size (scn_setsize) is not needed */
+};
+
+/* view volume types for multi-view queries (scn_create_queries) */
+enum scn_view_type
+{
+    SCN_VIEW_FRUSTUM = 0,   /* camera frustum: models and lights, same as scn_create_query */
+    SCN_VIEW_SWEEP, /* bounds swept along a direction: shadow casters, same as scn_create_query_csm */
+    SCN_VIEW_SPHERE /* local volume: shadow models, same as scn_create_query_sphere */
+};
+
+struct scn_view
+{
+    enum scn_view_type type;
+    int occlusion;  /* SCN_VIEW_FRUSTUM: test against occluders, only for the primary camera */
+    struct plane planes[6]; /* SCN_VIEW_FRUSTUM */
+    struct aabb bounds; /* SCN_VIEW_SWEEP: frustum bounds */
+    struct vec3f dir;   /* SCN_VIEW_SWEEP: normalized sweep direction */
+    struct sphere sphere;   /* SCN_VIEW_SPHERE */
+};
+
+/* gameplay probes (scn_run_probes), they are tested against object bounds (cmp_bounds) */
+enum scn_probe_type
+{
+    SCN_PROBE_RAY = 0,  /* ray segment, hit distance is along the ray */
+    SCN_PROBE_SPHERE,   /* overlap with a sphere, hit distance is from sphere center */
+    SCN_PROBE_AABB, /* overlap with a box, hit distance is from box center */
+    SCN_PROBE_NEAREST   /* k-nearest objects to a point, hit distance is from bounds surface */
+};
+
+struct scn_probe
+{
+    enum scn_probe_type type;
+    uint obj_types; /* combination of cmp_obj_type to accept, 0 accepts all objects */
+    uint ignore_id; /* object that is never reported (shooter, self), 0 for none */
+    struct vec3f pt;    /* ray origin, sphere center or nearest query point */
+    struct vec3f dir;   /* SCN_PROBE_RAY: normalized direction */
+    float len;  /* ray length, sphere radius or max distance of nearest query */
+    struct aabb box;    /* SCN_PROBE_AABB */
+};
+
+struct scn_probe_hit
+{
+    uint obj_id;    /* see scn_getobj */
+    float dist;
+};
+
 struct scn_render_model
 {
 	cmphandle_t model_hdl;
@@ -50,6 +108,7 @@ struct scn_render_model
 struct scn_render_light
 {
     cmphandle_t light_hdl;
+    struct cmp_light* ldata;    /* light data, a copy of component data in pipelined render */
     uint bounds_idx;
     uint mat_idx;
     float intensity_mul;
@@ -87,14 +146,31 @@ struct scn_render_query* scn_create_query_csm(uint scene_id, struct allocator* a
 struct scn_render_query* scn_create_query_sphere(uint scene_id, struct allocator* alloc,
     const struct sphere* sphere, const struct gfx_view_params* params);
 
+/* culls all views with a single traversal of the scene, queries[i] receives result of views[i]
+ * view_cnt must not exceed SCN_VIEW_MAX */
+result_t scn_create_queries(uint scene_id, struct allocator* alloc, const struct scn_view* views,
+    uint view_cnt, const struct gfx_view_params* params, OUT struct scn_render_query** queries);
+
 void scn_destroy_query(struct scn_render_query* query);
 
+/* runs a batch of gameplay probes against the scene's spatial structure, large batches are run in
+ * parallel (thread_id: caller's thread, see fgr_parallel_for)
+ * hits receives max_hits items for each probe (probe_cnt*max_hits), nearest hits are kept and
+ * sorted by distance. hit_cnts receives number of hits for each probe, all zero if max_hits is 0 */
+ENGINE_API void scn_run_probes(uint scene_id, const struct scn_probe* probes, uint probe_cnt,
+    uint max_hits, OUT struct scn_probe_hit* hits, OUT uint* hit_cnts, uint thread_id);
+
 void scn_create_csmquery();
 void scn_destroy_csmquery();
 
 void scn_update_spatial(uint scene_id, cmphandle_t bounds_hdl);
+/* applies queued spatial updates of all scenes, runs as a frame stage after component updates
+ * queries also apply pending updates of their own scene */
+void scn_flush_spatial(uint thread_id);
 void scn_push_spatial(uint scene_id, cmphandle_t bounds_hdl);
 void scn_pull_spatial(uint scene_id, cmphandle_t bounds_hdl);
+/* drops all cached occlusion results, called when an occluder geometry changes or goes away */
+void scn_reset_viscache();
 
 uint scn_getphxscene(uint scene_id);
 
@@ -102,9 +178,26 @@ ENGINE_API struct cmp_obj* scn_create_obj(uint scene_id, const char* name, enum
 ENGINE_API void scn_destroy_obj(struct cmp_obj* obj);
 
 ENGINE_API uint scn_findobj(uint scene_id, const char* name);
+/* same as scn_findobj, but takes pre-hashed name (name_hash = hash_str(name)), for names that are
+ * looked up frequently. name is still compared, so hash collisions are resolved */
+ENGINE_API uint scn_findobj_byhash(uint scene_id, uint name_hash, const char* name);
 ENGINE_API struct cmp_obj* scn_getobj(uint scene_id, uint obj_id);
 ENGINE_API void scn_clear(uint scene_id);
 
+/* prefabs: component setup of a fully configured object is captured once, and copies of it are
+ * spawned from it. only public component values are copied (cmp_create_instance_copy), so
+ * resources and internal data are created by modify callbacks, as with cmp_value_set functions,
+ * and each spawned object costs about the same as setting its values one by one.
+ * indirect (child) components are not captured, they are created by their owners on modify */
+ENGINE_API struct scn_prefab* scn_create_prefab(const struct cmp_obj* obj);
+ENGINE_API void scn_destroy_prefab(struct scn_prefab* prefab);
+/* spawns 'cnt' objects named 'name' from prefab, 'mats' (optional) holds local transform of each
+ * object, 'objs' (optional) receives spawned objects. component buffers are grown once and
+ * objects are pushed into spatial structure after all of them are created
+ * returns number of spawned objects */
+ENGINE_API uint scn_spawn_prefab(uint scene_id, const struct scn_prefab* prefab, const char* name,
+    uint cnt, OPTIONAL const struct mat3f* mats, OPTIONAL OUT struct cmp_obj** objs);
+
 ENGINE_API void scn_setsize(uint scene_id, const struct vec3f* minpt, const struct vec3f* maxpt);
 ENGINE_API void scn_getsize(uint scene_id, OUT struct vec3f* minpt, OUT struct vec3f* maxpt);
 
@@ -114,6 +207,16 @@ ENGINE_API uint scn_getactive();
 ENGINE_API void scn_setcellsize(uint scene_id, float cell_size);
 ENGINE_API float scn_getcellsize(uint scene_id);
 
+/* picks the grid/hash-grid cell size with lowest estimated query cost and rebuilds the structure
+ * it is done in the next spatial stage, so call it right after the level is loaded */
+ENGINE_API void scn_tunecellsize(uint scene_id);
+
+/* writes cell occupancy, recorded query costs and estimated costs of other cell sizes to json */
+ENGINE_API result_t scn_savestats(uint scene_id, const char* json_filepath);
+
+ENGINE_API result_t scn_setspatial(uint scene_id, enum scn_spatial_type type);
+ENGINE_API enum scn_spatial_type scn_getspatial(uint scene_id);
+
 _EXTERN_END_
 
 #endif /* __SCENEMGR_H__ */
@@ -65,6 +65,10 @@ struct init_params* app_config_load(const char* cfg_jsonfile)
             BIT_ADD(params->flags, ENG_FLAG_OPTIMIZEMEMORY);
         if (json_getb_child(general, "no-bgload", FALSE))
             BIT_ADD(params->flags, ENG_FLAG_DISABLEBGLOAD);
+        if (json_getb_child(general, "pipelined", FALSE))
+            BIT_ADD(params->flags, ENG_FLAG_PIPELINED);
+        if (json_getb_child(general, "anim-tracks", FALSE))
+            BIT_ADD(params->flags, ENG_FLAG_ANIMTRACKS);
         params->console_lines_max = json_geti_child(general, "console-lines", 1000);
     }	else	{
         params->console_lines_max = 1000;
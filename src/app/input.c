@@ -26,8 +26,12 @@ struct input_mgr
     int mousex_locked;    /* -1 if it's not locked */
     int mousey_locked;    /* -1 if it's not locked */
     uint8 kb_locked[INPUT_KEY_CNT];
-    uint8 mouse_keylocked[5];
+    uint8 mouse_keylocked[INPUT_MOUSEKEY_CNT];
     int init;
+
+    pfn_input_capture capture_fn;   /* if set, queries read from 'raw' instead of platform */
+    void* capture_param;
+    struct input_rawstate raw;  /* raw state polled in last input_update (capture mode) */
 };
 
 /* globals */
@@ -39,6 +43,8 @@ typedef GLFWwindow* wplatform_t;
 #elif defined(_D3D_)
 #include "dhcore/win.h"
 typedef HWND wplatform_t;
+#elif defined(_NULL_)
+typedef void* wplatform_t;
 #endif
 
 /* multiplatform functions that are implemented in their own .c files */
@@ -50,6 +56,15 @@ int input_kb_getkey_platform(wplatform_t wnd_hdl, const uint keymap[INPUT_KEY_CN
                                 enum input_key key);
 wplatform_t app_window_getplatform_w();
 
+/* fwd */
+void input_poll_rawstate(wplatform_t wnd_hdl, struct input_rawstate* state);
+
+/* inlines */
+INLINE int input_isactive()
+{
+    return g_input.capture_fn != NULL ? g_input.raw.active : app_window_isactive();
+}
+
 /* */
 void input_zero()
 {
@@ -78,9 +93,18 @@ void input_update()
     if (!g_input.init)
         return;
 
-    /* update mouse, convert x,y to relative */
+    /* capture mode: poll whole state once and let the callback record/overwrite it */
     int mx, my;
-    input_mouse_getpos_platform(app_window_getplatform_w(), &mx, &my);
+    if (g_input.capture_fn != NULL) {
+        input_poll_rawstate(app_window_getplatform_w(), &g_input.raw);
+        g_input.capture_fn(&g_input.raw, g_input.capture_param);
+        mx = g_input.raw.mousex;
+        my = g_input.raw.mousey;
+    }   else    {
+        input_mouse_getpos_platform(app_window_getplatform_w(), &mx, &my);
+    }
+
+    /* update mouse, convert x,y to relative */
 
     if (g_input.mousex_locked != -1 && g_input.mousey_locked != -1) {
         g_input.mousex += mx - g_input.mousex_locked;
@@ -97,12 +121,13 @@ void input_update()
 int input_kb_getkey(enum input_key key, int once)
 {
     ASSERT(g_input.init);
-    if (!app_window_isactive())
+    if (!input_isactive())
         return FALSE;
 
     uint idx = (uint)key;
     uint8 lock_flag = g_input.kb_locked[idx];
-    int keypressed = input_kb_getkey_platform(app_window_getplatform_w(), g_input.keymap, key);
+    int keypressed = g_input.capture_fn != NULL ? (int)g_input.raw.keys[idx] :
+        input_kb_getkey_platform(app_window_getplatform_w(), g_input.keymap, key);
 
     if (!once)   {
         return ((!(lock_flag & 0x1) && keypressed) || ((lock_flag >> 1) & 0x1));
@@ -129,12 +154,13 @@ int input_mouse_getkey(enum input_mouse_key mkey, int once)
 {
     ASSERT(g_input.init);
 
-    if (!app_window_isactive())
+    if (!input_isactive())
         return FALSE;
 
     uint idx = (uint)mkey;
     uint8 lock_flag = g_input.mouse_keylocked[idx];
-    int keypressed = input_mouse_getkey_platform(app_window_getplatform_w(), mkey);
+    int keypressed = g_input.capture_fn != NULL ? (int)g_input.raw.mkeys[idx] :
+        input_mouse_getkey_platform(app_window_getplatform_w(), mkey);
 
     if (!once)  {
         return ((!(lock_flag & 0x1) && keypressed) || ((lock_flag >> 1) & 0x1));
@@ -232,4 +258,27 @@ void input_mouse_resetlocks()
     memset(g_input.mouse_keylocked, 0x00, sizeof(g_input.mouse_keylocked));
     g_input.mousex_locked = -1;
     g_input.mousey_locked = -1;
-}
\ No newline at end of file
+}
+
+void input_set_capturefn(pfn_input_capture fn, void* param)
+{
+    ASSERT(g_input.init);
+    g_input.capture_fn = fn;
+    g_input.capture_param = param;
+    memset(&g_input.raw, 0x00, sizeof(g_input.raw));
+}
+
+void input_poll_rawstate(wplatform_t wnd_hdl, struct input_rawstate* state)
+{
+    memset(state, 0x00, sizeof(struct input_rawstate));
+
+    input_mouse_getpos_platform(wnd_hdl, &state->mousex, &state->mousey);
+    state->active = app_window_isactive();
+
+    for (uint i = 0; i < INPUT_MOUSEKEY_CNT; i++)
+        state->mkeys[i] = (uint8)input_mouse_getkey_platform(wnd_hdl, (enum input_mouse_key)i);
+    for (uint i = 0; i < INPUT_KEY_CNT; i++)    {
+        state->keys[i] = (uint8)input_kb_getkey_platform(wnd_hdl, g_input.keymap,
+            (enum input_key)i);
+    }
+}
@@ -0,0 +1,302 @@
+/***********************************************************************************
+ * Copyright (c) 2013, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+/**
+ * Headless application for null graphics device: there is no window or context, the main loop
+ * just calls the update callback until the process receives SIGINT/SIGTERM
+ */
+
+#if defined(_NULL_)
+
+#include <signal.h>
+
+#include "dhcore/core.h"
+#include "dhcore/json.h"
+
+#include "init-params.h"
+#include "app.h"
+#include "input.h"
+
+#define DEFAULT_WIDTH   1280
+#define DEFAULT_HEIGHT  720
+
+/*************************************************************************************************
+ * types
+ */
+struct app_null
+{
+    char name[32];
+    uint width;
+    uint height;
+    uint refresh_rate;
+    int always_active;
+    int init;
+
+    /* callbacks */
+    pfn_app_create create_fn;
+    pfn_app_destroy destroy_fn;
+    pfn_app_resize resize_fn;
+    pfn_app_active active_fn;
+    pfn_app_keypress keypress_fn;
+    pfn_app_update update_fn;
+    pfn_app_mousedown mousedown_fn;
+    pfn_app_mouseup mouseup_fn;
+    pfn_app_mousemove mousemove_fn;
+};
+
+/*************************************************************************************************
+ * globals
+ */
+struct app_null* g_app = NULL;
+static volatile sig_atomic_t g_app_quit = FALSE;
+
+/*************************************************************************************************/
+void app_signal_quit(int sig)
+{
+    g_app_quit = TRUE;
+}
+
+result_t app_init(const char* name, const struct init_params* params)
+{
+    ASSERT(g_app == NULL);
+    if (g_app != NULL)  {
+        err_print(__FILE__, __LINE__, "application already initialized");
+        return RET_FAIL;
+    }
+
+    /* create application */
+    log_print(LOG_TEXT, "init headless (null) app ...");
+
+    struct app_null* app = (struct app_null*)ALLOC(sizeof(struct app_null), 0);
+    ASSERT(app);
+    memset(app, 0x00, sizeof(struct app_null));
+    g_app = app;
+
+    input_zero();
+
+    uint width = params->gfx.width;
+    uint height = params->gfx.height;
+    if (width == 0)
+        width = DEFAULT_WIDTH;
+    if (height == 0)
+        height = DEFAULT_HEIGHT;
+
+    str_safecpy(app->name, sizeof(app->name), name);
+    app->width = width;
+    app->height = height;
+    app->always_active = TRUE;
+    app->refresh_rate = params->gfx.refresh_rate;
+
+    g_app_quit = FALSE;
+    signal(SIGINT, app_signal_quit);
+    signal(SIGTERM, app_signal_quit);
+
+    /* initialize input system */
+    input_init();
+
+    app->init = TRUE;
+    return RET_OK;
+}
+
+void app_release()
+{
+    if (g_app == NULL)
+        return;
+
+    input_release();
+
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+
+    FREE(g_app);
+    g_app = NULL;
+}
+
+void app_window_run()
+{
+    ASSERT(g_app);
+
+    while (!g_app_quit)   {
+        if (g_app->update_fn)
+            g_app->update_fn();
+    }
+
+    if (g_app->destroy_fn != NULL)
+        g_app->destroy_fn();
+}
+
+void app_window_readjust(uint client_width, uint client_height)
+{
+    app_window_resize(client_width, client_height);
+}
+
+void app_window_alwaysactive(int active)
+{
+    g_app->always_active = active;
+}
+
+result_t app_window_resize(uint width, uint height)
+{
+    struct app_null* app = g_app;
+    ASSERT(app);
+    if (!app->init)
+        return RET_FAIL;
+
+    app->width = width;
+    app->height = height;
+
+    return RET_OK;
+}
+
+void app_window_swapbuffers()
+{
+}
+
+int app_window_isactive()
+{
+    return TRUE;
+}
+
+uint app_window_getwidth()
+{
+    return g_app->width;
+}
+
+uint app_window_getheight()
+{
+    return g_app->height;
+}
+
+void app_window_setcreatefn(pfn_app_create fn)
+{
+    ASSERT(g_app);
+    g_app->create_fn = fn;
+}
+
+void app_window_setdestroyfn(pfn_app_destroy fn)
+{
+    ASSERT(g_app);
+    g_app->destroy_fn = fn;
+}
+
+void app_window_setresizefn(pfn_app_resize fn)
+{
+    ASSERT(g_app);
+    g_app->resize_fn = fn;
+}
+
+void app_window_setactivefn(pfn_app_active fn)
+{
+    ASSERT(g_app);
+    g_app->active_fn = fn;
+}
+
+void app_window_setkeypressfn(pfn_app_keypress fn)
+{
+    ASSERT(g_app);
+    g_app->keypress_fn = fn;
+}
+
+void app_window_setupdatefn(pfn_app_update fn)
+{
+    ASSERT(g_app);
+    g_app->update_fn = fn;
+}
+
+void app_window_setmousedownfn(pfn_app_mousedown fn)
+{
+    ASSERT(g_app);
+    g_app->mousedown_fn = fn;
+}
+
+void app_window_setmouseupfn(pfn_app_mouseup fn)
+{
+    ASSERT(g_app);
+    g_app->mouseup_fn = fn;
+}
+
+void app_window_setmousemovefn(pfn_app_mousemove fn)
+{
+    ASSERT(g_app);
+    g_app->mousemove_fn = fn;
+}
+
+void* app_gfx_getcontext()
+{
+    return NULL;
+}
+
+void app_window_show()
+{
+}
+
+void app_window_hide()
+{
+}
+
+const char* app_getname()
+{
+    return g_app->name;
+}
+
+char* app_display_querymodes()
+{
+    size_t outsz;
+
+    /* single virtual adapter and monitor, with default resolution */
+    json_t jroot = json_create_arr();
+    json_t jadapter = json_create_obj();
+    json_additem_toarr(jroot, jadapter);
+    json_additem_toobj(jadapter, "name", json_create_str("Null device"));
+    json_additem_toobj(jadapter, "id", json_create_num(0));
+
+    json_t joutputs = json_create_arr();
+    json_additem_toobj(jadapter, "monitors", joutputs);
+    json_t joutput = json_create_obj();
+    json_additem_toarr(joutputs, joutput);
+    json_additem_toobj(joutput, "id", json_create_num(0));
+    json_additem_toobj(joutput, "name", json_create_str("Null output"));
+
+    json_t jmodes = json_create_arr();
+    json_additem_toobj(joutput, "modes", jmodes);
+    json_t jmode = json_create_obj();
+    json_additem_toobj(jmode, "width", json_create_num((fl64)DEFAULT_WIDTH));
+    json_additem_toobj(jmode, "height", json_create_num((fl64)DEFAULT_HEIGHT));
+    json_additem_toobj(jmode, "refresh-rate", json_create_num(60.0));
+    json_additem_toarr(jmodes, jmode);
+
+    char* r = json_savetobuffer(jroot, &outsz, FALSE);
+    json_destroy(jroot);
+
+    return r;
+}
+
+void app_display_freemodes(char* dispmodes)
+{
+    ASSERT(dispmodes);
+    json_deletebuffer(dispmodes);
+}
+
+wnd_t app_window_gethandle()
+{
+    return (wnd_t)0;
+}
+
+void* app_window_getplatform_w()
+{
+    return NULL;
+}
+
+#endif /* _NULL_ */
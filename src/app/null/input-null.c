@@ -0,0 +1,49 @@
+/***********************************************************************************
+ * Copyright (c) 2013, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#if defined(_NULL_)
+
+#include "dhcore/core.h"
+#include "dhapp/input.h"
+
+/* headless app has no input devices: nothing is pressed and mouse stays at the origin */
+void input_make_keymap_platform(uint keymap[INPUT_KEY_CNT])
+{
+    for (uint i = 0; i < INPUT_KEY_CNT; i++)
+        keymap[i] = i;
+}
+
+void input_mouse_getpos_platform(void* wnd_hdl, OUT int* x, OUT int* y)
+{
+    *x = 0;
+    *y = 0;
+}
+
+void input_mouse_setpos_platform(void* wnd_hdl, int x, int y)
+{
+}
+
+int input_mouse_getkey_platform(void* wnd_hdl, enum input_mouse_key mkey)
+{
+    return FALSE;
+}
+
+int input_kb_getkey_platform(void* wnd_hdl, const uint keymap[INPUT_KEY_CNT],
+                                enum input_key key)
+{
+    return FALSE;
+}
+
+#endif
@@ -31,6 +31,9 @@
 
 #include "components/cmp-xform.h"
 
+#define ANIM_SAMPLE_BATCH 32    /* poses that are sampled together into stack memory */
+#define ANIM_NLERP_MINDOT 0.95f /* min cos(half-angle) between rotations that are nlerped */
+
 /*************************************************************************************************
  * types
  */
@@ -49,7 +52,9 @@ const struct mat3f* anim_ctrl_layer_additive(struct mat3f* result, struct mat3f*
 enum anim_flags
 {
     ANIM_LOOP = (1<<0), /* animation is looped */
-    ANIM_SCALE = (1<<1) /* animation has scale values */
+    ANIM_SCALE = (1<<1), /* animation has scale values */
+    ANIM_TRACKS = (1<<2), /* poses are stored in per-pose tracks (anim_reel.tracks) */
+    ANIM_COMPRESSED = (1<<3) /* tracks are compressed (anim_reel.ctracks), implies ANIM_TRACKS */
 };
 
 struct ALIGN16 anim_pose
@@ -66,6 +71,34 @@ struct anim_channel
     struct anim_pose* poses;    /* count: anim_reel.pose_cnt */
 };
 
+/* all frames of one pose, stored separately so sampling a subset of poses only touches their data
+ * rotations are 16-byte aligned, positions are packed (x, y, z) */
+struct anim_track
+{
+    struct quat4f* rot; /* count: anim_reel.frame_cnt */
+    float* pos; /* count: anim_reel.frame_cnt*3 */
+    float* scale;   /* count: anim_reel.frame_cnt (=NULL if reel doesn't have ANIM_SCALE) */
+};
+
+/* compressed track (H3D_VERSION_12 files), key arrays point to key data of the reel
+ * key frames are sorted, first key is on frame 0, single key tracks are constant */
+struct anim_ctrack
+{
+    uint pos_cnt;
+    uint rot_cnt;
+    uint scale_cnt; /* =0 if reel doesn't have scale */
+    const uint16* pos_frames;
+    const uint16* pos;  /* 3 per key */
+    const uint16* rot_frames;
+    const uint16* rot;  /* 3 per key, smallest-three components */
+    const uint16* scale_frames;
+    const uint16* scale;
+    float pos_min[3];
+    float pos_range[3]; /* extent/H3D_ANIM_QPOS_MAX */
+    float scale_min;
+    float scale_range;
+};
+
 /* sets of animation clips
  * long clips can be divided into clips for better referencing
  * for example an animation clip (loaded form file) can contain 'walk', 'attack', 'bend-over' clips */
@@ -90,7 +123,9 @@ struct anim_reel_data
     uint pose_cnt;
     uint clip_cnt;
     char* binds;   /* maps each joint/node to binded hierarchy/skeleton nodes. size: char(32)*pose_cnt */
-    struct anim_channel* channels;  /* count: frame_cnt */
+    struct anim_channel* channels;  /* count: frame_cnt (=NULL if ANIM_TRACKS is set) */
+    struct anim_track* tracks;  /* count: pose_cnt (=NULL if ANIM_TRACKS is not set) */
+    struct anim_ctrack* ctracks;    /* count: pose_cnt (=NULL if ANIM_COMPRESSED is not set) */
     struct anim_clip* clips;
     struct hashtable_fixed clip_tbl;    /* key: name_hash, value: clip_idx */
     struct allocator* alloc;
@@ -298,9 +333,18 @@ struct anim_ctrl_instance_data
  */
 
 /* animation reel */
+static result_t anim_loadframes(file_t f, anim_reel reel, struct allocator* alloc,
+    struct allocator* tmp_alloc);
+static result_t anim_loadctracks(file_t f, anim_reel reel, struct allocator* alloc,
+    size_t keys_sz);
 static void anim_loadchannel(file_t f, anim_reel reel, struct vec4f* tmp_pos_scale,
     struct quat4f* tmp_rot, uint pose_idx, uint frame_cnt);
+static void anim_ctrack_eval(struct anim_pose* r, const struct anim_ctrack* track, uint frame);
+static void anim_sampletracks(struct anim_pose* r, const anim_reel reel, uint frame_a,
+    uint frame_b, const uint* idxs, uint cnt, float t);
 static uint anim_findclip_hashed(const anim_reel reel, uint name_hash);
+static void anim_blendposes(struct anim_pose* r, const struct anim_pose* a,
+    const struct anim_pose* b, uint cnt, float t);
 
 /* animation controller - loading */
 static void anim_ctrl_load_params(anim_ctrl ctrl, json_t jparams, struct allocator* alloc);
@@ -341,8 +385,9 @@ static float anim_ctrl_progress_state(const anim_ctrl ctrl, anim_ctrl_inst inst,
 static float anim_ctrl_updateseq(struct anim_pose* poses,
                          const anim_ctrl ctrl, anim_ctrl_inst inst, const anim_reel reel,
                          const struct anim_ctrl_sequence* seq, float tm, float playrate,
-                         struct allocator* tmp_alloc);
-static void anim_ctrl_calcpose(struct anim_pose* poses, const anim_reel reel, uint clip_idx, float tm);
+                         const float* bone_mask, struct allocator* tmp_alloc);
+static void anim_ctrl_calcpose(struct anim_pose* poses, const anim_reel reel, uint clip_idx,
+                               float tm, const float* bone_mask);
 static void anim_ctrl_blendpose(struct anim_pose* poses, const struct anim_pose* poses_a,
                          const struct anim_pose* poses_b, uint pose_cnt, float blend);
 static void anim_ctrl_startseq(const anim_ctrl ctrl, anim_ctrl_inst inst,
@@ -355,11 +400,17 @@ static int anim_ctrl_checktgroup(const anim_ctrl ctrl, anim_ctrl_inst inst,
                              const struct anim_ctrl_transition_group* tgroup, float tm);
 static float anim_ctrl_updateclip(struct anim_pose* poses, const anim_ctrl ctrl,
                           anim_ctrl_inst inst, const anim_reel reel, uint clip_idx, float tm,
-                          float playrate);
+                          float playrate, const float* bone_mask);
 static float anim_ctrl_updateblendtree(struct anim_pose* poses,
                                const anim_ctrl ctrl, anim_ctrl_inst inst,
                                const anim_reel reel, uint blendtree_idx, float tm,
-                               float playrate, struct allocator* tmp_alloc);
+                               float playrate, const float* bone_mask,
+                               struct allocator* tmp_alloc);
+
+/*************************************************************************************************
+ * globals
+ */
+static int g_anim_tracks = FALSE;   /* new reels are loaded with ANIM_TRACKS layout */
 
 /*************************************************************************************************
  * inlines
@@ -369,6 +420,40 @@ INLINE char* anim_get_bindname(char* binds, uint idx)
     return binds + idx*32;
 }
 
+/* finds the key that starts the segment of 'frame', 't' receives the interpolator to next key */
+INLINE uint anim_ctrack_findkey(const uint16* frames, uint cnt, uint frame, OUT float* t)
+{
+    uint lo = 0;
+    uint hi = cnt - 1;
+    while (lo < hi) {
+        uint mid = (lo + hi + 1) >> 1;
+        if (frames[mid] <= frame)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+
+    if (lo < cnt - 1 && frames[lo] < frame)
+        *t = (float)(frame - frames[lo]) / (float)(frames[lo + 1] - frames[lo]);
+    else
+        *t = 0.0f;
+    return lo;
+}
+
+/* smallest-three: 3 components in [-1/sqrt(2), 1/sqrt(2)], dropped (largest) one is positive */
+INLINE void anim_ctrack_decoderot(struct quat4f* q, const uint16* key)
+{
+    const float scale = 1.41421356f / H3D_ANIM_QROT_MAX;
+    uint m = (key[0] >> 15) | ((key[1] >> 15) << 1);
+    float c[3];
+    for (uint i = 0; i < 3; i++)
+        c[i] = (float)(key[i] & 0x7fff)*scale - 0.70710678f;
+
+    float w = sqrtf(maxf(0.0f, 1.0f - c[0]*c[0] - c[1]*c[1] - c[2]*c[2]));
+    for (uint i = 0, k = 0; i < 4; i++)
+        q->f[i] = (i == m) ? w : c[k++];
+}
+
 INLINE float anim_calc_duration(float ft, float frame_cnt)
 {
     return ft*frame_cnt;
@@ -487,7 +572,7 @@ anim_reel anim_load(struct allocator* alloc, const char* h3da_filepath, uint thr
         A_LOAD(tmp_alloc);
         return NULL;
     }
-    if (header.version != H3D_VERSION_11)   {
+    if (header.version != H3D_VERSION_11 && header.version != H3D_VERSION_12)   {
         fio_close(f);
         err_printf(__FILE__, __LINE__, "load anim '%s' failed: invalid file version", h3da_filepath);
         A_LOAD(tmp_alloc);
@@ -502,13 +587,36 @@ anim_reel anim_load(struct allocator* alloc, const char* h3da_filepath, uint thr
     /* create stack allocator for proceeding allocations */
     struct stack_alloc stack_mem;
     struct allocator stack_alloc;
+    int compressed = (header.version == H3D_VERSION_12);
+    int tracks = compressed || g_anim_tracks;
+    size_t key_cnt = h3danim.channel_cnt*h3danim.frame_cnt;
+    size_t keys_offset = header.data_offset + sizeof(h3danim);
+    size_t keys_sz = compressed ? (h3danim.clips_offset - keys_offset) : 0;
+    if (compressed && h3danim.clips_offset < keys_offset)   {
+        fio_close(f);
+        err_printf(__FILE__, __LINE__, "load anim '%s' failed: invalid file format", h3da_filepath);
+        A_LOAD(tmp_alloc);
+        return NULL;
+    }
+
     size_t total_sz =
         sizeof(struct anim_reel_data) +
         32*h3danim.channel_cnt +
-        sizeof(struct anim_channel)*h3danim.frame_cnt +
         sizeof(struct anim_clip)*h3danim.clip_cnt +
-        sizeof(struct anim_pose)*h3danim.channel_cnt*h3danim.frame_cnt + 16 +
         hashtable_fixed_estimate_size(h3danim.clip_cnt);
+    if (compressed) {
+        total_sz += sizeof(struct anim_ctrack)*h3danim.channel_cnt + keys_sz + 16;
+    }   else if (tracks) {
+        total_sz +=
+            sizeof(struct anim_track)*h3danim.channel_cnt +
+            sizeof(struct quat4f)*key_cnt + 16 +
+            sizeof(float)*3*key_cnt +
+            (h3danim.has_scale ? sizeof(float)*key_cnt : 0);
+    }   else    {
+        total_sz +=
+            sizeof(struct anim_channel)*h3danim.frame_cnt +
+            sizeof(struct anim_pose)*key_cnt + 16;
+    }
     if (IS_FAIL(mem_stack_create(alloc, &stack_mem, total_sz, MID_GFX))) {
         err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
         fio_close(f);
@@ -534,6 +642,10 @@ anim_reel anim_load(struct allocator* alloc, const char* h3da_filepath, uint thr
     reel->clip_cnt = h3danim.clip_cnt;
     if (h3danim.has_scale)
         BIT_ADD(reel->flags, ANIM_SCALE);
+    if (tracks)
+        BIT_ADD(reel->flags, ANIM_TRACKS);
+    if (compressed)
+        BIT_ADD(reel->flags, ANIM_COMPRESSED);
 
     /* channel data */
     /* bind names is a buffer with each item being 32-byte char
@@ -542,42 +654,21 @@ anim_reel anim_load(struct allocator* alloc, const char* h3da_filepath, uint thr
     ASSERT(reel->binds);
     memset(reel->binds, 0x00, 32*h3danim.channel_cnt);
 
-    uint frame_cnt = h3danim.frame_cnt;
-    /* channels are set of poses in each frame , unlike what is in the file which are poses
-     * so we allocate frame_cnt of channels */
-    reel->channels = (struct anim_channel*)A_ALLOC(&stack_alloc,
-        sizeof(struct anim_channel)*frame_cnt, MID_ANIM);
-    ASSERT(reel->channels);
-    memset(reel->channels, 0x00, sizeof(struct anim_channel)*frame_cnt);
-
-    struct vec4f* pos_scale = (struct vec4f*)A_ALLOC(tmp_alloc, sizeof(struct vec4f)*frame_cnt,
-        MID_ANIM);
-    struct quat4f* rot = (struct quat4f*)A_ALLOC(tmp_alloc, sizeof(struct quat4f)*frame_cnt,
-        MID_ANIM);
-    if (pos_scale == NULL || rot == NULL)   {
+    /* compressed keys are kept as they are in the file and decoded while sampling */
+    result_t r = compressed ? anim_loadctracks(f, reel, &stack_alloc, keys_sz) :
+        anim_loadframes(f, reel, &stack_alloc, tmp_alloc);
+    if (IS_FAIL(r)) {
         fio_close(f);
         anim_unload(reel);
-        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        if (r == RET_OUTOFMEMORY)
+            err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        else
+            err_printf(__FILE__, __LINE__, "load anim '%s' failed: invalid channel data",
+                h3da_filepath);
         A_LOAD(tmp_alloc);
         return NULL;
     }
 
-    /* create a big buffer for all poses in all frames and assign them to each channel
-     * (better cache locality) */
-    uint8* pos_buff = (uint8*)A_ALIGNED_ALLOC(&stack_alloc,
-        sizeof(struct anim_pose)*h3danim.channel_cnt*frame_cnt, MID_ANIM);
-    ASSERT(pos_buff);
-
-    for (uint i = 0; i < frame_cnt; i++)
-        reel->channels[i].poses = (struct anim_pose*)
-            (pos_buff + i*reel->pose_cnt*sizeof(struct anim_pose));
-
-    for (uint i = 0; i < h3danim.channel_cnt; i++)
-        anim_loadchannel(f, reel, pos_scale, rot, i, frame_cnt);
-
-    A_FREE(tmp_alloc, pos_scale);
-    A_FREE(tmp_alloc, rot);
-
     /* clips */
     ASSERT(h3danim.clip_cnt > 0);
     reel->clips = (struct anim_clip*)A_ALLOC(&stack_alloc,
@@ -604,6 +695,167 @@ anim_reel anim_load(struct allocator* alloc, const char* h3da_filepath, uint thr
     return reel;
 }
 
+/* reads raw channels (H3D_VERSION_11) into frames or tracks, depending on ANIM_TRACKS flag */
+result_t anim_loadframes(file_t f, anim_reel reel, struct allocator* alloc,
+    struct allocator* tmp_alloc)
+{
+    uint frame_cnt = reel->frame_cnt;
+    size_t key_cnt = reel->pose_cnt*frame_cnt;
+    struct vec4f* pos_scale = (struct vec4f*)A_ALLOC(tmp_alloc, sizeof(struct vec4f)*frame_cnt,
+        MID_ANIM);
+    struct quat4f* rot = (struct quat4f*)A_ALLOC(tmp_alloc, sizeof(struct quat4f)*frame_cnt,
+        MID_ANIM);
+    if (pos_scale == NULL || rot == NULL)
+        return RET_OUTOFMEMORY;
+
+    if (BIT_CHECK(reel->flags, ANIM_TRACKS))  {
+        /* tracks: each pose keeps its frames together, so sampling a few poses doesn't pull
+         * the whole frames into cache */
+        reel->tracks = (struct anim_track*)A_ALLOC(alloc,
+            sizeof(struct anim_track)*reel->pose_cnt, MID_ANIM);
+        struct quat4f* rot_buff = (struct quat4f*)A_ALIGNED_ALLOC(alloc,
+            sizeof(struct quat4f)*key_cnt, MID_ANIM);
+        float* pos_buff = (float*)A_ALLOC(alloc, sizeof(float)*3*key_cnt, MID_ANIM);
+        float* scale_buff = BIT_CHECK(reel->flags, ANIM_SCALE) ?
+            (float*)A_ALLOC(alloc, sizeof(float)*key_cnt, MID_ANIM) : NULL;
+        ASSERT(reel->tracks);
+        ASSERT(rot_buff);
+        ASSERT(pos_buff);
+
+        for (uint i = 0; i < reel->pose_cnt; i++) {
+            struct anim_track* track = &reel->tracks[i];
+            track->rot = rot_buff + i*frame_cnt;
+            track->pos = pos_buff + i*frame_cnt*3;
+            track->scale = scale_buff != NULL ? (scale_buff + i*frame_cnt) : NULL;
+        }
+    }   else    {
+        /* channels are set of poses in each frame , unlike what is in the file which are poses
+         * so we allocate frame_cnt of channels */
+        reel->channels = (struct anim_channel*)A_ALLOC(alloc,
+            sizeof(struct anim_channel)*frame_cnt, MID_ANIM);
+        ASSERT(reel->channels);
+        memset(reel->channels, 0x00, sizeof(struct anim_channel)*frame_cnt);
+
+        /* create a big buffer for all poses in all frames and assign them to each channel
+         * (better cache locality) */
+        uint8* pos_buff = (uint8*)A_ALIGNED_ALLOC(alloc,
+            sizeof(struct anim_pose)*key_cnt, MID_ANIM);
+        ASSERT(pos_buff);
+
+        for (uint i = 0; i < frame_cnt; i++)
+            reel->channels[i].poses = (struct anim_pose*)
+                (pos_buff + i*reel->pose_cnt*sizeof(struct anim_pose));
+    }
+
+    for (uint i = 0; i < reel->pose_cnt; i++)
+        anim_loadchannel(f, reel, pos_scale, rot, i, frame_cnt);
+
+    A_FREE(tmp_alloc, pos_scale);
+    A_FREE(tmp_alloc, rot);
+    return RET_OK;
+}
+
+/* key data of H3D_VERSION_12 files is kept in memory and tracks are set to point into it */
+result_t anim_loadctracks(file_t f, anim_reel reel, struct allocator* alloc, size_t keys_sz)
+{
+    reel->ctracks = (struct anim_ctrack*)A_ALLOC(alloc,
+        sizeof(struct anim_ctrack)*reel->pose_cnt, MID_ANIM);
+    uint8* keys = (uint8*)A_ALIGNED_ALLOC(alloc, keys_sz, MID_ANIM);
+    ASSERT(reel->ctracks);
+    ASSERT(keys);
+    fio_read(f, keys, keys_sz, 1);
+
+    const uint8* end = keys + keys_sz;
+    for (uint i = 0; i < reel->pose_cnt; i++) {
+        struct h3d_anim_channel h3dchannel;
+        struct h3d_anim_ctrack h3dtrack;
+        if (keys + sizeof(h3dchannel) + sizeof(h3dtrack) > end)
+            return RET_FAIL;
+        memcpy(&h3dchannel, keys, sizeof(h3dchannel));
+        memcpy(&h3dtrack, keys + sizeof(h3dchannel), sizeof(h3dtrack));
+        keys += sizeof(h3dchannel) + sizeof(h3dtrack);
+
+        size_t sz = sizeof(uint16)*
+            (4*h3dtrack.pos_cnt + 4*h3dtrack.rot_cnt + 2*h3dtrack.scale_cnt);
+        if (h3dtrack.pos_cnt == 0 || h3dtrack.rot_cnt == 0 || keys + sz > end)
+            return RET_FAIL;
+
+        strcpy(anim_get_bindname(reel->binds, i), h3dchannel.bindto);
+
+        struct anim_ctrack* track = &reel->ctracks[i];
+        const uint16* data = (const uint16*)keys;
+        track->pos_cnt = h3dtrack.pos_cnt;
+        track->pos_frames = data;
+        track->pos = data + h3dtrack.pos_cnt;
+        data += 4*h3dtrack.pos_cnt;
+        track->rot_cnt = h3dtrack.rot_cnt;
+        track->rot_frames = data;
+        track->rot = data + h3dtrack.rot_cnt;
+        data += 4*h3dtrack.rot_cnt;
+        track->scale_cnt = h3dtrack.scale_cnt;
+        track->scale_frames = data;
+        track->scale = data + h3dtrack.scale_cnt;
+
+        for (uint k = 0; k < 3; k++)  {
+            track->pos_min[k] = h3dtrack.pos_min[k];
+            track->pos_range[k] = h3dtrack.pos_extent[k] / H3D_ANIM_QPOS_MAX;
+        }
+        track->scale_min = h3dtrack.scale_min;
+        track->scale_range = h3dtrack.scale_extent / H3D_ANIM_QPOS_MAX;
+
+        keys += sz;
+    }
+
+    return RET_OK;
+}
+
+/* decodes the pose of a compressed track on a frame, keys are interpolated the same way that
+ * h3dimport measures the error when it reduces them (lerp, rotations are nlerped) */
+void anim_ctrack_eval(struct anim_pose* r, const struct anim_ctrack* track, uint frame)
+{
+    float t;
+    uint k;
+
+    /* position */
+    k = anim_ctrack_findkey(track->pos_frames, track->pos_cnt, frame, &t);
+    const uint16* pa = track->pos + k*3;
+    const uint16* pb = (t > 0.0f) ? (pa + 3) : pa;
+    float p[3];
+    for (uint i = 0; i < 3; i++)    {
+        float a = (float)pa[i];
+        p[i] = track->pos_min[i] + (a + ((float)pb[i] - a)*t)*track->pos_range[i];
+    }
+
+    /* scale */
+    float scale = 1.0f;
+    if (track->scale_cnt > 0)   {
+        k = anim_ctrack_findkey(track->scale_frames, track->scale_cnt, frame, &t);
+        float a = (float)track->scale[k];
+        float b = (t > 0.0f) ? (float)track->scale[k + 1] : a;
+        scale = track->scale_min + (a + (b - a)*t)*track->scale_range;
+    }
+
+    vec4_setf(&r->pos_scale, p[0], p[1], p[2], scale);
+
+    /* rotation */
+    k = anim_ctrack_findkey(track->rot_frames, track->rot_cnt, frame, &t);
+    anim_ctrack_decoderot(&r->rot, track->rot + k*3);
+    if (t > 0.0f)   {
+        struct quat4f b;
+        struct quat4f* a = &r->rot;
+        anim_ctrack_decoderot(&b, track->rot + (k + 1)*3);
+
+        float tb = (a->x*b.x + a->y*b.y + a->z*b.z + a->w*b.w) < 0.0f ? -t : t;
+        float ta = 1.0f - t;
+        float x = a->x*ta + b.x*tb;
+        float y = a->y*ta + b.y*tb;
+        float z = a->z*ta + b.z*tb;
+        float w = a->w*ta + b.w*tb;
+        float ilen = 1.0f / sqrtf(x*x + y*y + z*z + w*w);
+        quat_setf(a, x*ilen, y*ilen, z*ilen, w*ilen);
+    }
+}
+
 void anim_loadchannel(file_t f, anim_reel reel, struct vec4f* tmp_pos_scale,
     struct quat4f* tmp_rot, uint pose_idx, uint frame_cnt)
 {
@@ -612,8 +864,23 @@ void anim_loadchannel(file_t f, anim_reel reel, struct vec4f* tmp_pos_scale,
 
     strcpy(anim_get_bindname(reel->binds, pose_idx), h3dchannel.bindto);
     fio_read(f, tmp_pos_scale, sizeof(struct vec4f), frame_cnt);
-    fio_read(f, tmp_rot, sizeof(struct quat4f), frame_cnt);
 
+    if (BIT_CHECK(reel->flags, ANIM_TRACKS))  {
+        struct anim_track* track = &reel->tracks[pose_idx];
+        fio_read(f, track->rot, sizeof(struct quat4f), frame_cnt);
+        for (uint i = 0; i < frame_cnt; i++)  {
+            const struct vec4f* ps = &tmp_pos_scale[i];
+            float* pos = track->pos + i*3;
+            pos[0] = ps->x;
+            pos[1] = ps->y;
+            pos[2] = ps->z;
+            if (track->scale != NULL)
+                track->scale[i] = ps->w;
+        }
+        return;
+    }
+
+    fio_read(f, tmp_rot, sizeof(struct quat4f), frame_cnt);
     for (uint i = 0; i < frame_cnt; i++)  {
         vec4_setv(&reel->channels[i].poses[pose_idx].pos_scale, &tmp_pos_scale[i]);
         quat_setq(&reel->channels[i].poses[pose_idx].rot, &tmp_rot[i]);
@@ -625,6 +892,11 @@ void anim_unload(anim_reel reel)
     A_ALIGNED_FREE(reel->alloc, reel);
 }
 
+void anim_set_tracklayout(int enable)
+{
+    g_anim_tracks = enable;
+}
+
 void anim_update_clip_hierarchal(const anim_reel reel, uint clip_idx, float t,
     const uint* bindmap, const cmphandle_t* xforms, uint frame_force_idx,
     const uint* root_idxs, uint root_idx_cnt, const struct mat3f* root_mat)
@@ -647,23 +919,33 @@ void anim_update_clip_hierarchal(const anim_reel reel, uint clip_idx, float t,
      * normalize between 0~1 */
     float ivalue = (t - (frame_idx * ft)) / ft;
 
-    const struct anim_channel* sampl = &reel->channels[frame_idx + subclip->frame_start];
-    const struct anim_channel* next_sampl = &reel->channels[nextframe_idx + subclip->frame_start];
+    uint frame_a = frame_idx + subclip->frame_start;
+    uint frame_b = nextframe_idx + subclip->frame_start;
+    int tracks = BIT_CHECK(reel->flags, ANIM_TRACKS);
 
+    struct anim_pose poses[ANIM_SAMPLE_BATCH];
+    uint idxs[ANIM_SAMPLE_BATCH];
     struct mat3f xfm;
     mat3_set_ident(&xfm);
 
-    for (uint i = 0, pose_cnt = reel->pose_cnt; i < pose_cnt; i++)    {
-        struct vec3f pos_lerp;
-        struct quat4f rot_slerp;
+    for (uint i = 0, pose_cnt = reel->pose_cnt; i < pose_cnt; i += ANIM_SAMPLE_BATCH)  {
+        uint cnt = minui(ANIM_SAMPLE_BATCH, pose_cnt - i);
+        if (tracks) {
+            for (uint k = 0; k < cnt; k++)
+                idxs[k] = i + k;
+            anim_sampletracks(poses, reel, frame_a, frame_b, idxs, cnt, ivalue);
+        }   else    {
+            anim_blendposes(poses, &reel->channels[frame_a].poses[i],
+                &reel->channels[frame_b].poses[i], cnt, ivalue);
+        }
 
-        vec3_lerp(&pos_lerp, &sampl->poses[i].pos_scale, &next_sampl->poses[i].pos_scale, ivalue);
-        quat_slerp(&rot_slerp, &sampl->poses[i].rot, &next_sampl->poses[i].rot, ivalue);
-        mat3_set_trans_rot(&xfm, &pos_lerp, &rot_slerp);
+        for (uint k = 0; k < cnt; k++)  {
+            mat3_set_trans_rot(&xfm, &poses[k].pos_scale, &poses[k].rot);
 
-        cmphandle_t xfh = xforms[bindmap[i]];
-        struct cmp_xform* xf = (struct cmp_xform*)cmp_getinstancedata(xfh);
-        mat3_setm(&xf->mat, &xfm);
+            cmphandle_t xfh = xforms[bindmap[i + k]];
+            struct cmp_xform* xf = (struct cmp_xform*)cmp_getinstancedata(xfh);
+            mat3_setm(&xf->mat, &xfm);
+        }
     }
 
     for (uint i = 0; i < root_idx_cnt; i++)   {
@@ -695,20 +977,30 @@ void anim_update_clip_skeletal(const anim_reel reel, uint clip_idx, float t,
      * normalize between 0~1 */
     float ivalue = (t - (frame_idx * ft)) / ft;
 
-    const struct anim_channel* sampl = &reel->channels[frame_idx + subclip->frame_start];
-    const struct anim_channel* next_sampl = &reel->channels[nextframe_idx + subclip->frame_start];
+    uint frame_a = frame_idx + subclip->frame_start;
+    uint frame_b = nextframe_idx + subclip->frame_start;
+    int tracks = BIT_CHECK(reel->flags, ANIM_TRACKS);
 
+    struct anim_pose poses[ANIM_SAMPLE_BATCH];
+    uint idxs[ANIM_SAMPLE_BATCH];
     struct mat3f xfm;
     mat3_set_ident(&xfm);
 
-    for (uint i = 0, pose_cnt = reel->pose_cnt; i < pose_cnt; i++)    {
-        struct vec3f pos_lerp;
-        struct quat4f rot_slerp;
+    for (uint i = 0, pose_cnt = reel->pose_cnt; i < pose_cnt; i += ANIM_SAMPLE_BATCH)  {
+        uint cnt = minui(ANIM_SAMPLE_BATCH, pose_cnt - i);
+        if (tracks) {
+            for (uint k = 0; k < cnt; k++)
+                idxs[k] = i + k;
+            anim_sampletracks(poses, reel, frame_a, frame_b, idxs, cnt, ivalue);
+        }   else    {
+            anim_blendposes(poses, &reel->channels[frame_a].poses[i],
+                &reel->channels[frame_b].poses[i], cnt, ivalue);
+        }
 
-        vec3_lerp(&pos_lerp, &sampl->poses[i].pos_scale, &next_sampl->poses[i].pos_scale, ivalue);
-        quat_slerp(&rot_slerp, &sampl->poses[i].rot, &next_sampl->poses[i].rot, ivalue);
-        mat3_set_trans_rot(&xfm, &pos_lerp, &rot_slerp);
-        mat3_setm(&joints[bindmap[i]], &xfm);
+        for (uint k = 0; k < cnt; k++)  {
+            mat3_set_trans_rot(&xfm, &poses[k].pos_scale, &poses[k].rot);
+            mat3_setm(&joints[bindmap[i + k]], &xfm);
+        }
     }
 
     for (uint i = 0; i < root_idx_cnt; i++)   {
@@ -716,6 +1008,148 @@ void anim_update_clip_skeletal(const anim_reel reel, uint clip_idx, float t,
     }
 }
 
+/* gathers 'cnt' poses (indexed by 'idxs') of two frames from tracks and interpolates them into 'r'
+ * cnt must be <= ANIM_SAMPLE_BATCH */
+void anim_sampletracks(struct anim_pose* r, const anim_reel reel, uint frame_a, uint frame_b,
+    const uint* idxs, uint cnt, float t)
+{
+    struct anim_pose a[ANIM_SAMPLE_BATCH];
+    struct anim_pose b[ANIM_SAMPLE_BATCH];
+    ASSERT(cnt <= ANIM_SAMPLE_BATCH);
+
+    if (BIT_CHECK(reel->flags, ANIM_COMPRESSED))    {
+        for (uint i = 0; i < cnt; i++)  {
+            const struct anim_ctrack* track = &reel->ctracks[idxs[i]];
+            anim_ctrack_eval(&a[i], track, frame_a);
+            anim_ctrack_eval(&b[i], track, frame_b);
+        }
+        anim_blendposes(r, a, b, cnt, t);
+        return;
+    }
+
+    for (uint i = 0; i < cnt; i++)  {
+        const struct anim_track* track = &reel->tracks[idxs[i]];
+        const float* pa = track->pos + frame_a*3;
+        const float* pb = track->pos + frame_b*3;
+        float sa = 1.0f;
+        float sb = 1.0f;
+        if (track->scale != NULL)   {
+            sa = track->scale[frame_a];
+            sb = track->scale[frame_b];
+        }
+
+        vec4_setf(&a[i].pos_scale, pa[0], pa[1], pa[2], sa);
+        vec4_setf(&b[i].pos_scale, pb[0], pb[1], pb[2], sb);
+        quat_setq(&a[i].rot, &track->rot[frame_a]);
+        quat_setq(&b[i].rot, &track->rot[frame_b]);
+    }
+
+    anim_blendposes(r, a, b, cnt, t);
+}
+
+/* interpolates poses: positions (and scales) are lerped and rotations are nlerped, four poses at
+ * a time with rotation components transposed into x/y/z/w lanes
+ * rotations that are farther than ANIM_NLERP_MINDOT (~36 degrees) are slerped instead, so nlerp
+ * error stays below ~0.06 degrees. 'r' can be the same array as 'a' or 'b' */
+#if defined(_SIMD_SSE_)
+void anim_blendposes(struct anim_pose* r, const struct anim_pose* a, const struct anim_pose* b,
+    uint cnt, float t)
+{
+    struct quat4f rots[4];
+    simd_t _t = _mm_set1_ps(t);
+    simd_t _zero = _mm_setzero_ps();
+    simd_t _signbit = _mm_set1_ps(-0.0f);
+    simd_t _mindot = _mm_set1_ps(ANIM_NLERP_MINDOT);
+    uint cnt4 = cnt & ~3u;
+
+    for (uint i = 0; i < cnt4; i += 4)    {
+        simd_t _ax = _mm_load_ps(a[i].rot.f);
+        simd_t _ay = _mm_load_ps(a[i+1].rot.f);
+        simd_t _az = _mm_load_ps(a[i+2].rot.f);
+        simd_t _aw = _mm_load_ps(a[i+3].rot.f);
+        simd_t _bx = _mm_load_ps(b[i].rot.f);
+        simd_t _by = _mm_load_ps(b[i+1].rot.f);
+        simd_t _bz = _mm_load_ps(b[i+2].rot.f);
+        simd_t _bw = _mm_load_ps(b[i+3].rot.f);
+        _MM_TRANSPOSE4_PS(_ax, _ay, _az, _aw);
+        _MM_TRANSPOSE4_PS(_bx, _by, _bz, _bw);
+
+        /* take the shortest path: negate b where dot(a, b) < 0 */
+        simd_t _dot = _mm_mul_ps(_ax, _bx);
+        _dot = _mm_madd(_ay, _by, _dot);
+        _dot = _mm_madd(_az, _bz, _dot);
+        _dot = _mm_madd(_aw, _bw, _dot);
+        simd_t _neg = _mm_and_ps(_mm_cmplt_ps(_dot, _zero), _signbit);
+        _bx = _mm_xor_ps(_bx, _neg);
+        _by = _mm_xor_ps(_by, _neg);
+        _bz = _mm_xor_ps(_bz, _neg);
+        _bw = _mm_xor_ps(_bw, _neg);
+        int slerp_mask = _mm_movemask_ps(_mm_cmplt_ps(_mm_xor_ps(_dot, _neg), _mindot));
+
+        /* nlerp: normalize(a + (b - a)*t) */
+        simd_t _rx = _mm_madd(_mm_sub_ps(_bx, _ax), _t, _ax);
+        simd_t _ry = _mm_madd(_mm_sub_ps(_by, _ay), _t, _ay);
+        simd_t _rz = _mm_madd(_mm_sub_ps(_bz, _az), _t, _az);
+        simd_t _rw = _mm_madd(_mm_sub_ps(_bw, _aw), _t, _aw);
+        simd_t _len = _mm_mul_ps(_rx, _rx);
+        _len = _mm_madd(_ry, _ry, _len);
+        _len = _mm_madd(_rz, _rz, _len);
+        _len = _mm_sqrt_ps(_mm_madd(_rw, _rw, _len));
+        _rx = _mm_div_ps(_rx, _len);
+        _ry = _mm_div_ps(_ry, _len);
+        _rz = _mm_div_ps(_rz, _len);
+        _rw = _mm_div_ps(_rw, _len);
+        _MM_TRANSPOSE4_PS(_rx, _ry, _rz, _rw);
+        _mm_store_ps(rots[0].f, _rx);
+        _mm_store_ps(rots[1].f, _ry);
+        _mm_store_ps(rots[2].f, _rz);
+        _mm_store_ps(rots[3].f, _rw);
+
+        /* each pose only reads it's own source poses, so 'r' can alias them */
+        for (uint k = 0; k < 4; k++)  {
+            uint idx = i + k;
+            simd_t _pa = _mm_load_ps(a[idx].pos_scale.f);
+            simd_t _pb = _mm_load_ps(b[idx].pos_scale.f);
+            _mm_store_ps(r[idx].pos_scale.f, _mm_madd(_mm_sub_ps(_pb, _pa), _t, _pa));
+
+            if (slerp_mask & (1<<k))
+                quat_slerp(&r[idx].rot, &a[idx].rot, &b[idx].rot, t);
+            else
+                quat_setq(&r[idx].rot, &rots[k]);
+        }
+    }
+
+    /* remaining poses, same rules as above one pose at a time */
+    for (uint i = cnt4; i < cnt; i++)   {
+        simd_t _pa = _mm_load_ps(a[i].pos_scale.f);
+        simd_t _pb = _mm_load_ps(b[i].pos_scale.f);
+        _mm_store_ps(r[i].pos_scale.f, _mm_madd(_mm_sub_ps(_pb, _pa), _t, _pa));
+
+        const struct quat4f* qa = &a[i].rot;
+        const struct quat4f* qb = &b[i].rot;
+        float dot = qa->x*qb->x + qa->y*qb->y + qa->z*qb->z + qa->w*qb->w;
+        float s = dot < 0.0f ? -1.0f : 1.0f;
+        if (dot*s < ANIM_NLERP_MINDOT)  {
+            quat_slerp(&r[i].rot, qa, qb, t);
+            continue;
+        }
+
+        struct quat4f q;
+        quat_setf(&q, qa->x + (qb->x*s - qa->x)*t, qa->y + (qb->y*s - qa->y)*t,
+            qa->z + (qb->z*s - qa->z)*t, qa->w + (qb->w*s - qa->w)*t);
+        quat_norm(&r[i].rot, &q);
+    }
+}
+#else
+void anim_blendposes(struct anim_pose* r, const struct anim_pose* a, const struct anim_pose* b,
+    uint cnt, float t)
+{
+    for (uint i = 0; i < cnt; i++)   {
+        vec3_lerp(&r[i].pos_scale, &a[i].pos_scale, &b[i].pos_scale, t);
+        quat_slerp(&r[i].rot, &a[i].rot, &b[i].rot, t);
+    }
+}
+#endif
 
 uint anim_findclip(const anim_reel reel, const char* name)
 {
@@ -1314,7 +1748,7 @@ void anim_ctrl_updatestate(struct anim_pose* poses, const anim_ctrl ctrl, anim_c
     const struct anim_ctrl_state* cstate = &ctrl->states[state_idx];
 
     float progress = anim_ctrl_updateseq(poses, ctrl, inst, reel, &cstate->seq, tm, inst->playrate,
-        tmp_alloc);
+        inst->layers[layer_idx].bone_mask, tmp_alloc);
 
     /* only update progress for blendtrees because they are recursive */
     if (cstate->seq.type == ANIM_CTRL_SEQUENCE_BLENDTREE)
@@ -1325,19 +1759,21 @@ void anim_ctrl_updatestate(struct anim_pose* poses, const anim_ctrl ctrl, anim_c
 float anim_ctrl_updateseq(struct anim_pose* poses,
                          const anim_ctrl ctrl, anim_ctrl_inst inst, const anim_reel reel,
                          const struct anim_ctrl_sequence* seq, float tm, float playrate,
-                         struct allocator* tmp_alloc)
+                         const float* bone_mask, struct allocator* tmp_alloc)
 {
-    if (seq->type == ANIM_CTRL_SEQUENCE_CLIP)
-        return anim_ctrl_updateclip(poses, ctrl, inst, reel, seq->idx, tm, playrate);
-    else if (seq->type == ANIM_CTRL_SEQUENCE_BLENDTREE)
-        return anim_ctrl_updateblendtree(poses, ctrl, inst, reel, seq->idx, tm, playrate, tmp_alloc);
+    if (seq->type == ANIM_CTRL_SEQUENCE_CLIP)   {
+        return anim_ctrl_updateclip(poses, ctrl, inst, reel, seq->idx, tm, playrate, bone_mask);
+    }   else if (seq->type == ANIM_CTRL_SEQUENCE_BLENDTREE) {
+        return anim_ctrl_updateblendtree(poses, ctrl, inst, reel, seq->idx, tm, playrate,
+            bone_mask, tmp_alloc);
+    }
     return 0.0f;
 }
 
 /* returns progress */
 float anim_ctrl_updateclip(struct anim_pose* poses, const anim_ctrl ctrl,
                           anim_ctrl_inst inst, const anim_reel reel, uint clip_idx, float tm,
-                          float playrate)
+                          float playrate, const float* bone_mask)
 {
     struct anim_ctrl_clip_inst* iclip = &inst->clips[clip_idx];
 
@@ -1354,12 +1790,14 @@ float anim_ctrl_updateclip(struct anim_pose* poses, const anim_ctrl ctrl,
     }
 
     /* interpolate frames */
-    anim_ctrl_calcpose(poses, reel, iclip->rclip_idx, iclip->tm);
+    anim_ctrl_calcpose(poses, reel, iclip->rclip_idx, iclip->tm, bone_mask);
 
     return iclip->progress;
 }
 
-void anim_ctrl_calcpose(struct anim_pose* poses, const anim_reel reel, uint clip_idx, float tm)
+/* bone_mask: poses with zero multipliers are not sampled from tracks (ANIM_TRACKS reels only) */
+void anim_ctrl_calcpose(struct anim_pose* poses, const anim_reel reel, uint clip_idx, float tm,
+                        const float* bone_mask)
 {
     const struct anim_clip* clip = &reel->clips[clip_idx];
     float ft = reel->ft;
@@ -1370,26 +1808,59 @@ void anim_ctrl_calcpose(struct anim_pose* poses, const anim_reel reel, uint clip
 
     float interpolate = (tm - (frame_idx*ft)) / ft;
 
-    const struct anim_channel* frame_a = &reel->channels[frame_idx + clip->frame_start];
-    const struct anim_channel* frame_b = &reel->channels[frame_next_idx + clip->frame_start];
+    uint frame_a = frame_idx + clip->frame_start;
+    uint frame_b = frame_next_idx + clip->frame_start;
+
+    if (!BIT_CHECK(reel->flags, ANIM_TRACKS))  {
+        anim_ctrl_blendpose(poses, reel->channels[frame_a].poses, reel->channels[frame_b].poses,
+            reel->pose_cnt, interpolate);
+        return;
+    }
+
+    /* masked poses are set to identity instead of sampled, they are still blended by sequences
+     * and transitions, so they must hold valid values */
+    struct anim_pose batch[ANIM_SAMPLE_BATCH];
+    uint idxs[ANIM_SAMPLE_BATCH];
+    uint cnt = 0;
 
-    anim_ctrl_blendpose(poses, frame_a->poses, frame_b->poses, reel->pose_cnt, interpolate);
+    for (uint i = 0, pose_cnt = reel->pose_cnt; i < pose_cnt; i++)    {
+        if (bone_mask[i] == 0.0f)   {
+            vec4_setf(&poses[i].pos_scale, 0.0f, 0.0f, 0.0f, 1.0f);
+            quat_setidentity(&poses[i].rot);
+            continue;
+        }
+
+        idxs[cnt++] = i;
+        if (cnt == ANIM_SAMPLE_BATCH)   {
+            anim_sampletracks(batch, reel, frame_a, frame_b, idxs, cnt, interpolate);
+            for (uint k = 0; k < cnt; k++)  {
+                vec4_setv(&poses[idxs[k]].pos_scale, &batch[k].pos_scale);
+                quat_setq(&poses[idxs[k]].rot, &batch[k].rot);
+            }
+            cnt = 0;
+        }
+    }
+
+    if (cnt > 0)    {
+        anim_sampletracks(batch, reel, frame_a, frame_b, idxs, cnt, interpolate);
+        for (uint k = 0; k < cnt; k++)  {
+            vec4_setv(&poses[idxs[k]].pos_scale, &batch[k].pos_scale);
+            quat_setq(&poses[idxs[k]].rot, &batch[k].rot);
+        }
+    }
 }
 
 void anim_ctrl_blendpose(struct anim_pose* poses, const struct anim_pose* poses_a,
                          const struct anim_pose* poses_b, uint pose_cnt, float blend)
 {
-    for (uint i = 0; i < pose_cnt; i++)   {
-        vec3_lerp(&poses[i].pos_scale, &poses_a[i].pos_scale, &poses_b[i].pos_scale, blend);
-        quat_slerp(&poses[i].rot, &poses_a[i].rot, &poses_b[i].rot, blend);
-    }
+    anim_blendposes(poses, poses_a, poses_b, pose_cnt, blend);
 }
 
 /* returns progress */
 float anim_ctrl_updateblendtree(struct anim_pose* poses,
     const anim_ctrl ctrl, anim_ctrl_inst inst,
     const anim_reel reel, uint blendtree_idx, float tm,
-    float playrate, struct allocator* tmp_alloc)
+    float playrate, const float* bone_mask, struct allocator* tmp_alloc)
 {
     const struct anim_ctrl_blendtree* bt = &ctrl->blendtrees[blendtree_idx];
     struct anim_ctrl_blendtree_inst* ibt = &inst->blendtrees[blendtree_idx];
@@ -1427,9 +1898,9 @@ float anim_ctrl_updateblendtree(struct anim_pose* poses,
         ASSERT(poses_b);
 
         float progress_a = anim_ctrl_updateseq(poses_a, ctrl, inst, reel, seq_a, tm, playrate,
-            tmp_alloc);
+            bone_mask, tmp_alloc);
         float progress_b = anim_ctrl_updateseq(poses_b, ctrl, inst, reel, seq_b, tm, playrate,
-            tmp_alloc);
+            bone_mask, tmp_alloc);
 
         A_ALIGNED_FREE(tmp_alloc, poses_a);
         A_ALIGNED_FREE(tmp_alloc, poses_b);
@@ -1439,7 +1910,8 @@ float anim_ctrl_updateblendtree(struct anim_pose* poses,
         progress = (1.0f - blend)*progress_a + blend*progress_b;
     }    else   {
         const struct anim_ctrl_sequence* seq = &bt->child_seqs[idx];
-        progress = anim_ctrl_updateseq(poses, ctrl, inst, reel, seq, tm, playrate, tmp_alloc);
+        progress = anim_ctrl_updateseq(poses, ctrl, inst, reel, seq, tm, playrate, bone_mask,
+            tmp_alloc);
     }
 
     return progress;
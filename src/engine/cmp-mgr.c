@@ -14,11 +14,13 @@
  ***********************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "dhcore/core.h"
 #include "dhcore/array.h"
 #include "dhcore/pool-alloc.h"
 #include "dhcore/linked-list.h"
 #include "dhcore/hash-table.h"
+#include "dhcore/task-mgr.h"
 
 #include "cmp-mgr.h"
 #include "mem-ids.h"
@@ -27,8 +29,13 @@
 #include "scene-mgr.h"
 #include "console.h"
 #include "engine.h"
+#include "frame-graph.h"
 
 #define CHAIN_POOLSIZE  1000
+#define CMP_DEPS_MAX 8
+#define CMP_UPDATE_BATCH 64 /* default minimum instances per thread for range updates */
+#define CMP_RANGEBATCH_MAX 32
+#define CMP_SORT_RATIO 8    /* re-sort packed instances after 1/N of them are created/destroyed */
 
 /*************************************************************************************************
  * types
@@ -42,13 +49,21 @@ struct cmp_component
     pfn_cmp_create create_func;
     pfn_cmp_destroy destroy_func;
     pfn_cmp_update update_funcs[CMP_UPDATE_MAXSTAGE]; /* for each stage (each elem can be NULL) */
+    pfn_cmp_update_range update_range_funcs[CMP_UPDATE_MAXSTAGE];
     pfn_cmp_debug debug_func;
+    pfn_cmp_release release_func;
+    uint update_batch;
+    uint dep_cnt;
+    cmptype_t deps[CMP_DEPS_MAX];
 
     uint stride; /* single data size */
     uint cur_idx; /* end index of the data_buff */
     uint instance_cnt;
     uint grow_cnt;
     uint update_cnt;  /* number of updates in update_refs */
+    uint sort_cnt;  /* created/destroyed instances since last sort (CMP_FLAG_PACKED) */
+    int updates_unsorted;   /* update_refs is not in data order (CMP_FLAG_PACKED) */
+    uint data_gen;  /* increased when instance data is moved (see cmp_get_datagen) */
     struct allocator* alloc;
     uint* indexes; /* indexes to valid data slots */
     struct cmp_instance_desc* instances;
@@ -66,9 +81,30 @@ struct cmp_mgr
     struct pool_alloc chainnode_pool; /* item: cmp_chain_node */
     struct array deferred_instances;    /* item: cmphandle_t */
     cmp_chain debug_list;   /* debug items */
+    uint16 type_idxs[0x10000];   /* component index+1 for each type (0 = not registered) */
 
     struct allocator* alloc;    /* used for modify */
     struct allocator* tmp_alloc; /* used for modify */
+    uint update_thread; /* thread that runs current update stage */
+};
+
+/* sort key of packed instances */
+struct cmp_sort_item
+{
+    uptr_t key; /* host object */
+    uint slot;
+};
+
+/* group of components that their range updates are processed together in one parallel loop */
+struct cmp_range_batch
+{
+    uint stage_id;
+    uint thread_id;
+    float dt;
+    void* param;
+    uint cnt;
+    cmp_t cmps[CMP_RANGEBATCH_MAX];
+    uint offsets[CMP_RANGEBATCH_MAX+1];   /* start of each component in the combined range */
 };
 
 /*************************************************************************************************
@@ -79,12 +115,22 @@ uint8* cmp_get_valuedata(cmphandle_t hdl, const char* name, struct cmp_obj** pho
     pfn_cmp_modify* pmod_fn, const struct cmp_value** pcval);
 cmp_t cmp_create_component(struct allocator* alloc, const struct cmp_createparams* params);
 void cmp_destroy_component(cmp_t c);
-result_t cmp_grow_component(cmp_t c);
+result_t cmp_grow_component(cmp_t c, uint nsize);
 void cmp_setcommonhdl(struct cmp_obj* obj, cmphandle_t hdl, cmptype_t type);
 
 result_t cmp_console_debug(uint argc, const char ** argv, void* param);
 result_t cmp_console_undebug(uint argc, const char ** argv, void* param);
 void cmp_update_hdl_inchain(cmp_chain chain, cmphandle_t cur_hdl, cmphandle_t new_hdl);
+void cmp_update_batch(struct cmp_range_batch* batch);
+void cmp_update_ranges(struct cmp_range_batch* batch);
+void cmp_update_range_fn(uint start, uint end, uint thread_id, void* param);
+result_t cmp_value_setbatch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    const void* value, uint size, enum cmp_valuetype type);
+void cmp_pack_freeslot(cmp_t c);
+result_t cmp_sort_instances(cmp_t c);
+void cmp_sort_updates(cmp_t c);
+int cmp_sort_cmp(const void* a, const void* b);
+int cmp_sort_refcmp(const void* a, const void* b);
 
 /*************************************************************************************************
  * globals
@@ -94,6 +140,28 @@ struct cmp_mgr g_cmp;
 /*************************************************************************************************
  * inlines
  */
+INLINE int cmp_depends(cmp_t c, cmptype_t type)
+{
+    for (uint i = 0; i < c->dep_cnt; i++)   {
+        if (c->deps[i] == type)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/* walks the chain, used when the component doesn't have an object slot */
+INLINE cmphandle_t cmp_findinstance_inchain(cmp_chain chain, cmptype_t type)
+{
+    struct linked_list* node = chain;
+    while (node != NULL)    {
+        struct cmp_chain_node* chnode = (struct cmp_chain_node*)node->data;
+        if (type == CMP_GET_TYPE(chnode->hdl))
+            return chnode->hdl;
+        node = node->next;
+    }
+    return INVALID_HANDLE;
+}
+
 INLINE struct cmp_instance_desc* cmp_get_inst(cmphandle_t hdl)
 {
     uint16 idx = CMP_GET_INDEX(hdl);
@@ -172,6 +240,20 @@ void cmp_releasemgr()
 
 result_t cmp_register_component(struct allocator* alloc, const struct cmp_createparams* params)
 {
+    /* dependencies must be registered before, so update order (registration order) is valid */
+    if (params->dep_cnt > CMP_DEPS_MAX) {
+        err_printf(__FILE__, __LINE__, "cmp-register failed: too many dependencies for '%s'",
+            params->name);
+        return RET_FAIL;
+    }
+    for (uint i = 0; i < params->dep_cnt; i++)  {
+        if (cmp_findtype(params->deps[i]) == NULL)  {
+            err_printf(__FILE__, __LINE__, "cmp-register failed: dependency 0x%x of '%s' is not "
+                "registered", params->deps[i], params->name);
+            return RET_FAIL;
+        }
+    }
+
     cmp_t c = cmp_create_component(alloc, params);
     if (c == NULL)  {
         err_printf(__FILE__, __LINE__, "cmp-register failed: could not register component '%s'",
@@ -189,6 +271,7 @@ result_t cmp_register_component(struct allocator* alloc, const struct cmp_create
     /* assign ID (index+1) */
     c->id = g_cmp.cmps.item_cnt;
     *pc = c;
+    g_cmp.type_idxs[c->type] = (uint16)c->id;
     return RET_OK;
 }
 
@@ -206,9 +289,16 @@ cmp_t cmp_create_component(struct allocator* alloc, const struct cmp_createparam
     c->create_func = params->create_func;
     c->destroy_func = params->destroy_func;
     c->debug_func = params->debug_func;
+    c->release_func = params->release_func;
 
-    for (uint i = 0; i < CMP_UPDATE_MAXSTAGE; i++)
+    for (uint i = 0; i < CMP_UPDATE_MAXSTAGE; i++)    {
         c->update_funcs[i] = params->update_funcs[i];
+        c->update_range_funcs[i] = params->update_range_funcs[i];
+    }
+    c->update_batch = params->update_batch != 0 ? params->update_batch : CMP_UPDATE_BATCH;
+    c->dep_cnt = params->dep_cnt;
+    for (uint i = 0; i < params->dep_cnt; i++)
+        c->deps[i] = params->deps[i];
     c->alloc = alloc;
     c->stride = params->stride;
     c->grow_cnt = params->grow_cnt;
@@ -255,6 +345,9 @@ void cmp_destroy_component(cmp_t c)
 
     struct allocator* alloc = c->alloc;
 
+    if (c->release_func != NULL)
+        c->release_func(c);
+
     if (c->indexes != NULL)
         A_FREE(alloc, c->indexes);
     if (c->instances != NULL)
@@ -269,10 +362,10 @@ void cmp_destroy_component(cmp_t c)
     A_FREE(alloc, c);
 }
 
-result_t cmp_grow_component(cmp_t c)
+result_t cmp_grow_component(cmp_t c, uint nsize)
 {
     /* realloc */
-    uint nsize = c->instance_cnt + c->grow_cnt;
+    ASSERT(nsize > c->instance_cnt);
     struct allocator* alloc = c->alloc;
 
     uint* indexes = (uint*)A_ALLOC(alloc, sizeof(uint)*nsize, MID_CMP);
@@ -317,6 +410,7 @@ result_t cmp_grow_component(cmp_t c)
     c->instances = instances;
     c->update_refs = update_refs;
     c->data_buff = (uint8*)buffer;
+    c->data_gen ++;
 
     /* increase number of instances */
     c->instance_cnt = nsize;
@@ -334,6 +428,55 @@ cmphandle_t cmp_create_instance_forobj(const char* cmpname, struct cmp_obj* obj)
     }
 }
 
+cmphandle_t cmp_create_instance_copy(cmp_t c, struct cmp_obj* obj, const void* src_data)
+{
+    cmphandle_t hdl = cmp_create_instance(c, obj, 0, INVALID_HANDLE, 0);
+    if (hdl == INVALID_HANDLE)
+        return INVALID_HANDLE;
+
+    /* only public values are copied, internal data is rebuilt by modify callbacks */
+    const struct cmp_value* values = c->values;
+    uint8* data = (uint8*)cmp_getinstancedata(hdl);
+    for (uint i = 0; i < c->value_cnt; i++)  {
+        memcpy(data + values[i].offset, (const uint8*)src_data + values[i].offset,
+            values[i].stride*values[i].elem_cnt);
+    }
+
+    /* deferred-modify instances are already queued (cmp_prepare_deferredinstances) */
+    if (BIT_CHECK(c->flags, CMP_FLAG_DEFERREDMODIFY))
+        return hdl;
+
+    for (uint i = 0; i < c->value_cnt; i++)  {
+        /* each distinct modify callback is applied once, values may share callbacks */
+        pfn_cmp_modify mod_fn = values[i].modify_func;
+        if (mod_fn == NULL)
+            continue;
+        uint k;
+        for (k = 0; k < i && values[k].modify_func != mod_fn; k++)   {}
+        if (k != i)
+            continue;
+
+        /* data is fetched for each call, modify callbacks may move packed instances */
+        if (IS_FAIL(mod_fn(obj, g_cmp.alloc, g_cmp.tmp_alloc, cmp_getinstancedata(hdl), hdl)))  {
+            log_printf(LOG_WARNING, "modify value '%s' for object '%s' failed", values[i].name,
+                obj->name);
+        }
+    }
+
+    return hdl;
+}
+
+result_t cmp_reserve_instances(cmp_t c, uint cnt)
+{
+    uint nsize = c->cur_idx + cnt;
+    if (nsize <= c->instance_cnt)
+        return RET_OK;
+
+    /* grow once, rounded up to component's grow count */
+    uint grow_cnt = maxui(c->grow_cnt, 1);
+    nsize = c->instance_cnt + ((nsize - c->instance_cnt + grow_cnt - 1)/grow_cnt)*grow_cnt;
+    return cmp_grow_component(c, nsize);
+}
 
 cmphandle_t cmp_create_instance(cmp_t c, struct cmp_obj* obj, uint flags,
     OPTIONAL cmphandle_t parent_hdl, OPTIONAL uint offset_in_parent)
@@ -341,7 +484,7 @@ cmphandle_t cmp_create_instance(cmp_t c, struct cmp_obj* obj, uint flags,
     result_t r = RET_OK;
     uint idx = c->cur_idx;
     if (idx == c->instance_cnt) {
-        if (IS_FAIL(cmp_grow_component(c)))
+        if (IS_FAIL(cmp_grow_component(c, c->instance_cnt + c->grow_cnt)))
             return INVALID_HANDLE;
     }
 
@@ -369,6 +512,9 @@ cmphandle_t cmp_create_instance(cmp_t c, struct cmp_obj* obj, uint flags,
     if (!BIT_CHECK(flags, CMP_INSTANCEFLAG_INDIRECTHOST))   {
         ASSERT(obj != NULL);
         list_add(&obj->chain, &chain_node->node, chain_node);
+        /* newest instance is the head of the chain, so it also takes the slot */
+        if (c->id <= CMP_OBJ_SLOTCNT)
+            obj->cmps[c->id-1] = hdl;
     }   else    {
         ASSERT(parent_hdl != INVALID_HANDLE);
         inst->parent_hdl = parent_hdl;
@@ -377,6 +523,7 @@ cmphandle_t cmp_create_instance(cmp_t c, struct cmp_obj* obj, uint flags,
     }
 
     c->cur_idx ++;
+    c->sort_cnt ++;
 
     /* call create callback function */
     if (c->create_func != NULL)
@@ -430,6 +577,10 @@ void cmp_destroy_instance(cmphandle_t hdl)
             }
             node = node->next;
         }
+
+        /* another instance of the same type may still be in the chain */
+        if (c_idx < CMP_OBJ_SLOTCNT && host_obj->cmps[c_idx] == hdl)
+            host_obj->cmps[c_idx] = cmp_findinstance_inchain(host_obj->chain, c->type);
     }   else    {
         ASSERT(instance->parent_hdl != INVALID_HANDLE);
 
@@ -473,6 +624,8 @@ void cmp_destroy_instance(cmphandle_t hdl)
             ASSERT(last_instance->host);
             cmp_update_hdl_inchain(last_instance->host->chain, last_instance->hdl, hdl);
             cmp_setcommonhdl(last_instance->host, hdl, c->type);
+            if (c_idx < CMP_OBJ_SLOTCNT && last_instance->host->cmps[c_idx] == last_instance->hdl)
+                last_instance->host->cmps[c_idx] = hdl;
         }    else   {
             ASSERT(last_instance->parent_hdl != INVALID_HANDLE);
             struct cmp_instance_desc* parent_inst = cmp_get_inst(last_instance->parent_hdl);
@@ -501,6 +654,169 @@ void cmp_destroy_instance(cmphandle_t hdl)
     }
 
     c->cur_idx --;
+    if (BIT_CHECK(c->flags, CMP_FLAG_PACKED))
+        cmp_pack_freeslot(c);
+}
+
+/* walks each component buffer once, from the end, so when flagged hosts own the tail of the
+ * buffer (usually the case when a whole scene is released), destroyed instances are the last ones
+ * and the swap trick and packing are skipped
+ * types are visited in reverse registration order, so components are destroyed before the ones
+ * they depend on (transforms last) */
+void cmp_destroy_hostinstances(uint tmp_flag)
+{
+    cmp_t* cmps = (cmp_t*)g_cmp.cmps.buffer;
+    for (int i = g_cmp.cmps.item_cnt - 1; i >= 0; i--)    {
+        cmp_t c = cmps[i];
+        for (uint idx = c->cur_idx; idx > 0; idx--)  {
+            /* destroy callbacks may have removed more instances */
+            if (idx > c->cur_idx)
+                continue;
+
+            /* indirect instances are destroyed with their parents */
+            struct cmp_instance_desc* inst = &c->instances[c->indexes[idx - 1]];
+            if (!BIT_CHECK(inst->flags, CMP_INSTANCEFLAG_INDIRECTHOST) &&
+                BIT_CHECK(inst->host->tmp_flags, tmp_flag))
+            {
+                cmp_destroy_instance(inst->hdl);
+            }
+        }
+    }
+}
+
+/* packed components: moves the last instance data into the freed slot, so live instances are
+ * always in [0, cur_idx) slots */
+void cmp_pack_freeslot(cmp_t c)
+{
+    uint free_slot = c->indexes[c->cur_idx];
+    uint last_slot = c->cur_idx;
+    c->sort_cnt ++;
+    if (free_slot == last_slot)
+        return;
+
+    struct cmp_instance_desc* src = &c->instances[last_slot];
+    struct cmp_instance_desc* dest = &c->instances[free_slot];
+    uint8* data = dest->data;
+    c->data_gen ++;
+    memcpy(data, src->data, c->stride);
+    memcpy(dest, src, sizeof(struct cmp_instance_desc));
+    dest->data = data;
+    if (dest->updatelist_idx != INVALID_INDEX)  {
+        c->update_refs[dest->updatelist_idx] = dest;
+        c->updates_unsorted = TRUE;
+    }
+
+    c->indexes[CMP_GET_INSTANCEINDEX(dest->hdl)] = free_slot;
+    c->indexes[c->cur_idx] = last_slot;
+    src->host = NULL;
+    src->updatelist_idx = INVALID_INDEX;
+}
+
+/* reorders packed instances by their host objects, so instances of different components that
+ * belong to the same objects are stored in the same order. handles stay the same, only their
+ * data slots change */
+result_t cmp_sort_instances(cmp_t c)
+{
+    uint cnt = c->cur_idx;
+    c->sort_cnt = 0;
+    if (cnt < 2)
+        return RET_OK;
+
+    struct allocator* alloc = c->alloc;
+    struct allocator* tmp_alloc = tsk_get_tmpalloc(0);
+    uint stride = c->stride;
+
+    A_SAVE(tmp_alloc);
+    struct cmp_sort_item* items = (struct cmp_sort_item*)A_ALLOC(tmp_alloc,
+        sizeof(struct cmp_sort_item)*cnt, MID_CMP);
+    struct cmp_instance_desc* instances = (struct cmp_instance_desc*)A_ALLOC(alloc,
+        sizeof(struct cmp_instance_desc)*c->instance_cnt, MID_CMP);
+    uint8* buffer = (uint8*)A_ALIGNED_ALLOC(alloc, stride*c->instance_cnt, MID_CMP);
+    if (items == NULL || instances == NULL || buffer == NULL)   {
+        if (instances != NULL)
+            A_FREE(alloc, instances);
+        if (buffer != NULL)
+            A_ALIGNED_FREE(alloc, buffer);
+        A_LOAD(tmp_alloc);
+        return RET_OUTOFMEMORY;
+    }
+
+    for (uint i = 0; i < cnt; i++)  {
+        items[i].key = (uptr_t)c->instances[i].host;
+        items[i].slot = i;
+    }
+    qsort(items, cnt, sizeof(struct cmp_sort_item), cmp_sort_cmp);
+
+    for (uint i = 0; i < cnt; i++)  {
+        const struct cmp_instance_desc* src = &c->instances[items[i].slot];
+        struct cmp_instance_desc* dest = &instances[i];
+        memcpy(dest, src, sizeof(struct cmp_instance_desc));
+        dest->data = buffer + i*stride;
+        memcpy(dest->data, src->data, stride);
+
+        c->indexes[CMP_GET_INSTANCEINDEX(dest->hdl)] = i;
+        if (dest->updatelist_idx != INVALID_INDEX)
+            c->update_refs[dest->updatelist_idx] = dest;
+    }
+
+    /* free handles map to free slots */
+    for (uint i = cnt; i < c->instance_cnt; i++)    {
+        c->indexes[i] = i;
+        instances[i].host = NULL;
+        instances[i].data = buffer + i*stride;
+        instances[i].updatelist_idx = INVALID_INDEX;
+    }
+
+    A_LOAD(tmp_alloc);
+    A_FREE(alloc, c->instances);
+    A_ALIGNED_FREE(alloc, c->data_buff);
+    c->instances = instances;
+    c->data_buff = buffer;
+    c->data_gen ++;
+    c->updates_unsorted = TRUE;
+    return RET_OK;
+}
+
+/* sorts update list of packed component by data slots, so range updates walk memory forward */
+void cmp_sort_updates(cmp_t c)
+{
+    if (!c->updates_unsorted)
+        return;
+    c->updates_unsorted = FALSE;
+
+    uint cnt = c->update_cnt;
+    if (cnt*4 >= c->cur_idx)  {
+        /* dense update list: gather updates by walking live slots */
+        uint idx = 0;
+        for (uint i = 0, slot_cnt = c->cur_idx; i < slot_cnt; i++)  {
+            struct cmp_instance_desc* inst = &c->instances[i];
+            if (inst->updatelist_idx != INVALID_INDEX)  {
+                inst->updatelist_idx = idx;
+                c->update_refs[idx++] = inst;
+            }
+        }
+        ASSERT(idx == cnt);
+    }   else    {
+        qsort(c->update_refs, cnt, sizeof(struct cmp_instance_desc*), cmp_sort_refcmp);
+        for (uint i = 0; i < cnt; i++)
+            c->update_refs[i]->updatelist_idx = i;
+    }
+}
+
+int cmp_sort_cmp(const void* a, const void* b)
+{
+    const struct cmp_sort_item* ia = (const struct cmp_sort_item*)a;
+    const struct cmp_sort_item* ib = (const struct cmp_sort_item*)b;
+    if (ia->key != ib->key)
+        return ia->key < ib->key ? -1 : 1;
+    return (int)ia->slot - (int)ib->slot;
+}
+
+int cmp_sort_refcmp(const void* a, const void* b)
+{
+    const struct cmp_instance_desc* ia = *(const struct cmp_instance_desc* const*)a;
+    const struct cmp_instance_desc* ib = *(const struct cmp_instance_desc* const*)b;
+    return (ia < ib) ? -1 : ((ia > ib) ? 1 : 0);
 }
 
 void cmp_updateinstance(cmphandle_t hdl)
@@ -513,6 +829,7 @@ void cmp_updateinstance(cmphandle_t hdl)
     	c->update_refs[c->update_cnt] = &c->instances[r_idx];
     	c->instances[r_idx].updatelist_idx = c->update_cnt;
     	c->update_cnt ++;
+        c->updates_unsorted = TRUE;
     }
 }
 
@@ -528,6 +845,7 @@ void cmp_updateinstance_reset(cmphandle_t hdl)
     	swapptr((void**)&c->update_refs[updatelist_idx], (void**)&c->update_refs[c->update_cnt-1]);
     	c->update_refs[updatelist_idx]->updatelist_idx = updatelist_idx;
     	c->update_cnt --;
+        c->updates_unsorted = TRUE;
 
     	/* reset removed one from instances array */
     	c->instances[r_idx].updatelist_idx = INVALID_INDEX;
@@ -586,13 +904,8 @@ result_t cmp_prepare_deferredinstances(struct allocator* alloc, struct allocator
 
 cmp_t cmp_findtype(cmptype_t type)
 {
-    uint cmp_cnt = g_cmp.cmps.item_cnt;
-    cmp_t* cmps = (cmp_t*)g_cmp.cmps.buffer;
-    for (uint i = 0; i < cmp_cnt; i++)    {
-        if (cmps[i]->type == type)
-            return cmps[i];
-    }
-    return NULL;
+    uint idx = g_cmp.type_idxs[type];
+    return idx != 0 ? ((cmp_t*)g_cmp.cmps.buffer)[idx-1] : NULL;
 }
 
 cmp_t cmp_findname(const char* name)
@@ -620,26 +933,25 @@ cmphandle_t cmp_findinstance_inobj(struct cmp_obj* obj, const char* cmpname)
 {
     cmp_t c = cmp_findname(cmpname);
     if (c != NULL)
-        return cmp_findinstance(obj->chain, c->type);
+        return cmp_findinstance_bytype_inobj(obj, c->type);
     else
         return INVALID_HANDLE;
 }
 
 cmphandle_t cmp_findinstance_bytype_inobj(struct cmp_obj* obj, cmptype_t type)
 {
-    return cmp_findinstance(obj->chain, type);
+    uint idx = g_cmp.type_idxs[type];
+    if (idx == 0)
+        return INVALID_HANDLE;
+    else if (idx <= CMP_OBJ_SLOTCNT)
+        return obj->cmps[idx-1];
+    else
+        return cmp_findinstance_inchain(obj->chain, type);
 }
 
 cmphandle_t cmp_findinstance(cmp_chain chain, cmptype_t type)
 {
-    struct linked_list* node = chain;
-    while (node != NULL)    {
-        struct cmp_chain_node* chnode = (struct cmp_chain_node*)node->data;
-        if (type == CMP_GET_TYPE(chnode->hdl))
-            return chnode->hdl;
-        node = node->next;
-    }
-    return INVALID_HANDLE;
+    return cmp_findinstance_inchain(chain, type);
 }
 
 cmp_t cmp_getbyhdl(cmphandle_t hdl)
@@ -710,16 +1022,21 @@ void cmp_debug(float dt, const struct gfx_view_params* params)
 	}
 }
 
-void cmp_update(float dt, uint stage_id)
+void cmp_update(float dt, uint stage_id, uint thread_id)
 {
 	void* param = NULL;
 
+    /* profiler samples can only be opened in main thread */
 #if defined(_PROFILE_)
     char name[32];
-    sprintf(name, "Stage #%d", stage_id+1);
-    PRF_OPENSAMPLE(name);
+    if (thread_id == 0) {
+        sprintf(name, "Stage #%d", stage_id+1);
+        PRF_OPENSAMPLE(name);
+    }
 #endif
 
+    g_cmp.update_thread = thread_id;
+
 	/* before render stage, we pass active cmdqueue as param */
     switch (stage_id)   {
     case CMP_UPDATE_STAGE4:
@@ -729,14 +1046,123 @@ void cmp_update(float dt, uint stage_id)
         param = NULL;
     }
 
+    /* consecutive components with range callbacks are grouped into batches (components in a
+     * batch do not depend on each other), ranges of the batch are processed in parallel and then
+     * normal update callbacks of the batch are called in registration order */
+    struct cmp_range_batch batch;
+    batch.stage_id = stage_id;
+    batch.thread_id = thread_id;
+    batch.dt = dt;
+    batch.param = param;
+    batch.cnt = 0;
+
 	uint cnt = g_cmp.cmps.item_cnt;
 	for (uint i = 0; i < cnt; i++)	{
 		cmp_t c = ((cmp_t*)g_cmp.cmps.buffer)[i];
-		if (c->update_funcs[stage_id] != NULL)
-			c->update_funcs[stage_id](c, dt, param);
+        if (c->update_range_funcs[stage_id] == NULL)    {
+            if (c->update_funcs[stage_id] != NULL)  {
+                cmp_update_batch(&batch);
+                c->update_funcs[stage_id](c, dt, param);
+            }
+            continue;
+        }
+
+        int flush = (batch.cnt == CMP_RANGEBATCH_MAX);
+        for (uint k = 0; k < batch.cnt && !flush; k++)
+            flush = cmp_depends(c, batch.cmps[k]->type);
+        if (flush)
+            cmp_update_batch(&batch);
+
+        batch.cmps[batch.cnt++] = c;
 	}
+    cmp_update_batch(&batch);
 
-    PRF_CLOSESAMPLE();
+    g_cmp.update_thread = 0;
+#if defined(_PROFILE_)
+    if (thread_id == 0) {
+        PRF_CLOSESAMPLE();
+    }
+#endif
+}
+
+uint cmp_get_updatethread()
+{
+    return g_cmp.update_thread;
+}
+
+void cmp_update_batch(struct cmp_range_batch* batch)
+{
+    if (batch->cnt == 0)
+        return;
+
+    cmp_t cmps[CMP_RANGEBATCH_MAX];
+    uint cnt = batch->cnt;
+    memcpy(cmps, batch->cmps, sizeof(cmp_t)*cnt);
+
+    cmp_update_ranges(batch);
+
+    uint stage_id = batch->stage_id;
+    for (uint i = 0; i < cnt; i++)  {
+        cmp_t c = cmps[i];
+        if (c->update_funcs[stage_id] != NULL)
+            c->update_funcs[stage_id](c, batch->dt, batch->param);
+    }
+    batch->cnt = 0;
+}
+
+void cmp_update_ranges(struct cmp_range_batch* batch)
+{
+    uint stage_id = batch->stage_id;
+    uint total = 0;
+    uint batch_min = 0xffffffff;
+    uint b = 0;
+
+    /* components that are not thread-safe are updated here, the rest are gathered into a single
+     * combined range for parallel processing */
+    for (uint i = 0; i < batch->cnt; i++)  {
+        cmp_t c = batch->cmps[i];
+        if (c->update_cnt == 0)
+            continue;
+
+        if (BIT_CHECK(c->flags, CMP_FLAG_PACKED))
+            cmp_sort_updates(c);
+
+        if (!BIT_CHECK(c->flags, CMP_FLAG_THREADSAFE))    {
+            c->update_range_funcs[stage_id](c, batch->dt, batch->param, 0, c->update_cnt,
+                batch->thread_id);
+            continue;
+        }
+
+        batch->cmps[b] = c;
+        batch->offsets[b] = total;
+        total += c->update_cnt;
+        batch_min = minui(batch_min, c->update_batch);
+        b++;
+    }
+    batch->offsets[b] = total;
+    batch->cnt = b;
+
+    if (total > 0)
+        fgr_parallel_for(cmp_update_range_fn, total, batch_min, batch, batch->thread_id);
+}
+
+/* Runs in main thread and task threads */
+void cmp_update_range_fn(uint start, uint end, uint thread_id, void* param)
+{
+    struct cmp_range_batch* batch = (struct cmp_range_batch*)param;
+
+    for (uint i = 0; i < batch->cnt && start < end; i++)   {
+        uint c_start = batch->offsets[i];
+        uint c_end = batch->offsets[i+1];
+        if (start >= c_end)
+            continue;
+
+        cmp_t c = batch->cmps[i];
+        uint range_end = minui(end, c_end);
+        c->update_range_funcs[batch->stage_id](c, batch->dt, batch->param, start - c_start,
+            range_end - c_start, thread_id);
+        start = range_end;
+    }
 }
 
 void cmp_clear_updates()
@@ -750,6 +1176,10 @@ void cmp_clear_updates()
 
             c->update_cnt = 0;
         }
+
+        /* keep packed instances in host order, data is not referenced between frames */
+        if (BIT_CHECK(c->flags, CMP_FLAG_PACKED) && c->sort_cnt*CMP_SORT_RATIO > c->cur_idx)
+            cmp_sort_instances(c);
     }
 }
 
@@ -1124,12 +1554,129 @@ uint8* cmp_get_valuedata(cmphandle_t hdl, const char* name, struct cmp_obj** pho
     return NULL;
 }
 
+cmpvalhdl_t cmp_value_gethdl(cmptype_t type, const char* name)
+{
+    cmp_t c = cmp_findtype(type);
+    if (c == NULL)
+        return INVALID_INDEX;
+
+    struct hashtable_item* item = hashtable_fixed_find(&c->value_table, hash_str(name));
+    if (item == NULL)
+        return INVALID_INDEX;
+    return CMP_MAKE_VALHDL(c->id - 1, (uint)item->value);
+}
+
+/* writes 'size' bytes of value (or string) to the value of all instances and calls modify */
+result_t cmp_value_setbatch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    const void* value, uint size, enum cmp_valuetype type)
+{
+    if (vhdl == INVALID_INDEX)
+        return RET_INVALIDARG;
+
+    uint c_idx = CMP_VALHDL_GETINDEX(vhdl);
+    ASSERT(c_idx < (uint)g_cmp.cmps.item_cnt);
+    cmp_t c = ((cmp_t*)g_cmp.cmps.buffer)[c_idx];
+    ASSERT(CMP_VALHDL_GETVALUE(vhdl) < c->value_cnt);
+    const struct cmp_value* cval = &c->values[CMP_VALHDL_GETVALUE(vhdl)];
+    ASSERT(cval->type == type);
+    pfn_cmp_modify mod_fn = cval->modify_func;
+
+    result_t r = RET_OK;
+    for (uint i = 0; i < hdl_cnt; i++)  {
+        cmphandle_t hdl = hdls[i];
+        if (hdl == INVALID_HANDLE || CMP_GET_INDEX(hdl) != c_idx)   {
+            r = RET_INVALIDARG;
+            continue;
+        }
+
+        /* instance is fetched for each handle, modify callbacks may move packed instances */
+        struct cmp_instance_desc* inst = &c->instances[c->indexes[CMP_GET_INSTANCEINDEX(hdl)]];
+        if (type != CMP_VALUE_STRING)
+            memcpy(inst->data + cval->offset, value, size);
+        else
+            str_safecpy((char*)inst->data + cval->offset, cval->stride, (const char*)value);
+
+        if (mod_fn != NULL) {
+            result_t mr = mod_fn(inst->host, g_cmp.alloc, g_cmp.tmp_alloc, inst->data, hdl);
+            if (IS_FAIL(mr))
+                r = mr;
+        }
+    }
+    return r;
+}
+
+result_t cmp_value_setf_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    float value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, &value, sizeof(float), CMP_VALUE_FLOAT);
+}
+
+result_t cmp_value_seti_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    int value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, &value, sizeof(int), CMP_VALUE_INT);
+}
+
+result_t cmp_value_setui_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    uint value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, &value, sizeof(uint), CMP_VALUE_UINT);
+}
+
+result_t cmp_value_setb_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    int value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, &value, sizeof(int), CMP_VALUE_BOOL);
+}
+
+result_t cmp_value_set2f_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    const float* value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, value, sizeof(float)*2, CMP_VALUE_FLOAT2);
+}
+
+result_t cmp_value_set3f_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    const float* value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, value, sizeof(float)*3, CMP_VALUE_FLOAT3);
+}
+
+result_t cmp_value_set4f_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    const float* value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, value, sizeof(float)*4, CMP_VALUE_FLOAT4);
+}
+
+result_t cmp_value_set3m_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    const struct mat3f* value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, value, sizeof(struct mat3f),
+        CMP_VALUE_MATRIX);
+}
+
+result_t cmp_value_sets_batch(cmpvalhdl_t vhdl, const cmphandle_t* hdls, uint hdl_cnt,
+    const char* value)
+{
+    return cmp_value_setbatch(vhdl, hdls, hdl_cnt, value, 0, CMP_VALUE_STRING);
+}
+
 const struct cmp_instance_desc** cmp_get_updateinstances(cmp_t c, OUT uint* cnt)
 {
     *cnt = c->update_cnt;
     return (const struct cmp_instance_desc**)c->update_refs;
 }
 
+cmphandle_t cmp_get_lastinstance(cmp_t c)
+{
+    ASSERT(c->cur_idx > 0);
+    return c->instances[c->indexes[c->cur_idx - 1]].hdl;
+}
+
+uint cmp_get_datagen(cmp_t c)
+{
+    return c->data_gen;
+}
+
 const struct cmp_instance_desc** cmp_get_allinstances(cmp_t c, OUT uint* cnt,
     struct allocator* alloc)
 {
@@ -1155,6 +1702,9 @@ void cmp_zeroobj(struct cmp_obj* obj)
 {
     memset(obj, 0x00, sizeof(struct cmp_obj));
 
+    for (uint i = 0; i < CMP_OBJ_SLOTCNT; i++)
+        obj->cmps[i] = INVALID_HANDLE;
+
     obj->xform_cmp = INVALID_HANDLE;
     obj->bounds_cmp = INVALID_HANDLE;
     obj->model_cmp = INVALID_HANDLE;
@@ -1166,6 +1716,11 @@ void cmp_zeroobj(struct cmp_obj* obj)
     obj->attach_cmp = INVALID_HANDLE;
 }
 
+uint cmp_getstride(cmp_t c)
+{
+    return c->stride;
+}
+
 cmptype_t cmp_gettype(cmp_t c)
 {
     return c->type;
@@ -1190,7 +1745,7 @@ result_t cmp_console_debug(uint argc, const char ** argv, void* param)
         return RET_FAIL;
     }
 
-    cmphandle_t hdl = cmp_findinstance(obj->chain, c->type);
+    cmphandle_t hdl = cmp_findinstance_bytype_inobj(obj, c->type);
     if (hdl == INVALID_HANDLE)  {
         con_log(LOG_ERROR, "component not found in object", NULL);
         return RET_FAIL;
@@ -1219,7 +1774,7 @@ result_t cmp_console_undebug(uint argc, const char ** argv, void* param)
         return RET_FAIL;
     }
 
-    cmphandle_t hdl = cmp_findinstance(obj->chain, c->type);
+    cmphandle_t hdl = cmp_findinstance_bytype_inobj(obj, c->type);
     if (hdl == INVALID_HANDLE)  {
         con_log(LOG_ERROR, "component not found in object", NULL);
         return RET_FAIL;
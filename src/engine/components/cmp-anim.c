@@ -33,7 +33,8 @@
  */
 result_t cmp_anim_create(struct cmp_obj* obj, void* data, cmphandle_t hdl);
 void cmp_anim_destroy(struct cmp_obj* obj, void* data, cmphandle_t hdl);
-void cmp_anim_update(cmp_t c, float dt, void* param);
+void cmp_anim_update(cmp_t c, float dt, void* param, uint start, uint end, uint thread_id);
+void cmp_anim_updatemodels(cmp_t c, float dt, void* param);
 void cmp_anim_destroydata(struct cmp_obj* obj, struct cmp_anim* data, cmphandle_t hdl,
     int release_mesh);
 result_t cmp_anim_createhierarchy(struct cmp_anim* a, struct cmp_model* m, struct gfx_model* gmodel);
@@ -64,8 +65,10 @@ result_t cmp_anim_register(struct allocator* alloc)
     params.values = cmp_anim_values;
     params.value_cnt = CMP_VALUE_CNT(cmp_anim_values);
     params.type = cmp_anim_type;
-    params.update_funcs[CMP_UPDATE_STAGE1] = cmp_anim_update;
-    params.flags = CMP_FLAG_ALWAYSUPDATE;
+    params.update_range_funcs[CMP_UPDATE_STAGE1] = cmp_anim_update;
+    params.update_funcs[CMP_UPDATE_STAGE1] = cmp_anim_updatemodels;
+    params.update_batch = 8;    /* each instance samples a whole skeleton/hierarchy */
+    params.flags = CMP_FLAG_ALWAYSUPDATE | CMP_FLAG_THREADSAFE;
     return cmp_register_component(alloc, &params);
 }
 
@@ -85,14 +88,15 @@ void cmp_anim_destroy(struct cmp_obj* obj, void* data, cmphandle_t hdl)
     cmp_anim_destroydata(obj, (struct cmp_anim*)data, hdl, TRUE);
 }
 
-void cmp_anim_update(cmp_t c, float dt, void* param)
+/* Runs in main thread and task threads */
+void cmp_anim_update(cmp_t c, float dt, void* param, uint start, uint end, uint thread_id)
 {
     uint cnt;
     struct anim_reel_desc desc;
     struct anim_clip_desc clip_desc;
 
     const struct cmp_instance_desc** updates = cmp_get_updateinstances(c, &cnt);
-    for (uint i = 0; i < cnt; i++)	{
+    for (uint i = start; i < end; i++)	{
         const struct cmp_instance_desc* inst = updates[i];
         struct cmp_anim* a = (struct cmp_anim*)inst->data;
 #if !defined(_RETAIL_)
@@ -114,7 +118,7 @@ void cmp_anim_update(cmp_t c, float dt, void* param)
                     t = fmodf(t, clip_desc.duration);
                 }   else if (t > clip_desc.duration)    {
                     a->t = 0.0f;
-                    cmp_anim_stop(inst->hdl);
+                    a->finished = TRUE;
                     continue;
                 }
 #if !defined(_RETAIL_)
@@ -131,9 +135,6 @@ void cmp_anim_update(cmp_t c, float dt, void* param)
                     a->frame_idx, a->root_idxs, a->root_cnt, &a->root_mat);
             }
 
-            if (inst->host->model_cmp != INVALID_HANDLE)
-                cmp_updateinstance(inst->host->model_cmp);
-
 #if !defined(_RETAIL_)
         }
 #endif
@@ -142,6 +143,30 @@ anim_reel_proceed:
     }
 }
 
+/* stops finished clips and notifies models of animated instances, after range updates */
+void cmp_anim_updatemodels(cmp_t c, float dt, void* param)
+{
+    uint cnt;
+    const struct cmp_instance_desc** updates = cmp_get_updateinstances(c, &cnt);
+
+    /* reverse order, stopping an instance moves the last one of update list into it's place */
+    for (int i = (int)cnt - 1; i >= 0; i--) {
+        const struct cmp_instance_desc* inst = updates[i];
+        struct cmp_anim* a = (struct cmp_anim*)inst->data;
+        if (a->finished)    {
+            a->finished = FALSE;
+            cmp_anim_stop(inst->hdl);
+            continue;
+        }
+
+        if (inst->host->model_cmp != INVALID_HANDLE && a->clip_hdl != INVALID_HANDLE &&
+            rs_get_animreel(a->clip_hdl) != NULL)
+        {
+            cmp_updateinstance(inst->host->model_cmp);
+        }
+    }
+}
+
 result_t cmp_anim_modify(struct cmp_obj* obj, struct allocator* alloc, struct allocator* tmp_alloc,
     void* data, cmphandle_t cur_hdl)
 {
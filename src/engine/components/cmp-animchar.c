@@ -30,7 +30,9 @@
  */
 result_t cmp_animchar_create(struct cmp_obj* obj, void* data, cmphandle_t hdl);
 void cmp_animchar_destroy(struct cmp_obj* obj, void* data, cmphandle_t hdl);
-void cmp_animchar_update(cmp_t c, float dt, void* param);
+void cmp_animchar_update(cmp_t c, float dt, void* param, uint start, uint end,
+    uint thread_id);
+void cmp_animchar_updatemodels(cmp_t c, float dt, void* param);
 void cmp_animchar_destroydata(struct cmp_obj* obj, struct cmp_animchar* data, cmphandle_t hdl,
                               int release_ctrl);
 result_t cmp_animchar_createhierarchy(struct cmp_animchar* ch, struct cmp_model* m,
@@ -50,6 +52,9 @@ void cmp_animchar_destroyinstances(reshandle_t hdl, const struct cmp_instance_de
 result_t cmp_animchar_createskeleton(struct cmp_animchar* ch, struct cmp_model* m,
     struct gfx_model* gmodel, uint geo_idx);
 
+/* global controller time, advanced on main thread after range updates */
+static float g_animchar_tm = 0.0f;
+
 /*************************************************************************************************/
 result_t cmp_animchar_register(struct allocator* alloc)
 {
@@ -66,8 +71,10 @@ result_t cmp_animchar_register(struct allocator* alloc)
     params.values = cmp_animchar_values;
     params.value_cnt = CMP_VALUE_CNT(cmp_animchar_values);
     params.type = cmp_animchar_type;
-    params.update_funcs[CMP_UPDATE_STAGE1] = cmp_animchar_update;
-    params.flags = CMP_FLAG_ALWAYSUPDATE;
+    params.update_range_funcs[CMP_UPDATE_STAGE1] = cmp_animchar_update;
+    params.update_funcs[CMP_UPDATE_STAGE1] = cmp_animchar_updatemodels;
+    params.update_batch = 4;    /* each instance evaluates a whole controller and skeleton */
+    params.flags = CMP_FLAG_ALWAYSUPDATE | CMP_FLAG_THREADSAFE;
     return cmp_register_component(alloc, &params);
 }
 
@@ -87,17 +94,18 @@ void cmp_animchar_destroy(struct cmp_obj* obj, void* data, cmphandle_t hdl)
     obj->animchar_cmp = INVALID_HANDLE;
 }
 
-void cmp_animchar_update(cmp_t c, float dt, void* param)
+/* Runs in main thread and task threads */
+void cmp_animchar_update(cmp_t c, float dt, void* param, uint start, uint end,
+    uint thread_id)
 {
-    static float tm = 0.0f;
     uint cnt;
+    float tm = g_animchar_tm + dt;
 
-    tm += dt;
-
-    struct allocator* tmp_alloc = tsk_get_tmpalloc(0);
+    struct allocator* tmp_alloc = tsk_get_tmpalloc(thread_id);
+    A_SAVE(tmp_alloc);
 
     const struct cmp_instance_desc** updates = cmp_get_updateinstances(c, &cnt);
-    for (uint i = 0; i < cnt; i++)    {
+    for (uint i = start; i < end; i++)    {
         const struct cmp_instance_desc* inst = updates[i];
         struct cmp_animchar* ch = (struct cmp_animchar*)inst->data;
         if (ch->ctrl_hdl != INVALID_HANDLE) {
@@ -114,9 +122,26 @@ void cmp_animchar_update(cmp_t c, float dt, void* param)
                 anim_ctrl_fetchresult_hierarchal(ch->inst, ch->bindmap, ch->xform_hdls,
                     ch->root_idxs, ch->root_cnt, &ch->root_mat);
             }
+        }
+    }
+
+    A_LOAD(tmp_alloc);
+}
 
-            if (inst->host->model_cmp != INVALID_HANDLE)
-                cmp_updateinstance(inst->host->model_cmp);
+/* advances controller time and notifies models of animated instances, after range updates */
+void cmp_animchar_updatemodels(cmp_t c, float dt, void* param)
+{
+    uint cnt;
+    g_animchar_tm += dt;
+
+    const struct cmp_instance_desc** updates = cmp_get_updateinstances(c, &cnt);
+    for (uint i = 0; i < cnt; i++)    {
+        const struct cmp_instance_desc* inst = updates[i];
+        struct cmp_animchar* ch = (struct cmp_animchar*)inst->data;
+        if (inst->host->model_cmp != INVALID_HANDLE && ch->ctrl_hdl != INVALID_HANDLE &&
+            rs_get_animctrl(ch->ctrl_hdl) != NULL)
+        {
+            cmp_updateinstance(inst->host->model_cmp);
         }
     }
 }
@@ -89,7 +89,7 @@ void cmp_attachment_destroydata(struct cmp_obj* obj, struct cmp_attachment* data
             mat3_setm(&cxf->mat, &ws_mat);
 
             /* clear current object's transform parent */
-            cxf->parent_hdl = INVALID_HANDLE;
+            cmp_xform_setparent(obj->xform_cmp, INVALID_HANDLE);
             cmp_updateinstance(obj->xform_cmp);
         }
 
@@ -180,7 +180,7 @@ result_t cmp_attachment_modifydockslot(struct cmp_obj* obj, struct allocator* al
     struct cmp_xform* cxf = (struct cmp_xform*)cmp_getinstancedata(obj->xform_cmp);
     struct cmp_attachdock* attdock = (struct cmp_attachdock*)cmp_getinstancedata(dock_hdl);
     attdock->docks[att->dock_slot].attachment_hdl = cur_hdl;
-    cxf->parent_hdl = attdock->docks[att->dock_slot].xform_hdl;
+    cmp_xform_setparent(obj->xform_cmp, attdock->docks[att->dock_slot].xform_hdl);
     mat3_set_ident(&cxf->mat);
 
     cmp_updateinstance(obj->xform_cmp);
@@ -28,7 +28,8 @@
  */
 result_t cmp_bounds_create(struct cmp_obj* host_obj, void* data, cmphandle_t hdl);
 void cmp_bounds_destroy(struct cmp_obj* host_obj, void* data, cmphandle_t hdl);
-void cmp_bounds_update(cmp_t c, float dt, void* params);
+void cmp_bounds_update(cmp_t c, float dt, void* params, uint start, uint end, uint thread_id);
+void cmp_bounds_updatespatial(cmp_t c, float dt, void* params);
 void cmp_bounds_debug(struct cmp_obj* obj, void* data, cmphandle_t cur_hdl, float dt,
 	    const struct gfx_view_params* params);
 
@@ -48,7 +49,11 @@ result_t cmp_bounds_register(struct allocator* alloc)
 	params.create_func = cmp_bounds_create;
 	params.destroy_func = cmp_bounds_destroy;
 	params.debug_func = cmp_bounds_debug;
-	params.update_funcs[CMP_UPDATE_STAGE4] = cmp_bounds_update;
+	params.update_range_funcs[CMP_UPDATE_STAGE4] = cmp_bounds_update;
+	params.update_funcs[CMP_UPDATE_STAGE4] = cmp_bounds_updatespatial;
+	params.flags = CMP_FLAG_THREADSAFE | CMP_FLAG_PACKED;
+	params.deps = &cmp_xform_type;
+	params.dep_cnt = 1;
 
 	return cmp_register_component(alloc, &params);
 }
@@ -57,6 +62,11 @@ result_t cmp_bounds_create(struct cmp_obj* host_obj, void* data, cmphandle_t hdl
 {
 	struct cmp_bounds* b = (struct cmp_bounds*)data;
 	aabb_setzero(&b->ws_aabb);
+	b->tree_node = -1;
+	b->cell_range[0] = 0;
+	b->cell_range[1] = 0;
+	b->cell_range[2] = -1;
+	b->cell_range[3] = -1;
 	host_obj->bounds_cmp = hdl;
 
     /* push into spatial structure of the scene */
@@ -72,11 +82,11 @@ void cmp_bounds_destroy(struct cmp_obj* host_obj, void* data, cmphandle_t hdl)
 	host_obj->bounds_cmp = INVALID_HANDLE;
 }
 
-void cmp_bounds_update(cmp_t c, float dt, void* params)
+void cmp_bounds_update(cmp_t c, float dt, void* params, uint start, uint end, uint thread_id)
 {
     uint cnt;
     const struct cmp_instance_desc** updates = cmp_get_updateinstances(c, &cnt);
-	for (uint i = 0; i < cnt; i++)	{
+	for (uint i = start; i < end; i++)	{
 		const struct cmp_instance_desc* inst = updates[i];
 
 		/* update bounding volume in world-space from transform component */
@@ -84,6 +94,15 @@ void cmp_bounds_update(cmp_t c, float dt, void* params)
 		struct cmp_xform* xf = (struct cmp_xform*)cmp_getinstancedata(inst->host->xform_cmp);
 		sphere_xform(&b->ws_s, &b->s, &xf->ws_mat);
 		aabb_from_sphere(&b->ws_aabb, &b->ws_s);
+	}
+}
+
+void cmp_bounds_updatespatial(cmp_t c, float dt, void* params)
+{
+    uint cnt;
+    const struct cmp_instance_desc** updates = cmp_get_updateinstances(c, &cnt);
+	for (uint i = 0; i < cnt; i++)	{
+		const struct cmp_instance_desc* inst = updates[i];
 
 		/* update spatial (update will happen on visible query - see scn-mgr.c) */
         scn_update_spatial(inst->host->scene_id, inst->host->bounds_cmp);
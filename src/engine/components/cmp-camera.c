@@ -115,7 +115,7 @@ result_t cmp_camera_modifyactive(struct cmp_obj* obj, struct allocator* alloc,
     if (cam->active)    {
 	    wld_set_cam(&cam->c);
         if (g_active_camobj != NULL)    {
-            cmphandle_t prev_hdl = cmp_findinstance(g_active_camobj->chain, cmp_camera_type);
+            cmphandle_t prev_hdl = cmp_findinstance_bytype_inobj(g_active_camobj, cmp_camera_type);
             if (prev_hdl != INVALID_HANDLE)
                 ((struct cmp_camera*)cmp_getinstancedata(prev_hdl))->active = FALSE;
         }
@@ -32,6 +32,11 @@
 #define LOD_INDEX_MED 1
 #define LOD_INDEX_LOW 2
 
+/*************************************************************************************************
+ * globals
+ */
+static cmpvalhdl_t g_lodmodel_shadows_vhdl = INVALID_INDEX; /* "exclude_shadows" of model */
+
 /*************************************************************************************************
  * fwd declarations
  */
@@ -73,13 +78,17 @@ result_t cmp_lodmodel_register(struct allocator* alloc)
     params.values = cmp_lodmodel_values;
     params.value_cnt = CMP_VALUE_CNT(cmp_lodmodel_values);
     params.type = cmp_lodmodel_type;
+
+    /* model component is registered before, shadow flag is forwarded to all lod models */
+    g_lodmodel_shadows_vhdl = cmp_value_gethdl(cmp_model_type, "exclude_shadows");
+    ASSERT(g_lodmodel_shadows_vhdl != INVALID_INDEX);
     return cmp_register_component(alloc, &params);
 }
 
 result_t cmp_lodmodel_create(struct cmp_obj* host_obj, void* data, cmphandle_t hdl)
 {
     /* object should not have model attached */
-    if (cmp_findinstance(host_obj->chain, cmp_model_type) != INVALID_HANDLE)    {
+    if (cmp_findinstance_bytype_inobj(host_obj, cmp_model_type) != INVALID_HANDLE)    {
         log_printf(LOG_WARNING, "creating lod-model failed: object '%s' already assigned a model",
             host_obj->name);
         return RET_FAIL;
@@ -244,7 +253,7 @@ void cmp_lodmodel_updatedeps(struct cmp_obj* obj)
     if (obj->attachdock_cmp != INVALID_HANDLE)
         cmp_attachdock_refresh(obj->attachdock_cmp);
 
-    cmphandle_t anim_cmp = cmp_findinstance(obj->chain, cmp_anim_type);
+    cmphandle_t anim_cmp = cmp_findinstance_bytype_inobj(obj, cmp_anim_type);
     if (anim_cmp != INVALID_HANDLE)
         cmp_anim_bind_noalloc(obj, anim_cmp);
 
@@ -342,10 +351,14 @@ result_t cmp_lodmodel_modify_shadows(struct cmp_obj* obj, struct allocator* allo
     struct allocator* tmp_alloc, void* data, cmphandle_t cur_hdl)
 {
     struct cmp_lodmodel* m = (struct cmp_lodmodel*)data;
+    cmphandle_t models[CMP_LOD_MODELS_MAX];
+    uint model_cnt = 0;
     for (uint i = 0; i < CMP_LOD_MODELS_MAX; i++) {
         if (m->models[i] != INVALID_HANDLE)
-            cmp_value_setb(m->models[i], "exclude_shadows", m->exclude_shadows);
+            models[model_cnt++] = m->models[i];
     }
+
+    cmp_value_setb_batch(g_lodmodel_shadows_vhdl, models, model_cnt, m->exclude_shadows);
     return RET_OK;
 }
 
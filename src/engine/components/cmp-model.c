@@ -28,6 +28,7 @@
 #include "cmp-mgr.h"
 #include "gfx-canvas.h"
 #include "engine.h"
+#include "scene-mgr.h"
 
 /*************************************************************************************************
  * fwd declarations
@@ -259,7 +260,7 @@ result_t cmp_model_modify(struct cmp_obj* obj, struct allocator* alloc,
 
 		struct cmp_xform* xf = (struct cmp_xform*)cmp_getinstancedata(m->xforms[i]);
 		mat3_setm(&xf->mat, &gmodel->nodes[i].local_mat);
-		xf->parent_hdl = m->xforms[gmodel->nodes[i].parent_id];
+		cmp_xform_setparent(m->xforms[i], m->xforms[gmodel->nodes[i].parent_id]);
 	}
 
 	/* bounds component is required */
@@ -291,7 +292,7 @@ result_t cmp_model_modify(struct cmp_obj* obj, struct allocator* alloc,
             obj->animchar_cmp);
     }
 
-    cmphandle_t anim_cmp = cmp_findinstance(obj->chain, cmp_anim_type);
+    cmphandle_t anim_cmp = cmp_findinstance_bytype_inobj(obj, cmp_anim_type);
     if (anim_cmp != INVALID_HANDLE) {
         cmp_anim_bind(obj, cmp_getinstancedata(anim_cmp), alloc, tmp_alloc, anim_cmp);
     }
@@ -310,6 +311,13 @@ void cmp_model_destroydata(struct cmp_obj* host_obj, struct cmp_model* data, cmp
     for (uint i = 0; i < data->xform_cnt; i++)
         data->xforms[i] = INVALID_HANDLE;
 
+    /* occluder geometry is going away, cached occlusion results are not valid anymore */
+    if (data->model_hdl != INVALID_HANDLE)  {
+        struct gfx_model* gmodel = rs_get_model(data->model_hdl);
+        if (gmodel != NULL && gmodel->occ != NULL)
+            scn_reset_viscache();
+    }
+
     if (data->model_inst != NULL)   {
         gfx_model_destroyinstance(data->model_inst);
         data->model_inst = NULL;
@@ -394,7 +402,7 @@ void cmp_model_clearinstances(reshandle_t model_hdl, const struct cmp_instance_d
             if (obj->animchar_cmp != INVALID_HANDLE)
                 cmp_animchar_unbind(obj->animchar_cmp);
 
-            cmphandle_t anim_cmp = cmp_findinstance(obj->chain, cmp_anim_type);
+            cmphandle_t anim_cmp = cmp_findinstance_bytype_inobj(obj, cmp_anim_type);
             if (anim_cmp != INVALID_HANDLE)
                 cmp_anim_unbind(anim_cmp);
 
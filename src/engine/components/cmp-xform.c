@@ -14,6 +14,7 @@
  ***********************************************************************************/
 
 #include "dhcore/core.h"
+#include "dhcore/task-mgr.h"
 
 #include "components/cmp-xform.h"
 #include "components/cmp-light.h"
@@ -26,14 +27,63 @@
 #include "cmp-mgr.h"
 #include "gfx-canvas.h"
 #include "phx-device.h"
+#include "mem-ids.h"
+#include "frame-graph.h"
+
+#define XFORM_UPDATE_BATCH 16   /* min dirty subtrees per thread in world-space update */
+
+/*************************************************************************************************
+ * types
+ */
+
+/* flattened transform hierarchy, nodes are in depth-first order, so parents always come before
+ * their children and every subtree is a contiguous range of nodes [node, node + sizes[node])
+ * it's kept between frames: new transforms are appended as roots, and it's only rebuilt when a
+ * parent changes or a transform is destroyed */
+struct xform_hierarchy
+{
+    struct allocator* alloc;
+    uint node_cnt;
+    uint node_max;
+    cmphandle_t* hdls;  /* xform instance of each node */
+    struct cmp_xform** xfs; /* instance data of each node (valid while 'data_gen' is unchanged) */
+    uint* parents;  /* parent node of each node (INVALID_INDEX for roots) */
+    uint* sizes;    /* number of nodes in the subtree of each node, including itself */
+    struct mat3f* ws_mats;  /* world matrices in node order, parent matrices are read from here */
+    uint* dirty_bits;   /* one bit for each node, nodes that need world-space update */
+    uint data_gen;  /* component data generation that 'xfs' are fetched in */
+    int rebuild;    /* parents are changed or transforms are destroyed */
+};
+
+/* dirty subtree, contiguous range of nodes */
+struct xform_range
+{
+    uint start;
+    uint end;
+};
+
+/*************************************************************************************************
+ * globals
+ */
+struct xform_hierarchy g_xf_hier;
 
 /*************************************************************************************************
  * fwd declarations
  */
 result_t cmp_xform_create(struct cmp_obj* host_obj, void* data, cmphandle_t hdl);
 void cmp_xform_destroy(struct cmp_obj* host_obj, void* data, cmphandle_t hdl);
+void cmp_xform_release(cmp_t c);
 void cmp_xform_update1(cmp_t c, float dt, void* params);
 void cmp_xform_update2(cmp_t c, float dt, void* params);
+void cmp_xform_update_range(uint start, uint end, uint thread_id, void* param);
+void cmp_xform_unlink(cmphandle_t hdl, struct cmp_xform* xf);
+void cmp_xform_relink(struct cmp_xform* xf, cmphandle_t old_hdl, cmphandle_t new_hdl);
+void cmp_xform_append(cmphandle_t hdl, struct cmp_xform* xf);
+result_t cmp_xform_rebuild(cmp_t c, uint thread_id);
+void cmp_xform_refresh(cmp_t c);
+void cmp_xform_setbits(uint* bits, uint start, uint end);
+result_t cmp_xform_growhier(struct xform_hierarchy* h, uint cnt);
+void cmp_xform_freehier(struct xform_hierarchy* h);
 void cmp_xform_debug(struct cmp_obj* obj, void* data, cmphandle_t cur_hdl, float dt,
 	    const struct gfx_view_params* params);
 
@@ -59,6 +109,11 @@ result_t cmp_xform_register(struct allocator* alloc)
 	params.debug_func = cmp_xform_debug;
 	params.update_funcs[CMP_UPDATE_STAGE2] = cmp_xform_update1; /* dependency update (mesh, bounds)*/
 	params.update_funcs[CMP_UPDATE_STAGE3] = cmp_xform_update2; /* world-space calc */
+	params.release_func = cmp_xform_release;
+	params.flags = CMP_FLAG_PACKED;
+
+	memset(&g_xf_hier, 0x00, sizeof(g_xf_hier));
+	g_xf_hier.alloc = alloc;
 
 	return cmp_register_component(alloc, &params);
 }
@@ -72,6 +127,10 @@ result_t cmp_xform_create(struct cmp_obj* host_obj, void* data, cmphandle_t hdl)
 	vec3_setzero(&xf->vel_ang);
 	mat3_set_ident(&xf->ws_mat);
 	xf->parent_hdl = INVALID_HANDLE;
+	xf->first_child = INVALID_HANDLE;
+	xf->next_sibling = INVALID_HANDLE;
+	xf->node_idx = INVALID_INDEX;
+	cmp_xform_append(hdl, xf);
 	if (!BIT_CHECK(cmp_getinstanceflags(hdl), CMP_INSTANCEFLAG_INDIRECTHOST))
 		host_obj->xform_cmp = hdl;
 	return RET_OK;
@@ -79,6 +138,27 @@ result_t cmp_xform_create(struct cmp_obj* host_obj, void* data, cmphandle_t hdl)
 
 void cmp_xform_destroy(struct cmp_obj* host_obj, void* data, cmphandle_t hdl)
 {
+	struct cmp_xform* xf = (struct cmp_xform*)data;
+
+	/* remove from parent, children become roots */
+	cmp_xform_unlink(hdl, xf);
+	cmphandle_t child_hdl = xf->first_child;
+	while (child_hdl != INVALID_HANDLE)	{
+		struct cmp_xform* child_xf = (struct cmp_xform*)cmp_getinstancedata(child_hdl);
+		cmphandle_t next_hdl = child_xf->next_sibling;
+		child_xf->parent_hdl = INVALID_HANDLE;
+		child_xf->next_sibling = INVALID_HANDLE;
+		cmp_updateinstance(child_hdl);
+		child_hdl = next_hdl;
+	}
+	xf->first_child = INVALID_HANDLE;
+
+	/* destroy also changes handle of the last instance (swap), so fix the links to it */
+	cmphandle_t last_hdl = cmp_get_lastinstance(cmp_getbyhdl(hdl));
+	if (last_hdl != hdl)
+		cmp_xform_relink((struct cmp_xform*)cmp_getinstancedata(last_hdl), last_hdl, hdl);
+	g_xf_hier.rebuild = TRUE;
+
 	if (!BIT_CHECK(cmp_getinstanceflags(hdl), CMP_INSTANCEFLAG_INDIRECTHOST))	{
 		/* because transform component is very basic and can be used in the other components ..
 		 * we should invalidate it on them too
@@ -132,10 +212,10 @@ void cmp_xform_updatedeps(struct cmp_obj* obj, uint flags)
 
 		switch (obj->type)	{
 		case CMP_OBJTYPE_LIGHT:
-			cmp_updateinstance(cmp_findinstance(obj->chain, cmp_light_type));
+			cmp_updateinstance(cmp_findinstance_bytype_inobj(obj, cmp_light_type));
 			break;
 		case CMP_OBJTYPE_CAMERA:
-			cmp_updateinstance(cmp_findinstance(obj->chain, cmp_camera_type));
+			cmp_updateinstance(cmp_findinstance_bytype_inobj(obj, cmp_camera_type));
 			break;
 		default:
 			break;
@@ -143,25 +223,339 @@ void cmp_xform_updatedeps(struct cmp_obj* obj, uint flags)
 	}
 }
 
+void cmp_xform_release(cmp_t c)
+{
+    cmp_xform_freehier(&g_xf_hier);
+}
+
+void cmp_xform_setparent(cmphandle_t xform_hdl, cmphandle_t parent_hdl)
+{
+    struct cmp_xform* xf = (struct cmp_xform*)cmp_getinstancedata(xform_hdl);
+    if (xf->parent_hdl == parent_hdl)
+        return;
+
+    /* new parent can't be inside the subtree of xform */
+    cmphandle_t hdl = parent_hdl;
+    while (hdl != INVALID_HANDLE)   {
+        if (hdl == xform_hdl)   {
+            log_print(LOG_WARNING, "xform: parent is a child of transform, ignored");
+            return;
+        }
+        hdl = ((const struct cmp_xform*)cmp_getinstancedata(hdl))->parent_hdl;
+    }
+
+    cmp_xform_unlink(xform_hdl, xf);
+
+    if (parent_hdl != INVALID_HANDLE)   {
+        struct cmp_xform* parent_xf = (struct cmp_xform*)cmp_getinstancedata(parent_hdl);
+        xf->parent_hdl = parent_hdl;
+        xf->next_sibling = parent_xf->first_child;
+        parent_xf->first_child = xform_hdl;
+    }
+
+    g_xf_hier.rebuild = TRUE;
+    cmp_updateinstance(xform_hdl);
+}
+
+/* removes xform from child list of it's parent */
+void cmp_xform_unlink(cmphandle_t hdl, struct cmp_xform* xf)
+{
+    if (xf->parent_hdl == INVALID_HANDLE)
+        return;
+
+    struct cmp_xform* parent_xf = (struct cmp_xform*)cmp_getinstancedata(xf->parent_hdl);
+    cmphandle_t* phdl = &parent_xf->first_child;
+    while (*phdl != hdl)    {
+        ASSERT(*phdl != INVALID_HANDLE);
+        phdl = &((struct cmp_xform*)cmp_getinstancedata(*phdl))->next_sibling;
+    }
+    *phdl = xf->next_sibling;
+
+    xf->parent_hdl = INVALID_HANDLE;
+    xf->next_sibling = INVALID_HANDLE;
+}
+
+/* xform is moved from old_hdl to new_hdl, replaces old_hdl in it's parent and children */
+void cmp_xform_relink(struct cmp_xform* xf, cmphandle_t old_hdl, cmphandle_t new_hdl)
+{
+    if (xf->parent_hdl != INVALID_HANDLE)   {
+        struct cmp_xform* parent_xf = (struct cmp_xform*)cmp_getinstancedata(xf->parent_hdl);
+        cmphandle_t* phdl = &parent_xf->first_child;
+        while (*phdl != old_hdl)    {
+            ASSERT(*phdl != INVALID_HANDLE);
+            phdl = &((struct cmp_xform*)cmp_getinstancedata(*phdl))->next_sibling;
+        }
+        *phdl = new_hdl;
+    }
+
+    cmphandle_t child_hdl = xf->first_child;
+    while (child_hdl != INVALID_HANDLE) {
+        struct cmp_xform* child_xf = (struct cmp_xform*)cmp_getinstancedata(child_hdl);
+        child_xf->parent_hdl = new_hdl;
+        child_hdl = child_xf->next_sibling;
+    }
+}
+
+/* new transforms don't have a parent, so they are added to the end of hierarchy as roots */
+void cmp_xform_append(cmphandle_t hdl, struct cmp_xform* xf)
+{
+    struct xform_hierarchy* h = &g_xf_hier;
+    if (h->rebuild)
+        return;
+
+    if (IS_FAIL(cmp_xform_growhier(h, h->node_cnt + 1)))    {
+        h->rebuild = TRUE;
+        return;
+    }
+
+    uint node = h->node_cnt++;
+    h->hdls[node] = hdl;
+    h->xfs[node] = xf;
+    h->parents[node] = INVALID_INDEX;
+    h->sizes[node] = 1;
+    mat3_setm(&h->ws_mats[node], &xf->ws_mat);
+    xf->node_idx = node;
+}
+
+/* world-space matrices: updated transforms are marked in dirty bits, then bits are propagated
+ * down the flattened hierarchy. each dirty subtree is a contiguous range of nodes that only
+ * depends on it's (clean) parent, so ranges are updated linearly and in parallel */
 void cmp_xform_update2(cmp_t c, float dt, void* params)
 {
+    struct xform_hierarchy* h = &g_xf_hier;
+    uint thread_id = cmp_get_updatethread();
     uint cnt;
     const struct cmp_instance_desc** updates = cmp_get_updateinstances(c, &cnt);
-	for (uint i = 0; i < cnt; i++)	{
-		const struct cmp_instance_desc* inst = updates[i];
-		struct cmp_xform* xf = (struct cmp_xform*)inst->data;
-
-		/* calculate world matrix */
-		struct mat3f wsmat;
-		cmphandle_t parent_hdl = xf->parent_hdl;
-		mat3_setm(&wsmat, &xf->mat);
-		while (parent_hdl != INVALID_HANDLE)	{
-			struct cmp_xform* parent_xf = (struct cmp_xform*)cmp_getinstancedata(parent_hdl);
-			mat3_mul(&wsmat, &wsmat, &parent_xf->mat);
-			parent_hdl = parent_xf->parent_hdl;
-		}
-		mat3_setm(&xf->ws_mat, &wsmat);
-	}
+    if (cnt == 0)
+        return;
+
+    if (h->rebuild) {
+        if (IS_FAIL(cmp_xform_rebuild(c, thread_id)))   {
+            err_print(__FILE__, __LINE__, "xform update failed: could not build hierarchy");
+            return;
+        }
+    }   else if (h->data_gen != cmp_get_datagen(c))   {
+        cmp_xform_refresh(c);
+    }
+
+    uint node_cnt = h->node_cnt;
+    uint* dirty_bits = h->dirty_bits;
+    memset(dirty_bits, 0x00, sizeof(uint)*((node_cnt + 31) >> 5));
+    for (uint i = 0; i < cnt; i++)  {
+        uint node = ((const struct cmp_xform*)updates[i]->data)->node_idx;
+        ASSERT(node < node_cnt);
+        dirty_bits[node >> 5] |= 1u << (node & 31);
+    }
+
+    struct allocator* tmp_alloc = tsk_get_tmpalloc(thread_id);
+    A_SAVE(tmp_alloc);
+    struct xform_range* ranges = (struct xform_range*)A_ALLOC(tmp_alloc,
+        sizeof(struct xform_range)*cnt, MID_CMP);
+    if (ranges == NULL) {
+        A_LOAD(tmp_alloc);
+        err_print(__FILE__, __LINE__, "xform update failed: out of memory");
+        return;
+    }
+
+    /* first dirty node that is found is the top of a dirty subtree, the whole subtree is marked
+     * and skipped, so each range starts with an updated node and there are at most 'cnt' ranges */
+    const uint* sizes = h->sizes;
+    uint range_cnt = 0;
+    for (uint i = 0; i < node_cnt; )    {
+        uint bits = dirty_bits[i >> 5] >> (i & 31);
+        if (bits == 0)  {
+            i = (i | 31) + 1;
+            continue;
+        }
+        while (!(bits & 1)) {
+            bits >>= 1;
+            i ++;
+        }
+
+        uint end = i + sizes[i];
+        cmp_xform_setbits(dirty_bits, i + 1, end);
+        ranges[range_cnt].start = i;
+        ranges[range_cnt].end = end;
+        range_cnt ++;
+        i = end;
+    }
+
+    fgr_parallel_for(cmp_xform_update_range, range_cnt, XFORM_UPDATE_BATCH, ranges, thread_id);
+    A_LOAD(tmp_alloc);
+}
+
+/* Runs in main thread and task threads */
+void cmp_xform_update_range(uint start, uint end, uint thread_id, void* param)
+{
+    const struct xform_hierarchy* h = &g_xf_hier;
+    const struct xform_range* ranges = (const struct xform_range*)param;
+    struct cmp_xform* const* xfs = h->xfs;
+    const uint* parents = h->parents;
+    struct mat3f* ws_mats = h->ws_mats;
+
+    for (uint r = start; r < end; r++)  {
+        for (uint i = ranges[r].start, range_end = ranges[r].end; i < range_end; i++)  {
+            struct cmp_xform* xf = xfs[i];
+            uint p = parents[i];
+            if (p != INVALID_INDEX)
+                mat3_mul(&ws_mats[i], &xf->mat, &ws_mats[p]);
+            else
+                mat3_setm(&ws_mats[i], &xf->mat);
+            mat3_setm(&xf->ws_mat, &ws_mats[i]);
+        }
+    }
+}
+
+/* sets bits [start, end) */
+void cmp_xform_setbits(uint* bits, uint start, uint end)
+{
+    uint i = start;
+    for (; i < end && (i & 31) != 0; i++)
+        bits[i >> 5] |= 1u << (i & 31);
+    for (; i + 32 <= end; i += 32)
+        bits[i >> 5] = 0xffffffff;
+    for (; i < end; i++)
+        bits[i >> 5] |= 1u << (i & 31);
+}
+
+/* flattens all transforms, depth-first from each root. children are pushed to the stack, so the
+ * whole subtree of a node is written before it's siblings */
+result_t cmp_xform_rebuild(cmp_t c, uint thread_id)
+{
+    struct xform_hierarchy* h = &g_xf_hier;
+    struct allocator* tmp_alloc = tsk_get_tmpalloc(thread_id);
+    uint cnt;
+
+    A_SAVE(tmp_alloc);
+    const struct cmp_instance_desc** insts = cmp_get_allinstances(c, &cnt, tmp_alloc);
+    cmphandle_t* stack = (cmphandle_t*)A_ALLOC(tmp_alloc, sizeof(cmphandle_t)*(cnt + 1),
+        MID_CMP);
+    if ((cnt > 0 && insts == NULL) || stack == NULL || IS_FAIL(cmp_xform_growhier(h, cnt)))   {
+        A_LOAD(tmp_alloc);
+        return RET_OUTOFMEMORY;
+    }
+
+    uint node_cnt = 0;
+    for (uint i = 0; i < cnt; i++)  {
+        if (((const struct cmp_xform*)insts[i]->data)->parent_hdl != INVALID_HANDLE)
+            continue;
+
+        uint stack_cnt = 0;
+        stack[stack_cnt++] = insts[i]->hdl;
+        while (stack_cnt > 0)   {
+            cmphandle_t hdl = stack[--stack_cnt];
+            struct cmp_xform* xf = (struct cmp_xform*)cmp_getinstancedata(hdl);
+            uint node = node_cnt++;
+            xf->node_idx = node;
+            h->hdls[node] = hdl;
+            h->xfs[node] = xf;
+            h->parents[node] = (xf->parent_hdl != INVALID_HANDLE) ?
+                ((const struct cmp_xform*)cmp_getinstancedata(xf->parent_hdl))->node_idx :
+                INVALID_INDEX;
+            h->sizes[node] = 1;
+            mat3_setm(&h->ws_mats[node], &xf->ws_mat);
+
+            cmphandle_t child_hdl = xf->first_child;
+            while (child_hdl != INVALID_HANDLE) {
+                stack[stack_cnt++] = child_hdl;
+                child_hdl = ((const struct cmp_xform*)cmp_getinstancedata(child_hdl))->next_sibling;
+            }
+        }
+    }
+    ASSERT(node_cnt == cnt);
+
+    /* children are always after their parents, so subtree sizes are summed up backwards */
+    for (uint i = node_cnt; i-- > 0; )  {
+        uint p = h->parents[i];
+        if (p != INVALID_INDEX)
+            h->sizes[p] += h->sizes[i];
+    }
+
+    h->node_cnt = node_cnt;
+    h->data_gen = cmp_get_datagen(c);
+    h->rebuild = FALSE;
+
+    A_LOAD(tmp_alloc);
+    return RET_OK;
+}
+
+/* instance data is moved (grow, packing or re-sort), fetch data pointers again */
+void cmp_xform_refresh(cmp_t c)
+{
+    struct xform_hierarchy* h = &g_xf_hier;
+    for (uint i = 0, node_cnt = h->node_cnt; i < node_cnt; i++)
+        h->xfs[i] = (struct cmp_xform*)cmp_getinstancedata(h->hdls[i]);
+    h->data_gen = cmp_get_datagen(c);
+}
+
+/* grows hierarchy buffers, current nodes are kept (appends) */
+result_t cmp_xform_growhier(struct xform_hierarchy* h, uint cnt)
+{
+    if (cnt <= h->node_max)
+        return RET_OK;
+
+    struct allocator* alloc = h->alloc;
+    uint node_max = cnt + cnt/2 + 64;
+    uint node_cnt = h->node_cnt;
+
+    struct xform_hierarchy nh;
+    memset(&nh, 0x00, sizeof(nh));
+    nh.alloc = alloc;
+    nh.hdls = (cmphandle_t*)A_ALLOC(alloc, sizeof(cmphandle_t)*node_max, MID_CMP);
+    nh.xfs = (struct cmp_xform**)A_ALLOC(alloc, sizeof(struct cmp_xform*)*node_max, MID_CMP);
+    nh.parents = (uint*)A_ALLOC(alloc, sizeof(uint)*node_max, MID_CMP);
+    nh.sizes = (uint*)A_ALLOC(alloc, sizeof(uint)*node_max, MID_CMP);
+    nh.ws_mats = (struct mat3f*)A_ALIGNED_ALLOC(alloc, sizeof(struct mat3f)*node_max, MID_CMP);
+    nh.dirty_bits = (uint*)A_ALLOC(alloc, sizeof(uint)*((node_max + 31) >> 5), MID_CMP);
+    if (nh.hdls == NULL || nh.xfs == NULL || nh.parents == NULL || nh.sizes == NULL ||
+        nh.ws_mats == NULL || nh.dirty_bits == NULL)
+    {
+        cmp_xform_freehier(&nh);
+        return RET_OUTOFMEMORY;
+    }
+
+    if (node_cnt > 0)   {
+        memcpy(nh.hdls, h->hdls, sizeof(cmphandle_t)*node_cnt);
+        memcpy(nh.xfs, h->xfs, sizeof(struct cmp_xform*)*node_cnt);
+        memcpy(nh.parents, h->parents, sizeof(uint)*node_cnt);
+        memcpy(nh.sizes, h->sizes, sizeof(uint)*node_cnt);
+        memcpy(nh.ws_mats, h->ws_mats, sizeof(struct mat3f)*node_cnt);
+    }
+
+    /* dirty bits are cleared in each update */
+    nh.node_cnt = node_cnt;
+    nh.node_max = node_max;
+    nh.data_gen = h->data_gen;
+    nh.rebuild = h->rebuild;
+    cmp_xform_freehier(h);
+    memcpy(h, &nh, sizeof(nh));
+    return RET_OK;
+}
+
+void cmp_xform_freehier(struct xform_hierarchy* h)
+{
+    struct allocator* alloc = h->alloc;
+    if (h->hdls != NULL)
+        A_FREE(alloc, h->hdls);
+    if (h->xfs != NULL)
+        A_FREE(alloc, h->xfs);
+    if (h->parents != NULL)
+        A_FREE(alloc, h->parents);
+    if (h->sizes != NULL)
+        A_FREE(alloc, h->sizes);
+    if (h->ws_mats != NULL)
+        A_ALIGNED_FREE(alloc, h->ws_mats);
+    if (h->dirty_bits != NULL)
+        A_FREE(alloc, h->dirty_bits);
+
+    h->hdls = NULL;
+    h->xfs = NULL;
+    h->parents = NULL;
+    h->sizes = NULL;
+    h->ws_mats = NULL;
+    h->dirty_bits = NULL;
+    h->node_cnt = 0;
+    h->node_max = 0;
 }
 
 void cmp_xform_debug(struct cmp_obj* obj, void* data, cmphandle_t cur_hdl, float dt,
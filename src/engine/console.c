@@ -20,6 +20,7 @@
 #include "dhcore/hash-table.h"
 #include "mem-ids.h"
 #include "debug-hud.h"
+#include "replay.h"
 
 /*************************************************************************************************
  * types
@@ -154,9 +155,17 @@ result_t con_exec(const char* cmd)
 		return RET_INVALIDCALL;
 	}
 	const struct console_cmd* c = &((struct console_cmd*)g_con.cmds.buffer)[item->value];
+
+	/* keep executed commands in recording, so replays can run them again
+	 * state is checked before running the command, so the command that starts recording and
+	 * replayed commands are never recorded */
+	int record = (rpl_getstate() == RPL_STATE_RECORD);
 	result_t r = c->cmd_func(args_arr.item_cnt - 1, (const char**)args + 1, c->param);
 	arr_destroy(&args_arr);
 
+	if (record)
+		rpl_addcmd(cmd);
+
 	con_respond(r, name, cmd);
 	return r;
 }
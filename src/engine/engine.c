@@ -45,6 +45,9 @@
 #include "phx.h"
 #include "world-mgr.h"
 #include "gfx-device.h"
+#include "frame-graph.h"
+#include "replay.h"
+#include "anim.h"
 
 #define GRAPH_WIDTH 250
 #define GRAPH_HEIGHT 100
@@ -78,6 +81,7 @@ struct engine
     uint alloc_tmp0_frameid;  /* maximum tmp allocated frameid */
     uint alloc_tmp0_max; /* maxomum allocated bytes from temp0 stack allocator */
     int fps_lock;    /* =0 if not locked */
+    int phx_simulated;  /* physics simulation is running (dispatched in previous frame) */
 };
 
 /*************************************************************************************************/
@@ -102,6 +106,20 @@ int eng_hud_drawfpsgraph(gfx_cmdqueue cmdqueue, ui_widget widget, int x, int y,
 int eng_hud_drawfps(gfx_cmdqueue cmdqueue, int x, int y, int line_stride, void* param);
 int eng_hud_drawft(gfx_cmdqueue cmdqueue, int x, int y, int line_stride, void* param);
 
+result_t eng_register_stages();
+result_t eng_register_cmpstages(const char** cmp_names);
+uint eng_cmpstage_writes(uint stage_id);
+void eng_stage_files(float dt, uint thread_id, void* param);
+void eng_stage_resources(float dt, uint thread_id, void* param);
+void eng_stage_phxgather(float dt, uint thread_id, void* param);
+void eng_stage_script(float dt, uint thread_id, void* param);
+void eng_stage_phxsim(float dt, uint thread_id, void* param);
+void eng_stage_cmp(float dt, uint thread_id, void* param);
+void eng_stage_cmpupdate(float dt, uint thread_id, void* param);
+void eng_stage_spatial(float dt, uint thread_id, void* param);
+void eng_stage_render(float dt, uint thread_id, void* param);
+void eng_stage_snapshot(float dt, uint thread_id, void* param);
+
 /*************************************************************************************************/
 void eng_zero()
 {
@@ -112,6 +130,8 @@ void eng_zero()
     sct_zero();
     lod_zero();
     wld_zero();
+    fgr_zero();
+    rpl_zero();
 
 #if defined(_PROFILE_)
     prf_zero();
@@ -296,6 +316,13 @@ result_t eng_init(const struct init_params* params)
     struct allocator* tmp_alloc = tsk_get_tmpalloc(0);
     A_SAVE(tmp_alloc);
 
+    /* frame-graph (uses task workers that are not reserved for res-mgr) */
+    r = fgr_initmgr(thread_cnt);
+    if (IS_FAIL(r)) {
+        err_print(__FILE__, __LINE__, "engine init failed: could not init frame-graph");
+        return RET_FAIL;
+    }
+
     /* resource manager (with only 1 thread for multi-thread loading) */
     r = rs_initmgr(rs_flags, 1);
     if (IS_FAIL(r)) {
@@ -303,6 +330,7 @@ result_t eng_init(const struct init_params* params)
         return RET_FAIL;
     }
     rs_set_dataalloc(&g_eng->lsr_alloc);
+    anim_set_tracklayout(BIT_CHECK(params->flags, ENG_FLAG_ANIMTRACKS));
 
     /* graphics renderer */
     r = gfx_init(&params->gfx);
@@ -311,6 +339,16 @@ result_t eng_init(const struct init_params* params)
         return RET_FAIL;
     }
 
+    /* pipelined render, resources can't be hot-loaded while they are referenced by snapshot */
+    if (BIT_CHECK(params->flags, ENG_FLAG_PIPELINED))   {
+        if (BIT_CHECK(params->flags, ENG_FLAG_DEV)) {
+            log_print(LOG_WARNING, "pipelined render is not supported in dev mode, ignored");
+        }   else if (IS_FAIL(gfx_set_pipelined(TRUE)))  {
+            err_print(__FILE__, __LINE__, "engine init failed: could not init pipelined render");
+            return RET_FAIL;
+        }
+    }
+
     /* debug HUD */
     r = hud_init(BIT_CHECK(params->flags, ENG_FLAG_CONSOLE));
     if (IS_FAIL(r))	{
@@ -365,6 +403,13 @@ result_t eng_init(const struct init_params* params)
     }
 #endif
 
+    /* record/replay */
+    r = rpl_initmgr();
+    if (IS_FAIL(r)) {
+        err_print(__FILE__, __LINE__, "engine init failed: could not init replay");
+        return RET_FAIL;
+    }
+
     /* lod-scheme */
     r = lod_initmgr();
     if (IS_FAIL(r)) {
@@ -390,6 +435,13 @@ result_t eng_init(const struct init_params* params)
     /* init world vars */
     eng_world_regvars();
 
+    /* engine's own frame stages, game stages can be added/inserted between them later */
+    r = eng_register_stages();
+    if (IS_FAIL(r)) {
+        err_print(__FILE__, __LINE__, "engine init failed: could not register frame stages");
+        return RET_FAIL;
+    }
+
     /* engine specific console commnads */
     con_register_cmd("showfps", eng_console_showfps, NULL, "showfps [1*/0]");
     con_register_cmd("showft", eng_console_showft, NULL, "showft [1*/0]");
@@ -412,8 +464,11 @@ void eng_release()
     if (g_eng == NULL)
         return;
 
+    /* release model instances held by render snapshot, before their resources are released */
+    gfx_set_pipelined(FALSE);
     rs_release_resources();
 
+    rpl_releasemgr();
     lod_releasemgr();
 #if !defined(_DEBUG_)
     pak_close(&g_eng->data_pak);
@@ -428,6 +483,7 @@ void eng_release()
     gfx_release();
     rs_reportleaks();
     rs_releasemgr();
+    fgr_releasemgr();
     tsk_releasemgr();
 
     if (g_eng->timer != NULL)
@@ -459,7 +515,6 @@ void eng_update()
     /* variables for fps calculation */
     static float elapsed_tm = 0.0f;
     static uint frame_cnt = 0;
-    static int simulated = FALSE;
 
     /* reset frame stack on start of each frame */
     struct allocator* tmp_alloc = tsk_get_tmpalloc(0);
@@ -468,49 +523,11 @@ void eng_update()
     uint64 start_tick = timer_querytick();
     g_eng->frame_stats.start_tick = start_tick;
 
-    /* check for file changes (dev-mode) */
-    if (BIT_CHECK(g_eng->params.flags, ENG_FLAG_DEV))
-        fio_mon_update();
-
-    /* update all timers */
-    timer_update(start_tick);
+    /* update all timers, on replay they are driven by recorded (or fixed) delta-time */
+    timer_update(rpl_beginframe(start_tick));
 
     /* do all the work ... */
-    float dt = g_eng->timer->dt;
-
-    /* resource manager */
-    rs_update();
-
-    /* physics */
-    if (!BIT_CHECK(g_eng->params.flags, ENG_FLAG_DISABLEPHX)) {
-        if (simulated)
-            phx_wait();
-        phx_update_xforms(simulated);   /* gather results */
-    }
-
-    /* update scripting */
-    sct_update();
-
-    /* physics: run simulation */
-    if (!BIT_CHECK(g_eng->params.flags, ENG_FLAG_DISABLEPHX))
-        simulated = phx_update_sim(dt);
-
-    /* update component system stages */
-    PRF_OPENSAMPLE("Component (pre-render)");
-    cmp_update(dt, CMP_UPDATE_STAGE1);
-    cmp_update(dt, CMP_UPDATE_STAGE2);
-    cmp_update(dt, CMP_UPDATE_STAGE3);
-    cmp_update(dt, CMP_UPDATE_STAGE4);
-    PRF_CLOSESAMPLE();
-
-    /* cull and render active scene */
-    PRF_OPENSAMPLE("Render");
-    gfx_render();
-    PRF_CLOSESAMPLE();
-
-    PRF_OPENSAMPLE("Component (post-render)");
-    cmp_update(dt, CMP_UPDATE_STAGE5);
-    PRF_CLOSESAMPLE();
+    fgr_run(g_eng->timer->dt);
 
     /* clear update list of components */
     cmp_clear_updates();
@@ -529,6 +546,8 @@ void eng_update()
     prf_presentsamples(ft);
 #endif
 
+    rpl_endframe(ft);
+
     g_eng->frame_stats.ft = (float)ft;
     g_eng->frame_stats.frame ++;
     frame_cnt ++;
@@ -542,6 +561,230 @@ void eng_update()
     A_LOAD(tmp_alloc);
 }
 
+result_t eng_register_stages()
+{
+    result_t r = RET_OK;
+    struct fgr_stage_desc desc;
+
+    memset(&desc, 0x00, sizeof(desc));
+    desc.flags = FGR_STAGEFLAG_MAINTHREAD;
+
+    /* check for file changes (dev-mode), hot-loading may reload any resource */
+    if (BIT_CHECK(g_eng->params.flags, ENG_FLAG_DEV))   {
+        desc.name = "files";
+        desc.run_fn = eng_stage_files;
+        desc.writes = FGR_DATA_FILES | FGR_DATA_RESOURCES;
+        r |= fgr_add_stage(&desc, NULL);
+    }
+
+    /* resource manager, syncs background loads and creates gfx objects */
+    desc.name = "resources";
+    desc.run_fn = eng_stage_resources;
+    desc.reads = FGR_DATA_FILES;
+    desc.writes = FGR_DATA_RESOURCES | FGR_DATA_GFX | FGR_DATA_COMPONENTS | FGR_DATA_PHYSICS;
+    r |= fgr_add_stage(&desc, NULL);
+
+    if (!BIT_CHECK(g_eng->params.flags, ENG_FLAG_DISABLEPHX)) {
+        /* physics: gather results of previous simulation into xform components */
+        desc.name = "phx-gather";
+        desc.run_fn = eng_stage_phxgather;
+        desc.reads = 0;
+        desc.writes = FGR_DATA_PHYSICS | FGR_DATA_COMPONENTS;
+        desc.flags = 0;
+        r |= fgr_add_stage(&desc, NULL);
+    }
+
+    /* scripts can load resources, change objects and bodies and print to console */
+    desc.name = "script";
+    desc.run_fn = eng_stage_script;
+    desc.reads = 0;
+    desc.writes = FGR_DATA_SCRIPT | FGR_DATA_RESOURCES | FGR_DATA_COMPONENTS | FGR_DATA_SCENE |
+        FGR_DATA_PHYSICS | FGR_DATA_HUD;
+    desc.flags = FGR_STAGEFLAG_MAINTHREAD;
+    r |= fgr_add_stage(&desc, NULL);
+
+    if (!BIT_CHECK(g_eng->params.flags, ENG_FLAG_DISABLEPHX)) {
+        /* physics: run simulation, results are fetched in next frame's phx-gather
+         * only stage4 components (rbody, trigger) touch physics, so it runs along stages 1-3 */
+        desc.name = "phx-sim";
+        desc.run_fn = eng_stage_phxsim;
+        desc.reads = 0;
+        desc.writes = FGR_DATA_PHYSICS;
+        desc.flags = 0;
+        r |= fgr_add_stage(&desc, NULL);
+    }
+
+    static const char* cmp_names[] = {"cmp-stage1", "cmp-stage2", "cmp-stage3", "cmp-stage4",
+        "cmp-stage5"};
+
+    if (gfx_is_pipelined()) {
+        /* pipelined: component stages 1-3 run on a worker, while main thread renders previous
+         * frame's snapshot. both become ready after script (console writes), so cmp-update is
+         * dispatched before main thread starts rendering. stages 1-3 don't create or destroy
+         * components, so they don't touch resources or gfx objects held by the snapshot */
+        desc.name = "cmp-update";
+        desc.run_fn = eng_stage_cmpupdate;
+        desc.param = NULL;
+        desc.reads = FGR_DATA_RESOURCES;
+        desc.writes = FGR_DATA_COMPONENTS;
+        desc.flags = 0;
+        r |= fgr_add_stage(&desc, NULL);
+
+        desc.name = "render";
+        desc.run_fn = eng_stage_render;
+        desc.reads = FGR_DATA_SNAPSHOT | FGR_DATA_RESOURCES;
+        desc.writes = FGR_DATA_GFX | FGR_DATA_HUD;
+        desc.flags = FGR_STAGEFLAG_MAINTHREAD;
+        r |= fgr_add_stage(&desc, NULL);
+
+        /* stage4 fills render cmdqueue, so it runs after render on main thread */
+        desc.name = cmp_names[CMP_UPDATE_STAGE4];
+        desc.run_fn = eng_stage_cmp;
+        desc.param = (void*)(uptr_t)CMP_UPDATE_STAGE4;
+        desc.reads = FGR_DATA_RESOURCES;
+        desc.writes = eng_cmpstage_writes(CMP_UPDATE_STAGE4);
+        desc.flags = FGR_STAGEFLAG_MAINTHREAD;
+        r |= fgr_add_stage(&desc, NULL);
+
+        desc.name = "spatial";
+        desc.run_fn = eng_stage_spatial;
+        desc.param = NULL;
+        desc.reads = FGR_DATA_COMPONENTS;
+        desc.writes = FGR_DATA_SCENE;
+        desc.flags = FGR_STAGEFLAG_MAINTHREAD;
+        r |= fgr_add_stage(&desc, NULL);
+
+        desc.name = "snapshot";
+        desc.run_fn = eng_stage_snapshot;
+        desc.reads = FGR_DATA_COMPONENTS | FGR_DATA_SCENE | FGR_DATA_RESOURCES;
+        desc.writes = FGR_DATA_SNAPSHOT | FGR_DATA_GFX;
+        desc.flags = FGR_STAGEFLAG_MAINTHREAD;
+        r |= fgr_add_stage(&desc, NULL);
+    }   else    {
+        r |= eng_register_cmpstages(cmp_names);
+    }
+
+    /* component system (post-render) */
+    desc.flags = FGR_STAGEFLAG_MAINTHREAD;
+    desc.name = cmp_names[CMP_UPDATE_STAGE5];
+    desc.run_fn = eng_stage_cmp;
+    desc.param = (void*)(uptr_t)CMP_UPDATE_STAGE5;
+    desc.reads = FGR_DATA_RESOURCES;
+    desc.writes = eng_cmpstage_writes(CMP_UPDATE_STAGE5);
+    r |= fgr_add_stage(&desc, NULL);
+
+    return IS_FAIL(r) ? RET_FAIL : RET_OK;
+}
+
+/* all stages change component data and update lists (cmp_updateinstance), so they run in order.
+ * stage4 gets render cmdqueue (see cmp_update), moves bodies (rbody, trigger) and queues moved
+ * objects for spatial update (bounds) */
+uint eng_cmpstage_writes(uint stage_id)
+{
+    switch (stage_id)   {
+    case CMP_UPDATE_STAGE4:
+        return FGR_DATA_COMPONENTS | FGR_DATA_SCENE | FGR_DATA_PHYSICS | FGR_DATA_GFX;
+    case CMP_UPDATE_STAGE5:
+        return FGR_DATA_COMPONENTS | FGR_DATA_GFX;
+    default:
+        return FGR_DATA_COMPONENTS;
+    }
+}
+
+/* component updates and render in the same frame */
+result_t eng_register_cmpstages(const char** cmp_names)
+{
+    result_t r = RET_OK;
+    struct fgr_stage_desc desc;
+    memset(&desc, 0x00, sizeof(desc));
+
+    /* component system stages (pre-render) */
+    desc.run_fn = eng_stage_cmp;
+    desc.reads = FGR_DATA_RESOURCES;
+    desc.flags = FGR_STAGEFLAG_MAINTHREAD;
+    for (uint i = CMP_UPDATE_STAGE1; i <= CMP_UPDATE_STAGE4; i++)   {
+        desc.name = cmp_names[i];
+        desc.param = (void*)(uptr_t)i;
+        desc.writes = eng_cmpstage_writes(i);
+        r |= fgr_add_stage(&desc, NULL);
+    }
+
+    /* move updated objects in spatial structures, before they are culled */
+    desc.name = "spatial";
+    desc.run_fn = eng_stage_spatial;
+    desc.param = NULL;
+    desc.reads = FGR_DATA_COMPONENTS;
+    desc.writes = FGR_DATA_SCENE;
+    r |= fgr_add_stage(&desc, NULL);
+
+    /* cull and render active scene */
+    desc.name = "render";
+    desc.run_fn = eng_stage_render;
+    desc.param = NULL;
+    desc.reads = FGR_DATA_COMPONENTS | FGR_DATA_SCENE | FGR_DATA_RESOURCES;
+    desc.writes = FGR_DATA_GFX | FGR_DATA_HUD;
+    r |= fgr_add_stage(&desc, NULL);
+
+    return r;
+}
+
+void eng_stage_files(float dt, uint thread_id, void* param)
+{
+    fio_mon_update();
+}
+
+void eng_stage_resources(float dt, uint thread_id, void* param)
+{
+    rs_update();
+}
+
+void eng_stage_phxgather(float dt, uint thread_id, void* param)
+{
+    if (g_eng->phx_simulated)
+        phx_wait();
+    /* runs on any thread, so temp memory of the stage's thread is used */
+    phx_update_xforms(g_eng->phx_simulated, thread_id);
+}
+
+void eng_stage_script(float dt, uint thread_id, void* param)
+{
+    sct_update();
+}
+
+void eng_stage_phxsim(float dt, uint thread_id, void* param)
+{
+    g_eng->phx_simulated = phx_update_sim(dt);
+}
+
+void eng_stage_cmp(float dt, uint thread_id, void* param)
+{
+    cmp_update(dt, (uint)(uptr_t)param, thread_id);
+}
+
+/* component stages 1-3 in one job (pipelined mode), range updates of the stages are still run in
+ * parallel, fgr_parallel_for claims idle workers from the worker that runs this stage */
+void eng_stage_cmpupdate(float dt, uint thread_id, void* param)
+{
+    for (uint i = CMP_UPDATE_STAGE1; i <= CMP_UPDATE_STAGE3; i++)
+        cmp_update(dt, i, thread_id);
+}
+
+/* moved objects are queued by bounds components (scn_update_spatial) */
+void eng_stage_spatial(float dt, uint thread_id, void* param)
+{
+    scn_flush_spatial(thread_id);
+}
+
+void eng_stage_render(float dt, uint thread_id, void* param)
+{
+    gfx_render();
+}
+
+void eng_stage_snapshot(float dt, uint thread_id, void* param)
+{
+    gfx_render_snapshot();
+}
+
 const struct frame_stats* eng_get_framestats()
 {
 	return &g_eng->frame_stats;
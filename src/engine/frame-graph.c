@@ -0,0 +1,449 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include "dhcore/core.h"
+#include "dhcore/task-mgr.h"
+#include "dhcore/timer.h"
+#include "dhcore/mt.h"
+
+#include "frame-graph.h"
+#include "console.h"
+#include "prf-mgr.h"
+#include "mem-ids.h"
+
+#define FGR_WORKERS_MAX 63
+
+/*************************************************************************************************
+ * types
+ */
+struct fgr_stage
+{
+    char name[FGR_NAME_MAX];
+    pfn_fgr_stage run_fn;
+    void* param;
+    uint reads;
+    uint writes;
+    uint flags;
+    uint64 deps;    /* bitmask of stages (indexes) that must be finished before this one */
+    uint job_id;    /* job_id if stage is dispatched to a worker, else 0 */
+    int worker;     /* index of worker (in g_fgr.worker_idxs) that runs the stage, or -1 */
+    fl64 tm;        /* last run time (ms) */
+};
+
+struct fgr_range_job
+{
+    pfn_fgr_range range_fn;
+    void* param;
+    uint item_cnt;
+    uint chunk_cnt;
+};
+
+struct fgr_mgr
+{
+    struct fgr_stage stages[FGR_STAGES_MAX];
+    uint stage_cnt;
+    int deps_dirty;
+    float dt;   /* current frame's delta-time, passed to stages running on workers */
+    uint worker_cnt;    /* number of task workers that can be used for frame jobs */
+    int worker_idxs[FGR_WORKERS_MAX];
+    uint64 busy_workers;    /* bitmask of workers that run a stage or a parallel range */
+    mt_mutex worker_mtx;    /* stages on workers can also claim workers (fgr_parallel_for) */
+};
+
+/*************************************************************************************************
+ * fwd declarations
+ */
+void fgr_build_deps();
+int fgr_find_stageidx(const char* name);
+int fgr_claim_worker();
+void fgr_run_inline(struct fgr_stage* s, float dt);
+void fgr_dispatch(struct fgr_stage* s, int worker);
+void fgr_finish(struct fgr_stage* s);
+void fgr_stage_job(void* params, void* result, uint thread_id, uint job_id, int worker_idx);
+void fgr_range_job(void* params, void* result, uint thread_id, uint job_id, int worker_idx);
+result_t fgr_console_framegraph(uint argc, const char** argv, void* param);
+
+/*************************************************************************************************
+ * globals
+ */
+struct fgr_mgr g_fgr;
+
+/*************************************************************************************************
+ * inlines
+ */
+INLINE int fgr_conflicts(const struct fgr_stage* a, const struct fgr_stage* b)
+{
+    return (a->writes & (b->reads | b->writes)) || (a->reads & b->writes);
+}
+
+INLINE uint64 fgr_stagebit(uint idx)
+{
+    return ((uint64)1) << idx;
+}
+
+/*************************************************************************************************/
+void fgr_zero()
+{
+    memset(&g_fgr, 0x00, sizeof(g_fgr));
+}
+
+result_t fgr_initmgr(uint thread_cnt)
+{
+    log_print(LOG_TEXT, "init frame-graph ...");
+
+    /* first task worker is reserved for background loading of res-mgr, so we use the rest */
+    g_fgr.worker_cnt = thread_cnt > 1 ? minui(thread_cnt - 1, FGR_WORKERS_MAX) : 0;
+    for (uint i = 0; i < g_fgr.worker_cnt; i++)
+        g_fgr.worker_idxs[i] = (int)i + 1;
+
+    log_printf(LOG_INFO, "\tframe jobs run on main thread + %d workers", g_fgr.worker_cnt);
+    mt_mutex_init(&g_fgr.worker_mtx);
+
+    con_register_cmd("framegraph", fgr_console_framegraph, NULL, "framegraph");
+    return RET_OK;
+}
+
+void fgr_releasemgr()
+{
+    mt_mutex_release(&g_fgr.worker_mtx);
+    fgr_zero();
+}
+
+result_t fgr_add_stage(const struct fgr_stage_desc* desc, OPTIONAL const char* before)
+{
+    ASSERT(desc->run_fn);
+
+    if (g_fgr.stage_cnt == FGR_STAGES_MAX)  {
+        err_printf(__FILE__, __LINE__, "frame-graph: maximum stages (%d) exceeded",
+            FGR_STAGES_MAX);
+        return RET_FAIL;
+    }
+
+    if (fgr_find_stageidx(desc->name) != -1)    {
+        err_printf(__FILE__, __LINE__, "frame-graph: stage '%s' already exists", desc->name);
+        return RET_FAIL;
+    }
+
+    uint idx = g_fgr.stage_cnt;
+    if (before != NULL) {
+        int before_idx = fgr_find_stageidx(before);
+        if (before_idx == -1)   {
+            err_printf(__FILE__, __LINE__, "frame-graph: stage '%s' not found", before);
+            return RET_FAIL;
+        }
+        idx = (uint)before_idx;
+        memmove(&g_fgr.stages[idx+1], &g_fgr.stages[idx],
+            sizeof(struct fgr_stage)*(g_fgr.stage_cnt - idx));
+    }
+
+    struct fgr_stage* s = &g_fgr.stages[idx];
+    memset(s, 0x00, sizeof(struct fgr_stage));
+    str_safecpy(s->name, sizeof(s->name), desc->name);
+    s->run_fn = desc->run_fn;
+    s->param = desc->param;
+    s->reads = desc->reads;
+    s->writes = desc->writes;
+    s->flags = desc->flags;
+    s->worker = -1;
+
+    g_fgr.stage_cnt ++;
+    g_fgr.deps_dirty = TRUE;
+    return RET_OK;
+}
+
+void fgr_remove_stage(const char* name)
+{
+    int idx = fgr_find_stageidx(name);
+    if (idx == -1)
+        return;
+
+    uint cnt = g_fgr.stage_cnt - (uint)idx - 1;
+    if (cnt > 0)
+        memmove(&g_fgr.stages[idx], &g_fgr.stages[idx+1], sizeof(struct fgr_stage)*cnt);
+    g_fgr.stage_cnt --;
+    g_fgr.deps_dirty = TRUE;
+}
+
+void fgr_enable_stage(const char* name, int enable)
+{
+    int idx = fgr_find_stageidx(name);
+    if (idx == -1)
+        return;
+
+    if (enable)
+        BIT_REMOVE(g_fgr.stages[idx].flags, FGR_STAGEFLAG_DISABLED);
+    else
+        BIT_ADD(g_fgr.stages[idx].flags, FGR_STAGEFLAG_DISABLED);
+}
+
+uint fgr_get_threadcnt()
+{
+    return g_fgr.worker_cnt + 1;
+}
+
+int fgr_find_stageidx(const char* name)
+{
+    for (uint i = 0; i < g_fgr.stage_cnt; i++)  {
+        if (str_isequal(g_fgr.stages[i].name, name))
+            return (int)i;
+    }
+    return -1;
+}
+
+/* each stage depends on every stage before it that it conflicts with,
+ * so the order that stages are added is the tie breaker for conflicting data access */
+void fgr_build_deps()
+{
+    for (uint i = 0; i < g_fgr.stage_cnt; i++)  {
+        struct fgr_stage* s = &g_fgr.stages[i];
+        s->deps = 0;
+        for (uint k = 0; k < i; k++)    {
+            if (fgr_conflicts(&g_fgr.stages[k], s))
+                s->deps |= fgr_stagebit(k);
+        }
+    }
+    g_fgr.deps_dirty = FALSE;
+}
+
+/* marks the first idle worker as busy and returns it, or -1 if all workers are busy */
+int fgr_claim_worker()
+{
+    int worker = -1;
+    mt_mutex_lock(&g_fgr.worker_mtx);
+    for (uint i = 0; i < g_fgr.worker_cnt; i++)  {
+        if (!(g_fgr.busy_workers & fgr_stagebit(i)))    {
+            g_fgr.busy_workers |= fgr_stagebit(i);
+            worker = (int)i;
+            break;
+        }
+    }
+    mt_mutex_unlock(&g_fgr.worker_mtx);
+    return worker;
+}
+
+void fgr_run(float dt)
+{
+    if (g_fgr.deps_dirty)
+        fgr_build_deps();
+
+    uint cnt = g_fgr.stage_cnt;
+    uint64 done = 0;
+    uint64 dispatched = 0;
+    uint64 all = cnt < 64 ? (fgr_stagebit(cnt) - 1) : ~((uint64)0);
+
+    g_fgr.dt = dt;
+
+    for (uint i = 0; i < cnt; i++)  {
+        if (BIT_CHECK(g_fgr.stages[i].flags, FGR_STAGEFLAG_DISABLED))
+            done |= fgr_stagebit(i);
+    }
+
+    while (done != all) {
+        /* main thread takes the first ready main-thread stage, or if there is none, the first
+         * ready worker stage. the rest of ready worker stages are dispatched to idle workers */
+        uint64 ready = 0;
+        int main_idx = -1;
+        for (uint i = 0; i < cnt; i++)  {
+            const struct fgr_stage* s = &g_fgr.stages[i];
+            if (!((done | dispatched) & fgr_stagebit(i)) && (s->deps & done) == s->deps)   {
+                ready |= fgr_stagebit(i);
+                if (main_idx == -1 && BIT_CHECK(s->flags, FGR_STAGEFLAG_MAINTHREAD))
+                    main_idx = (int)i;
+            }
+        }
+
+        for (uint i = 0; i < cnt && ready != 0; i++)  {
+            uint64 b = fgr_stagebit(i);
+            if (!(ready & b) || BIT_CHECK(g_fgr.stages[i].flags, FGR_STAGEFLAG_MAINTHREAD))
+                continue;
+
+            if (main_idx == -1) {
+                main_idx = (int)i;
+                continue;
+            }
+
+            int worker = fgr_claim_worker();
+            if (worker == -1)
+                break;
+            fgr_dispatch(&g_fgr.stages[i], worker);
+            dispatched |= b;
+        }
+
+        if (main_idx != -1) {
+            fgr_run_inline(&g_fgr.stages[main_idx], dt);
+            done |= fgr_stagebit((uint)main_idx);
+            continue;
+        }
+
+        /* nothing to do on main thread, collect finished workers or wait for the first one */
+        ASSERT(dispatched != 0);
+        int finished = FALSE;
+        for (uint i = 0; i < cnt; i++)  {
+            uint64 b = fgr_stagebit(i);
+            if ((dispatched & b) && tsk_check_finished(g_fgr.stages[i].job_id))  {
+                fgr_finish(&g_fgr.stages[i]);
+                dispatched &= ~b;
+                done |= b;
+                finished = TRUE;
+            }
+        }
+
+        if (!finished)  {
+            for (uint i = 0; i < cnt; i++)  {
+                uint64 b = fgr_stagebit(i);
+                if (dispatched & b) {
+                    fgr_finish(&g_fgr.stages[i]);
+                    dispatched &= ~b;
+                    done |= b;
+                    break;
+                }
+            }
+        }
+    }
+
+    ASSERT(g_fgr.busy_workers == 0);
+}
+
+void fgr_run_inline(struct fgr_stage* s, float dt)
+{
+    PRF_OPENSAMPLE(s->name);
+    uint64 start_tick = timer_querytick();
+    s->run_fn(dt, 0, s->param);
+    s->tm = timer_calctm(start_tick, timer_querytick())*1000.0;
+    PRF_CLOSESAMPLE();
+}
+
+void fgr_dispatch(struct fgr_stage* s, int worker)
+{
+    s->worker = worker;
+    mt_mutex_lock(&g_fgr.worker_mtx);
+    s->job_id = tsk_dispatch_exclusive(fgr_stage_job, &g_fgr.worker_idxs[worker], 1, s, NULL);
+    mt_mutex_unlock(&g_fgr.worker_mtx);
+}
+
+void fgr_finish(struct fgr_stage* s)
+{
+    tsk_wait(s->job_id);
+    mt_mutex_lock(&g_fgr.worker_mtx);
+    tsk_destroy(s->job_id);
+    g_fgr.busy_workers &= ~fgr_stagebit((uint)s->worker);
+    mt_mutex_unlock(&g_fgr.worker_mtx);
+    s->job_id = 0;
+    s->worker = -1;
+}
+
+/* Runs in task threads */
+void fgr_stage_job(void* params, void* result, uint thread_id, uint job_id, int worker_idx)
+{
+    struct fgr_stage* s = (struct fgr_stage*)params;
+    struct allocator* tmp_alloc = tsk_get_tmpalloc(thread_id);
+
+    A_SAVE(tmp_alloc);
+    uint64 start_tick = timer_querytick();
+    s->run_fn(g_fgr.dt, thread_id, s->param);
+    s->tm = timer_calctm(start_tick, timer_querytick())*1000.0;
+    A_LOAD(tmp_alloc);
+}
+
+void fgr_parallel_for(pfn_fgr_range range_fn, uint item_cnt, uint batch_min, void* param,
+    uint thread_id)
+{
+    if (item_cnt == 0)
+        return;
+
+    batch_min = maxui(batch_min, 1);
+
+    /* claim as many idle workers as we need chunks, caller can be the main thread or a stage that
+     * runs on a worker, so workers are claimed under lock */
+    int thread_idxs[FGR_WORKERS_MAX];
+    uint64 claimed = 0;
+    uint idle_cnt = 0;
+    uint need_cnt = (item_cnt + batch_min - 1)/batch_min - 1;
+
+    mt_mutex_lock(&g_fgr.worker_mtx);
+    for (uint i = 0; i < g_fgr.worker_cnt && idle_cnt < need_cnt; i++)  {
+        if (!(g_fgr.busy_workers & fgr_stagebit(i)))    {
+            thread_idxs[idle_cnt++] = g_fgr.worker_idxs[i];
+            claimed |= fgr_stagebit(i);
+        }
+    }
+    g_fgr.busy_workers |= claimed;
+    mt_mutex_unlock(&g_fgr.worker_mtx);
+
+    uint chunk_cnt = idle_cnt + 1;
+    if (chunk_cnt <= 1) {
+        range_fn(0, item_cnt, thread_id, param);
+        return;
+    }
+
+    struct fgr_range_job job;
+    job.range_fn = range_fn;
+    job.param = param;
+    job.item_cnt = item_cnt;
+    job.chunk_cnt = chunk_cnt;
+
+    /* chunk #0 is processed by calling thread, others by claimed workers */
+    mt_mutex_lock(&g_fgr.worker_mtx);
+    uint job_id = tsk_dispatch_exclusive(fgr_range_job, thread_idxs, chunk_cnt - 1, &job, NULL);
+    mt_mutex_unlock(&g_fgr.worker_mtx);
+
+    range_fn(0, (uint)((uint64)item_cnt/chunk_cnt), thread_id, param);
+    tsk_wait(job_id);
+
+    mt_mutex_lock(&g_fgr.worker_mtx);
+    tsk_destroy(job_id);
+    g_fgr.busy_workers &= ~claimed;
+    mt_mutex_unlock(&g_fgr.worker_mtx);
+}
+
+/* Runs in task threads */
+void fgr_range_job(void* params, void* result, uint thread_id, uint job_id, int worker_idx)
+{
+    struct fgr_range_job* job = (struct fgr_range_job*)params;
+    uint64 chunk = (uint64)worker_idx + 1;
+    uint start = (uint)(chunk*job->item_cnt/job->chunk_cnt);
+    uint end = (uint)((chunk + 1)*job->item_cnt/job->chunk_cnt);
+
+    struct allocator* tmp_alloc = tsk_get_tmpalloc(thread_id);
+    A_SAVE(tmp_alloc);
+    job->range_fn(start, end, thread_id, job->param);
+    A_LOAD(tmp_alloc);
+}
+
+result_t fgr_console_framegraph(uint argc, const char** argv, void* param)
+{
+    if (g_fgr.deps_dirty)
+        fgr_build_deps();
+
+    log_printf(LOG_TEXT, "frame-graph: %d stages, %d workers", g_fgr.stage_cnt, g_fgr.worker_cnt);
+    for (uint i = 0; i < g_fgr.stage_cnt; i++)  {
+        const struct fgr_stage* s = &g_fgr.stages[i];
+        char deps[256];
+        deps[0] = 0;
+        for (uint k = 0; k < i; k++)    {
+            if ((s->deps & fgr_stagebit(k)) &&
+                strlen(deps) + strlen(g_fgr.stages[k].name) + 2 < sizeof(deps))
+            {
+                strcat(deps, " ");
+                strcat(deps, g_fgr.stages[k].name);
+            }
+        }
+
+        log_printf(LOG_TEXT, "\t%s (%s%s): %.3fms, deps:%s", s->name,
+            BIT_CHECK(s->flags, FGR_STAGEFLAG_MAINTHREAD) ? "main" : "worker",
+            BIT_CHECK(s->flags, FGR_STAGEFLAG_DISABLED) ? ", disabled" : "", s->tm, deps);
+    }
+    return RET_OK;
+}
@@ -43,7 +43,7 @@ void* gfx_ringbuffer_map(gfx_cmdqueue cmdqueue, struct gfx_ringbuffer* rbuff,
 		mode = GFX_MAP_WRITE_DISCARD;
 	}	else	{
 		mode = GFX_MAP_WRITE_DISCARDRANGE;
-#if defined(_GL_)
+#if defined(_GL_) || defined(_NULL_)
         sync = FALSE;
 #endif
 	}
@@ -96,7 +96,7 @@ void* gfx_contbuffer_map(gfx_cmdqueue cmdqueue, struct gfx_contbuffer* cbuff,
 	if ((size + cbuff->offset) > total_sz)
 		cbuff->offset = 0;
 
-#if defined(_GL_)
+#if defined(_GL_) || defined(_NULL_)
     int sync = (cbuff->offset == 0);
 #else
     int sync = TRUE;
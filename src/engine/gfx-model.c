@@ -57,6 +57,8 @@ void model_update_uniqueids(struct gfx_model_instance* inst);
 void model_update_alphaflags(struct gfx_model_instance* inst);
 const struct mat3f* model_loadmat_pq(struct mat3f* rm, const float* pos, const float* quat);
 const struct mat3f* model_loadmat(struct mat3f* rm, const float* f);
+int model_sort_joints(struct gfx_model_skeleton* sk);
+uint model_joint_depth(const struct gfx_model_skeleton* sk, uint joint_idx);
 
 int gfx_model_create_inputlayout(struct gfx_model_geo* geo);
 uint gfx_model_choose_elem_buffidx(enum gfx_input_element_id id, OUT uint* offset);
@@ -129,6 +131,7 @@ struct gfx_model* gfx_model_load(struct allocator* alloc, const char* h3dm_filep
         h3dmodel.total_geo_subsets*sizeof(struct gfx_model_geosubset) +
         h3dmodel.total_joints*sizeof(struct gfx_model_joint) +
         h3dmodel.total_joints*sizeof(struct mat3f) +
+        h3dmodel.total_joints*sizeof(uint) +
         h3dmodel.total_submeshes*sizeof(struct gfx_model_submesh) +
         h3dmodel.total_skeletons*sizeof(struct gfx_model_skeleton) +
         h3dmodel.total_skeletons*32 + /* 2 aligned allocs per skeleton */
@@ -466,8 +469,11 @@ int model_loadgeo(struct gfx_model_geo* geo, file_t f, struct allocator* alloc,
             sizeof(struct mat3f)*h3dgeo.joint_cnt, MID_GFX);
 		geo->skeleton->joints = (struct gfx_model_joint*)A_ALIGNED_ALLOC(alloc,
 				sizeof(struct gfx_model_joint)*h3dgeo.joint_cnt, MID_GFX);
+        geo->skeleton->joint_order = (uint*)A_ALLOC(alloc, sizeof(uint)*h3dgeo.joint_cnt,
+            MID_GFX);
 		ASSERT(geo->skeleton->init_pose != NULL);
         ASSERT(geo->skeleton->joints != NULL);
+        ASSERT(geo->skeleton->joint_order != NULL);
 
 		for (uint i = 0; i < h3dgeo.joint_cnt; i++)	{
 			struct h3d_joint h3djoint;
@@ -483,6 +489,10 @@ int model_loadgeo(struct gfx_model_geo* geo, file_t f, struct allocator* alloc,
 		}
 
         fio_read(f, geo->skeleton->init_pose, sizeof(struct mat3f), h3dgeo.joint_cnt);
+        if (!model_sort_joints(geo->skeleton))  {
+            err_print(__FILE__, __LINE__, "load model failed: invalid joint hierarchy");
+            goto err_cleanup;
+        }
 	}
 
     ASSERT(v_cnt > 0);
@@ -519,6 +529,43 @@ err_cleanup:
 	return FALSE;
 }
 
+/* sorts joint indexes by depth in hierarchy (parents-first), so skin mats are calculated in one
+ * pass that reuses parent results (gfx_model_update_skin)
+ * returns FALSE if hierarchy is broken (parent out of range or a cycle) */
+int model_sort_joints(struct gfx_model_skeleton* sk)
+{
+    uint max_depth = 0;
+    for (uint i = 0; i < sk->joint_cnt; i++)  {
+        uint depth = model_joint_depth(sk, i);
+        if (depth == INVALID_INDEX)
+            return FALSE;
+        max_depth = maxui(max_depth, depth);
+    }
+
+    uint cnt = 0;
+    for (uint depth = 0; depth <= max_depth; depth++)  {
+        for (uint i = 0; i < sk->joint_cnt; i++)  {
+            if (model_joint_depth(sk, i) == depth)
+                sk->joint_order[cnt++] = i;
+        }
+    }
+    return TRUE;
+}
+
+/* walk is capped at joint count, any deeper chain must contain a cycle (returns INVALID_INDEX) */
+uint model_joint_depth(const struct gfx_model_skeleton* sk, uint joint_idx)
+{
+    uint depth = 0;
+    uint parent_id = sk->joints[joint_idx].parent_id;
+    while (parent_id != INVALID_INDEX)  {
+        if (parent_id >= sk->joint_cnt || depth == sk->joint_cnt)
+            return INVALID_INDEX;
+        depth ++;
+        parent_id = sk->joints[parent_id].parent_id;
+    }
+    return depth;
+}
+
 const struct mat3f* model_loadmat_pq(struct mat3f* rm, const float* pos, const float* quat)
 {
     struct vec3f p;
@@ -696,7 +743,7 @@ struct gfx_model_instance* gfx_model_createinstance(struct allocator* alloc,
 				inst->mtls[mtl_id] = model_load_gpumtl(alloc, &stack_alloc, tmp_alloc,
                     &m->mtls[mtl_id], rpath_flags);
 				if (inst->mtls[mtl_id] == NULL)	{
-					gfx_model_destroyinstance(inst);
+					gfx_model_destroyinstance_now(inst);
 					return NULL;
 				}
 			}
@@ -705,7 +752,7 @@ struct gfx_model_instance* gfx_model_createinstance(struct allocator* alloc,
 				inst->poses[geo_id] = model_load_gpupose(&stack_alloc, tmp_alloc, &m->geos[geo_id],
 						rpath_flags);
 				if (inst->poses[geo_id] == NULL)	{
-					gfx_model_destroyinstance(inst);
+					gfx_model_destroyinstance_now(inst);
 					return NULL;
 				}
 			}
@@ -716,7 +763,7 @@ struct gfx_model_instance* gfx_model_createinstance(struct allocator* alloc,
 	if (unique_cnt > 0)	{
 		inst->unique_ids = (uint*)A_ALLOC(&stack_alloc, sizeof(uint)*unique_cnt, MID_GFX);
 		if (inst->unique_ids == NULL)	{
-			gfx_model_destroyinstance(inst);
+			gfx_model_destroyinstance_now(inst);
 			return NULL;
 		}
 		memset(inst->unique_ids, 0x00, sizeof(uint)*unique_cnt);
@@ -793,6 +840,14 @@ void model_update_alphaflags(struct gfx_model_instance* inst)
 }
 
 void gfx_model_destroyinstance(struct gfx_model_instance* inst)
+{
+    /* pipelined renderer may still use the instance in it's snapshot */
+    if (gfx_snapshot_holdinstance(inst))
+        return;
+    gfx_model_destroyinstance_now(inst);
+}
+
+void gfx_model_destroyinstance_now(struct gfx_model_instance* inst)
 {
 	struct allocator* alloc = inst->alloc;
 	ASSERT(inst->model != INVALID_HANDLE);
@@ -1153,21 +1208,30 @@ uint gfx_model_findjoint(const struct gfx_model_skeleton* skeleton, const char*
     return INVALID_INDEX;
 }
 
-/* calculate model-view mats and multiply them into their offsets to get skin mats */
+/* calculate model-view mats and multiply them into their offsets to get skin mats
+ * joints are visited parents-first, so model-view mats of parents are already in skin_mats */
 void gfx_model_update_skin(struct gfx_model_posegpu* pose)
 {
     struct mat3f tmp_mat;
     const struct gfx_model_skeleton* sk = pose->skeleton;
+    const struct gfx_model_joint* joints = sk->joints;
+    const uint* order = sk->joint_order;
+    struct mat3f* skin_mats = pose->skin_mats;
+    const struct mat3f* mats = pose->mats;
+    uint cnt = pose->mat_cnt;
+
+    for (uint i = 0; i < cnt; i++)   {
+        uint idx = order[i];
+        uint parent_id = joints[idx].parent_id;
+        if (parent_id != INVALID_INDEX)
+            mat3_mul(&skin_mats[idx], &mats[idx], &skin_mats[parent_id]);
+        else
+            mat3_setm(&skin_mats[idx], &mats[idx]);
+    }
 
-    for (uint i = 0, cnt = pose->mat_cnt; i < cnt; i++)   {
-        mat3_setm(&tmp_mat, &pose->mats[i]);
-        const struct gfx_model_joint* joint = &sk->joints[i];
-        while (joint->parent_id != INVALID_INDEX)   {
-            mat3_mul(&tmp_mat, &tmp_mat, &pose->mats[joint->parent_id]);
-            joint = &sk->joints[joint->parent_id];
-        }
-
-        mat3_mul(&pose->skin_mats[i], &pose->offset_mats[i], &tmp_mat);
+    for (uint i = 0; i < cnt; i++)  {
+        mat3_mul(&tmp_mat, &pose->offset_mats[i], &skin_mats[i]);
+        mat3_setm(&skin_mats[i], &tmp_mat);
     }
 }
 
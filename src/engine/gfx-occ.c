@@ -640,12 +640,12 @@ float gfx_occ_getfar()
     return OCC_FAR;
 }
 
+/* tests only read the zbuffer, so they can run in parallel, callers report stats with
+ * gfx_occ_addtests */
 int gfx_occ_testbounds(const struct sphere* s, const struct vec3f* xaxis,
     const struct vec3f* yaxis, const struct vec3f* campos)
 {
     struct vec4f quad_pts[4];
-    g_occ.stats.test_obj_cnt ++;
-    g_occ.stats.test_tri_cnt += 2;
 
     /**
      * calculate object bounding quad
@@ -705,6 +705,12 @@ int gfx_occ_testbounds(const struct sphere* s, const struct vec3f* xaxis,
     return sum > OCC_THRESHOLD;
 }
 
+void gfx_occ_addtests(uint obj_cnt)
+{
+    g_occ.stats.test_obj_cnt += obj_cnt;
+    g_occ.stats.test_tri_cnt += obj_cnt*2;
+}
+
 float occ_testtri(const struct vec3f* v0, const struct vec3f* v1, const struct vec3f* v2)
 {
     float* buff = g_occ.zbuff;
@@ -36,6 +36,9 @@
 #elif defined(_GL_)
 #define SHADER_SUFFIX "glsl"
 #define CACHE_FILENAME "dh_shaders_gl"
+#elif defined(_NULL_)
+#define SHADER_SUFFIX "glsl"
+#define CACHE_FILENAME "dh_shaders_null"
 #endif
 
 #define HSEED 4354
@@ -369,7 +372,7 @@ void shader_loadcache()
 			fread(item, sizeof(struct shader_cache_item), 1, f);
 
 			/* read program/shaders data */
-#if defined(_GL_)
+#if defined(_GL_) || defined(_NULL_)
 			if (item->bin.prog_size > 0)	{
 				item->bin.prog_data = ALLOC(item->bin.prog_size, MID_GFX);
 				ASSERT(item->bin.prog_data);
@@ -424,7 +427,7 @@ void shader_saveunloadcache()
 			for (uint i = 0; i < item_cnt; i++)	{
 				fwrite(&items[i], sizeof(struct shader_cache_item), 1, f);
 
-#if defined(_GL_)
+#if defined(_GL_) || defined(_NULL_)
 				if (items[i].bin.prog_size > 0 && items[i].bin.prog_data != NULL)	{
 					fwrite(items[i].bin.prog_data, items[i].bin.prog_size, 1, f);
 					FREE(items[i].bin.prog_data);
@@ -777,7 +780,7 @@ struct gfx_shader* shader_load_fromcache(struct allocator* alloc,
     struct gfx_program_bin_desc bindesc;
 
     /* binary data is different for each API */
-#if defined(_GL_)
+#if defined(_GL_) || defined(_NULL_)
     bindesc.data = cache->bin.prog_data;
     bindesc.fmt = cache->bin.fmt;
     bindesc.size = cache->bin.prog_size;
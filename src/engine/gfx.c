@@ -17,6 +17,7 @@
 #include "dhcore/core.h"
 #include "dhcore/task-mgr.h"
 #include "dhcore/hwinfo.h"
+#include "dhcore/stack-alloc.h"
 
 #include "dhapp/app.h"
 
@@ -39,6 +40,7 @@
 #include "gfx-billboard.h"
 #include "res-mgr.h"
 #include "world-mgr.h"
+#include "components/cmp-light.h"
 
 #include "renderpaths/gfx-fwd.h"
 #include "renderpaths/gfx-deferred.h"
@@ -49,6 +51,7 @@
 #define TONEMAP_DEFAULT_LUM_MIN 0.1f
 #define TONEMAP_DEFAULT_LUM_MAX 1.0f
 #define OCC_BUFFER_SIZE 128
+#define GFX_SNAPSHOT_SIZE (8*1024*1024)
 
 /*************************************************************************************************
  * structs/types
@@ -97,6 +100,20 @@ struct gfx_fs_vertex
     struct vec3f coord;
 };
 
+/* culled render data of a frame, created after component updates and rendered in the next frame
+ * by pipelined renderer. everything that may change by next frame's update is copied */
+struct gfx_snapshot
+{
+    struct stack_alloc stack;
+    struct allocator alloc;
+    struct camera cam;
+    struct gfx_view_params params;
+    struct scn_render_query* query;
+    struct scn_render_query* query_csm;
+    struct array held_insts;    /* item: gfx_model_instance*, destroyed by next snapshot */
+    int valid;
+};
+
 struct gfx_renderer
 {
     /* note: width, height defined in 'params' will change in runtime
@@ -128,6 +145,9 @@ struct gfx_renderer
     struct gfx_device_info info;
     int rtv_width;
     int rtv_height;
+
+    int pipelined;
+    struct gfx_snapshot snapshot;
 };
 
 /*************************************************************************************************
@@ -148,7 +168,7 @@ struct gfx_renderpass* gfx_renderpass_create(struct allocator* alloc);
 /* primary pass provides render data and send it to additem for further processing
  * @param trans_items: item is gfx_transparent_item
  * @param trans_idxs: item is uint (index to trans_items) */
-void gfx_renderpass_process_primary(struct allocator* alloc, const struct frustum* frust,
+void gfx_renderpass_process_primary(struct allocator* alloc, struct scn_render_query* query,
     struct array* trans_items, struct array* trans_idxs, const struct gfx_view_params* params);
 /* for each pass processing, there are items that are need to be added and batched
  * each pass includes a number of subpasses which share the same render-path
@@ -175,7 +195,7 @@ void gfx_renderpass_additem_transparent(struct scn_render_query* query, enum cmp
 		struct array* trans_items, struct array* trans_idxs,
 		const struct mat3f* view);
 
-void gfx_renderpass_process_sunshadow(struct allocator* alloc, const struct gfx_view_params* params);
+void gfx_renderpass_process_sunshadow(struct allocator* alloc, struct scn_render_query* rq);
 
 /* finally process render passes renders all (batched) passes by order */
 void gfx_process_renderpasses(gfx_cmdqueue cmdqueue, gfx_rendertarget rt,
@@ -208,6 +228,20 @@ void gfx_composite_render(gfx_cmdqueue cmdqueue, gfx_texture src_tex, gfx_textur
 
 void gfx_render_blank(gfx_cmdqueue cmdqueue, int width, int height);
 
+/* render stages: view setup and culling reads scene data, the rest only uses culled queries */
+void gfx_render_setview(OUT struct gfx_view_params* params, OUT struct frustum* viewfrust,
+    struct camera* cam, int width, int height);
+void gfx_render_cull(struct allocator* alloc, const struct gfx_view_params* params,
+    const struct frustum* viewfrust, OUT struct scn_render_query** query,
+    OUT struct scn_render_query** query_csm);
+void gfx_render_scene(struct allocator* alloc, const struct gfx_view_params* params,
+    struct scn_render_query* query, struct scn_render_query* query_csm);
+void gfx_render_overlays(const struct gfx_view_params* params, int debug_cmps);
+
+/* pipelined render */
+result_t gfx_snapshot_copyquery(struct allocator* alloc, struct scn_render_query* query);
+void gfx_snapshot_releaseinsts(struct gfx_snapshot* snap);
+
 /*************************************************************************************************
  * globals
  */
@@ -395,6 +429,9 @@ result_t gfx_init(const struct gfx_params* params)
 
 void gfx_release()
 {
+    if (g_gfx.pipelined)
+        gfx_set_pipelined(FALSE);
+
     if (g_gfx.tex_blank_black != INVALID_HANDLE)
         rs_unload(g_gfx.tex_blank_black);
 
@@ -441,66 +478,162 @@ void gfx_render()
 {
 	int width = (int)g_gfx.rtv_width;
 	int height = (int)g_gfx.rtv_height;
-
-	float widthf = (float)width;
-	float heightf = (float)height;
     gfx_cmdqueue cmdqueue = g_gfx.cmdqueue;
-    struct array trans_items;
-    struct array trans_idxs;
     struct gfx_view_params params;
     struct frustum viewfrust;
     struct allocator* tmp_alloc = tsk_get_tmpalloc(0);
-    struct gfx_renderpass* rpass;
-    result_t r;
 
     g_gfx.preview_render = FALSE;
 
-    /* we have no camera, just render blank screen */
-    struct camera* cam = wld_get_cam();
-
 	/* reset */
     PRF_OPENSAMPLE("render");
-    memset(&g_gfx.cull_stats, 0x00, sizeof(struct gfx_cull_stats));
-
 	gfx_reset_framestats(cmdqueue);
     gfx_reset_devstates(cmdqueue);
 
-    /* render */
-    params.width = width;
-    params.height = height;
-    params.cam = cam;
-    cam_set_viewsize(cam, widthf, heightf);
-    cam_get_perspective(&params.proj, cam);
-    cam_get_view(&params.view, cam);
-    mat3_mul4(&params.viewproj, &params.view, &params.proj);
-    vec3_setv(&params.cam_pos, &cam->pos);
-    cam_calc_frustumplanes(viewfrust.planes, &params.viewproj);
-    vec4_setf(&params.projparams, params.proj.m11, params.proj.m22,
-        params.proj.m33, params.proj.m43);
+    /* pipelined: render the snapshot of previous frame (see gfx_render_snapshot) */
+    if (g_gfx.pipelined)    {
+        struct gfx_snapshot* snap = &g_gfx.snapshot;
+        if (!snap->valid)   {
+            gfx_render_blank(cmdqueue, width, height);
+            PRF_CLOSESAMPLE();
+            hud_render(cmdqueue);
+            gfx_canvas_render2d(cmdqueue, NULL, (float)width, (float)height);
+            return;
+        }
+
+        memcpy(&params, &snap->params, sizeof(params));
+        A_SAVE(tmp_alloc);
+        gfx_render_scene(tmp_alloc, &params, snap->query, snap->query_csm);
+        A_LOAD(tmp_alloc);
+        PRF_CLOSESAMPLE();
+
+        /* components are updated concurrently, so we can't debug draw them */
+        gfx_render_overlays(&params, FALSE);
+        return;
+    }
+
+    gfx_render_setview(&params, &viewfrust, wld_get_cam(), width, height);
 
     /* use frame allocator for main thread (temp) */
     A_SAVE(tmp_alloc);
+    struct scn_render_query* query;
+    struct scn_render_query* query_csm;
+    gfx_render_cull(tmp_alloc, &params, &viewfrust, &query, &query_csm);
+    gfx_render_scene(tmp_alloc, &params, query, query_csm);
+    A_LOAD(tmp_alloc);	/* free all memory of culling/batching */
+
+    PRF_CLOSESAMPLE();
+
+    gfx_render_overlays(&params, TRUE);
+}
+
+void gfx_render_setview(OUT struct gfx_view_params* params, OUT struct frustum* viewfrust,
+    struct camera* cam, int width, int height)
+{
+    float widthf = (float)width;
+    float heightf = (float)height;
+
+    params->width = width;
+    params->height = height;
+    params->cam = cam;
+    cam_set_viewsize(cam, widthf, heightf);
+    cam_get_perspective(&params->proj, cam);
+    cam_get_view(&params->view, cam);
+    mat3_mul4(&params->viewproj, &params->view, &params->proj);
+    vec3_setv(&params->cam_pos, &cam->pos);
+    cam_calc_frustumplanes(viewfrust->planes, &params->viewproj);
+    vec4_setf(&params->projparams, params->proj.m11, params->proj.m22,
+        params->proj.m33, params->proj.m43);
+}
+
+void gfx_render_cull(struct allocator* alloc, const struct gfx_view_params* params,
+    const struct frustum* viewfrust, OUT struct scn_render_query** query,
+    OUT struct scn_render_query** query_csm)
+{
+    memset(&g_gfx.cull_stats, 0x00, sizeof(struct gfx_cull_stats));
+    *query = NULL;
+    *query_csm = NULL;
+
+    uint scene_id = scn_getactive();
+    if (scene_id == 0)
+        return;
+
+    /* sun shadows */
+    struct vec3f sun_dir;
+    struct aabb world_bounds;
+    struct vec3f world_min, world_max;
+    uint sec_light = wld_find_section("light");
+    const float* world_sundir = wld_get_var(sec_light, wld_find_var(sec_light, "dir"))->fv;
+
+    scn_getsize(scene_id, &world_min, &world_max);
+    vec3_setf(&sun_dir, world_sundir[0], world_sundir[1], world_sundir[2]);
+    aabb_setv(&world_bounds, &world_min, &world_max);
+
+    /* calculate csm shadow stuff like matrices and frustum bounds */
+    gfx_csm_prepare(params, vec3_norm(&sun_dir, &sun_dir), &world_bounds);
+    const struct aabb* frust_bounds = gfx_csm_get_frustumbounds();
+
+    /* primary view and sun shadows are culled with a single traversal of the scene */
+    PRF_OPENSAMPLE("cull-views");
+    struct scn_view views[2];
+    struct scn_render_query* queries[2];
+    memset(views, 0x00, sizeof(views));
+
+    views[0].type = SCN_VIEW_FRUSTUM;
+    views[0].occlusion = TRUE;
+    memcpy(views[0].planes, viewfrust->planes, sizeof(struct plane)*6);
+
+    views[1].type = SCN_VIEW_SWEEP;
+    aabb_setb(&views[1].bounds, frust_bounds);
+    vec3_setv(&views[1].dir, &sun_dir);
+
+    result_t r = scn_create_queries(scene_id, alloc, views, 2, params, queries);
+    ASSERT(IS_OK(r));
+    if (IS_FAIL(r)) {
+        PRF_CLOSESAMPLE();
+        return;
+    }
+
+    *query = queries[0];
+    *query_csm = queries[1];
+    g_gfx.cull_stats.prim_model_cnt = (*query)->model_cnt;
+    g_gfx.cull_stats.prim_light_cnt = (*query)->light_cnt;
+    g_gfx.cull_stats.csm_model_cnt = (*query_csm)->model_cnt;
+    PRF_CLOSESAMPLE();
+}
+
+/* batches culled queries and renders them into backbuffer */
+void gfx_render_scene(struct allocator* alloc, const struct gfx_view_params* params,
+    struct scn_render_query* query, struct scn_render_query* query_csm)
+{
+    gfx_cmdqueue cmdqueue = g_gfx.cmdqueue;
+    struct array trans_items;
+    struct array trans_idxs;
+    struct gfx_renderpass* rpass;
+    int width = params->width;
+    int height = params->height;
+    result_t r;
 
     /* create transparent objects arrays */
-    r = arr_create(tmp_alloc, &trans_items, sizeof(struct gfx_transparent_item), 50, 200, MID_GFX);
-    r |= arr_create(tmp_alloc, &trans_idxs, sizeof(uint), 50, 200, MID_GFX);
+    r = arr_create(alloc, &trans_items, sizeof(struct gfx_transparent_item), 50, 200, MID_GFX);
+    r |= arr_create(alloc, &trans_idxs, sizeof(uint), 50, 200, MID_GFX);
     ASSERT(IS_OK(r));
 
     /* create primary pass (note that primary pass is actually rendered last in render passes) */
     PRF_OPENSAMPLE("batch-primary");
-    g_gfx.passes[GFX_RENDERPASS_PRIMARY] = gfx_renderpass_create(tmp_alloc);
-    gfx_renderpass_process_primary(tmp_alloc, &viewfrust, &trans_items, &trans_idxs, &params);
+    g_gfx.passes[GFX_RENDERPASS_PRIMARY] = gfx_renderpass_create(alloc);
+    gfx_renderpass_process_primary(alloc, query, &trans_items, &trans_idxs, params);
     PRF_CLOSESAMPLE();
 
     PRF_OPENSAMPLE("batch-csm");
-    g_gfx.passes[GFX_RENDERPASS_SUNSHADOW] = gfx_renderpass_create(tmp_alloc);
-    gfx_renderpass_process_sunshadow(tmp_alloc, &params);
+    g_gfx.passes[GFX_RENDERPASS_SUNSHADOW] = gfx_renderpass_create(alloc);
+    gfx_renderpass_process_sunshadow(alloc, query_csm);
     PRF_CLOSESAMPLE();
 
-    gfx_occ_finish(cmdqueue, &params);
+    gfx_occ_finish(cmdqueue, params);
 
     /* process all render passes */
-    gfx_process_renderpasses(cmdqueue, NULL, &params);
+    gfx_process_renderpasses(cmdqueue, NULL, params);
 
     /* get possible data from primary render-pass and copy it into backbuffer */
     rpass = g_gfx.passes[GFX_RENDERPASS_PRIMARY];
@@ -511,7 +644,7 @@ void gfx_render()
             /* do additional postfx */
 
             /* tonemapping */
-            ldr_tex = gfx_pfx_tonemap_render(cmdqueue, g_gfx.tonemap, &params,
+            ldr_tex = gfx_pfx_tonemap_render(cmdqueue, g_gfx.tonemap, params,
                 (gfx_texture)rpass->result.rt->desc.rt.rt_textures[0], &bloom_tex);
 
             /* fxaa */
@@ -531,18 +664,23 @@ void gfx_render()
     }   else    {
         gfx_render_blank(cmdqueue, width, height);
     }
+}
 
-    A_LOAD(tmp_alloc);	/* free all memory of culling/batching */
-
-    PRF_CLOSESAMPLE();
+/* billboards, debug and 2d drawing over the rendered scene */
+void gfx_render_overlays(const struct gfx_view_params* params, int debug_cmps)
+{
+    gfx_cmdqueue cmdqueue = g_gfx.cmdqueue;
+    float widthf = (float)params->width;
+    float heightf = (float)params->height;
 
-    gfx_blb_render(cmdqueue, &params);
+    gfx_blb_render(cmdqueue, params);
 
     /* debug render */
     PRF_OPENSAMPLE("debug-render");
-    gfx_canvas_begin3d(cmdqueue, widthf, heightf, &params.viewproj);
+    gfx_canvas_begin3d(cmdqueue, widthf, heightf, &params->viewproj);
     /* component debug render */
-    cmp_debug(0.0f, &params);
+    if (debug_cmps)
+        cmp_debug(0.0f, params);
 
     /* additional debug draw ? */
     if (g_gfx.show_worldbounds) {
@@ -554,7 +692,7 @@ void gfx_render()
     }
 
     if (g_gfx.debug_render_fn != NULL)
-		g_gfx.debug_render_fn(g_gfx.cmdqueue, &params);
+		g_gfx.debug_render_fn(g_gfx.cmdqueue, params);
     gfx_canvas_end3d();
     PRF_CLOSESAMPLE();
 
@@ -564,6 +702,153 @@ void gfx_render()
     PRF_CLOSESAMPLE();
 }
 
+result_t gfx_set_pipelined(int enable)
+{
+    struct gfx_snapshot* snap = &g_gfx.snapshot;
+    if (enable == g_gfx.pipelined)
+        return RET_OK;
+
+    if (enable) {
+        /* snapshot holds culled data of a whole frame, so it's as big as frame temp buffer */
+        size_t size = eng_get_params()->dev.buffsize_tmp;
+        size = size != 0 ? size*1024 : GFX_SNAPSHOT_SIZE;
+
+        memset(snap, 0x00, sizeof(struct gfx_snapshot));
+        result_t r = mem_stack_create(mem_heap(), &snap->stack, size, MID_GFX);
+        if (IS_FAIL(r)) {
+            err_print(__FILE__, __LINE__, "gfx: could not create snapshot buffer");
+            return RET_OUTOFMEMORY;
+        }
+        mem_stack_bindalloc(&snap->stack, &snap->alloc);
+
+        r = arr_create(mem_heap(), &snap->held_insts, sizeof(struct gfx_model_instance*), 32, 32,
+            MID_GFX);
+        if (IS_FAIL(r)) {
+            mem_stack_destroy(&snap->stack);
+            return RET_OUTOFMEMORY;
+        }
+    }   else    {
+        gfx_snapshot_releaseinsts(snap);
+        arr_destroy(&snap->held_insts);
+        mem_stack_destroy(&snap->stack);
+        memset(snap, 0x00, sizeof(struct gfx_snapshot));
+    }
+
+    g_gfx.pipelined = enable;
+    return RET_OK;
+}
+
+int gfx_is_pipelined()
+{
+    return g_gfx.pipelined;
+}
+
+void gfx_render_snapshot()
+{
+    struct gfx_snapshot* snap = &g_gfx.snapshot;
+    struct frustum viewfrust;
+    ASSERT(g_gfx.pipelined);
+
+    PRF_OPENSAMPLE("snapshot");
+
+    /* previous snapshot is rendered by now, so we can discard it */
+    gfx_snapshot_releaseinsts(snap);
+    mem_stack_reset(&snap->stack);
+    snap->valid = FALSE;
+
+    /* view params are calculated from a copy of the camera, because it will be updated
+     * in the next frame while snapshot is being rendered */
+    struct camera* cam = wld_get_cam();
+    cam_set_viewsize(cam, (float)g_gfx.rtv_width, (float)g_gfx.rtv_height);
+    memcpy(&snap->cam, cam, sizeof(struct camera));
+    gfx_render_setview(&snap->params, &viewfrust, &snap->cam, g_gfx.rtv_width, g_gfx.rtv_height);
+
+    gfx_render_cull(&snap->alloc, &snap->params, &viewfrust, &snap->query, &snap->query_csm);
+    /* snapshot buffer is fixed size, if the frame doesn't fit, it is dropped and a blank frame
+     * is rendered instead of referencing data that changes during next frame's update */
+    if (IS_FAIL(gfx_snapshot_copyquery(&snap->alloc, snap->query)) ||
+        IS_FAIL(gfx_snapshot_copyquery(&snap->alloc, snap->query_csm)))
+    {
+        log_print(LOG_WARNING, "gfx: render snapshot dropped, out of snapshot memory "
+            "(increase dev.buffsize_tmp)");
+        PRF_CLOSESAMPLE();
+        return;
+    }
+    snap->valid = TRUE;
+
+    PRF_CLOSESAMPLE();
+}
+
+/* world matrices and bounds are already copied into the query, here we copy skinning matrices and
+ * light data which are referenced by pointers */
+result_t gfx_snapshot_copyquery(struct allocator* alloc, struct scn_render_query* query)
+{
+    if (query == NULL)
+        return RET_OK;
+
+    for (uint i = 0, cnt = query->model_cnt; i < cnt; i++) {
+        struct scn_render_model* rmodel = &query->models[i];
+        const struct gfx_model_posegpu* pose = rmodel->pose;
+        if (pose == NULL)
+            continue;
+
+        struct gfx_model_posegpu* spose = (struct gfx_model_posegpu*)A_ALLOC(alloc,
+            sizeof(struct gfx_model_posegpu), MID_GFX);
+        struct mat3f* skin_mats = (struct mat3f*)A_ALIGNED_ALLOC(alloc,
+            sizeof(struct mat3f)*pose->mat_cnt, MID_GFX);
+        if (spose == NULL || skin_mats == NULL)
+            return RET_OUTOFMEMORY;
+
+        /* only skinning matrices are used by render-paths */
+        memcpy(skin_mats, pose->skin_mats, sizeof(struct mat3f)*pose->mat_cnt);
+        spose->skeleton = pose->skeleton;
+        spose->mat_cnt = pose->mat_cnt;
+        spose->mats = NULL;
+        spose->offset_mats = NULL;
+        spose->skin_mats = skin_mats;
+        rmodel->pose = spose;
+    }
+
+    for (uint i = 0, cnt = query->light_cnt; i < cnt; i++) {
+        struct scn_render_light* rlight = &query->lights[i];
+        struct cmp_light* ldata = (struct cmp_light*)A_ALLOC(alloc, sizeof(struct cmp_light),
+            MID_GFX);
+        if (ldata == NULL)
+            return RET_OUTOFMEMORY;
+        memcpy(ldata, rlight->ldata, sizeof(struct cmp_light));
+        rlight->ldata = ldata;
+    }
+
+    return RET_OK;
+}
+
+int gfx_snapshot_holdinstance(struct gfx_model_instance* inst)
+{
+    if (!g_gfx.pipelined || !g_gfx.snapshot.valid)
+        return FALSE;
+
+    struct gfx_model_instance** pinst =
+        (struct gfx_model_instance**)arr_add(&g_gfx.snapshot.held_insts);
+    if (pinst == NULL)
+        return FALSE;
+    *pinst = inst;
+
+    /* keep a reference to model resource, until the instance is actually destroyed */
+    rs_load_model(rs_get_filepath(inst->model), 0);
+    return TRUE;
+}
+
+void gfx_snapshot_releaseinsts(struct gfx_snapshot* snap)
+{
+    struct gfx_model_instance** insts = (struct gfx_model_instance**)snap->held_insts.buffer;
+    for (uint i = 0, cnt = snap->held_insts.item_cnt; i < cnt; i++)    {
+        reshandle_t model_hdl = insts[i]->model;
+        gfx_model_destroyinstance_now(insts[i]);
+        rs_unload(model_hdl);
+    }
+    arr_clear(&snap->held_insts);
+}
+
 void gfx_set_debug_renderfunc(pfn_debug_render fn)
 {
 	g_gfx.debug_render_fn = fn;
@@ -821,23 +1106,13 @@ struct gfx_renderpass* gfx_renderpass_create(struct allocator* alloc)
     return rpass;
 }
 
-void gfx_renderpass_process_primary(struct allocator* alloc, const struct frustum* frust,
+void gfx_renderpass_process_primary(struct allocator* alloc, struct scn_render_query* query,
     struct array* trans_items, struct array* trans_idxs, const struct gfx_view_params* params)
 {
     struct gfx_renderpass* pass = g_gfx.passes[GFX_RENDERPASS_PRIMARY];
-
-    /* cull scene by frustum */
-    uint scene_id = scn_getactive();
-    if (scene_id == 0)
+    if (query == NULL)
         return;
 
-    struct scn_render_query* query = scn_create_query(scene_id, alloc, frust->planes, params, 0);
-    ASSERT(query != NULL);
-
-    /* cull stats */
-    g_gfx.cull_stats.prim_model_cnt = query->model_cnt;
-    g_gfx.cull_stats.prim_light_cnt = query->light_cnt;
-
 	/* models */
 	for (uint i = 0, cnt = query->model_cnt; i < cnt; i++)	{
 		struct scn_render_model* rmodel = &query->models[i];
@@ -891,32 +1166,11 @@ void gfx_renderpass_process_primary(struct allocator* alloc, const struct frustu
 
 }
 
-void gfx_renderpass_process_sunshadow(struct allocator* alloc, const struct gfx_view_params* params)
+void gfx_renderpass_process_sunshadow(struct allocator* alloc, struct scn_render_query* rq)
 {
-    struct vec3f sun_dir;
-    struct aabb world_bounds;
-    uint sec_light = wld_find_section("light");
-    const float* world_sundir = wld_get_var(sec_light, wld_find_var(sec_light, "dir"))->fv;
-    struct vec3f world_min, world_max;
-
-    uint scene_id = scn_getactive();
-    if (scene_id == 0)
-        return;
-    scn_getsize(scene_id, &world_min, &world_max);
-
-    vec3_setf(&sun_dir, world_sundir[0], world_sundir[1], world_sundir[2]);
-    aabb_setv(&world_bounds, &world_min, &world_max);
     struct gfx_renderpass* pass = g_gfx.passes[GFX_RENDERPASS_SUNSHADOW];
-
-    /* calculate csm shadow stuff like matrices and frustum bounds */
-    gfx_csm_prepare(params, vec3_norm(&sun_dir, &sun_dir), &world_bounds);
-    const struct aabb* frust_bounds = gfx_csm_get_frustumbounds();
-
-    /* shadow csm cull */
-    struct scn_render_query* rq =
-        scn_create_query_csm(scn_getactive(), alloc, frust_bounds, &sun_dir, params);
-    ASSERT(rq != NULL);
-    g_gfx.cull_stats.csm_model_cnt = rq->model_cnt;
+    if (rq == NULL)
+        return;
 
     for (uint i = 0, cnt = rq->model_cnt; i < cnt; i++)   {
  		struct scn_render_model* rmodel = &rq->models[i];
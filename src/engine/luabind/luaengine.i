@@ -278,6 +278,7 @@ public:
     void clear();
     Object find(const char* name);
     Object getObject(uint obj_id);
+    Object probeRay(const Vector& origin, const Vector& dir, float len);
 
     Object createModelLod(const char* name, const char* h3dm_hi, const char* h3dm_md = "",
         const char* h3dm_lo = "");
@@ -4003,6 +4003,50 @@ fail:
 }
 
 
+static int _wrap_Scene_probeRay(lua_State* L) {
+  int SWIG_arg = 0;
+  Scene *arg1 = (Scene *) 0 ;
+  Vector *arg2 = 0 ;
+  Vector *arg3 = 0 ;
+  float arg4 ;
+  Object result;
+  
+  SWIG_check_num_args("Scene::probeRay",4,4)
+  if(!SWIG_isptrtype(L,1)) SWIG_fail_arg("Scene::probeRay",1,"Scene *");
+  if(!lua_isuserdata(L,2)) SWIG_fail_arg("Scene::probeRay",2,"Vector const &");
+  if(!lua_isuserdata(L,3)) SWIG_fail_arg("Scene::probeRay",3,"Vector const &");
+  if(!lua_isnumber(L,4)) SWIG_fail_arg("Scene::probeRay",4,"float");
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,1,(void**)&arg1,SWIGTYPE_p_Scene,0))){
+    SWIG_fail_ptr("Scene_probeRay",1,SWIGTYPE_p_Scene);
+  }
+  
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,2,(void**)&arg2,SWIGTYPE_p_Vector,0))){
+    SWIG_fail_ptr("Scene_probeRay",2,SWIGTYPE_p_Vector);
+  }
+  
+  
+  if (!SWIG_IsOK(SWIG_ConvertPtr(L,3,(void**)&arg3,SWIGTYPE_p_Vector,0))){
+    SWIG_fail_ptr("Scene_probeRay",3,SWIGTYPE_p_Vector);
+  }
+  
+  arg4 = (float)lua_tonumber(L, 4);
+  result = (arg1)->probeRay((Vector const &)*arg2,(Vector const &)*arg3,arg4);
+  {
+    Object * resultptr = new Object((const Object &) result);
+    SWIG_NewPointerObj(L,(void *) resultptr,SWIGTYPE_p_Object,1); SWIG_arg++;
+  }
+  return SWIG_arg;
+  
+  if(0) SWIG_fail;
+  
+fail:
+  lua_error(L);
+  return SWIG_arg;
+}
+
+
 static int _wrap_Scene_createModelLod__SWIG_0(lua_State* L) {
   int SWIG_arg = 0;
   Scene *arg1 = (Scene *) 0 ;
@@ -4577,6 +4621,7 @@ static swig_lua_method swig_Scene_methods[] = {
     {"clear", _wrap_Scene_clear}, 
     {"find", _wrap_Scene_find}, 
     {"getObject", _wrap_Scene_getObject}, 
+    {"probeRay", _wrap_Scene_probeRay}, 
     {"createModelLod", _wrap_Scene_createModelLod}, 
     {"createModel", _wrap_Scene_createModel}, 
     {"createPointLight", _wrap_Scene_createPointLight}, 
@@ -74,7 +74,7 @@ cmphandle_t get_component(struct cmp_obj* obj, const char* cmp_name)
     }
 
     cmptype_t type = cmp_gettype(c);
-    cmphandle_t hdl = cmp_findinstance(obj->chain, type);
+    cmphandle_t hdl = cmp_findinstance_bytype_inobj(obj, type);
 
     if (hdl == INVALID_HANDLE) {
         sct_throwerror("get_component - could not find Component '%s' in Object '%s'", cmp_name,
@@ -92,7 +92,7 @@ cmphandle_t add_component(struct cmp_obj* obj, const char* cmp_name)
         return INVALID_HANDLE;
     }
 
-    cmphandle_t hdl = cmp_findinstance(obj->chain, cmp_gettype(c));
+    cmphandle_t hdl = cmp_findinstance_bytype_inobj(obj, cmp_gettype(c));
     if (hdl != INVALID_HANDLE)
         return hdl;
 
@@ -604,6 +604,27 @@ Object Scene::getObject(uint obj_id)
     return Object(scn_getobj(id_, obj_id));
 }
 
+Object Scene::probeRay(const Vector& origin, const Vector& dir, float len)
+{
+    PROTECT_SCENE_R(Object());
+
+    struct scn_probe probe;
+    struct scn_probe_hit hit;
+    uint hit_cnt;
+    memset(&probe, 0x00, sizeof(probe));
+    probe.type = SCN_PROBE_RAY;
+    vec3_setv(&probe.pt, &origin.v_);
+    vec3_norm(&probe.dir, &dir.v_);
+    probe.len = len;
+
+    /* scripts run in main thread */
+    scn_run_probes(id_, &probe, 1, 1, &hit, &hit_cnt, 0);
+    if (hit_cnt == 0)
+        return Object();
+
+    return Object(scn_getobj(id_, hit.obj_id));
+}
+
 Object Scene::createModel(const char* name, const char* h3dmfile)
 {
     PROTECT_SCENE_R(Object());
@@ -0,0 +1,415 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+/**
+ * Null command queue: does not render anything, only counts calls in frame stats (same as
+ * other APIs) and optionally writes them into a text log ("gfx_cmdlog" console command)
+ */
+
+#if defined(_NULL_)
+
+#include <stdio.h>
+#include <stdarg.h>
+
+#include "dhcore/core.h"
+
+#include "dhapp/app.h"
+
+#include "gfx-cmdqueue.h"
+#include "mem-ids.h"
+#include "gfx-device.h"
+#include "gfx.h"
+#include "gfx-shader.h"
+#include "engine.h"
+#include "console.h"
+
+/*************************************************************************************************
+ * types
+ */
+struct gfx_cmdqueue_s
+{
+	struct gfx_framestats stats;
+	struct gfx_rasterizer_desc last_raster;
+	struct gfx_depthstencil_desc last_depthstencil;
+	struct gfx_blend_desc last_blend;
+    FILE* log;  /* command log, NULL if logging is off */
+    uint frame_idx;
+};
+
+/*************************************************************************************************
+ * forward declarations
+ */
+void cmdqueue_log(gfx_cmdqueue cmdqueue, const char* fmt, ...);
+result_t cmdqueue_console_log(uint argc, const char** argv, void* param);
+
+/*************************************************************************************************/
+gfx_cmdqueue gfx_create_cmdqueue()
+{
+	gfx_cmdqueue cmdqueue = (gfx_cmdqueue)ALLOC(sizeof(struct gfx_cmdqueue_s), MID_GFX);
+	if (cmdqueue == NULL)
+		return NULL;
+	memset(cmdqueue, 0x00, sizeof(struct gfx_cmdqueue_s));
+	return cmdqueue;
+}
+
+void gfx_destroy_cmdqueue(gfx_cmdqueue cmdqueue)
+{
+    FREE(cmdqueue);
+}
+
+result_t gfx_initcmdqueue(gfx_cmdqueue cmdqueue)
+{
+    memcpy(&cmdqueue->last_raster, gfx_get_defaultraster(), sizeof(struct gfx_rasterizer_desc));
+    memcpy(&cmdqueue->last_depthstencil, gfx_get_defaultdepthstencil(),
+        sizeof(struct gfx_depthstencil_desc));
+    memcpy(&cmdqueue->last_blend, gfx_get_defaultblend(), sizeof(struct gfx_blend_desc));
+
+    con_register_cmd("gfx_cmdlog", cmdqueue_console_log, cmdqueue, "gfx_cmdlog [filepath/off]");
+
+	return RET_OK;
+}
+
+void gfx_releasecmdqueue(gfx_cmdqueue cmdqueue)
+{
+    if (cmdqueue->log != NULL)  {
+        fclose(cmdqueue->log);
+        cmdqueue->log = NULL;
+    }
+}
+
+void gfx_input_setlayout(gfx_cmdqueue cmdqueue, gfx_inputlayout inputlayout)
+{
+	ASSERT(inputlayout->type == GFX_OBJ_INPUTLAYOUT);
+    cmdqueue_log(cmdqueue, "input_setlayout %p", inputlayout);
+
+	cmdqueue->stats.input_cnt ++;
+}
+
+void gfx_program_set(gfx_cmdqueue cmdqueue, gfx_program prog)
+{
+    cmdqueue_log(cmdqueue, "program_set %p", prog);
+
+	cmdqueue->stats.shaderchange_cnt ++;
+}
+
+void gfx_buffer_update(gfx_cmdqueue cmdqueue, gfx_buffer buffer, const void* data, uint size)
+{
+	ASSERT(buffer->type == GFX_OBJ_BUFFER);
+
+	uint s = minui(size, buffer->desc.buff.size);
+    memcpy((void*)buffer->api_obj, data, s);
+    cmdqueue_log(cmdqueue, "buffer_update %p size=%d", buffer, s);
+
+    cmdqueue->stats.map_cnt ++;
+}
+
+void gfx_reset_framestats(gfx_cmdqueue cmdqueue)
+{
+    if (cmdqueue->log != NULL)  {
+        const struct gfx_framestats* s = &cmdqueue->stats;
+        fprintf(cmdqueue->log, "-- frame %d: draws=%d prims=%d shaders=%d maps=%d rts=%d\n",
+            cmdqueue->frame_idx, s->draw_cnt, s->prims_cnt, s->shaderchange_cnt, s->map_cnt,
+            s->rtchange_cnt);
+    }
+    cmdqueue->frame_idx ++;
+
+	memset(&cmdqueue->stats, 0x00, sizeof(struct gfx_framestats));
+}
+
+const struct gfx_framestats* gfx_get_framestats(gfx_cmdqueue cmdqueue)
+{
+	return &cmdqueue->stats;
+}
+
+void gfx_program_setcblock(gfx_cmdqueue cmdqueue, gfx_program prog, enum gfx_shader_type shader,
+		gfx_buffer buffer, uint shaderbind_id, uint bind_idx)
+{
+    cmdqueue_log(cmdqueue, "program_setcblock %p bind=%d", buffer, bind_idx);
+}
+
+void gfx_program_bindcblock_range(gfx_cmdqueue cmdqueue,  gfx_program prog,
+                                  enum gfx_shader_type shader, gfx_buffer buffer,
+                                  uint shaderbind_id, uint bind_idx,
+                                  uint offset, uint size)
+{
+    cmdqueue_log(cmdqueue, "program_bindcblock_range %p bind=%d offset=%d size=%d", buffer,
+        bind_idx, offset, size);
+}
+
+void gfx_program_setsampler(gfx_cmdqueue cmdqueue, gfx_program prog, enum gfx_shader_type shader,
+		gfx_sampler sampler, uint shaderbind_id, uint texture_unit)
+{
+    cmdqueue_log(cmdqueue, "program_setsampler %p unit=%d", sampler, texture_unit);
+}
+
+void gfx_program_settexture(gfx_cmdqueue cmdqueue, gfx_program prog, enum gfx_shader_type shader,
+        gfx_texture tex, uint texture_unit)
+{
+    cmdqueue_log(cmdqueue, "program_settexture %p unit=%d", tex, texture_unit);
+}
+
+void gfx_output_setviewport(gfx_cmdqueue cmdqueue, int x, int y, int width, int height)
+{
+    cmdqueue_log(cmdqueue, "output_setviewport %d %d %d %d", x, y, width, height);
+}
+
+void gfx_output_setviewportbias(gfx_cmdqueue cmdqueue, int x, int y, int width, int height)
+{
+    cmdqueue_log(cmdqueue, "output_setviewportbias %d %d %d %d", x, y, width, height);
+}
+
+void gfx_output_setblendstate(gfx_cmdqueue cmdqueue, gfx_blendstate blend,
+		OPTIONAL const float* blend_color)
+{
+	const struct gfx_blend_desc* desc;
+	if (blend != NULL)
+		desc = &blend->desc.blend;
+	else
+		desc = gfx_get_defaultblend();
+
+	memcpy(&cmdqueue->last_blend, desc, sizeof(struct gfx_blend_desc));
+    cmdqueue_log(cmdqueue, "output_setblendstate %p", blend);
+
+	cmdqueue->stats.blendstatechange_cnt ++;
+}
+
+void gfx_output_setscissor(gfx_cmdqueue cmdqueue, int x, int y, int width, int height)
+{
+    cmdqueue_log(cmdqueue, "output_setscissor %d %d %d %d", x, y, width, height);
+}
+
+void gfx_output_setrasterstate(gfx_cmdqueue cmdqueue, gfx_rasterstate raster)
+{
+	const struct gfx_rasterizer_desc* desc;
+	if (raster != NULL)
+		desc = &raster->desc.raster;
+	else
+		desc = gfx_get_defaultraster();
+
+	memcpy(&cmdqueue->last_raster, desc, sizeof(struct gfx_rasterizer_desc));
+    cmdqueue_log(cmdqueue, "output_setrasterstate %p", raster);
+
+	cmdqueue->stats.rsstatechange_cnt ++;
+}
+
+void gfx_output_setdepthstencilstate(gfx_cmdqueue cmdqueue, gfx_depthstencilstate ds,
+		int stencil_ref)
+{
+	const struct gfx_depthstencil_desc* desc;
+	if (ds != NULL)
+		desc = &ds->desc.ds;
+	else
+		desc = gfx_get_defaultdepthstencil();
+
+	memcpy(&cmdqueue->last_depthstencil, desc, sizeof(struct gfx_depthstencil_desc));
+    cmdqueue_log(cmdqueue, "output_setdepthstencilstate %p ref=%d", ds, stencil_ref);
+
+	cmdqueue->stats.dsstatechange_cnt ++;
+}
+
+void* gfx_buffer_map(gfx_cmdqueue cmdqueue, gfx_buffer buffer, uint offset, uint size,
+		uint mode /* enum gfx_map_mode */, int sync_cpu)
+{
+	ASSERT(buffer->type == GFX_OBJ_BUFFER);
+    ASSERT(offset + size <= buffer->desc.buff.size);
+    cmdqueue_log(cmdqueue, "buffer_map %p offset=%d size=%d", buffer, offset, size);
+
+	cmdqueue->stats.map_cnt ++;
+
+	return (uint8*)buffer->api_obj + offset;
+}
+
+void gfx_buffer_unmap(gfx_cmdqueue cmdqueue, gfx_buffer buffer)
+{
+	ASSERT(buffer->type == GFX_OBJ_BUFFER);
+    cmdqueue_log(cmdqueue, "buffer_unmap %p", buffer);
+}
+
+void gfx_draw(gfx_cmdqueue cmdqueue, enum gfx_primitive_type type, uint vert_idx,
+		uint vert_cnt, uint draw_id)
+{
+    cmdqueue_log(cmdqueue, "draw prim=%d vert=%d cnt=%d id=%d", type, vert_idx, vert_cnt,
+        draw_id);
+
+	cmdqueue->stats.draw_cnt ++;
+	cmdqueue->stats.prims_cnt += vert_cnt;
+	cmdqueue->stats.draw_prim_cnt[draw_id] += vert_cnt;
+	cmdqueue->stats.draw_group_cnt[draw_id] ++;
+}
+
+void gfx_draw_indexed(gfx_cmdqueue cmdqueue, enum gfx_primitive_type type,
+		uint ib_idx, uint idx_cnt, enum gfx_index_type ib_type, uint draw_id)
+{
+    cmdqueue_log(cmdqueue, "draw_indexed prim=%d idx=%d cnt=%d id=%d", type, ib_idx, idx_cnt,
+        draw_id);
+
+	cmdqueue->stats.draw_cnt ++;
+	cmdqueue->stats.prims_cnt += idx_cnt;
+	cmdqueue->stats.draw_prim_cnt[draw_id] += idx_cnt;
+	cmdqueue->stats.draw_group_cnt[draw_id] ++;
+}
+
+void gfx_draw_instance(gfx_cmdqueue cmdqueue, enum gfx_primitive_type type,
+		uint vert_idx, uint vert_cnt, uint instance_cnt, uint draw_id)
+{
+    cmdqueue_log(cmdqueue, "draw_instance prim=%d vert=%d cnt=%d instances=%d id=%d", type,
+        vert_idx, vert_cnt, instance_cnt, draw_id);
+
+	cmdqueue->stats.draw_cnt ++;
+	cmdqueue->stats.prims_cnt += vert_cnt;
+	cmdqueue->stats.draw_prim_cnt[draw_id] += vert_cnt;
+	cmdqueue->stats.draw_group_cnt[draw_id] ++;
+}
+
+void gfx_draw_indexedinstance(gfx_cmdqueue cmdqueue, enum gfx_primitive_type type,
+		uint ib_idx, uint idx_cnt, enum gfx_index_type ib_type, uint instance_cnt,
+		uint draw_id)
+{
+    cmdqueue_log(cmdqueue, "draw_indexedinstance prim=%d idx=%d cnt=%d instances=%d id=%d",
+        type, ib_idx, idx_cnt, instance_cnt, draw_id);
+
+	cmdqueue->stats.draw_cnt ++;
+	cmdqueue->stats.prims_cnt += idx_cnt;
+	cmdqueue->stats.draw_prim_cnt[draw_id] += idx_cnt;
+	cmdqueue->stats.draw_group_cnt[draw_id] ++;
+}
+
+void gfx_reset_devstates(gfx_cmdqueue cmdqueue)
+{
+    gfx_output_setblendstate(cmdqueue, NULL, NULL);
+    gfx_output_setrasterstate(cmdqueue, NULL);
+    gfx_output_setdepthstencilstate(cmdqueue, NULL, 0);
+}
+
+void gfx_output_setrendertarget(gfx_cmdqueue cmdqueue, OPTIONAL gfx_rendertarget rt)
+{
+	if (rt != NULL)	{
+		ASSERT(rt->type == GFX_OBJ_RENDERTARGET);
+	    gfx_set_rtvsize(rt->desc.rt.width, rt->desc.rt.height);
+	}	else	{
+        int width, height;
+        gfx_get_wndsize(&width, &height);
+		gfx_set_rtvsize(width, height);
+	}
+    cmdqueue_log(cmdqueue, "output_setrendertarget %p", rt);
+
+	cmdqueue->stats.rtchange_cnt ++;
+}
+
+void gfx_rendertarget_blit(gfx_cmdqueue cmdqueue,
+		int dest_x, int dest_y, int dest_width, int dest_height,
+		gfx_rendertarget src_rt, int src_x, int src_y, int src_width, int src_height)
+{
+    cmdqueue_log(cmdqueue, "rendertarget_blit %p", src_rt);
+}
+
+void gfx_rendertarget_blitraw(gfx_cmdqueue cmdqueue, gfx_rendertarget src_rt)
+{
+    cmdqueue_log(cmdqueue, "rendertarget_blitraw %p", src_rt);
+}
+
+void gfx_flush(gfx_cmdqueue cmdqueue)
+{
+    if (cmdqueue->log != NULL)
+        fflush(cmdqueue->log);
+}
+
+gfx_syncobj gfx_addsync(gfx_cmdqueue cmdqueue)
+{
+    /* nothing to wait for, but callers treat NULL as 'no sync object' */
+	return (gfx_syncobj)cmdqueue;
+}
+
+void gfx_waitforsync(gfx_cmdqueue cmdqueue, gfx_syncobj syncobj)
+{
+}
+
+void gfx_removesync(gfx_cmdqueue cmdqueue, gfx_syncobj syncobj)
+{
+}
+
+void gfx_program_setbindings(gfx_cmdqueue cmdqueue, const uint* bindings, uint binding_cnt)
+{
+}
+
+void gfx_cmdqueue_resetsrvs(gfx_cmdqueue cmdqueue)
+{
+}
+
+void gfx_output_clearrendertarget(gfx_cmdqueue cmdqueue, gfx_rendertarget rt,
+    const float color[4], float depth, uint8 stencil, uint flags)
+{
+    if (BIT_CHECK(flags, GFX_CLEAR_DEPTH) || BIT_CHECK(flags, GFX_CLEAR_STENCIL))
+        cmdqueue->stats.cleards_cnt ++;
+
+    if (BIT_CHECK(flags, GFX_CLEAR_COLOR))
+        cmdqueue->stats.clearrt_cnt ++;
+
+    cmdqueue_log(cmdqueue, "output_clearrendertarget %p flags=0x%x", rt, flags);
+}
+
+void gfx_program_setcblock_tbuffer(gfx_cmdqueue cmdqueue, gfx_program prog,
+    enum gfx_shader_type shader, gfx_buffer buffer, uint shaderbind_id, uint texture_unit)
+{
+    cmdqueue_log(cmdqueue, "program_setcblock_tbuffer %p unit=%d", buffer, texture_unit);
+}
+
+void gfx_texture_generatemips(gfx_cmdqueue cmdqueue, gfx_texture tex)
+{
+    cmdqueue_log(cmdqueue, "texture_generatemips %p", tex);
+}
+
+void gfx_texture_update(gfx_cmdqueue cmdqueue, gfx_texture tex, const void* pixels)
+{
+    cmdqueue_log(cmdqueue, "texture_update %p", tex);
+}
+
+/*************************************************************************************************/
+void cmdqueue_log(gfx_cmdqueue cmdqueue, const char* fmt, ...)
+{
+    if (cmdqueue->log == NULL)
+        return;
+
+    va_list args;
+    va_start(args, fmt);
+    vfprintf(cmdqueue->log, fmt, args);
+    va_end(args);
+    fputc('\n', cmdqueue->log);
+}
+
+result_t cmdqueue_console_log(uint argc, const char** argv, void* param)
+{
+    gfx_cmdqueue cmdqueue = (gfx_cmdqueue)param;
+    if (argc != 1)
+        return RET_INVALIDARG;
+
+    if (cmdqueue->log != NULL)  {
+        fclose(cmdqueue->log);
+        cmdqueue->log = NULL;
+    }
+
+    if (str_isequal_nocase(argv[0], "off"))
+        return RET_OK;
+
+    cmdqueue->log = fopen(argv[0], "wt");
+    if (cmdqueue->log == NULL)  {
+        err_printf(__FILE__, __LINE__, "gfx_cmdlog: could not open file '%s'", argv[0]);
+        return RET_FAIL;
+    }
+
+    return RET_OK;
+}
+
+#endif  /* _NULL_ */
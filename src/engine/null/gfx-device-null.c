@@ -0,0 +1,667 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+/**
+ * Null (headless) graphics device, creates api objects without any gpu, so the whole engine can
+ * run on machines without a graphics context (build servers, cpu profiling)\n
+ * buffers are backed by system memory, so mapping and updating them behaves like real devices,
+ * textures and render-targets only keep their descriptions
+ */
+
+#if defined(_NULL_)
+
+#include <stdio.h>
+
+#include "dhcore/core.h"
+#include "dhcore/pool-alloc.h"
+#include "dhcore/mt.h"
+
+#include "gfx-device.h"
+#include "mem-ids.h"
+#include "gfx.h"
+#include "gfx-texture.h"
+
+#define BUFFER_ALIGNMENT 256
+#define PROGRAM_BIN_SIGN 0x4c4c554e /* NULL */
+
+/*************************************************************************************************
+ * Types
+ */
+struct gfx_device
+{
+	struct gfx_params params;
+	struct gfx_gpu_memstats memstats;
+	struct pool_alloc obj_pool;
+    mt_mutex obj_mtx;   /* objects can be created from loader threads, protects obj_pool */
+    enum gfx_hwver ver;
+};
+
+/* header of program binary data, followed by define code and shader sources */
+struct gfx_program_bin_null
+{
+    uint define_size;
+    uint vs_size;
+    uint ps_size;
+    uint gs_size;
+};
+
+/*************************************************************************************************
+ * Globals
+ */
+static struct gfx_device g_gfxdev;
+
+/*************************************************************************************************
+ * Fwd declarations
+ */
+void* shader_reflect_null(const char* define_code, size_t define_size,
+    const struct gfx_shader_data* source_data);
+void shader_destroyreflect_null(void* reflect);
+void shader_make_defines(char* define_code,
+    const struct gfx_shader_define* defines, uint define_cnt);
+int texture_has_alpha(enum gfx_format fmt);
+
+/*************************************************************************************************
+ * inlines
+ */
+INLINE struct gfx_obj_data* create_obj(uptr_t api_obj, enum gfx_obj_type type)
+{
+    mt_mutex_lock(&g_gfxdev.obj_mtx);
+	struct gfx_obj_data* obj = (struct gfx_obj_data*)mem_pool_alloc(&g_gfxdev.obj_pool);
+    mt_mutex_unlock(&g_gfxdev.obj_mtx);
+    ASSERT(obj != NULL);
+    memset(obj, 0x00, sizeof(struct gfx_obj_data));
+    obj->api_obj = (uptr_t)api_obj;
+    obj->type = type;
+    return obj;
+}
+
+INLINE void destroy_obj(struct gfx_obj_data* obj)
+{
+    obj->type = GFX_OBJ_NULL;
+    mt_mutex_lock(&g_gfxdev.obj_mtx);
+    mem_pool_free(&g_gfxdev.obj_pool, obj);
+    mt_mutex_unlock(&g_gfxdev.obj_mtx);
+}
+
+/*************************************************************************************************/
+void gfx_zerodev()
+{
+	memset(&g_gfxdev, 0x00, sizeof(struct gfx_device));
+}
+
+result_t gfx_initdev(const struct gfx_params* params)
+{
+	result_t r;
+
+	memcpy(&g_gfxdev.params, params, sizeof(struct gfx_params));
+
+    log_print(LOG_INFO, "  init gfx-device (null) ...");
+
+    /* report GL versions, so shaders and renderers choose the same paths as GL builds */
+    switch (params->hwver)  {
+    case GFX_HWVER_GL3_2:
+    case GFX_HWVER_GL3_3:
+    case GFX_HWVER_GL4_0:
+    case GFX_HWVER_GL4_1:
+    case GFX_HWVER_GL4_2:
+    case GFX_HWVER_GL4_3:
+    case GFX_HWVER_GL4_4:
+        g_gfxdev.ver = params->hwver;
+        break;
+    default:
+        g_gfxdev.ver = GFX_HWVER_GL3_3;
+        break;
+    }
+
+	/* object pool */
+	r = mem_pool_create(mem_heap(), &g_gfxdev.obj_pool, sizeof(struct gfx_obj_data),
+			200, MID_GFX);
+	if (IS_FAIL(r))
+		return RET_OUTOFMEMORY;
+    mt_mutex_init(&g_gfxdev.obj_mtx);
+
+	return RET_OK;
+}
+
+void gfx_releasedev()
+{
+    /* detect leaks and delete remaining objects */
+    uint leaks_cnt = mem_pool_getleaks(&g_gfxdev.obj_pool);
+    if (leaks_cnt > 0)
+        log_printf(LOG_WARNING, "gfx-device: total %d leaks found", leaks_cnt);
+
+    mem_pool_destroy(&g_gfxdev.obj_pool);
+    mt_mutex_release(&g_gfxdev.obj_mtx);
+
+	gfx_zerodev();
+}
+
+gfx_inputlayout gfx_create_inputlayout(const struct gfx_input_vbuff_desc* vbuffs, uint vbuff_cnt,
+                                       const struct gfx_input_element_binding* inputs,
+                                       uint input_cnt, OPTIONAL gfx_buffer idxbuffer,
+                                       OPTIONAL enum gfx_index_type itype, uint thread_id)
+{
+    gfx_inputlayout obj = create_obj(0, GFX_OBJ_INPUTLAYOUT);
+    obj->desc.il.ibuff = idxbuffer;
+    obj->desc.il.idxfmt = itype;
+    obj->desc.il.vbuff_cnt = vbuff_cnt;
+    for (uint i = 0; i < vbuff_cnt; i++)  {
+        obj->desc.il.vbuffs[i] = vbuffs[i].vbuff;
+        obj->desc.il.strides[i] = vbuffs[i].stride;
+    }
+    return obj;
+}
+
+void gfx_destroy_inputlayout(gfx_inputlayout input_layout)
+{
+	destroy_obj(input_layout);
+}
+
+gfx_program gfx_create_program(const struct gfx_shader_data* source_data,
+		const struct gfx_input_element_binding* bindings, uint binding_cnt,
+		const struct gfx_shader_define* defines, uint define_cnt,
+		struct gfx_shader_binary_data* bin_data)
+{
+	char define_code[1024];
+    uint shader_cnt = 0;
+	enum gfx_shader_type shader_types[GFX_PROGRAM_MAX_SHADERS];
+
+	shader_make_defines(define_code, defines, define_cnt);
+    size_t define_size = strlen(define_code);
+
+    void* reflect = shader_reflect_null(define_code, define_size, source_data);
+    if (reflect == NULL)    {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+
+    if (source_data->vs_source != NULL)
+        shader_types[shader_cnt++] = GFX_SHADER_VERTEX;
+    if (source_data->ps_source != NULL)
+        shader_types[shader_cnt++] = GFX_SHADER_PIXEL;
+    if (source_data->gs_source != NULL)
+        shader_types[shader_cnt++] = GFX_SHADER_GEOMETRY;
+
+    /* binary data is the source itself, it will be reflected again on gfx_create_program_bin */
+	if (bin_data != NULL)	{
+        struct gfx_program_bin_null hdr;
+        hdr.define_size = (uint)define_size;
+        hdr.vs_size = (source_data->vs_source != NULL) ? (uint)source_data->vs_size : 0;
+        hdr.ps_size = (source_data->ps_source != NULL) ? (uint)source_data->ps_size : 0;
+        hdr.gs_size = (source_data->gs_source != NULL) ? (uint)source_data->gs_size : 0;
+
+        uint bin_size = sizeof(hdr) + hdr.define_size + hdr.vs_size + hdr.ps_size + hdr.gs_size;
+        uint8* data = (uint8*)ALLOC(bin_size, MID_GFX);
+        if (data == NULL)   {
+            shader_destroyreflect_null(reflect);
+            err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+            return NULL;
+        }
+
+        bin_data->prog_data = data;
+        bin_data->prog_size = bin_size;
+        bin_data->fmt = PROGRAM_BIN_SIGN;
+
+        memcpy(data, &hdr, sizeof(hdr));
+        data += sizeof(hdr);
+        memcpy(data, define_code, hdr.define_size);
+        data += hdr.define_size;
+        if (hdr.vs_size > 0)
+            memcpy(data, source_data->vs_source, hdr.vs_size);
+        data += hdr.vs_size;
+        if (hdr.ps_size > 0)
+            memcpy(data, source_data->ps_source, hdr.ps_size);
+        data += hdr.ps_size;
+        if (hdr.gs_size > 0)
+            memcpy(data, source_data->gs_source, hdr.gs_size);
+	}
+
+	gfx_program obj = create_obj((uptr_t)reflect, GFX_OBJ_PROGRAM);
+	obj->desc.prog.shader_cnt = shader_cnt;
+	for (uint i = 0; i < shader_cnt; i++)
+		obj->desc.prog.shader_types[i] = shader_types[i];
+	return obj;
+}
+
+void shader_make_defines(char* define_code,
+		const struct gfx_shader_define* defines, uint define_cnt)
+{
+	char line[128];
+
+    define_code[0] = 0;
+	for (uint i = 0; i < define_cnt; i++)	{
+		sprintf(line, "#define %s %s\n", defines[i].name, defines[i].value);
+		strcat(define_code, line);
+	}
+}
+
+gfx_program gfx_create_program_bin(const struct gfx_program_bin_desc* bindesc)
+{
+    struct gfx_program_bin_null hdr;
+    if (bindesc->fmt != PROGRAM_BIN_SIGN || bindesc->size < sizeof(hdr))   {
+        err_print(__FILE__, __LINE__, "gfx-device: invalid program binary");
+        return NULL;
+    }
+
+    const uint8* data = (const uint8*)bindesc->data;
+    memcpy(&hdr, data, sizeof(hdr));
+    if (sizeof(hdr) + hdr.define_size + hdr.vs_size + hdr.ps_size + hdr.gs_size != bindesc->size)  {
+        err_print(__FILE__, __LINE__, "gfx-device: invalid program binary");
+        return NULL;
+    }
+    data += sizeof(hdr);
+
+    const char* define_code = (const char*)data;
+    data += hdr.define_size;
+
+    struct gfx_shader_data source_data;
+    memset(&source_data, 0x00, sizeof(source_data));
+    if (hdr.vs_size > 0)    {
+        source_data.vs_source = (void*)data;
+        source_data.vs_size = hdr.vs_size;
+    }
+    data += hdr.vs_size;
+    if (hdr.ps_size > 0)    {
+        source_data.ps_source = (void*)data;
+        source_data.ps_size = hdr.ps_size;
+    }
+    data += hdr.ps_size;
+    if (hdr.gs_size > 0)    {
+        source_data.gs_source = (void*)data;
+        source_data.gs_size = hdr.gs_size;
+    }
+
+    void* reflect = shader_reflect_null(define_code, hdr.define_size, &source_data);
+    if (reflect == NULL)    {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+
+	return create_obj((uptr_t)reflect, GFX_OBJ_PROGRAM);
+}
+
+void gfx_destroy_program(gfx_program prog)
+{
+    if (prog->api_obj != 0)
+        shader_destroyreflect_null((void*)prog->api_obj);
+	destroy_obj(prog);
+}
+
+void gfx_delayed_createobjects()
+{
+}
+
+void gfx_delayed_fillobjects(uint thread_id)
+{
+}
+
+void gfx_delayed_finalizeobjects()
+{
+}
+
+void gfx_delayed_waitforobjects(uint thread_id)
+{
+}
+
+void gfx_delayed_release()
+{
+}
+
+gfx_buffer gfx_create_buffer(enum gfx_buffer_type type, enum gfx_mem_hint memhint,
+		uint size, const void* data, uint thread_id)
+{
+    /* buffers are kept in system memory, so maps and updates touch real memory */
+    void* mem = ALIGNED_ALLOC(size, MID_GFX);
+    if (mem == NULL)
+        return NULL;
+    if (data != NULL)
+        memcpy(mem, data, size);
+    else
+        memset(mem, 0x00, size);
+
+	gfx_buffer obj = create_obj((uptr_t)mem, GFX_OBJ_BUFFER);
+	obj->desc.buff.type = type;
+	obj->desc.buff.size = size;
+    obj->desc.buff.alignment = BUFFER_ALIGNMENT;
+
+    mt_mutex_lock(&g_gfxdev.obj_mtx);
+    g_gfxdev.memstats.buffer_cnt ++;
+    g_gfxdev.memstats.buffers += size;
+    mt_mutex_unlock(&g_gfxdev.obj_mtx);
+	return obj;
+}
+
+void gfx_destroy_buffer(gfx_buffer buff)
+{
+    mt_mutex_lock(&g_gfxdev.obj_mtx);
+    g_gfxdev.memstats.buffer_cnt --;
+    g_gfxdev.memstats.buffers -= buff->desc.buff.size;
+    mt_mutex_unlock(&g_gfxdev.obj_mtx);
+
+    if (buff->api_obj != 0)
+        ALIGNED_FREE((void*)buff->api_obj);
+	destroy_obj(buff);
+}
+
+const struct gfx_sampler_desc* gfx_get_defaultsampler()
+{
+	const static struct gfx_sampler_desc desc = {
+			GFX_FILTER_LINEAR,
+			GFX_FILTER_LINEAR,
+			GFX_FILTER_NEAREST,
+			GFX_ADDRESS_WRAP,
+			GFX_ADDRESS_WRAP,
+			GFX_ADDRESS_WRAP,
+			1,
+			GFX_CMP_OFF,
+			{0.0f, 0.0f, 0.0f, 0.0f},
+			-1000,
+			1000
+	};
+	return &desc;
+}
+
+gfx_sampler gfx_create_sampler(const struct gfx_sampler_desc* desc)
+{
+	return create_obj(0, GFX_OBJ_SAMPLER);
+}
+
+void gfx_destroy_sampler(gfx_sampler sampler)
+{
+	destroy_obj(sampler);
+}
+
+gfx_texture gfx_create_texture(enum gfx_texture_type type, uint width, uint height, uint depth,
+		enum gfx_format fmt, uint mip_cnt, uint array_size, uint total_size,
+		const struct gfx_subresource_data* data, enum gfx_mem_hint memhint, uint thread_id)
+{
+	gfx_texture obj = create_obj(0, GFX_OBJ_TEXTURE);
+	obj->desc.tex.type = type;
+	obj->desc.tex.width = width;
+	obj->desc.tex.height = height;
+	obj->desc.tex.fmt = fmt;
+	obj->desc.tex.has_alpha = texture_has_alpha(fmt);
+    obj->desc.tex.size = total_size;
+    /* depth holds slice count of 3d textures and array count of others (see gfx_obj_desc) */
+    obj->desc.tex.depth = (type == GFX_TEXTURE_3D) ? depth : maxui(array_size, 1);
+    obj->desc.tex.is_rt = FALSE;
+    obj->desc.tex.mip_cnt = mip_cnt;
+
+    mt_mutex_lock(&g_gfxdev.obj_mtx);
+    g_gfxdev.memstats.texture_cnt ++;
+    g_gfxdev.memstats.textures += total_size;
+    mt_mutex_unlock(&g_gfxdev.obj_mtx);
+	return obj;
+}
+
+gfx_texture gfx_create_texturert(uint width, uint height, enum gfx_format fmt,
+    int has_mipmap)
+{
+    uint mipcnt = 1;
+    if (has_mipmap)
+        mipcnt = 1 + (uint)floorf(log10f((float)maxui(width, height))/log10f(2.0f));
+
+	gfx_texture obj = create_obj(0, GFX_OBJ_TEXTURE);
+	obj->desc.tex.type = GFX_TEXTURE_2D;
+	obj->desc.tex.fmt = fmt;
+	obj->desc.tex.width = width;
+	obj->desc.tex.height = height;
+    obj->desc.tex.depth = 1;
+	obj->desc.tex.has_alpha = texture_has_alpha(fmt);
+    obj->desc.tex.size = width*height*(gfx_texture_getbpp(fmt)/8);
+    obj->desc.tex.is_rt = TRUE;
+    obj->desc.tex.mip_cnt = mipcnt;
+
+    g_gfxdev.memstats.rttexture_cnt ++;
+    g_gfxdev.memstats.rt_textures += obj->desc.tex.size;
+
+	return obj;
+}
+
+gfx_texture gfx_create_texturert_arr(uint width, uint height, uint arr_cnt,
+		enum gfx_format fmt)
+{
+	ASSERT(arr_cnt > 1);
+
+	gfx_texture obj = create_obj(0, GFX_OBJ_TEXTURE);
+	obj->desc.tex.type = GFX_TEXTURE_2D_ARRAY;
+	obj->desc.tex.fmt = fmt;
+	obj->desc.tex.width = width;
+	obj->desc.tex.height = height;
+	obj->desc.tex.depth = arr_cnt;
+	obj->desc.tex.has_alpha = texture_has_alpha(fmt);
+    obj->desc.tex.size = width*height*arr_cnt*(gfx_texture_getbpp(fmt)/8);
+    obj->desc.tex.is_rt = TRUE;
+    obj->desc.tex.mip_cnt = 1;
+
+    g_gfxdev.memstats.rttexture_cnt ++;
+    g_gfxdev.memstats.rt_textures += obj->desc.tex.size;
+
+	return obj;
+}
+
+gfx_texture gfx_create_texturert_cube(uint width, uint height, enum gfx_format fmt)
+{
+	gfx_texture obj = create_obj(0, GFX_OBJ_TEXTURE);
+	obj->desc.tex.type = GFX_TEXTURE_CUBE;
+	obj->desc.tex.fmt = fmt;
+	obj->desc.tex.width = width;
+	obj->desc.tex.height = height;
+	obj->desc.tex.depth = 1;
+	obj->desc.tex.has_alpha = texture_has_alpha(fmt);
+    obj->desc.tex.size = width*height*(gfx_texture_getbpp(fmt)/8)*6;
+    obj->desc.tex.is_rt = TRUE;
+    obj->desc.tex.mip_cnt = 1;
+
+    g_gfxdev.memstats.rttexture_cnt ++;
+    g_gfxdev.memstats.rt_textures += obj->desc.tex.size;
+
+	return obj;
+}
+
+void gfx_destroy_texture(gfx_texture tex)
+{
+    mt_mutex_lock(&g_gfxdev.obj_mtx);
+    if (!tex->desc.tex.is_rt)   {
+        g_gfxdev.memstats.texture_cnt --;
+        g_gfxdev.memstats.textures -= tex->desc.tex.size;
+    }   else    {
+        g_gfxdev.memstats.rttexture_cnt --;
+        g_gfxdev.memstats.rt_textures -= tex->desc.tex.size;
+    }
+    mt_mutex_unlock(&g_gfxdev.obj_mtx);
+
+	destroy_obj(tex);
+}
+
+gfx_rendertarget gfx_create_rendertarget(gfx_texture* rt_textures, uint rt_cnt,
+		OPTIONAL gfx_texture ds_texture)
+{
+    uint width;
+    uint height;
+
+    if (rt_cnt > 0) {
+        width = rt_textures[0]->desc.tex.width;
+        height = rt_textures[0]->desc.tex.height;
+    }   else if (ds_texture != NULL)    {
+        width = ds_texture->desc.tex.width;
+        height = ds_texture->desc.tex.height;
+    }   else    {
+    	width = 0;
+    	height = 0;
+        ASSERT(0);
+    }
+
+	gfx_rendertarget obj = create_obj(0, GFX_OBJ_RENDERTARGET);
+	obj->desc.rt.rt_cnt = rt_cnt;
+	for (uint i = 0; i < rt_cnt; i++)
+		obj->desc.rt.rt_textures[i] = rt_textures[i];
+	obj->desc.rt.ds_texture = ds_texture;
+	obj->desc.rt.width = width;
+	obj->desc.rt.height = height;
+
+	return obj;
+}
+
+void gfx_destroy_rendertarget(gfx_rendertarget rt)
+{
+	destroy_obj(rt);
+}
+
+int texture_has_alpha(enum gfx_format fmt)
+{
+    return (fmt == GFX_FORMAT_BC2 ||
+            fmt == GFX_FORMAT_BC3 ||
+            fmt == GFX_FORMAT_BC2_SRGB ||
+            fmt == GFX_FORMAT_BC3_SRGB ||
+            fmt == GFX_FORMAT_RGBA_UNORM ||
+            fmt == GFX_FORMAT_R32G32B32A32_FLOAT ||
+            fmt == GFX_FORMAT_R32G32B32A32_UINT ||
+            fmt == GFX_FORMAT_R10G10B10A2_UNORM);
+}
+
+gfx_blendstate gfx_create_blendstate(const struct gfx_blend_desc* blend)
+{
+	gfx_blendstate obj = create_obj(0, GFX_OBJ_BLENDSTATE);
+	memcpy(&obj->desc.blend, blend, sizeof(struct gfx_blend_desc));
+	return obj;
+}
+
+void gfx_destroy_blendstate(gfx_blendstate blend)
+{
+	destroy_obj(blend);
+}
+
+gfx_rasterstate gfx_create_rasterstate(const struct gfx_rasterizer_desc* raster)
+{
+	gfx_rasterstate obj = create_obj(0, GFX_OBJ_RASTERSTATE);
+	memcpy(&obj->desc.raster, raster, sizeof(struct gfx_rasterizer_desc));
+	return obj;
+}
+
+void gfx_destroy_rasterstate(gfx_rasterstate raster)
+{
+	destroy_obj(raster);
+}
+
+gfx_depthstencilstate gfx_create_depthstencilstate(const struct gfx_depthstencil_desc* ds)
+{
+	gfx_depthstencilstate obj = create_obj(0, GFX_OBJ_DEPTHSTENCILSTATE);
+	memcpy(&obj->desc.ds, ds, sizeof(struct gfx_depthstencil_desc));
+	return obj;
+}
+
+void gfx_destroy_depthstencilstate(gfx_depthstencilstate ds)
+{
+	destroy_obj(ds);
+}
+
+const struct gfx_blend_desc* gfx_get_defaultblend()
+{
+	static const struct gfx_blend_desc desc = {
+			FALSE,
+			GFX_BLEND_ONE,
+			GFX_BLEND_ZERO,
+			GFX_BLENDOP_ADD,
+			GFX_COLORWRITE_ALL
+	};
+
+	return &desc;
+}
+
+const struct gfx_rasterizer_desc* gfx_get_defaultraster()
+{
+	static const struct gfx_rasterizer_desc desc = {
+			GFX_FILL_SOLID,
+			GFX_CULL_BACK,
+			0.0f,
+			0.0f,
+			FALSE,
+			TRUE
+	};
+	return &desc;
+}
+
+const struct gfx_depthstencil_desc* gfx_get_defaultdepthstencil()
+{
+	static const struct gfx_depthstencil_desc desc = {
+			FALSE,
+			FALSE,
+			GFX_CMP_LESS,
+			FALSE,
+			0xffffffff,
+			{
+					GFX_STENCILOP_KEEP,
+					GFX_STENCILOP_KEEP,
+					GFX_STENCILOP_KEEP,
+					GFX_CMP_ALWAYS
+			},
+			{
+					GFX_STENCILOP_KEEP,
+					GFX_STENCILOP_KEEP,
+					GFX_STENCILOP_KEEP,
+					GFX_CMP_ALWAYS
+			}
+	};
+
+	return &desc;
+}
+
+const struct gfx_gpu_memstats* gfx_get_memstats()
+{
+    return &g_gfxdev.memstats;
+}
+
+int gfx_check_feature(enum gfx_feature ft)
+{
+    switch (ft) {
+    /* objects are created immediately in any thread, delayed_ functions do nothing */
+    case GFX_FEATURE_THREADED_CREATES:
+        return TRUE;
+    case GFX_FEATURE_RANGED_CBUFFERS:
+        return TRUE;
+    default:
+        return FALSE;
+    }
+}
+
+const char* gfx_get_driverstr()
+{
+    static char info[256];
+    sprintf(info, "null-device %s",
+#if defined(_X64_)
+        "x64"
+#elif defined(_X86_)
+        "x86"
+#else
+        "[]"
+#endif
+        );
+    return info;
+}
+
+void gfx_get_devinfo(struct gfx_device_info* info)
+{
+    memset(info, 0x00, sizeof(struct gfx_device_info));
+    info->vendor = GFX_GPU_UNKNOWN;
+    strcpy(info->desc, "null device (headless)");
+}
+
+enum gfx_hwver gfx_get_hwver()
+{
+    return g_gfxdev.ver;
+}
+
+#endif  /* _NULL_ */
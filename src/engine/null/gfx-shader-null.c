@@ -0,0 +1,1204 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+/**
+ * Null device has no driver to query the uniforms from, so glsl sources are scanned for uniform,
+ * uniform block and struct declarations (with a minimal preprocessor), and block members are
+ * laid out with std140 rules, same as GL drivers would report them
+ */
+
+#if defined(_NULL_)
+
+#include <ctype.h>
+
+#include "dhcore/core.h"
+#include "dhcore/hash-table.h"
+#include "dhcore/stack-alloc.h"
+
+#include "gfx-shader.h"
+#include "gfx-cmdqueue.h"
+#include "gfx-device.h"
+#include "mem-ids.h"
+
+#define UNIFORMS_MAX	64
+#define MEMBERS_MAX     256
+#define CBLOCKS_MAX     16
+#define STRUCTS_MAX     16
+#define DEFINES_MAX     64
+#define PREPROC_DEPTH_MAX 16
+#define EXPR_DEPTH_MAX  8
+#define TOKEN_MAX       128
+
+/*************************************************************************************************
+ * types
+ */
+struct shader_typeinfo_null
+{
+    const char* name;
+    enum gfx_constant_type type;
+    uint size;
+    uint align;
+};
+
+struct shader_var_null
+{
+    char name[32];
+    enum gfx_constant_type type;
+    uint size;  /* std140 size of single element */
+    uint align; /* std140 base alignment of single element */
+    uint offset;
+    uint arr_size;
+    uint arr_stride;
+    int is_sampler;
+};
+
+struct shader_cblock_null
+{
+    char name[32];
+    uint size;
+    uint shader_usage;  /* enum gfx_cblock_shaderusage */
+    uint member_idx;    /* index of first member in reflect->vars */
+    uint member_cnt;
+};
+
+/* program reflection, created by gfx_create_program and kept in program's api_obj */
+struct shader_reflect_null
+{
+    uint uniform_cnt;   /* free uniforms and samplers, first items of vars */
+    uint cblock_cnt;
+    struct shader_var_null* vars;
+    struct shader_cblock_null* cblocks;
+    uint8* uniform_data;    /* storage for free uniform values */
+    uint uniform_size;
+};
+
+struct shader_parser_null
+{
+    const char* p;
+    const char* end;
+    int line_begin;
+    uint stage_usage;   /* enum gfx_cblock_shaderusage */
+
+    /* preprocessor state */
+    uint define_cnt;
+    char define_names[DEFINES_MAX][32];
+    char define_values[DEFINES_MAX][64];
+    uint cond_depth;
+    int cond_active[PREPROC_DEPTH_MAX];
+    int cond_taken[PREPROC_DEPTH_MAX];
+
+    /* user defined structs (std140 size) */
+    uint struct_cnt;
+    char struct_names[STRUCTS_MAX][32];
+    uint struct_sizes[STRUCTS_MAX];
+
+    /* results */
+    uint uniform_cnt;
+    struct shader_var_null uniforms[UNIFORMS_MAX];
+    uint cblock_cnt;
+    struct shader_cblock_null cblocks[CBLOCKS_MAX];
+    uint member_cnt;
+    struct shader_var_null members[MEMBERS_MAX];
+};
+
+struct shader_expr_null
+{
+    const char* p;
+    const struct shader_parser_null* ps;
+    uint depth;
+};
+
+/*************************************************************************************************
+ * inlines
+ */
+INLINE uint shader_find_constant(struct gfx_shader* shader, uint name_hash)
+{
+	struct hashtable_item* item = hashtable_fixed_find(&shader->const_bindtable, name_hash);
+	if (item != NULL)
+		return (uint)item->value;
+	else
+		return INVALID_INDEX;
+}
+
+INLINE uint align_up(uint n, uint align)
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+INLINE int parser_isactive(const struct shader_parser_null* ps)
+{
+    return ps->cond_depth == 0 || ps->cond_active[ps->cond_depth-1];
+}
+
+INLINE int parser_isidentchar(char c)
+{
+    return isalnum((int)(uint8)c) || c == '_' || c == '.';
+}
+
+INLINE int parser_isqualifier(const char* tok)
+{
+    return str_isequal(tok, "highp") || str_isequal(tok, "mediump") || str_isequal(tok, "lowp");
+}
+
+/* writes a free uniform value into reflection storage, size is clamped to the uniform's size */
+INLINE void shader_write_uniform(struct gfx_shader* shader, uint name_hash, const void* data,
+    uint size)
+{
+    uint idx = shader_find_constant(shader, name_hash);
+    ASSERT(idx != INVALID_INDEX);
+    if (idx != INVALID_INDEX)   {
+        struct shader_reflect_null* r = (struct shader_reflect_null*)shader->prog->api_obj;
+        const struct shader_var_null* v = &r->vars[idx];
+        memcpy(r->uniform_data + v->offset, data,
+            minui(size, align_up(v->size, v->align)*v->arr_size));
+    }
+}
+
+/*************************************************************************************************
+ * fwd declarations
+ */
+void* shader_reflect_null(const char* define_code, size_t define_size,
+    const struct gfx_shader_data* source_data);
+void shader_destroyreflect_null(void* reflect);
+
+void parser_parsesource(struct shader_parser_null* ps, const char* src, size_t size);
+int parser_next(struct shader_parser_null* ps, OUT char* tok);
+void parser_directive(struct shader_parser_null* ps);
+void parser_struct(struct shader_parser_null* ps);
+void parser_uniform(struct shader_parser_null* ps);
+uint parser_members(struct shader_parser_null* ps, struct shader_var_null* vars, uint max_cnt);
+int parser_arraysize(struct shader_parser_null* ps, OUT char* tok);
+void parser_resolvetype(const struct shader_parser_null* ps, const char* type_name,
+    OUT struct shader_var_null* v);
+const char* parser_finddefine(const struct shader_parser_null* ps, const char* name);
+uint shader_layout_std140(struct shader_var_null* vars, uint cnt);
+
+int expr_eval(const struct shader_parser_null* ps, const char* expr, uint depth);
+int expr_or(struct shader_expr_null* e);
+int expr_and(struct shader_expr_null* e);
+int expr_cmp(struct shader_expr_null* e);
+int expr_add(struct shader_expr_null* e);
+int expr_mul(struct shader_expr_null* e);
+int expr_unary(struct shader_expr_null* e);
+int expr_token(struct shader_expr_null* e, OUT char* tok, int peek);
+
+/*************************************************************************************************/
+void gfx_shader_bindcblock_tbuffer(gfx_cmdqueue cmdqueue, struct gfx_shader* shader,
+    uint name_hash, const struct gfx_cblock* cblock)
+{
+    struct hashtable_item* item = hashtable_fixed_find(&shader->sampler_bindtable,
+        cblock->name_hash);
+    ASSERT(item != NULL);
+    struct gfx_shader_sampler* s = &shader->samplers[item->value];
+
+    gfx_program_setcblock_tbuffer(cmdqueue, shader->prog, GFX_SHADER_NONE, cblock->gpu_buffer,
+        s->id, s->texture_unit);
+}
+
+struct gfx_cblock* gfx_shader_create_cblock(struct allocator* alloc, struct allocator* tmp_alloc,
+		struct gfx_shader* shader, const char* block_name, struct gfx_sharedbuffer* shared_buff)
+{
+	ASSERT(shader->prog);
+
+    const struct shader_reflect_null* r = (const struct shader_reflect_null*)shader->prog->api_obj;
+    const struct shader_cblock_null* rcb = NULL;
+    for (uint i = 0; i < r->cblock_cnt; i++)  {
+        if (str_isequal(r->cblocks[i].name, block_name))  {
+            rcb = &r->cblocks[i];
+            break;
+        }
+    }
+    if (rcb == NULL)
+        return NULL;
+
+    uint c_cnt = rcb->member_cnt;
+    uint size = rcb->size;
+    if (c_cnt == 0) {
+        ASSERT(0);  /* no vars inside cblock ?! */
+        return NULL;
+    }
+
+    /* create stack allocator and calculate final size */
+    struct stack_alloc stack_mem;
+    struct allocator stack_alloc;
+
+    size_t total_sz =
+        sizeof(struct gfx_cblock) +
+        c_cnt*sizeof(struct gfx_constant_desc) +
+        size +
+        hashtable_fixed_estimate_size(c_cnt);
+
+    if (IS_FAIL(mem_stack_create(alloc, &stack_mem, total_sz, MID_GFX)))    {
+        err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+        return NULL;
+    }
+    mem_stack_bindalloc(&stack_mem, &stack_alloc);
+
+    /* */
+	struct gfx_cblock* cblock = (struct gfx_cblock*)A_ALLOC(&stack_alloc, sizeof(struct gfx_cblock),
+        MID_GFX);
+	ASSERT(cblock);
+	memset(cblock, 0x00, sizeof(struct gfx_cblock));
+	cblock->alloc = alloc;
+	cblock->name_hash = hash_str(block_name);
+    cblock->shader_usage = rcb->shader_usage;
+
+    /* create constants */
+    cblock->constants = (struct gfx_constant_desc*)A_ALLOC(&stack_alloc,
+        sizeof(struct gfx_constant_desc)*c_cnt, MID_GFX);
+    ASSERT(cblock->constants != NULL);
+    memset(cblock->constants, 0x0, sizeof(struct gfx_constant_desc)*c_cnt);
+    cblock->constant_cnt = c_cnt;
+
+    hashtable_fixed_create(&stack_alloc, &cblock->ctable, c_cnt, MID_GFX);
+
+    for (uint i = 0; i < c_cnt; i++)  {
+        const struct shader_var_null* v = &r->vars[rcb->member_idx + i];
+        struct gfx_constant_desc* desc = &cblock->constants[i];
+        strcpy(desc->name, v->name);
+        desc->shader_idx = rcb->member_idx + i;
+        desc->offset = v->offset;
+        desc->elem_size = align_up(v->size, v->align);
+        desc->arr_size = v->arr_size;
+        desc->arr_stride = v->arr_stride;
+        desc->type = v->type;
+
+        hashtable_fixed_add(&cblock->ctable, hash_str(desc->name), i);
+    }
+
+	/* buffers (gpu/cpu) */
+	cblock->cpu_buffer = (uint8*)A_ALLOC(&stack_alloc, size, MID_GFX);
+    ASSERT(cblock->cpu_buffer);
+
+    if (shared_buff == NULL)    {
+	    cblock->gpu_buffer = gfx_create_buffer(GFX_BUFFER_CONSTANT, GFX_MEMHINT_DYNAMIC, size,
+            NULL, 0);
+	    if (cblock->gpu_buffer == NULL)		{
+		    gfx_shader_destroy_cblock(cblock);
+		    err_printn(__FILE__, __LINE__, RET_OUTOFMEMORY);
+		    return NULL;
+	    }
+    }
+	cblock->buffer_size = size;
+    cblock->end_offset = size;
+    cblock->shared_buff = shared_buff;
+	memset(cblock->cpu_buffer, 0x00, size);
+
+	return cblock;
+}
+
+void gfx_shader_destroy_cblock(struct gfx_cblock* cblock)
+{
+	struct allocator* alloc = cblock->alloc;
+
+	if (cblock->gpu_buffer != NULL)
+		gfx_destroy_buffer(cblock->gpu_buffer);
+
+	A_ALIGNED_FREE(alloc, cblock);
+}
+
+void shader_init_cblocks(struct gfx_shader* shader)
+{
+	ASSERT(shader->alloc);
+	ASSERT(shader->prog);
+
+    const struct shader_reflect_null* r = (const struct shader_reflect_null*)shader->prog->api_obj;
+	if (r->cblock_cnt > 0)	{
+		hashtable_fixed_create(shader->alloc, &shader->cblock_bindtable, r->cblock_cnt, MID_GFX);
+		for (uint i = 0; i < r->cblock_cnt; i++)
+			hashtable_fixed_add(&shader->cblock_bindtable, hash_str(r->cblocks[i].name), i);
+	}
+}
+
+void shader_destroy_cblocks(struct gfx_shader* shader)
+{
+	hashtable_fixed_destroy(&shader->cblock_bindtable);
+}
+
+void shader_init_samplers(struct gfx_shader* shader)
+{
+	ASSERT(shader->alloc);
+	ASSERT(shader->prog);
+
+    const struct shader_reflect_null* r = (const struct shader_reflect_null*)shader->prog->api_obj;
+	uint s_cnt = 0;
+	for (uint i = 0; i < r->uniform_cnt; i++)  {
+		if (r->vars[i].is_sampler)
+			s_cnt ++;
+	}
+
+	if (s_cnt > 0)	{
+		shader->sampler_cnt = s_cnt;
+		shader->samplers = (struct gfx_shader_sampler*)A_ALLOC(shader->alloc,
+            sizeof(struct gfx_shader_sampler)*s_cnt, MID_GFX);
+		ASSERT(shader->samplers);
+
+		hashtable_fixed_create(shader->alloc, &shader->sampler_bindtable, s_cnt, MID_GFX);
+
+		for (uint i = 0, s = 0; i < r->uniform_cnt; i++)		{
+            if (!r->vars[i].is_sampler)
+                continue;
+			shader->samplers[s].id = (int)i;
+			shader->samplers[s].texture_unit = s;
+			hashtable_fixed_add(&shader->sampler_bindtable, hash_str(r->vars[i].name), (uint64)s);
+            s++;
+		}
+	}
+}
+
+void shader_destroy_samplers(struct gfx_shader* shader)
+{
+	if (shader->samplers != NULL)
+		A_FREE(shader->alloc, shader->samplers);
+	hashtable_fixed_destroy(&shader->sampler_bindtable);
+}
+
+void shader_init_constants(struct gfx_shader* shader)
+{
+    const struct shader_reflect_null* r = (const struct shader_reflect_null*)shader->prog->api_obj;
+    uint c_cnt = 0;
+	for (uint i = 0; i < r->uniform_cnt; i++)  {
+		if (!r->vars[i].is_sampler)
+			c_cnt ++;
+	}
+
+	if (c_cnt > 0)	{
+		hashtable_fixed_create(shader->alloc, &shader->const_bindtable, c_cnt, MID_GFX);
+		for (uint i = 0; i < r->uniform_cnt; i++)	{
+            if (!r->vars[i].is_sampler)
+			    hashtable_fixed_add(&shader->const_bindtable, hash_str(r->vars[i].name), (uint64)i);
+		}
+	}
+}
+
+void shader_destroy_constants(struct gfx_shader* shader)
+{
+	hashtable_fixed_destroy(&shader->const_bindtable);
+}
+
+result_t shader_init_metadata(struct gfx_shader* shader)
+{
+    return RET_OK;
+}
+
+void shader_destroy_metadata(struct gfx_shader* shader)
+{
+}
+
+void gfx_shader_bindconstants(gfx_cmdqueue cmdqueue, struct gfx_shader* shader)
+{
+}
+
+void gfx_shader_bindtexture(gfx_cmdqueue cmdqueue, struct gfx_shader* shader,
+    uint name_hash, gfx_texture tex)
+{
+    struct hashtable_item* item = hashtable_fixed_find(&shader->sampler_bindtable, name_hash);
+    ASSERT(item != NULL);
+    struct gfx_shader_sampler* s = &shader->samplers[item->value];
+    gfx_program_settexture(cmdqueue, shader->prog, GFX_SHADER_NONE, tex, s->texture_unit);
+}
+
+void gfx_shader_bindsampler(gfx_cmdqueue cmdqueue, struct gfx_shader* shader,
+    uint name_hash, gfx_sampler sampler)
+{
+    const struct hashtable_item* item = hashtable_fixed_find(&shader->sampler_bindtable,
+        name_hash);
+    ASSERT(item);
+    const struct gfx_shader_sampler* s = &shader->samplers[item->value];
+    gfx_program_setsampler(cmdqueue, shader->prog, GFX_SHADER_NONE, sampler,
+        s->id, s->texture_unit);
+}
+
+void gfx_shader_bindsamplertexture(gfx_cmdqueue cmdqueue, struct gfx_shader* shader,
+    uint name_hash, gfx_sampler sampler, gfx_texture tex)
+{
+    struct hashtable_item* item = hashtable_fixed_find(&shader->sampler_bindtable, name_hash);
+    ASSERT(item != NULL);
+    struct gfx_shader_sampler* s = &shader->samplers[item->value];
+    gfx_program_settexture(cmdqueue, shader->prog, GFX_SHADER_NONE, tex, s->texture_unit);
+    gfx_program_setsampler(cmdqueue, shader->prog, GFX_SHADER_NONE, sampler,
+        s->id, s->texture_unit);
+}
+
+void gfx_shader_bindcblocks(gfx_cmdqueue cmdqueue, struct gfx_shader* shader,
+    const struct gfx_cblock** cblocks, uint cblock_cnt)
+{
+    for (uint i = 0; i < cblock_cnt; i++)		{
+        const struct gfx_cblock* cb = cblocks[i];
+        uint hash_val = cb->name_hash;
+        ASSERT(cb->gpu_buffer->desc.buff.type == GFX_BUFFER_CONSTANT);
+
+        struct hashtable_item* item = hashtable_fixed_find(&shader->cblock_bindtable, hash_val);
+        if (item != NULL)	{
+            gfx_program_setcblock(cmdqueue, shader->prog, GFX_SHADER_NONE, cb->gpu_buffer,
+                (uint)item->value, i);
+        }
+    }
+}
+
+/*************************************************************************************************/
+void gfx_shader_set4m(struct gfx_shader* shader, uint name_hash, const struct mat4f* m)
+{
+    shader_write_uniform(shader, name_hash, m->f, sizeof(float)*16);
+}
+
+void gfx_shader_set3m(struct gfx_shader* shader, uint name_hash, const struct mat3f* m)
+{
+    shader_write_uniform(shader, name_hash, m->f, sizeof(float)*12);
+}
+
+void gfx_shader_set4f(struct gfx_shader* shader, uint name_hash, const float* fv)
+{
+    shader_write_uniform(shader, name_hash, fv, sizeof(float)*4);
+}
+
+void gfx_shader_set3f(struct gfx_shader* shader, uint name_hash, const float* fv)
+{
+    shader_write_uniform(shader, name_hash, fv, sizeof(float)*3);
+}
+
+void gfx_shader_set2f(struct gfx_shader* shader, uint name_hash, const float* fv)
+{
+    shader_write_uniform(shader, name_hash, fv, sizeof(float)*2);
+}
+
+void gfx_shader_setf(struct gfx_shader* shader, uint name_hash, float f)
+{
+    shader_write_uniform(shader, name_hash, &f, sizeof(float));
+}
+
+void gfx_shader_set4i(struct gfx_shader* shader, uint name_hash, const int* nv)
+{
+    shader_write_uniform(shader, name_hash, nv, sizeof(int)*4);
+}
+
+void gfx_shader_set3i(struct gfx_shader* shader, uint name_hash, const int* nv)
+{
+    shader_write_uniform(shader, name_hash, nv, sizeof(int)*3);
+}
+
+void gfx_shader_set3ui(struct gfx_shader* shader, uint name_hash, const uint* nv)
+{
+    shader_write_uniform(shader, name_hash, nv, sizeof(uint)*3);
+}
+
+void gfx_shader_set2i(struct gfx_shader* shader, uint name_hash, const int* nv)
+{
+    shader_write_uniform(shader, name_hash, nv, sizeof(int)*2);
+}
+
+void gfx_shader_seti(struct gfx_shader* shader, uint name_hash, int n)
+{
+    shader_write_uniform(shader, name_hash, &n, sizeof(int));
+}
+
+void gfx_shader_setui(struct gfx_shader* shader, uint name_hash, uint n)
+{
+    shader_write_uniform(shader, name_hash, &n, sizeof(uint));
+}
+
+void gfx_shader_set3mv(struct gfx_shader* shader, uint name_hash,
+		const struct mat3f* mv, uint cnt)
+{
+    shader_write_uniform(shader, name_hash, mv, sizeof(struct mat3f)*cnt);
+}
+
+void gfx_shader_set4mv(struct gfx_shader* shader, uint name_hash,
+		const struct mat4f* mv, uint cnt)
+{
+    shader_write_uniform(shader, name_hash, mv, sizeof(struct mat4f)*cnt);
+}
+
+void gfx_shader_set4fv(struct gfx_shader* shader, uint name_hash,
+		const struct vec4f* vv, uint cnt)
+{
+    shader_write_uniform(shader, name_hash, vv, sizeof(struct vec4f)*cnt);
+}
+
+void gfx_shader_setfv(struct gfx_shader* shader, uint name_hash, const float* fv, uint cnt)
+{
+    shader_write_uniform(shader, name_hash, fv, sizeof(float)*cnt);
+}
+
+int gfx_shader_isvalidtex(struct gfx_shader* shader, uint name_hash)
+{
+	return hashtable_fixed_find(&shader->sampler_bindtable, name_hash) != NULL;
+}
+
+int gfx_shader_isvalid(struct gfx_shader* shader, uint name_hash)
+{
+	return shader_find_constant(shader, name_hash) != INVALID_INDEX;
+}
+
+/*************************************************************************************************
+ * reflection
+ */
+void* shader_reflect_null(const char* define_code, size_t define_size,
+    const struct gfx_shader_data* source_data)
+{
+    struct shader_parser_null* ps = (struct shader_parser_null*)
+        ALLOC(sizeof(struct shader_parser_null), MID_GFX);
+    if (ps == NULL)
+        return NULL;
+    memset(ps, 0x00, sizeof(struct shader_parser_null));
+
+    const void* srcs[] = {source_data->vs_source, source_data->ps_source, source_data->gs_source};
+    const size_t sizes[] = {source_data->vs_size, source_data->ps_size, source_data->gs_size};
+    const uint usages[] = {GFX_SHADERUSAGE_VS, GFX_SHADERUSAGE_PS, GFX_SHADERUSAGE_GS};
+
+    /* every stage starts with a fresh preprocessor state, only the results are shared */
+    for (uint i = 0; i < 3; i++)  {
+        if (srcs[i] == NULL)
+            continue;
+        ps->define_cnt = 0;
+        ps->cond_depth = 0;
+        ps->struct_cnt = 0;
+        ps->stage_usage = usages[i];
+        parser_parsesource(ps, define_code, define_size);
+        parser_parsesource(ps, (const char*)srcs[i], sizes[i]);
+    }
+
+    /* assign storage for free uniforms */
+    uint uniform_size = 0;
+    for (uint i = 0; i < ps->uniform_cnt; i++)    {
+        struct shader_var_null* v = &ps->uniforms[i];
+        v->offset = uniform_size;
+        if (!v->is_sampler)
+            uniform_size += align_up(align_up(v->size, v->align)*v->arr_size, 16);
+    }
+
+    /* final reflection data is a single allocation */
+    uint var_cnt = ps->uniform_cnt + ps->member_cnt;
+    size_t total_sz = sizeof(struct shader_reflect_null) +
+        sizeof(struct shader_var_null)*var_cnt +
+        sizeof(struct shader_cblock_null)*ps->cblock_cnt +
+        uniform_size;
+    uint8* buff = (uint8*)ALLOC(total_sz, MID_GFX);
+    if (buff == NULL)   {
+        FREE(ps);
+        return NULL;
+    }
+    memset(buff, 0x00, total_sz);
+
+    struct shader_reflect_null* r = (struct shader_reflect_null*)buff;
+    buff += sizeof(struct shader_reflect_null);
+    r->vars = (struct shader_var_null*)buff;
+    buff += sizeof(struct shader_var_null)*var_cnt;
+    r->cblocks = (struct shader_cblock_null*)buff;
+    buff += sizeof(struct shader_cblock_null)*ps->cblock_cnt;
+    r->uniform_data = buff;
+    r->uniform_size = uniform_size;
+
+    r->uniform_cnt = ps->uniform_cnt;
+    memcpy(r->vars, ps->uniforms, sizeof(struct shader_var_null)*ps->uniform_cnt);
+    memcpy(r->vars + ps->uniform_cnt, ps->members, sizeof(struct shader_var_null)*ps->member_cnt);
+
+    r->cblock_cnt = ps->cblock_cnt;
+    for (uint i = 0; i < ps->cblock_cnt; i++) {
+        r->cblocks[i] = ps->cblocks[i];
+        r->cblocks[i].member_idx += ps->uniform_cnt;
+    }
+
+    FREE(ps);
+    return r;
+}
+
+void shader_destroyreflect_null(void* reflect)
+{
+    FREE(reflect);
+}
+
+void parser_parsesource(struct shader_parser_null* ps, const char* src, size_t size)
+{
+    char tok[TOKEN_MAX];
+
+    ps->p = src;
+    ps->end = src + size;
+    ps->line_begin = TRUE;
+
+    while (parser_next(ps, tok))  {
+        if (str_isequal(tok, "struct"))
+            parser_struct(ps);
+        else if (str_isequal(tok, "uniform"))
+            parser_uniform(ps);
+    }
+}
+
+/* reads next token of active code, comments and preprocessor directives are processed on the way
+ * returns FALSE if it reaches the end of source */
+int parser_next(struct shader_parser_null* ps, OUT char* tok)
+{
+    const char* end = ps->end;
+
+    while (ps->p < end) {
+        char c = *ps->p;
+
+        if (c == '\n')  {
+            ps->line_begin = TRUE;
+            ps->p++;
+            continue;
+        }
+        if (isspace((int)(uint8)c))  {
+            ps->p++;
+            continue;
+        }
+
+        /* comments */
+        if (c == '/' && ps->p + 1 < end && ps->p[1] == '/')   {
+            while (ps->p < end && *ps->p != '\n')
+                ps->p++;
+            continue;
+        }
+        if (c == '/' && ps->p + 1 < end && ps->p[1] == '*')   {
+            ps->p += 2;
+            while (ps->p + 1 < end && !(ps->p[0] == '*' && ps->p[1] == '/'))
+                ps->p++;
+            ps->p = minui(2, (uint)(end - ps->p)) + ps->p;
+            continue;
+        }
+
+        if (c == '#' && ps->line_begin) {
+            parser_directive(ps);
+            continue;
+        }
+        ps->line_begin = FALSE;
+
+        /* skip the whole line in inactive branches */
+        if (!parser_isactive(ps))   {
+            while (ps->p < end && *ps->p != '\n')
+                ps->p++;
+            continue;
+        }
+
+        uint i = 0;
+        if (parser_isidentchar(c))  {
+            while (ps->p < end && parser_isidentchar(*ps->p) && i < TOKEN_MAX - 1)
+                tok[i++] = *ps->p++;
+        }   else    {
+            tok[i++] = *ps->p++;
+        }
+        tok[i] = 0;
+        return TRUE;
+    }
+
+    return FALSE;
+}
+
+void parser_directive(struct shader_parser_null* ps)
+{
+    char line[256];
+    uint i = 0;
+
+    ps->p++;    /* '#' */
+    while (ps->p < ps->end && *ps->p != '\n')   {
+        if (i < sizeof(line) - 1)
+            line[i++] = *ps->p;
+        ps->p++;
+    }
+    line[i] = 0;
+
+    /* strip trailing comments */
+    char* comment = strstr(line, "//");
+    if (comment != NULL)
+        *comment = 0;
+    comment = strstr(line, "/*");
+    if (comment != NULL)
+        *comment = 0;
+
+    char* s = line;
+    while (*s == ' ' || *s == '\t')
+        s++;
+    char directive[16];
+    i = 0;
+    while (isalpha((int)(uint8)*s) && i < sizeof(directive) - 1)
+        directive[i++] = *s++;
+    directive[i] = 0;
+    while (*s == ' ' || *s == '\t')
+        s++;
+
+    /* remaining is the argument, trim the end */
+    char* e = s + strlen(s);
+    while (e > s && isspace((int)(uint8)*(e-1)))
+        *(--e) = 0;
+
+    int parent_active = parser_isactive(ps);
+    uint depth = ps->cond_depth;
+
+    if (str_isequal(directive, "ifdef") || str_isequal(directive, "ifndef") ||
+        str_isequal(directive, "if"))
+    {
+        if (depth == PREPROC_DEPTH_MAX) {
+            ASSERT(0);
+            return;
+        }
+
+        int cond;
+        if (str_isequal(directive, "ifdef"))
+            cond = parser_finddefine(ps, s) != NULL;
+        else if (str_isequal(directive, "ifndef"))
+            cond = parser_finddefine(ps, s) == NULL;
+        else
+            cond = parent_active ? (expr_eval(ps, s, 0) != 0) : FALSE;
+
+        ps->cond_active[depth] = parent_active && cond;
+        ps->cond_taken[depth] = cond;
+        ps->cond_depth ++;
+    }   else if (str_isequal(directive, "elif") && depth > 0)   {
+        parent_active = depth == 1 || ps->cond_active[depth-2];
+        if (ps->cond_taken[depth-1])    {
+            ps->cond_active[depth-1] = FALSE;
+        }   else    {
+            int cond = parent_active ? (expr_eval(ps, s, 0) != 0) : FALSE;
+            ps->cond_active[depth-1] = parent_active && cond;
+            ps->cond_taken[depth-1] = cond;
+        }
+    }   else if (str_isequal(directive, "else") && depth > 0)   {
+        parent_active = depth == 1 || ps->cond_active[depth-2];
+        ps->cond_active[depth-1] = parent_active && !ps->cond_taken[depth-1];
+        ps->cond_taken[depth-1] = TRUE;
+    }   else if (str_isequal(directive, "endif") && depth > 0)   {
+        ps->cond_depth --;
+    }   else if (str_isequal(directive, "define") && parent_active)    {
+        char name[32];
+        i = 0;
+        while (parser_isidentchar(*s) && i < sizeof(name) - 1)
+            name[i++] = *s++;
+        name[i] = 0;
+
+        /* function-like macros are not used in declarations */
+        if (*s == '(' || name[0] == 0 || ps->define_cnt == DEFINES_MAX)
+            return;
+        while (*s == ' ' || *s == '\t')
+            s++;
+
+        uint idx = ps->define_cnt;
+        for (uint k = 0; k < ps->define_cnt; k++) {
+            if (str_isequal(ps->define_names[k], name)) {
+                idx = k;
+                break;
+            }
+        }
+        if (idx == ps->define_cnt)
+            ps->define_cnt ++;
+        strcpy(ps->define_names[idx], name);
+        str_safecpy(ps->define_values[idx], sizeof(ps->define_values[idx]), s);
+    }   else if (str_isequal(directive, "undef") && parent_active)  {
+        for (uint k = 0; k < ps->define_cnt; k++) {
+            if (str_isequal(ps->define_names[k], s)) {
+                ps->define_cnt --;
+                if (k != ps->define_cnt)    {
+                    strcpy(ps->define_names[k], ps->define_names[ps->define_cnt]);
+                    strcpy(ps->define_values[k], ps->define_values[ps->define_cnt]);
+                }
+                break;
+            }
+        }
+    }
+    /* version, extension, line, error and pragma are ignored */
+}
+
+void parser_struct(struct shader_parser_null* ps)
+{
+    char name[TOKEN_MAX];
+    char tok[TOKEN_MAX];
+    struct shader_var_null members[UNIFORMS_MAX];
+
+    if (!parser_next(ps, name) || !parser_next(ps, tok) || !str_isequal(tok, "{"))
+        return;
+
+    uint cnt = parser_members(ps, members, UNIFORMS_MAX);
+    if (ps->struct_cnt == STRUCTS_MAX)  {
+        ASSERT(0);
+        return;
+    }
+
+    uint idx = ps->struct_cnt++;
+    str_safecpy(ps->struct_names[idx], sizeof(ps->struct_names[idx]), name);
+    ps->struct_sizes[idx] = shader_layout_std140(members, cnt);
+}
+
+void parser_uniform(struct shader_parser_null* ps)
+{
+    char type_name[TOKEN_MAX];
+    char tok[TOKEN_MAX];
+
+    do  {
+        if (!parser_next(ps, type_name))
+            return;
+    }   while (parser_isqualifier(type_name));
+
+    if (!parser_next(ps, tok))
+        return;
+
+    /* uniform block */
+    if (str_isequal(tok, "{"))    {
+        struct shader_var_null* members = ps->members + ps->member_cnt;
+        uint max_cnt = MEMBERS_MAX - ps->member_cnt;
+        uint cnt = parser_members(ps, members, max_cnt);
+
+        for (uint i = 0; i < ps->cblock_cnt; i++) {
+            if (str_isequal(ps->cblocks[i].name, type_name))  {
+                /* already declared by another stage */
+                ps->cblocks[i].shader_usage |= ps->stage_usage;
+                return;
+            }
+        }
+
+        if (ps->cblock_cnt == CBLOCKS_MAX || cnt == 0) {
+            ASSERT(ps->cblock_cnt < CBLOCKS_MAX);
+            return;
+        }
+
+        struct shader_cblock_null* cb = &ps->cblocks[ps->cblock_cnt++];
+        str_safecpy(cb->name, sizeof(cb->name), type_name);
+        cb->shader_usage = ps->stage_usage;
+        cb->member_idx = ps->member_cnt;
+        cb->member_cnt = cnt;
+        cb->size = shader_layout_std140(members, cnt);
+        ps->member_cnt += cnt;
+        return;
+    }
+
+    /* free uniform or sampler */
+    for (uint i = 0; i < ps->uniform_cnt; i++)    {
+        if (str_isequal(ps->uniforms[i].name, tok))
+            return;
+    }
+    if (ps->uniform_cnt == UNIFORMS_MAX)    {
+        ASSERT(0);
+        return;
+    }
+
+    struct shader_var_null* v = &ps->uniforms[ps->uniform_cnt++];
+    memset(v, 0x00, sizeof(struct shader_var_null));
+    str_safecpy(v->name, sizeof(v->name), tok);
+    v->is_sampler = strstr(type_name, "sampler") != NULL;
+    parser_resolvetype(ps, type_name, v);
+    v->arr_size = parser_arraysize(ps, tok);
+    v->arr_stride = (v->arr_size > 1) ? align_up(v->size, 16) : 0;
+}
+
+/* parses block/struct members up to (and including) the closing brace
+ * returns number of members written to vars */
+uint parser_members(struct shader_parser_null* ps, struct shader_var_null* vars, uint max_cnt)
+{
+    char type_name[TOKEN_MAX];
+    char tok[TOKEN_MAX];
+    uint cnt = 0;
+
+    while (parser_next(ps, type_name) && !str_isequal(type_name, "}"))  {
+        if (parser_isqualifier(type_name))
+            continue;
+
+        /* declarators: name[arr], name2, ...; */
+        while (parser_next(ps, tok))    {
+            if (str_isequal(tok, ";") || str_isequal(tok, "}"))
+                break;
+            if (str_isequal(tok, ","))
+                continue;
+
+            struct shader_var_null v;
+            memset(&v, 0x00, sizeof(v));
+            str_safecpy(v.name, sizeof(v.name), tok);
+            parser_resolvetype(ps, type_name, &v);
+            v.arr_size = parser_arraysize(ps, tok);
+            if (cnt < max_cnt)
+                vars[cnt++] = v;
+            else
+                ASSERT(0);
+
+            if (!str_isequal(tok, ","))
+                break;
+        }
+
+        if (str_isequal(tok, "}"))
+            break;
+    }
+
+    return cnt;
+}
+
+/* reads optional array suffix, tok receives the token after the declarator */
+int parser_arraysize(struct shader_parser_null* ps, OUT char* tok)
+{
+    char expr[256];
+
+    if (!parser_next(ps, tok))
+        return 1;
+    if (!str_isequal(tok, "["))
+        return 1;
+
+    expr[0] = 0;
+    while (parser_next(ps, tok) && !str_isequal(tok, "]"))   {
+        if (strlen(expr) + strlen(tok) + 2 < sizeof(expr))  {
+            strcat(expr, tok);
+            strcat(expr, " ");
+        }
+    }
+
+    int n = expr_eval(ps, expr, 0);
+    if (!parser_next(ps, tok))
+        tok[0] = 0;
+    return n > 0 ? n : 1;
+}
+
+void parser_resolvetype(const struct shader_parser_null* ps, const char* type_name,
+    OUT struct shader_var_null* v)
+{
+    static const struct shader_typeinfo_null types[] = {
+        {"float", GFX_CONSTANT_FLOAT, 4, 4},
+        {"vec2", GFX_CONSTANT_FLOAT2, 8, 8},
+        {"vec3", GFX_CONSTANT_FLOAT3, 12, 16},
+        {"vec4", GFX_CONSTANT_FLOAT4, 16, 16},
+        {"int", GFX_CONSTANT_INT, 4, 4},
+        {"ivec2", GFX_CONSTANT_INT2, 8, 8},
+        {"ivec3", GFX_CONSTANT_INT3, 12, 16},
+        {"ivec4", GFX_CONSTANT_INT4, 16, 16},
+        {"uint", GFX_CONSTANT_UINT, 4, 4},
+        {"uvec2", GFX_CONSTANT_UNKNOWN, 8, 8},
+        {"uvec3", GFX_CONSTANT_UNKNOWN, 12, 16},
+        {"uvec4", GFX_CONSTANT_UNKNOWN, 16, 16},
+        {"bool", GFX_CONSTANT_UNKNOWN, 4, 4},
+        {"mat3x4", GFX_CONSTANT_MAT4x3, 48, 16},
+        {"mat4", GFX_CONSTANT_MAT4x4, 64, 16},
+        {"mat4x4", GFX_CONSTANT_MAT4x4, 64, 16},
+        {"mat3", GFX_CONSTANT_UNKNOWN, 48, 16},
+        {"mat2", GFX_CONSTANT_UNKNOWN, 32, 16}
+    };
+    static const uint type_cnt = sizeof(types)/sizeof(struct shader_typeinfo_null);
+
+    for (uint i = 0; i < type_cnt; i++)   {
+        if (str_isequal(types[i].name, type_name))    {
+            v->type = types[i].type;
+            v->size = types[i].size;
+            v->align = types[i].align;
+            return;
+        }
+    }
+
+    for (uint i = 0; i < ps->struct_cnt; i++) {
+        if (str_isequal(ps->struct_names[i], type_name))  {
+            v->type = GFX_CONSTANT_STRUCT;
+            v->size = ps->struct_sizes[i];
+            v->align = 16;
+            return;
+        }
+    }
+
+    /* samplers and unknown types, reserve a vec4 */
+    v->type = GFX_CONSTANT_UNKNOWN;
+    v->size = 16;
+    v->align = 16;
+}
+
+const char* parser_finddefine(const struct shader_parser_null* ps, const char* name)
+{
+    for (uint i = 0; i < ps->define_cnt; i++) {
+        if (str_isequal(ps->define_names[i], name))
+            return ps->define_values[i];
+    }
+    return NULL;
+}
+
+/* assigns std140 offsets and array strides, returns total size of the block/struct */
+uint shader_layout_std140(struct shader_var_null* vars, uint cnt)
+{
+    uint offset = 0;
+    for (uint i = 0; i < cnt; i++)    {
+        struct shader_var_null* v = &vars[i];
+        if (v->arr_size > 1)    {
+            v->arr_stride = align_up(v->size, 16);
+            offset = align_up(offset, 16);
+            v->offset = offset;
+            offset += v->arr_stride*v->arr_size;
+        }   else    {
+            v->arr_stride = 0;
+            offset = align_up(offset, v->align);
+            v->offset = offset;
+            offset += v->size;
+        }
+    }
+    return align_up(offset, 16);
+}
+
+/*************************************************************************************************
+ * preprocessor expressions (#if conditions and array sizes)
+ */
+int expr_eval(const struct shader_parser_null* ps, const char* expr, uint depth)
+{
+    if (depth >= EXPR_DEPTH_MAX)
+        return 0;
+
+    struct shader_expr_null e;
+    e.p = expr;
+    e.ps = ps;
+    e.depth = depth;
+    return expr_or(&e);
+}
+
+int expr_or(struct shader_expr_null* e)
+{
+    char tok[TOKEN_MAX];
+    int r = expr_and(e);
+    while (expr_token(e, tok, TRUE) && str_isequal(tok, "||"))    {
+        expr_token(e, tok, FALSE);
+        int r2 = expr_and(e);
+        r = r || r2;
+    }
+    return r;
+}
+
+int expr_and(struct shader_expr_null* e)
+{
+    char tok[TOKEN_MAX];
+    int r = expr_cmp(e);
+    while (expr_token(e, tok, TRUE) && str_isequal(tok, "&&"))    {
+        expr_token(e, tok, FALSE);
+        int r2 = expr_cmp(e);
+        r = r && r2;
+    }
+    return r;
+}
+
+int expr_cmp(struct shader_expr_null* e)
+{
+    char tok[TOKEN_MAX];
+    int r = expr_add(e);
+    while (expr_token(e, tok, TRUE))   {
+        if (str_isequal(tok, "=="))    {
+            expr_token(e, tok, FALSE);
+            r = (r == expr_add(e));
+        }   else if (str_isequal(tok, "!="))   {
+            expr_token(e, tok, FALSE);
+            r = (r != expr_add(e));
+        }   else if (str_isequal(tok, "<="))   {
+            expr_token(e, tok, FALSE);
+            r = (r <= expr_add(e));
+        }   else if (str_isequal(tok, ">="))   {
+            expr_token(e, tok, FALSE);
+            r = (r >= expr_add(e));
+        }   else if (str_isequal(tok, "<"))    {
+            expr_token(e, tok, FALSE);
+            r = (r < expr_add(e));
+        }   else if (str_isequal(tok, ">"))    {
+            expr_token(e, tok, FALSE);
+            r = (r > expr_add(e));
+        }   else    {
+            break;
+        }
+    }
+    return r;
+}
+
+int expr_add(struct shader_expr_null* e)
+{
+    char tok[TOKEN_MAX];
+    int r = expr_mul(e);
+    while (expr_token(e, tok, TRUE))   {
+        if (str_isequal(tok, "+"))  {
+            expr_token(e, tok, FALSE);
+            r += expr_mul(e);
+        }   else if (str_isequal(tok, "-")) {
+            expr_token(e, tok, FALSE);
+            r -= expr_mul(e);
+        }   else    {
+            break;
+        }
+    }
+    return r;
+}
+
+int expr_mul(struct shader_expr_null* e)
+{
+    char tok[TOKEN_MAX];
+    int r = expr_unary(e);
+    while (expr_token(e, tok, TRUE))   {
+        if (str_isequal(tok, "*"))  {
+            expr_token(e, tok, FALSE);
+            r *= expr_unary(e);
+        }   else if (str_isequal(tok, "/")) {
+            expr_token(e, tok, FALSE);
+            int d = expr_unary(e);
+            r = (d != 0) ? r/d : 0;
+        }   else    {
+            break;
+        }
+    }
+    return r;
+}
+
+int expr_unary(struct shader_expr_null* e)
+{
+    char tok[TOKEN_MAX];
+    if (!expr_token(e, tok, FALSE))
+        return 0;
+
+    if (str_isequal(tok, "!"))
+        return !expr_unary(e);
+    if (str_isequal(tok, "-"))
+        return -expr_unary(e);
+    if (str_isequal(tok, "("))    {
+        int r = expr_or(e);
+        expr_token(e, tok, FALSE);  /* ')' */
+        return r;
+    }
+    if (str_isequal(tok, "defined"))  {
+        int paren = FALSE;
+        expr_token(e, tok, FALSE);
+        if (str_isequal(tok, "("))    {
+            paren = TRUE;
+            expr_token(e, tok, FALSE);
+        }
+        int r = parser_finddefine(e->ps, tok) != NULL;
+        if (paren)
+            expr_token(e, tok, FALSE);
+        return r;
+    }
+    if (isdigit((int)(uint8)tok[0]))
+        return (int)strtol(tok, NULL, 0);
+
+    /* identifier, expand the macro */
+    const char* value = parser_finddefine(e->ps, tok);
+    return (value != NULL) ? expr_eval(e->ps, value, e->depth + 1) : 0;
+}
+
+int expr_token(struct shader_expr_null* e, OUT char* tok, int peek)
+{
+    const char* p = e->p;
+    while (*p == ' ' || *p == '\t')
+        p++;
+    if (*p == 0)
+        return FALSE;
+
+    uint i = 0;
+    if (parser_isidentchar(*p)) {
+        while (parser_isidentchar(*p) && i < TOKEN_MAX - 1)
+            tok[i++] = *p++;
+    }   else if ((p[0] == '|' && p[1] == '|') || (p[0] == '&' && p[1] == '&') ||
+                 (p[1] == '=' && (p[0] == '=' || p[0] == '!' || p[0] == '<' || p[0] == '>')))
+    {
+        tok[i++] = *p++;
+        tok[i++] = *p++;
+    }   else    {
+        tok[i++] = *p++;
+    }
+    tok[i] = 0;
+
+    if (!peek)
+        e->p = p;
+    return TRUE;
+}
+
+#endif /* _NULL_ */
@@ -79,7 +79,7 @@ void phx_release()
     log_printf(LOG_TEXT, "physics released.");
 }
 
-void phx_update_xforms(int simulated)
+void phx_update_xforms(int simulated, uint thread_id)
 {
     static const float steptm_max = STEP_LEN;
     uint scene_id = g_phx.active_scene;
@@ -89,7 +89,7 @@ void phx_update_xforms(int simulated)
         return;
 
     float steptm = g_phx.steptm;
-    struct allocator* tmp_alloc = tsk_get_tmpalloc(0);
+    struct allocator* tmp_alloc = tsk_get_tmpalloc(thread_id);
     A_SAVE(tmp_alloc);
 
     struct phx_active_transform* xfs = phx_scene_activexforms(scene_id, tmp_alloc, &cnt);
@@ -80,6 +80,8 @@ struct prf_mgr
     struct prf_samples* samples_back; /* the one that is being created by engine */
     struct prf_samples* samples_front; /* the one that is presentable to user */
     mt_mutex samples_mtx;    /* mutex for front-buffer protection */
+    pfn_prf_capture capture_fn; /* receives finished frame samples (optional) */
+    void* capture_param;
 };
 
 /*************************************************************************************************
@@ -103,6 +105,7 @@ pfn_ajax_cmd prf_find_cmd(const char* name);
 json_t prf_create_node_json(json_t parent, struct prf_node* node);
 struct prf_samples* prf_create_samples();
 void prf_destroy_samples(struct prf_samples* s);
+void prf_capture_nodes(struct linked_list* nodes, uint depth);
 
 /*************************************************************************************************
  * commands (in form of pfn_ajax_cmd signature)
@@ -590,6 +593,9 @@ void prf_presentsamples(fl64 ft)
     /* save whole frame duration for built sampels */
     g_prf.samples_back->duration = (float)(ft*1000.0);
 
+    if (g_prf.capture_fn != NULL)
+        prf_capture_nodes(g_prf.samples_back->nodes, 0);
+
     /* block presenting front buffer until we are done with json data creation */
     if (mt_mutex_try(&g_prf.samples_mtx))   {
         swapptr((void**)&g_prf.samples_back, (void**)&g_prf.samples_front);
@@ -603,6 +609,23 @@ void prf_presentsamples(fl64 ft)
     s->nodes = NULL;
 }
 
+void prf_set_capturefn(pfn_prf_capture fn, void* param)
+{
+    g_prf.capture_fn = fn;
+    g_prf.capture_param = param;
+}
+
+void prf_capture_nodes(struct linked_list* nodes, uint depth)
+{
+    struct linked_list* l = nodes;
+    while (l != NULL)   {
+        struct prf_node* node = (struct prf_node*)l->data;
+        g_prf.capture_fn(node->name, depth, node->start_tm, node->tm, g_prf.capture_param);
+        prf_capture_nodes(node->childs, depth + 1);
+        l = l->next;
+    }
+}
+
 json_t prf_cmd_getcaminfo(const char* param1, const char* param2)
 {
     PROTECT_CMD();
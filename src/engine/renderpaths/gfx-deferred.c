@@ -1208,7 +1208,7 @@ void deferred_renderpreview(gfx_cmdqueue cmdqueue, enum gfx_deferred_preview_mod
     gfx_output_setviewport(cmdqueue, 0, 0, g_deferred->width, g_deferred->height);
     gfx_shader_bind(cmdqueue, shader);
 
-#if defined(_GL_)
+#if defined(_GL_) || defined(_NULL_)
     gfx_shader_bindsamplertexture(cmdqueue, shader, SHADER_NAME(s_viewmap), g_deferred->sampl_point,
     		tex);
 #elif defined(_D3D_)
@@ -1411,7 +1411,7 @@ void deferred_renderlocallights(gfx_cmdqueue cmdqueue, const struct gfx_view_par
     gfx_shader_bindtexture(cmdqueue, shader, SHADER_NAME(s_albedo), g_deferred->gbuff_tex[0]);
     gfx_shader_bindtexture(cmdqueue, shader, SHADER_NAME(s_norm), g_deferred->gbuff_tex[1]);
     gfx_shader_bindtexture(cmdqueue, shader, SHADER_NAME(s_mtl), g_deferred->gbuff_tex[2]);
-#elif defined(_GL_)
+#elif defined(_GL_) || defined(_NULL_)
     gfx_shader_bindsamplertexture(cmdqueue, shader, SHADER_NAME(s_depth), g_deferred->sampl_point,
         g_deferred->gbuff_depthtex);
     gfx_shader_bindsamplertexture(cmdqueue, shader, SHADER_NAME(s_albedo), g_deferred->sampl_point,
@@ -1552,7 +1552,7 @@ void deferred_rendersunlight(gfx_cmdqueue cmdqueue, const struct gfx_view_params
     gfx_shader_bindtexture(cmdqueue, shader, SHADER_NAME(s_mtl), g_deferred->gbuff_tex[2]);
     gfx_shader_bindtexture(cmdqueue, shader, SHADER_NAME(s_shadows), shadowcsm_tex);
     gfx_shader_bindtexture(cmdqueue, shader, SHADER_NAME(s_ssao), ssao_tex);
-#elif defined(_GL_)
+#elif defined(_GL_) || defined(_NULL_)
     gfx_shader_bindsamplertexture(cmdqueue, shader, SHADER_NAME(s_depth), g_deferred->sampl_point,
         g_deferred->gbuff_depthtex);
     gfx_shader_bindsamplertexture(cmdqueue, shader, SHADER_NAME(s_albedo), g_deferred->sampl_point,
@@ -1725,7 +1725,7 @@ uint deferred_createlight(struct deferred_tiles* tiles, const struct scn_render_
             return 0;
         }
 
-        struct cmp_light* ldata = (struct cmp_light*)cmp_getinstancedata(light->light_hdl);
+        const struct cmp_light* ldata = light->ldata;
         struct deferred_light dlight;
 
         /* calculate light data (view-space) */
@@ -2120,7 +2120,7 @@ void deferred_drawlights(gfx_cmdqueue cmdqueue, const struct gfx_view_params* pa
 
     for (uint i = 0; i < lightdata->cnt; i++) {
         struct scn_render_light* light = &lightdata->lights[i];
-        struct cmp_light* ldata = (struct cmp_light*)cmp_getinstancedata(light->light_hdl);
+        const struct cmp_light* ldata = light->ldata;
         color_setc(&clr, &ldata->color_lin);
         clr.a = ldata->intensity * light->intensity_mul;
 
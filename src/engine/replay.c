@@ -0,0 +1,546 @@
+/***********************************************************************************
+ * Copyright (c) 2012, Sepehr Taghdisian
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification,
+ * are permitted provided that the following conditions are met:
+ *
+ * - Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ * - Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ ***********************************************************************************/
+
+#include <stdio.h>
+
+#include "dhcore/core.h"
+#include "dhcore/array.h"
+#include "dhcore/timer.h"
+
+#include "dhapp/input.h"
+
+#include "replay.h"
+#include "console.h"
+#include "prf-mgr.h"
+#include "mem-ids.h"
+
+#define RPL_FILE_SIGN 0x50524844    /* "DHRP" */
+#define RPL_FILE_VERSION 1
+#define RPL_CMD_MAX 256
+#define RPL_SAMPLEPATH_MAX 128
+#define RPL_DEPTH_MAX 16
+
+/*************************************************************************************************
+ * types
+ */
+
+/* file layout: header, then frames, each frame followed by it's commands (uint len + text) */
+struct rpl_header
+{
+    uint sign;
+    uint version;
+    uint key_cnt;   /* INPUT_KEY_CNT of the recorder, input state must match */
+    uint mkey_cnt;  /* INPUT_MOUSEKEY_CNT of the recorder */
+};
+
+struct rpl_frame
+{
+    fl64 dt;
+    struct input_rawstate input;
+    uint cmd_cnt;
+};
+
+struct rpl_sample
+{
+    char path[RPL_SAMPLEPATH_MAX];  /* name of sample, prefixed by parents: "parent/child" */
+    fl64 start_tm;
+    fl64 tm;
+};
+
+enum rpl_report_fmt
+{
+    RPL_REPORT_NONE = 0,
+    RPL_REPORT_CSV,
+    RPL_REPORT_JSON
+};
+
+struct rpl_mgr
+{
+    enum rpl_state state;
+    char filepath[DH_PATH_MAX];
+    FILE* f;
+    FILE* report;
+    enum rpl_report_fmt report_fmt;
+
+    fl64 tick_freq; /* timer ticks per second */
+    uint64 real_tick;   /* last tick passed to rpl_beginframe */
+    uint64 timer_tick;  /* last tick returned to update timers, drifts from real ticks on replay */
+    int frame_begin;    /* current frame is recorded/replayed (rpl_beginframe called in state) */
+    int frame_loaded;   /* replay: current frame is read from file */
+    uint frame_idx;
+    float fixed_dt;
+
+    struct rpl_frame frame;
+    struct array cmds;  /* commands of current frame, item: char[RPL_CMD_MAX] */
+    struct array samples;   /* profiler samples of current frame, item: rpl_sample */
+    uint path_lens[RPL_DEPTH_MAX];  /* length of last sample path at each depth */
+    char sample_path[RPL_SAMPLEPATH_MAX];
+
+    /* replay stats (ms) */
+    fl64 ft_sum;
+    fl64 ft_min;
+    fl64 ft_max;
+
+    int init;
+};
+
+/*************************************************************************************************
+ * fwd declarations
+ */
+int rpl_fetchframe();
+void rpl_writeframe();
+void rpl_report_begin();
+void rpl_report_frame(fl64 dt, fl64 ft);
+void rpl_report_end();
+void rpl_report_jsonstr(FILE* f, const char* str);
+void rpl_capture_input(struct input_rawstate* state, void* param);
+void rpl_capture_sample(const char* name, uint depth, fl64 start_tm, fl64 tm, void* param);
+result_t rpl_console_record(uint argc, const char** argv, void* param);
+result_t rpl_console_replay(uint argc, const char** argv, void* param);
+result_t rpl_console_stop(uint argc, const char** argv, void* param);
+
+/*************************************************************************************************
+ * globals
+ */
+struct rpl_mgr g_rpl;
+
+/*************************************************************************************************/
+void rpl_zero()
+{
+    memset(&g_rpl, 0x00, sizeof(g_rpl));
+}
+
+result_t rpl_initmgr()
+{
+    result_t r;
+
+    r = arr_create(mem_heap(), &g_rpl.cmds, RPL_CMD_MAX, 4, 4, MID_PRF);
+    if (IS_FAIL(r))
+        return RET_OUTOFMEMORY;
+
+    r = arr_create(mem_heap(), &g_rpl.samples, sizeof(struct rpl_sample), 64, 64, MID_PRF);
+    if (IS_FAIL(r))
+        return RET_OUTOFMEMORY;
+
+    /* timer module doesn't expose it's frequency, so derive it from tick->time conversion */
+    g_rpl.tick_freq = 1000000.0 / timer_calctm(0, 1000000);
+    g_rpl.real_tick = timer_querytick();
+    g_rpl.timer_tick = g_rpl.real_tick;
+
+    con_register_cmd("rpl_record", rpl_console_record, NULL, "rpl_record [filepath]");
+    con_register_cmd("rpl_replay", rpl_console_replay, NULL,
+        "rpl_replay [filepath] [report.json/csv] [fixed_dt]");
+    con_register_cmd("rpl_stop", rpl_console_stop, NULL, "rpl_stop");
+
+    g_rpl.init = TRUE;
+    return RET_OK;
+}
+
+void rpl_releasemgr()
+{
+    if (g_rpl.init)
+        rpl_stop();
+
+    arr_destroy(&g_rpl.samples);
+    arr_destroy(&g_rpl.cmds);
+    rpl_zero();
+}
+
+result_t rpl_record(const char* filepath)
+{
+    if (!g_rpl.init)
+        return RET_FAIL;
+
+    if (g_rpl.state != RPL_STATE_IDLE)  {
+        err_print(__FILE__, __LINE__, "replay: record/replay is already running");
+        return RET_FAIL;
+    }
+
+    FILE* f = fopen(filepath, "wb");
+    if (f == NULL)  {
+        err_printf(__FILE__, __LINE__, "replay: could not open file '%s' for writing", filepath);
+        return RET_FAIL;
+    }
+
+    struct rpl_header header;
+    header.sign = RPL_FILE_SIGN;
+    header.version = RPL_FILE_VERSION;
+    header.key_cnt = INPUT_KEY_CNT;
+    header.mkey_cnt = INPUT_MOUSEKEY_CNT;
+    fwrite(&header, sizeof(header), 1, f);
+
+    str_safecpy(g_rpl.filepath, sizeof(g_rpl.filepath), filepath);
+    g_rpl.f = f;
+    g_rpl.frame_idx = 0;
+    memset(&g_rpl.frame, 0x00, sizeof(g_rpl.frame));
+    arr_clear(&g_rpl.cmds);
+
+    g_rpl.state = RPL_STATE_RECORD;
+    input_set_capturefn(rpl_capture_input, NULL);
+
+    log_printf(LOG_INFO, "replay: recording to '%s' ...", filepath);
+    return RET_OK;
+}
+
+result_t rpl_replay(const char* filepath, float fixed_dt, OPTIONAL const char* report_filepath)
+{
+    if (!g_rpl.init)
+        return RET_FAIL;
+
+    if (g_rpl.state != RPL_STATE_IDLE)  {
+        err_print(__FILE__, __LINE__, "replay: record/replay is already running");
+        return RET_FAIL;
+    }
+
+    FILE* f = fopen(filepath, "rb");
+    if (f == NULL)  {
+        err_printf(__FILE__, __LINE__, "replay: could not open file '%s'", filepath);
+        return RET_FAIL;
+    }
+
+    struct rpl_header header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || header.sign != RPL_FILE_SIGN)   {
+        err_printf(__FILE__, __LINE__, "replay: invalid file format '%s'", filepath);
+        fclose(f);
+        return RET_FAIL;
+    }
+
+    if (header.version != RPL_FILE_VERSION || header.key_cnt != INPUT_KEY_CNT ||
+        header.mkey_cnt != INPUT_MOUSEKEY_CNT)
+    {
+        err_printf(__FILE__, __LINE__, "replay: incompatible file version '%s'", filepath);
+        fclose(f);
+        return RET_FAIL;
+    }
+
+    /* report format is chosen by extension, anything other than json is written as csv */
+    if (report_filepath != NULL && report_filepath[0] != 0)    {
+        g_rpl.report = fopen(report_filepath, "wt");
+        if (g_rpl.report == NULL)   {
+            err_printf(__FILE__, __LINE__, "replay: could not open report file '%s'",
+                report_filepath);
+            fclose(f);
+            return RET_FAIL;
+        }
+
+        char ext[DH_PATH_MAX];
+        path_getfileext(ext, report_filepath);
+        g_rpl.report_fmt = str_isequal_nocase(ext, "json") ? RPL_REPORT_JSON : RPL_REPORT_CSV;
+    }   else    {
+        g_rpl.report_fmt = RPL_REPORT_NONE;
+    }
+
+    str_safecpy(g_rpl.filepath, sizeof(g_rpl.filepath), filepath);
+    g_rpl.f = f;
+    g_rpl.fixed_dt = maxf(fixed_dt, 0.0f);
+    g_rpl.frame_idx = 0;
+    g_rpl.frame_loaded = FALSE;
+    g_rpl.ft_sum = 0.0;
+    g_rpl.ft_min = 0.0;
+    g_rpl.ft_max = 0.0;
+    arr_clear(&g_rpl.cmds);
+    arr_clear(&g_rpl.samples);
+
+    g_rpl.state = RPL_STATE_REPLAY;
+    input_set_capturefn(rpl_capture_input, NULL);
+    prf_set_capturefn(rpl_capture_sample, NULL);
+    rpl_report_begin();
+
+    log_printf(LOG_INFO, "replay: replaying '%s' ...", filepath);
+    return RET_OK;
+}
+
+void rpl_stop()
+{
+    if (g_rpl.state == RPL_STATE_IDLE)
+        return;
+
+    input_set_capturefn(NULL, NULL);
+    prf_set_capturefn(NULL, NULL);
+
+    if (g_rpl.state == RPL_STATE_RECORD)    {
+        log_printf(LOG_INFO, "replay: recorded %d frames to '%s'", g_rpl.frame_idx,
+            g_rpl.filepath);
+    }   else if (g_rpl.state == RPL_STATE_REPLAY)   {
+        if (g_rpl.frame_idx > 0)    {
+            log_printf(LOG_INFO, "replay: replayed %d frames of '%s', "
+                "frame-time avg: %.3fms, min: %.3fms, max: %.3fms", g_rpl.frame_idx,
+                g_rpl.filepath, g_rpl.ft_sum/(fl64)g_rpl.frame_idx, g_rpl.ft_min, g_rpl.ft_max);
+        }   else    {
+            log_printf(LOG_INFO, "replay: no frames replayed from '%s'", g_rpl.filepath);
+        }
+
+        if (g_rpl.report != NULL)   {
+            rpl_report_end();
+            fclose(g_rpl.report);
+            g_rpl.report = NULL;
+        }
+    }
+
+    if (g_rpl.f != NULL)    {
+        fclose(g_rpl.f);
+        g_rpl.f = NULL;
+    }
+
+    arr_clear(&g_rpl.cmds);
+    arr_clear(&g_rpl.samples);
+    g_rpl.frame_begin = FALSE;
+    g_rpl.frame_loaded = FALSE;
+    g_rpl.state = RPL_STATE_IDLE;
+}
+
+enum rpl_state rpl_getstate()
+{
+    return g_rpl.state;
+}
+
+uint64 rpl_beginframe(uint64 tick)
+{
+    if (!g_rpl.init)
+        return tick;
+
+    uint64 dtick = tick - g_rpl.real_tick;
+    g_rpl.real_tick = tick;
+
+    if (g_rpl.state == RPL_STATE_REPLAY)    {
+        if (rpl_fetchframe())   {
+            fl64 dt = g_rpl.fixed_dt > 0.0f ? (fl64)g_rpl.fixed_dt : g_rpl.frame.dt;
+            dtick = (uint64)(dt*g_rpl.tick_freq + 0.5);
+
+            /* recorded commands are executed at the start of the frame */
+            const char* cmds = (const char*)g_rpl.cmds.buffer;
+            for (int i = 0; i < g_rpl.cmds.item_cnt; i++)
+                con_exec(cmds + i*RPL_CMD_MAX);
+        }   else    {
+            rpl_stop();
+        }
+    }   else if (g_rpl.state == RPL_STATE_RECORD)   {
+        g_rpl.frame.dt = timer_calctm(g_rpl.real_tick - dtick, g_rpl.real_tick);
+    }
+
+    g_rpl.frame_begin = (g_rpl.state != RPL_STATE_IDLE);
+
+    /* timers are driven by our own tick, so they keep running smoothly when replay stops */
+    g_rpl.timer_tick += dtick;
+    return g_rpl.timer_tick;
+}
+
+void rpl_endframe(fl64 ft)
+{
+    if (!g_rpl.frame_begin)
+        return;
+    g_rpl.frame_begin = FALSE;
+
+    if (g_rpl.state == RPL_STATE_RECORD)    {
+        rpl_writeframe();
+    }   else if (g_rpl.state == RPL_STATE_REPLAY)   {
+        fl64 ft_ms = ft*1000.0;
+        g_rpl.ft_sum += ft_ms;
+        if (g_rpl.frame_idx == 0 || ft_ms < g_rpl.ft_min)
+            g_rpl.ft_min = ft_ms;
+        if (ft_ms > g_rpl.ft_max)
+            g_rpl.ft_max = ft_ms;
+
+        if (g_rpl.report != NULL)   {
+            fl64 dt = g_rpl.fixed_dt > 0.0f ? (fl64)g_rpl.fixed_dt : g_rpl.frame.dt;
+            rpl_report_frame(dt, ft_ms);
+        }
+
+        arr_clear(&g_rpl.samples);
+        g_rpl.frame_loaded = FALSE;
+    }
+
+    g_rpl.frame_idx ++;
+}
+
+void rpl_addcmd(const char* cmd)
+{
+    if (g_rpl.state != RPL_STATE_RECORD)
+        return;
+
+    /* don't record our own commands, or replaying would start recording again */
+    if (strstr(cmd, "rpl_") == cmd)
+        return;
+
+    char* c = (char*)arr_add(&g_rpl.cmds);
+    if (c != NULL)
+        str_safecpy(c, RPL_CMD_MAX, cmd);
+}
+
+int rpl_fetchframe()
+{
+    if (g_rpl.frame_loaded)
+        return TRUE;
+
+    arr_clear(&g_rpl.cmds);
+    if (fread(&g_rpl.frame, sizeof(g_rpl.frame), 1, g_rpl.f) != 1)
+        return FALSE;
+
+    for (uint i = 0; i < g_rpl.frame.cmd_cnt; i++)  {
+        uint len;
+        char* c = (char*)arr_add(&g_rpl.cmds);
+        if (c == NULL || fread(&len, sizeof(len), 1, g_rpl.f) != 1 || len >= RPL_CMD_MAX ||
+            fread(c, len, 1, g_rpl.f) != 1)
+        {
+            return FALSE;
+        }
+        c[len] = 0;
+    }
+
+    g_rpl.frame_loaded = TRUE;
+    return TRUE;
+}
+
+void rpl_writeframe()
+{
+    g_rpl.frame.cmd_cnt = (uint)g_rpl.cmds.item_cnt;
+    fwrite(&g_rpl.frame, sizeof(g_rpl.frame), 1, g_rpl.f);
+
+    const char* cmds = (const char*)g_rpl.cmds.buffer;
+    for (int i = 0; i < g_rpl.cmds.item_cnt; i++)   {
+        const char* c = cmds + i*RPL_CMD_MAX;
+        uint len = (uint)strlen(c);
+        fwrite(&len, sizeof(len), 1, g_rpl.f);
+        fwrite(c, len, 1, g_rpl.f);
+    }
+
+    arr_clear(&g_rpl.cmds);
+}
+
+/* reports are streamed frame by frame, so long replays don't pile up in memory */
+void rpl_report_begin()
+{
+    switch (g_rpl.report_fmt)   {
+    case RPL_REPORT_CSV:
+        fprintf(g_rpl.report, "frame,dt,ft,sample,start,duration\n");
+        break;
+    case RPL_REPORT_JSON:
+        fprintf(g_rpl.report, "{\n\"fixed_dt\": %f,\n\"frames\": [", g_rpl.fixed_dt);
+        break;
+    default:
+        break;
+    }
+}
+
+void rpl_report_frame(fl64 dt, fl64 ft)
+{
+    const struct rpl_sample* samples = (const struct rpl_sample*)g_rpl.samples.buffer;
+    uint sample_cnt = (uint)g_rpl.samples.item_cnt;
+    FILE* f = g_rpl.report;
+
+    if (g_rpl.report_fmt == RPL_REPORT_CSV)    {
+        if (sample_cnt == 0)
+            fprintf(f, "%d,%.6f,%.4f,,,\n", g_rpl.frame_idx, dt, ft);
+        for (uint i = 0; i < sample_cnt; i++)   {
+            fprintf(f, "%d,%.6f,%.4f,%s,%.4f,%.4f\n", g_rpl.frame_idx, dt, ft,
+                samples[i].path, samples[i].start_tm, samples[i].tm);
+        }
+    }   else if (g_rpl.report_fmt == RPL_REPORT_JSON)  {
+        fprintf(f, "%s\n{\"frame\": %d, \"dt\": %.6f, \"ft\": %.4f, \"samples\": [",
+            g_rpl.frame_idx > 0 ? "," : "", g_rpl.frame_idx, dt, ft);
+        for (uint i = 0; i < sample_cnt; i++)   {
+            fprintf(f, "%s{\"name\": \"", i > 0 ? ", " : "");
+            rpl_report_jsonstr(f, samples[i].path);
+            fprintf(f, "\", \"start\": %.4f, \"duration\": %.4f}", samples[i].start_tm,
+                samples[i].tm);
+        }
+        fprintf(f, "]}");
+    }
+}
+
+void rpl_report_end()
+{
+    if (g_rpl.report_fmt != RPL_REPORT_JSON)
+        return;
+
+    uint frame_cnt = g_rpl.frame_idx;
+    fprintf(g_rpl.report, "\n],\n\"summary\": {\"frame_cnt\": %d, \"ft_avg\": %.4f, "
+        "\"ft_min\": %.4f, \"ft_max\": %.4f}\n}\n", frame_cnt,
+        frame_cnt > 0 ? g_rpl.ft_sum/(fl64)frame_cnt : 0.0,
+        g_rpl.ft_min, g_rpl.ft_max);
+}
+
+/* sample names are user strings, quotes, backslashes and control characters are escaped */
+void rpl_report_jsonstr(FILE* f, const char* str)
+{
+    for (const char* c = str; *c != 0; c++)  {
+        if (*c == '"' || *c == '\\')
+            fprintf(f, "\\%c", *c);
+        else if ((uint8)*c < 0x20)
+            fprintf(f, "\\u%04x", (uint)(uint8)*c);
+        else
+            fputc(*c, f);
+    }
+}
+
+/* input_update callback: records raw input state or overrides it with the replayed one */
+void rpl_capture_input(struct input_rawstate* state, void* param)
+{
+    if (g_rpl.state == RPL_STATE_RECORD)    {
+        memcpy(&g_rpl.frame.input, state, sizeof(struct input_rawstate));
+    }   else if (g_rpl.state == RPL_STATE_REPLAY)   {
+        /* on end of file, live input is kept and replay stops at the start of next frame */
+        if (rpl_fetchframe())
+            memcpy(state, &g_rpl.frame.input, sizeof(struct input_rawstate));
+    }
+}
+
+/* prf_presentsamples callback */
+void rpl_capture_sample(const char* name, uint depth, fl64 start_tm, fl64 tm, void* param)
+{
+    if (depth >= RPL_DEPTH_MAX)
+        return;
+
+    /* sample path is parent's path + name, parents always come before their children */
+    uint len = depth > 0 ? g_rpl.path_lens[depth - 1] : 0;
+    g_rpl.sample_path[len] = 0;
+    if (depth > 0)
+        str_safecat(g_rpl.sample_path, sizeof(g_rpl.sample_path), "/");
+    str_safecat(g_rpl.sample_path, sizeof(g_rpl.sample_path), name);
+    g_rpl.path_lens[depth] = (uint)strlen(g_rpl.sample_path);
+
+    struct rpl_sample* s = (struct rpl_sample*)arr_add(&g_rpl.samples);
+    if (s == NULL)
+        return;
+    str_safecpy(s->path, sizeof(s->path), g_rpl.sample_path);
+    s->start_tm = start_tm;
+    s->tm = tm;
+}
+
+/*************************************************************************************************
+ * console commands
+ */
+result_t rpl_console_record(uint argc, const char** argv, void* param)
+{
+    if (argc != 1)
+        return RET_INVALIDARG;
+    return rpl_record(argv[0]);
+}
+
+result_t rpl_console_replay(uint argc, const char** argv, void* param)
+{
+    if (argc < 1 || argc > 3)
+        return RET_INVALIDARG;
+
+    const char* report_filepath = argc > 1 ? argv[1] : NULL;
+    float fixed_dt = argc > 2 ? str_tofl32(argv[2]) : 0.0f;
+    return rpl_replay(argv[0], fixed_dt, report_filepath);
+}
+
+result_t rpl_console_stop(uint argc, const char** argv, void* param)
+{
+    rpl_stop();
+    return RET_OK;
+}
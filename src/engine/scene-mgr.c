@@ -13,6 +13,8 @@
  *
  ***********************************************************************************/
 
+#include <stdio.h>
+
 #include "dhcore/core.h"
 #include "dhcore/linked-list.h"
 #include "dhcore/array.h"
@@ -23,6 +25,9 @@
 #include "dhcore/stack-alloc.h"
 #include "dhcore/freelist-alloc.h"
 #include "dhcore/stack.h"
+#include "dhcore/task-mgr.h"
+#include "dhcore/timer.h"
+#include "dhcore/json.h"
 
 #include "scene-mgr.h"
 #include "mem-ids.h"
@@ -41,6 +46,7 @@
 #include "phx-device.h"
 #include "phx.h"
 #include "world-mgr.h"
+#include "frame-graph.h"
 
 #include "components/cmp-model.h"
 #include "components/cmp-bounds.h"
@@ -51,27 +57,57 @@
 
 #define SCN_OBJ_BLOCKSIZE	200
 #define SCN_OCC_NEAR_THRESHOLD 10.0f /* N meters that we always draw occluders */
+#define SCN_OCC_TEST 2  /* visible flag of objects that need occlusion test (scene_test_occlusion) */
+#define SCN_VISCACHE_RETEST 8   /* cached occlusion results are retested every N queries (staggered) */
+#define SCN_VISCACHE_MAXMOVE 0.5f   /* max camera move between queries to keep occlusion results */
+#define SCN_VISCACHE_MINROT 0.9995f /* min cosine of camera rotation between queries, ~1.8 deg */
+#define SCN_QUERY_BATCH 512 /* min objects per thread for parallel query stages (cull, occ-test) */
+#define SCN_QUERY_CHUNK 1024    /* objects per render-item extraction chunk */
+#define SCN_PROBE_BATCH 64  /* min gameplay probes per thread (scn_run_probes) */
+#define SCN_SPATIAL_BATCH 256   /* min queued spatial updates per thread (scene_update_spatial) */
+#define SCN_SPATIAL_MOVE 0x1    /* spatial update result: object is moved in the spatial structure */
+#define SCN_SPATIAL_OCCLUDER 0x2    /* spatial update result: object is an occluder */
 #define SCN_GRID_BLOCKSIZE 200
 #define SCN_GRID_CELLSIZE 50.0f /* N units of cell dimension size */
+#define SCN_GRID_MINCELLSIZE 10.0f  /* cell size range of scn_setcellsize and cell size tuning */
+#define SCN_GRID_MAXCELLSIZE 1000.0f
+#define SCN_TUNE_STEP 1.25f /* tested cell sizes grow by this factor (scene_tune_cellsize) */
+#define SCN_TUNE_CELLCOST 1.0f  /* relative cost of visiting a cell in spatial traversal */
+#define SCN_TUNE_OBJCOST 4.0f   /* relative cost of an object reference in a visited cell */
+#define SCN_TUNE_QUERYAREA 40000.0f /* XZ area of frustum bounds, if no query is recorded yet */
+#define SCN_TUNE_MAXCELLS 262144    /* grid cell sizes that make more cells are not tested */
+#define SCN_TUNE_MINGAIN 0.95f  /* cell size is changed if estimated cost drops below N*current */
+#define SCN_STATS_HISTCNT 8 /* occupancy histogram buckets: 0, 1, 2-3, 4-7, .., 64+ items */
+#define SCN_CELLITEMS_MINCNT 8  /* smallest cell items buffer */
+#define SCN_CELLITEMS_POOLCNT 5 /* cell item buffer pools: 8, 16, 32, 64, 128 items */
+#define SCN_CELLITEMS_BLOCKSIZE 64
+#define SCN_TREE_BLOCKSIZE 256
+#define SCN_TREE_MARGIN 1.0f /* leaf bounds are fattened by N units, so small moves don't refit */
+#define SCN_TREE_NULL -1
+#define SCN_TREE_STACK_MAX 256
+#define SCN_HASHGRID_SLOTCNT 1021   /* hash-table slots for occupied cells (prime) */
+#define SCN_NAME_SLOTCNT 509    /* hash-table slots for object names index (prime) */
+#define SCN_HASHGRID_COORD_MIN -32768   /* cell coords are packed into 16bits each */
+#define SCN_HASHGRID_COORD_MAX 32767
 
 #define SIGNBIT(d) ((d).i & 0x80000000)
 
 /*************************************************************************************************
  * types
  */
-enum scn_mem_mgr
+/* contiguous object list of a cell, buffers are allocated from scn_cell_alloc */
+struct scn_cell_items
 {
-    SCN_MEM_HEAP = 0,
-    SCN_MEM_FREELIST,
-    SCN_MEM_STACK
+    struct cmp_obj** objs;
+    uint cnt;
+    uint max;
 };
 
-struct scn_grid_item
+/* pools of cell item buffers, pools[i] holds buffers of (SCN_CELLITEMS_MINCNT << i) items,
+ * bigger buffers are allocated from heap */
+struct scn_cell_alloc
 {
-    struct linked_list cell_node; /* linked-list node for list of items in each cell */
-    struct linked_list bounds_node; /* linked-list node for list of cells in bounds component */
-    struct cmp_obj* obj;
-    uint cell_id;
+    struct pool_alloc pools[SCN_CELLITEMS_POOLCNT];
 };
 
 struct scn_grid
@@ -80,32 +116,201 @@ struct scn_grid
     uint col_cnt;
     uint row_cnt;
     float cell_size;
-    struct vec4f* cells;    /*count: 2*cell_cnt, grows if required by cell_cnt */
-    struct pool_alloc item_pool;    /* item: scn_grid_item */
-    struct linked_list** items;   /* pointer to cell items, count: cell_cnt */
+    float x_min;    /* grid bounds on XZ plane */
+    float z_min;
+    float x_max;
+    float z_max;
+    float* cells;   /* cell bounds (SoA) buffer, holds 4 arrays below, each padded to 4 cells */
+    float* cells_xmin;
+    float* cells_zmin;
+    float* cells_xmax;
+    float* cells_zmax;
+    struct scn_cell_items* items;   /* count: cell_cnt */
+    struct scn_cell_alloc item_alloc;
     int* vis_cells;  /* count: cell_cnt */
 };
 
+struct scn_tree_node
+{
+    struct aabb bb; /* leaves: fattened object bounds, branches: union of children */
+    struct cmp_obj* obj;    /* leaf object, NULL for branches */
+    int parent; /* next free node, if node is in the free list */
+    int child1;
+    int child2;
+    int height; /* leaf = 0, free node = -1 */
+};
+
+/* dynamic aabb tree, leaves are inserted by surface-area heuristic and kept balanced by rotations */
+struct scn_tree
+{
+    struct scn_tree_node* nodes;    /* count: node_max, grows if required */
+    int node_max;
+    int root;
+    int free_node;  /* head of free nodes list */
+    int leaf_cnt;
+};
+
+struct scn_hashgrid_cell
+{
+    int x;  /* cell coords: floor(world_pos/cell_size) on XZ plane */
+    int z;
+    struct scn_cell_items items;
+    uint cull_id;   /* equals scn_hashgrid.cull_id if cell was visible in the last frustum cull */
+};
+
+/* sparse grid, only occupied cells are allocated and they are looked up by packed cell coords */
+struct scn_hashgrid
+{
+    float cell_size;
+    uint cull_id;
+    struct array cells; /* item: scn_hashgrid_cell (occupied cells only) */
+    struct hashtable_chained cell_table;    /* key: packed cell coords, value: index to cells */
+    struct scn_cell_alloc item_alloc;
+};
+
+/* per-view data that is prepared once for spatial traversal of multiple views (scene_cullviews) */
+struct scn_view_cull
+{
+    struct plane frust2d[4];    /* SCN_VIEW_FRUSTUM: side planes projected on XZ */
+    float rmin[2];  /* SCN_VIEW_SPHERE: sphere rectangle on XZ */
+    float rmax[2];
+    struct vec3f fmin;  /* SCN_VIEW_SWEEP */
+    struct vec3f fmax;
+    struct vec3f d;
+};
+
+/* cost of visibility queries with the current spatial structure (scn_savestats)
+ * reset whenever spatial structure or cell size changes */
+struct scn_spatial_stats
+{
+    uint cull_cnt;  /* spatial traversals */
+    fl64 cull_tm;   /* total time of spatial traversals (seconds) */
+    uint query_cnt; /* frustum queries */
+    uint64 cand_cnt;    /* objects returned by spatial traversal for frustum queries */
+    uint64 vis_cnt; /* objects that passed frustum test */
+    uint area_cnt;  /* frustum queries that have valid XZ bounds */
+    fl64 area_sum;  /* XZ area of frustum bounds */
+};
+
 struct scn_data
 {
 	char name[32];
     struct array objs;  /* item: cmp_obj* */
-    struct array spatial_updates;   /* item: cmphandle_t (bounds) */
+    struct pool_alloc obj_pool; /* item: cmp_obj, owns all objects of the scene */
+    struct hashtable_chained name_table;    /* key: name hash, value: cmp_obj* (name_next list) */
+    struct array spatial_updates;   /* item: cmphandle_t (bounds), unique (CMP_OBJFLAG_SPATIALUPDATE) */
+    enum scn_spatial_type spatial_type;
     struct scn_grid grid;
+    struct scn_tree tree;
+    struct scn_hashgrid hgrid;
     struct vec3f minpt;
     struct vec3f maxpt;
     uint phx_sceneid; /* physics scene-id */
+    struct scn_spatial_stats stats;
+    int tune_pending;   /* pick cell size in the next spatial stage (scn_tunecellsize) */
+    int releasing;  /* all objects are being released, spatial structures are reset in bulk */
+    int defer_push; /* new bounds are pushed into spatial structure later (scn_spawn_prefab) */
+};
+
+/* component of a prefab, data is a copy of source instance data, but only public values of it
+ * are used on spawn (cmp_create_instance_copy) */
+struct scn_prefab_cmp
+{
+    cmp_t c;
+    const uint8* data;
+};
+
+struct scn_prefab
+{
+    enum cmp_obj_type obj_type;
+    uint cmp_cnt;
+    struct scn_prefab_cmp cmps[CMP_OBJ_SLOTCNT];    /* in creation order of source object */
+    uint8* data;    /* data of all components */
+};
+
+/* render items of a chunk of visible objects, filled by task workers (scene_fill_query)
+ * chunks are kept between queries, so their buffers are only grown a few times */
+struct scn_query_chunk
+{
+    struct array models;    /* item: scn_render_model */
+    struct array lights;    /* item: scn_render_light */
+    struct array mats;  /* item: mat3f */
+    uint obj_cnt;
+};
+
+/* parallel frustum cull of objects (scene_cullobjs) */
+struct scn_cull_job
+{
+    struct cmp_obj** objs;  /* optional: bounds are fetched from objects before culling */
+    struct sphere* bounds;
+    int* vis;
+    const struct plane* frust;
+};
+
+/* parallel occlusion test (scene_test_occlusion) */
+struct scn_occtest_job
+{
+    struct vec3f xaxis;
+    struct vec3f yaxis;
+    struct vec3f campos;
+    int* vis;
+    struct cmp_obj** objs;
+};
+
+/* parallel render-item extraction into query chunks (scene_fill_query) */
+struct scn_extract_job
+{
+    struct cmp_obj** objs;
+    const int* vis; /* optional: only visible objects are extracted */
+    const uint* bidxs;  /* optional: bounds index of objects, object index is used if NULL */
+    uint obj_cnt;
+    int shadow; /* extract shadow models instead of models and lights */
+    const struct gfx_view_params* params;
+    struct scn_query_chunk* chunks;
+};
+
+/* parallel gameplay probes (scn_run_probes) */
+struct scn_probe_job
+{
+    const struct scn_data* s;
+    const struct scn_probe* probes;
+    uint max_hits;
+    struct scn_probe_hit* hits;
+    uint* hit_cnts;
+};
+
+/* parallel test of queued spatial updates (scene_update_spatial) */
+struct scn_spatial_job
+{
+    const struct scn_data* s;
+    const cmphandle_t* updates;
+    uint8* results; /* item: combination of SCN_SPATIAL_xxx */
+};
+
+/* temporal coherence of occlusion results for the primary view (scene_fill_query)
+ * each object keeps its last result in CMP_OBJFLAG_VISIBLE, valid while cmp_obj::vis_frame is the
+ * previous query and the camera is moved slowly since then */
+struct scn_viscache
+{
+    int enabled;
+    int reset;  /* drop all cached results in the next query (occluder moved) */
+    uint frame; /* occlusion query counter */
+    uint scene_id;
+    struct vec3f cam_pos;
+    struct vec3f cam_dir;
 };
 
 struct scn_mgr
 {
     uint active_scene_id;
 	struct array scenes;	/* item: scn_data* */
-	struct pool_alloc obj_pool;	/* item: cmp_obj */
+	struct pool_alloc obj_pool;	/* item: cmp_obj (global objects, scenes have their own pools) */
     struct camera* active_cam;
-    struct array vis_objs;  /* item: cmp_obj* */
+    struct scn_viscache viscache;
+    struct array query_chunks;  /* item: scn_query_chunk */
     int debug_grid;
     struct array global_objs;   /* item: cmp_obj* */
+    struct hashtable_chained global_names;  /* name index of global_objs (see scn_data) */
     struct stack* free_scenes;   /* item: index to scenes array, free scene indexes array */
 };
 
@@ -115,6 +320,9 @@ struct scn_mgr
 struct scn_data* scene_create(const char* name);
 void scene_destroy(struct scn_data* s);
 void scene_destroy_objcmps(struct cmp_obj* obj);
+void scene_release_objcmps(OPTIONAL struct scn_data* s, const struct array* objarr);
+result_t scene_addname(struct hashtable_chained* name_table, struct cmp_obj* obj);
+void scene_removename(struct hashtable_chained* name_table, struct cmp_obj* obj);
 
 void scene_gather_models_csm(struct scn_data* s, struct array* objs);
 
@@ -141,10 +349,27 @@ void scene_cull_aabbs_sweep(int* vis, const struct aabb* frust_aabb, const struc
     const struct aabb* aabbs, uint startidx, uint endidx);
 void scene_draw_occluders(struct allocator* alloc, struct cmp_obj** objs, uint obj_cnt,
     const int* vis, const struct gfx_view_params* params);
-int scene_test_occlusion(const int* vis, INOUT struct cmp_obj** objs, uint* bound_idxs,
+void scene_test_occlusion(INOUT int* vis, struct cmp_obj** objs, uint obj_cnt,
+    const struct gfx_view_params* params);
+void scene_test_occlusion_range(uint start, uint end, uint thread_id, void* param);
+void scene_cullobjs(int* vis, struct sphere* bounds, OPTIONAL struct cmp_obj** objs, uint obj_cnt,
+    const struct plane frust[6]);
+void scene_cullobjs_range(uint start, uint end, uint thread_id, void* param);
+result_t scene_extract(struct allocator* alloc, struct scn_extract_job* job,
+    OUT struct array* models, OUT struct array* lights, OUT struct array* mats, OUT uint* obj_cnt);
+void scene_extract_range(uint start, uint end, uint thread_id, void* param);
+uint scene_viscache_begin(uint scene_id, struct cmp_obj** objs, const int* vis, OUT int* occ_vis,
     uint obj_cnt, const struct gfx_view_params* params);
-uint scene_cullgrid(const struct scn_grid* grid, INOUT struct cmp_obj** objs, uint start_idx,
-    uint end_idx, const struct plane frust[6]);
+result_t scene_fill_query(struct scn_render_query* rq, uint scene_id, INOUT struct cmp_obj** objs,
+    const int* vis, uint obj_cnt, const struct gfx_view_params* params, int occlusion);
+result_t scene_fill_query_shadow(struct scn_render_query* rq, struct cmp_obj** objs, const int* vis,
+    uint obj_cnt, const struct gfx_view_params* params);
+void scene_prepare_views(OUT struct scn_view_cull* vcs, const struct scn_view* views,
+    uint view_cnt);
+uint scene_cullviews(struct scn_data* s, const struct scn_view* views,
+    const struct scn_view_cull* vcs, uint view_cnt, INOUT uint* masks, OUT struct cmp_obj** objs);
+uint scene_cullgrid(const struct scn_grid* grid, OUT struct cmp_obj** objs,
+    const struct plane frust[6]);
 
 /* space partitioning (grid) */
 result_t scene_grid_init(struct scn_grid* grid, float cell_size, const struct vec3f* world_min,
@@ -156,38 +381,95 @@ result_t scene_grid_createcells(struct scn_grid* grid, float cell_size, const st
     const struct vec3f* maxpt);
 void scene_grid_destroycells(struct scn_grid* grid);
 void scene_grid_clear(struct scn_grid* grid);
-void scene_grid_push(struct scn_grid* grid, struct allocator* alloc, const cmphandle_t* obj_bounds,
-    uint start_idx, uint end_idx);
-void scene_grid_pull(struct scn_grid* grid, const cmphandle_t* obj_bounds, uint start_idx,
+void scene_grid_push(struct scn_grid* grid, const cmphandle_t* obj_bounds, uint start_idx,
     uint end_idx);
 void scene_grid_pushsingle(struct scn_grid* grid, cmphandle_t bounds_hdl);
 void scene_grid_pullsingle(struct scn_grid* grid, cmphandle_t bounds_hdl);
-void scene_grid_addtocell(struct scn_grid* grid, uint cell_id, cmphandle_t bounds_hdl);
-void scene_grid_removefromcell(struct scn_grid* grid, uint cell_id, struct scn_grid_item* item);
+
+/* cell items (grid and hash grid) */
+result_t scene_cellalloc_init(struct scn_cell_alloc* ca);
+void scene_cellalloc_release(struct scn_cell_alloc* ca);
+void scene_cellitems_add(struct scn_cell_alloc* ca, struct scn_cell_items* items,
+    struct cmp_obj* obj);
+void scene_cellitems_remove(struct scn_cell_alloc* ca, struct scn_cell_items* items,
+    struct cmp_obj* obj);
+void scene_cellitems_free(struct scn_cell_alloc* ca, struct scn_cell_items* items);
 void scene_calc_frustum_projxz(struct plane frust_proj[4], const struct plane frust_planes[6]);
 struct rect2di* scene_conv_coord(struct rect2di* rc, float x_min, float y_min,
     float x_max, float y_max, const struct rect2df* src_coord, const struct rect2df* res_coord);
 struct vec2i* scene_conv_coordpt(struct vec2i* pt, float x, float y,
     const struct rect2df* src_coord, const struct rect2df* res_coord);
-struct color* scene_get_densitycolor(struct color* c, const struct linked_list* cell,
-    const struct scn_grid* grid);
+struct color* scene_get_densitycolor(struct color* c, uint item_cnt, const struct scn_grid* grid);
+
+/* space partitioning (tree) */
+result_t scene_tree_init(struct scn_tree* tree);
+void scene_tree_release(struct scn_tree* tree);
+void scene_tree_clear(struct scn_tree* tree);
+result_t scene_tree_reserve(struct scn_tree* tree, int leaf_cnt);
+result_t scene_tree_insert(struct scn_tree* tree, cmphandle_t bounds_hdl);
+void scene_tree_remove(struct scn_tree* tree, cmphandle_t bounds_hdl);
+void scene_tree_move(struct scn_tree* tree, cmphandle_t bounds_hdl);
+int scene_tree_allocnode(struct scn_tree* tree);
+void scene_tree_freenode(struct scn_tree* tree, int idx);
+void scene_tree_insertleaf(struct scn_tree* tree, int leaf);
+void scene_tree_removeleaf(struct scn_tree* tree, int leaf);
+int scene_tree_balance(struct scn_tree* tree, int idx);
+uint scene_culltree(const struct scn_tree* tree, OUT struct cmp_obj** objs,
+    const struct plane frust[6]);
+uint scene_culltree_sphere(const struct scn_tree* tree, OUT struct cmp_obj** objs,
+    const struct sphere* sphere);
+void scene_gather_models_csm_tree(struct scn_data* s, struct array* objs,
+    const struct aabb* frust_bounds, const struct vec3f* dir_norm);
+/* space partitioning (sparse hash grid) */
+result_t scene_hashgrid_init(struct scn_hashgrid* hgrid, float cell_size);
+void scene_hashgrid_release(struct scn_hashgrid* hgrid);
+void scene_hashgrid_clear(struct scn_hashgrid* hgrid);
+void scene_hashgrid_push(struct scn_hashgrid* hgrid, cmphandle_t bounds_hdl);
+void scene_hashgrid_pull(struct scn_hashgrid* hgrid, cmphandle_t bounds_hdl);
+struct scn_hashgrid_cell* scene_hashgrid_findcell(const struct scn_hashgrid* hgrid, uint key);
+void scene_hashgrid_removecell(struct scn_hashgrid* hgrid, uint key);
+uint scene_cullhashgrid(struct scn_hashgrid* hgrid, OUT struct cmp_obj** objs,
+    const struct plane frust[6]);
+uint scene_cullhashgrid_sphere(const struct scn_hashgrid* hgrid, OUT struct cmp_obj** objs,
+    const struct sphere* sphere);
+int scene_calc_frustum_rectxz(OUT float rmin[2], OUT float rmax[2], const struct plane frust[6]);
+
+void scene_update_spatial(struct scn_data* s, uint thread_id);
+void scene_run_probes_range(uint start, uint end, uint thread_id, void* param);
+uint scene_run_probe(const struct scn_data* s, const struct scn_probe* p, uint max_hits,
+    OUT struct scn_probe_hit* hits);
+uint scene_probe_items(const struct scn_probe* p, const struct scn_cell_items* items,
+    int cell_x, int cell_z, const int range[4], uint max_hits, INOUT struct scn_probe_hit* hits,
+    uint hit_cnt);
+void scene_update_spatial_range(uint start, uint end, uint thread_id, void* param);
+uint scene_test_spatial(const struct scn_data* s, cmphandle_t bounds_hdl);
+void scene_clear_spatial(struct scn_data* s);
+uint scene_count_bounds(const struct scn_data* s);
+void scene_push_all(struct scn_data* s);
+float scene_tune_cellsize(const struct scn_data* s, OPTIONAL json_t jcosts, OUT float* cost);
+float scene_tune_estimate(const struct scn_data* s, float cell_size);
+void scene_tune_area(const struct scn_data* s, OUT float* area, OUT float* query_side);
+uint64 scene_tune_refcnt(const struct scn_data* s, float cell_size);
+void scene_tune(struct scn_data* s, uint scene_id);
+json_t scene_stats_json(const struct scn_data* s);
 
 void scene_grid_debug(struct scn_grid* grid, const struct camera* cam);
 result_t scene_console_debuggrid(uint argc, const char** argv, void* param);
 result_t scene_console_setcellsize(uint argc, const char** argv, void* param);
+result_t scene_console_setspatial(uint argc, const char** argv, void* param);
+result_t scene_console_viscache(uint argc, const char** argv, void* param);
+result_t scene_console_tunecells(uint argc, const char** argv, void* param);
+result_t scene_console_savestats(uint argc, const char** argv, void* param);
 result_t scene_console_campos(uint argc, const char** argv, void* param);
 int scene_debug_cam(gfx_cmdqueue cmqueue, int x, int y, int line_stride, void* param);
 
 result_t scene_create_components(struct cmp_obj* obj);
+struct cmp_obj* scene_allocobj(uint scene_id, const char* name, enum cmp_obj_type type);
+result_t scene_addobj(uint scene_id, struct cmp_obj* obj);
+struct cmp_obj* scene_spawn_obj(uint scene_id, const struct scn_prefab* prefab, const char* name,
+    OPTIONAL const struct mat3f* mat);
 cmphandle_t scene_add_component(struct cmp_obj* obj, cmptype_t type);
 
-void* scene_alloc(size_t size, const char* source, uint line, uint id, void* param);
-void scene_free(void* ptr, void* param);
-void* scene_aligned_alloc(size_t size, uint8 alignement, const char* source, uint line, uint id,
-                          void* param);
-void scene_aligned_free(void* ptr, void* param);
-void scene_bindalloc(struct scn_data* s);
-
 /*************************************************************************************************
  * globals
  */
@@ -204,12 +486,38 @@ INLINE struct scn_data* scene_get(uint scene_id)
 }
 
 
-INLINE int scene_test_occ_addobj(INOUT struct cmp_obj** objs, uint* bound_idxs, uint idx,
-    int vis_idx)
+/* records a frustum query in scene's spatial statistics */
+INLINE void scene_stats_addquery(struct scn_data* s, const struct plane frust[6], uint cand_cnt,
+    const int* vis, uint vis_cnt)
+{
+    struct scn_spatial_stats* stats = &s->stats;
+    float rmin[2];
+    float rmax[2];
+
+    stats->query_cnt ++;
+    stats->cand_cnt += cand_cnt;
+    for (uint i = 0; i < vis_cnt; i++)
+        stats->vis_cnt += vis[i] ? 1 : 0;
+
+    if (scene_calc_frustum_rectxz(rmin, rmax, frust))   {
+        stats->area_cnt ++;
+        stats->area_sum += (fl64)((rmax[0] - rmin[0])*(rmax[1] - rmin[1]));
+    }
+}
+
+/* drops cached occlusion result of a moved object
+ * returns TRUE if object is an occluder, which means that all cached results must be dropped */
+INLINE int scene_viscache_invalidate(struct cmp_obj* obj)
 {
-    swapui(&bound_idxs[vis_idx], &bound_idxs[idx]);
-    objs[vis_idx] = objs[idx];
-    return vis_idx + 1;
+    obj->vis_frame = 0;
+    if (obj->type != CMP_OBJTYPE_MODEL || obj->model_cmp == INVALID_HANDLE)
+        return FALSE;
+
+    struct cmp_model* m = (struct cmp_model*)cmp_getinstancedata(obj->model_cmp);
+    if (m->model_hdl == INVALID_HANDLE)
+        return FALSE;
+    struct gfx_model* gm = rs_get_model(m->model_hdl);
+    return gm != NULL && gm->occ != NULL;
 }
 
 INLINE struct array* scene_getobjarr(uint scene_id)
@@ -221,6 +529,472 @@ INLINE struct array* scene_getobjarr(uint scene_id)
         return &g_scn_mgr.global_objs;
 }
 
+INLINE struct pool_alloc* scene_getobjpool(uint scene_id)
+{
+    ASSERT(scene_id != 0);
+    if (scene_id != SCENE_GLOBAL)
+        return &scene_get(scene_id)->obj_pool;
+    else
+        return &g_scn_mgr.obj_pool;
+}
+
+INLINE struct hashtable_chained* scene_getnametable(uint scene_id)
+{
+    ASSERT(scene_id != 0);
+    if (scene_id != SCENE_GLOBAL)
+        return &scene_get(scene_id)->name_table;
+    else
+        return &g_scn_mgr.global_names;
+}
+
+INLINE float scene_aabb_area(const struct aabb* bb)
+{
+    float dx = bb->maxpt.x - bb->minpt.x;
+    float dy = bb->maxpt.y - bb->minpt.y;
+    float dz = bb->maxpt.z - bb->minpt.z;
+    return 2.0f*(dx*dy + dy*dz + dz*dx);
+}
+
+INLINE int scene_aabb_contains(const struct aabb* bb, const struct aabb* inner)
+{
+    return bb->minpt.x <= inner->minpt.x && bb->minpt.y <= inner->minpt.y &&
+        bb->minpt.z <= inner->minpt.z && bb->maxpt.x >= inner->maxpt.x &&
+        bb->maxpt.y >= inner->maxpt.y && bb->maxpt.z >= inner->maxpt.z;
+}
+
+INLINE int scene_aabb_overlaps(const struct aabb* bb1, const struct aabb* bb2)
+{
+    return bb1->minpt.x <= bb2->maxpt.x && bb1->maxpt.x >= bb2->minpt.x &&
+        bb1->minpt.y <= bb2->maxpt.y && bb1->maxpt.y >= bb2->minpt.y &&
+        bb1->minpt.z <= bb2->maxpt.z && bb1->maxpt.z >= bb2->minpt.z;
+}
+
+INLINE void scene_tree_fatbounds(struct aabb* r, const struct aabb* bb)
+{
+    vec3_setf(&r->minpt, bb->minpt.x - SCN_TREE_MARGIN, bb->minpt.y - SCN_TREE_MARGIN,
+        bb->minpt.z - SCN_TREE_MARGIN);
+    vec3_setf(&r->maxpt, bb->maxpt.x + SCN_TREE_MARGIN, bb->maxpt.y + SCN_TREE_MARGIN,
+        bb->maxpt.z + SCN_TREE_MARGIN);
+}
+
+/* recalculate height and bounds of a branch node from it's children */
+INLINE void scene_tree_refitnode(struct scn_tree_node* nodes, int idx)
+{
+    struct scn_tree_node* node = &nodes[idx];
+    const struct scn_tree_node* c1 = &nodes[node->child1];
+    const struct scn_tree_node* c2 = &nodes[node->child2];
+    node->height = 1 + maxi(c1->height, c2->height);
+    aabb_merge(&node->bb, &c1->bb, &c2->bb);
+}
+
+/* returns -1 if aabb is outside of frustum, 1 if it's completely inside, 0 if it intersects */
+INLINE int scene_test_aabb_frustum(const struct aabb* bb, const struct plane frust[6])
+{
+    int inside = TRUE;
+    for (uint i = 0; i < 6; i++)  {
+        const struct plane* p = &frust[i];
+
+        /* test the farthest corner along plane normal, then the nearest for full containment */
+        float px = p->nx > 0.0f ? bb->maxpt.x : bb->minpt.x;
+        float py = p->ny > 0.0f ? bb->maxpt.y : bb->minpt.y;
+        float pz = p->nz > 0.0f ? bb->maxpt.z : bb->minpt.z;
+        if (p->nx*px + p->ny*py + p->nz*pz + p->d < 0.0f)
+            return -1;
+
+        float nx = p->nx > 0.0f ? bb->minpt.x : bb->maxpt.x;
+        float ny = p->ny > 0.0f ? bb->minpt.y : bb->maxpt.y;
+        float nz = p->nz > 0.0f ? bb->minpt.z : bb->maxpt.z;
+        if (p->nx*nx + p->ny*ny + p->nz*nz + p->d < 0.0f)
+            inside = FALSE;
+    }
+    return inside;
+}
+
+INLINE int scene_test_aabb_sphere(const struct aabb* bb, const struct sphere* s)
+{
+    float dx = s->x - clampf(s->x, bb->minpt.x, bb->maxpt.x);
+    float dy = s->y - clampf(s->y, bb->minpt.y, bb->maxpt.y);
+    float dz = s->z - clampf(s->z, bb->minpt.z, bb->maxpt.z);
+    return (dx*dx + dy*dy + dz*dz) <= s->r*s->r;
+}
+
+/* clips ray segment [tmin, tmax] against one axis slab of a box */
+INLINE int scene_clip_rayslab(float p, float d, float bmin, float bmax, INOUT float* tmin,
+    INOUT float* tmax)
+{
+    if (fabsf(d) < EPSILON)
+        return p >= bmin && p <= bmax;
+
+    float inv_d = 1.0f/d;
+    float t1 = (bmin - p)*inv_d;
+    float t2 = (bmax - p)*inv_d;
+    if (t1 > t2)
+        swapf(&t1, &t2);
+    *tmin = maxf(*tmin, t1);
+    *tmax = minf(*tmax, t2);
+    return *tmin <= *tmax;
+}
+
+INLINE int scene_test_aabb_ray(const struct aabb* bb, const struct vec3f* pt,
+    const struct vec3f* dir, float len)
+{
+    float tmin = 0.0f;
+    float tmax = len;
+    return scene_clip_rayslab(pt->x, dir->x, bb->minpt.x, bb->maxpt.x, &tmin, &tmax) &&
+        scene_clip_rayslab(pt->y, dir->y, bb->minpt.y, bb->maxpt.y, &tmin, &tmax) &&
+        scene_clip_rayslab(pt->z, dir->z, bb->minpt.z, bb->maxpt.z, &tmin, &tmax);
+}
+
+/* sweep test of an aabb against frustum bounds moving along 'd' (see scene_cull_aabbs_sweep) */
+INLINE int scene_test_aabb_sweep(const struct vec3f* fmin, const struct vec3f* fmax,
+    const struct vec3f* d, const struct aabb* bb)
+{
+    struct vec3f tmp;
+
+    /* min/max of each object */
+    struct vec3f omin;
+    struct vec3f omax;
+    struct vec3f fcenter;
+    struct vec3f fhalf;
+    struct vec3f ocenter;
+    struct vec3f ohalf;
+
+    vec3_muls(&fcenter, vec3_add(&tmp, fmin, fmax), 0.5f);
+    vec3_muls(&fhalf, vec3_sub(&tmp, fmax, fmin), 0.5f);
+    float fcenter_proj = vec3_dot(&fcenter, d);
+
+    /* project frustum AABB half-size */
+    float fh_proj = fhalf.x*fabs(d->x) + fhalf.y*fabs(d->y) + fhalf.z*fabs(d->z);
+    float fp_min = fcenter_proj - fh_proj;
+    float fp_max = fcenter_proj + fh_proj;
+
+    /* project object AABB center point */
+    vec3_setv(&omin, &bb->minpt);
+    vec3_setv(&omax, &bb->maxpt);
+    vec3_muls(&ocenter, vec3_add(&tmp, &omin, &omax), 0.5f);
+    vec3_muls(&ohalf, vec3_sub(&tmp, &omax, &omin), 0.5f);
+    float ocenter_proj = vec3_dot(&ocenter, d);
+
+    /* project object AABB half-size */
+    float oh_proj = ohalf.x*fabs(d->x) + ohalf.y*fabs(d->y) + ohalf.z*fabs(d->z);
+    float op_min = ocenter_proj - oh_proj;
+    float op_max = ocenter_proj + oh_proj;
+
+    /* sweep intersection along dir */
+    float dist_min = fp_min - op_max;
+    float dist_max = fp_max - op_min;
+    if (dist_min > dist_max)
+        swapf(&dist_min, &dist_max);
+
+    if (dist_max < 0.0f)
+        return FALSE;
+
+    /* test x-axis */
+    if (math_iszero(d->x))    {
+        if (fmin->x > omax.x || omin.x > fmax->x)
+            return FALSE;
+    }   else    {
+        float dist_min_new = (fmin->x - omax.x)/d->x;
+        float dist_max_new = (fmax->x - omin.x)/d->x;
+        if (dist_min_new > dist_max_new)
+            swapf(&dist_min_new, &dist_max_new);
+        if (dist_min > dist_max_new || dist_min_new > dist_max)
+            return FALSE;
+        dist_min = maxf(dist_min, dist_min_new);
+        dist_max = maxf(dist_max, dist_max_new);
+    }
+
+    /* test y-axis */
+    if (math_iszero(d->y))    {
+        if (fmin->y > omax.y || omin.y > fmax->y)
+            return FALSE;
+    }   else    {
+        float dist_min_new = (fmin->y - omax.y)/d->y;
+        float dist_max_new = (fmax->y - omin.y)/d->y;
+        if (dist_min_new > dist_max_new)
+            swapf(&dist_min_new, &dist_max_new);
+        if (dist_min > dist_max_new || dist_min_new > dist_max)
+            return FALSE;
+        dist_min = maxf(dist_min, dist_min_new);
+        dist_max = maxf(dist_max, dist_max_new);
+    }
+
+    /* test z-axis */
+    if (math_iszero(d->z))    {
+        if (fmin->z > omax.z || omin.z > fmax->z)
+            return FALSE;
+    }   else    {
+        float dist_min_new = (fmin->z - omax.z)/d->z;
+        float dist_max_new = (fmax->z - omin.z)/d->z;
+        if (dist_min_new > dist_max_new)
+            swapf(&dist_min_new, &dist_max_new);
+        if (dist_min > dist_max_new || dist_min_new > dist_max)
+            return FALSE;
+    }
+
+    /* not culled */
+    return TRUE;
+}
+
+/* marks bounds as not being in any grid cell (empty cell range) */
+INLINE void scene_cellrange_reset(struct cmp_bounds* b)
+{
+    b->cell_range[0] = 0;
+    b->cell_range[1] = 0;
+    b->cell_range[2] = -1;
+    b->cell_range[3] = -1;
+}
+
+/* packs cell coords into hash-table key, coords are clamped to 16bit range */
+INLINE uint scene_hashgrid_key(int x, int z)
+{
+    return (((uint)x & 0xffff) << 16) | ((uint)z & 0xffff);
+}
+
+INLINE int scene_hashgrid_coord(float f, float cell_size)
+{
+    return (int)clampf(floorf(f/cell_size), (float)SCN_HASHGRID_COORD_MIN,
+        (float)SCN_HASHGRID_COORD_MAX);
+}
+
+/* cells are uniform, so the covered column/row range is calculated directly from object bounds
+ * returns FALSE if object is outside the grid, range is empty in that case */
+INLINE int scene_grid_cellrange(const struct scn_grid* grid, const struct cmp_bounds* b,
+    OUT int range[4])
+{
+    float r = b->ws_s.r;
+    float x_min = b->ws_s.x - r;
+    float x_max = b->ws_s.x + r;
+    float z_min = b->ws_s.z - r;
+    float z_max = b->ws_s.z + r;
+
+    if (grid->cell_cnt == 0 ||
+        x_min > grid->x_max || x_max < grid->x_min || z_min > grid->z_max || z_max < grid->z_min)
+    {
+        range[0] = 0;   range[1] = 0;
+        range[2] = -1;  range[3] = -1;
+        return FALSE;
+    }
+
+    float cs = grid->cell_size;
+    range[0] = clampi((int)floorf((x_min - grid->x_min)/cs), 0, (int)grid->col_cnt - 1);
+    range[1] = clampi((int)floorf((z_min - grid->z_min)/cs), 0, (int)grid->row_cnt - 1);
+    range[2] = clampi((int)floorf((x_max - grid->x_min)/cs), 0, (int)grid->col_cnt - 1);
+    range[3] = clampi((int)floorf((z_max - grid->z_min)/cs), 0, (int)grid->row_cnt - 1);
+    return TRUE;
+}
+
+/* hash-grid cell range that covers bounding sphere on XZ plane */
+INLINE void scene_hashgrid_cellrange(const struct scn_hashgrid* hgrid, const struct cmp_bounds* b,
+    OUT int range[4])
+{
+    float cs = hgrid->cell_size;
+    float r = b->ws_s.r;
+    range[0] = scene_hashgrid_coord(b->ws_s.x - r, cs);
+    range[1] = scene_hashgrid_coord(b->ws_s.z - r, cs);
+    range[2] = scene_hashgrid_coord(b->ws_s.x + r, cs);
+    range[3] = scene_hashgrid_coord(b->ws_s.z + r, cs);
+}
+
+INLINE int scene_cellrange_isequal(const int r1[4], const int r2[4])
+{
+    return r1[0] == r2[0] && r1[1] == r2[1] && r1[2] == r2[2] && r1[3] == r2[3];
+}
+
+/* bounding box of the volume that a probe covers, used for spatial traversal */
+INLINE void scene_probe_bounds(OUT struct aabb* bb, const struct scn_probe* p)
+{
+    switch (p->type)    {
+    case SCN_PROBE_RAY:
+        vec3_setf(&bb->minpt, p->pt.x, p->pt.y, p->pt.z);
+        vec3_setf(&bb->maxpt, p->pt.x, p->pt.y, p->pt.z);
+        aabb_pushptf(bb, p->pt.x + p->dir.x*p->len, p->pt.y + p->dir.y*p->len,
+            p->pt.z + p->dir.z*p->len);
+        break;
+    case SCN_PROBE_AABB:
+        aabb_setb(bb, &p->box);
+        break;
+    default:
+        vec3_setf(&bb->minpt, p->pt.x - p->len, p->pt.y - p->len, p->pt.z - p->len);
+        vec3_setf(&bb->maxpt, p->pt.x + p->len, p->pt.y + p->len, p->pt.z + p->len);
+        break;
+    }
+}
+
+/* exact test of object's bounding sphere against a probe
+ * @return FALSE if object is not hit, dist receives hit distance (see scn_probe_type) */
+INLINE int scene_probe_test(const struct scn_probe* p, const struct sphere* s, OUT float* dist)
+{
+    float dx = s->x - p->pt.x;
+    float dy = s->y - p->pt.y;
+    float dz = s->z - p->pt.z;
+    float dd = dx*dx + dy*dy + dz*dz;
+
+    switch (p->type)    {
+    case SCN_PROBE_RAY:
+    {
+        /* nearest intersection along the ray, rays that start inside hit at zero */
+        float r2 = s->r*s->r;
+        if (dd <= r2)   {
+            *dist = 0.0f;
+            return TRUE;
+        }
+        float t = dx*p->dir.x + dy*p->dir.y + dz*p->dir.z;
+        float m2 = dd - t*t;
+        if (t < 0.0f || m2 > r2)
+            return FALSE;
+        *dist = t - sqrtf(r2 - m2);
+        return *dist <= p->len;
+    }
+    case SCN_PROBE_SPHERE:
+    {
+        float rs = s->r + p->len;
+        *dist = sqrtf(dd);
+        return dd <= rs*rs;
+    }
+    case SCN_PROBE_AABB:
+    {
+        const struct aabb* bb = &p->box;
+        if (!scene_test_aabb_sphere(bb, s))
+            return FALSE;
+        float cx = s->x - (bb->minpt.x + bb->maxpt.x)*0.5f;
+        float cy = s->y - (bb->minpt.y + bb->maxpt.y)*0.5f;
+        float cz = s->z - (bb->minpt.z + bb->maxpt.z)*0.5f;
+        *dist = sqrtf(cx*cx + cy*cy + cz*cz);
+        return TRUE;
+    }
+    default:
+        *dist = maxf(0.0f, sqrtf(dd) - s->r);
+        return *dist <= p->len;
+    }
+}
+
+/* inserts a hit into distance sorted hits, farthest hit is dropped if hits are full
+ * @return new hit count */
+INLINE uint scene_probe_addhit(INOUT struct scn_probe_hit* hits, uint hit_cnt, uint max_hits,
+    uint obj_id, float dist)
+{
+    if (hit_cnt == max_hits)    {
+        if (dist >= hits[hit_cnt-1].dist)
+            return hit_cnt;
+        hit_cnt --;
+    }
+
+    uint i = hit_cnt;
+    while (i > 0 && hits[i-1].dist > dist)  {
+        hits[i] = hits[i-1];
+        i--;
+    }
+    hits[i].obj_id = obj_id;
+    hits[i].dist = dist;
+    return hit_cnt + 1;
+}
+
+/* tests an object against a probe and adds the hit, returns new hit count */
+INLINE uint scene_probe_obj(const struct scn_probe* p, const struct cmp_obj* obj,
+    const struct cmp_bounds* b, uint max_hits, INOUT struct scn_probe_hit* hits, uint hit_cnt)
+{
+    if ((p->obj_types != 0 && !BIT_CHECK(p->obj_types, obj->type)) || obj->id == p->ignore_id)
+        return hit_cnt;
+
+    float dist;
+    if (!scene_probe_test(p, &b->ws_s, &dist))
+        return hit_cnt;
+    return scene_probe_addhit(hits, hit_cnt, max_hits, obj->id, dist);
+}
+
+/* test a rectangle on XZ plane against frustum planes projected on XZ (scene_calc_frustum_projxz)
+ * returns FALSE if rectangle is completely outside */
+INLINE int scene_test_rect_frustumxz(float x_min, float z_min, float x_max, float z_max,
+    const struct plane frust2d[4])
+{
+    for (uint k = 0; k < 4; k++)  {
+        const struct plane* p = &frust2d[k];
+        if (p->nx*x_min + p->nz*z_min + p->d < 0.0f &&
+            p->nx*x_min + p->nz*z_max + p->d < 0.0f &&
+            p->nx*x_max + p->nz*z_min + p->d < 0.0f &&
+            p->nx*x_max + p->nz*z_max + p->d < 0.0f)
+        {
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+/* returns views of 'mask' that intersect the rectangle on XZ plane (scene_cullviews)
+ * sweep views are not bound on XZ, so they always pass */
+INLINE uint scene_viewmask_rect(const struct scn_view* views, const struct scn_view_cull* vcs,
+    uint view_cnt, uint mask, float x_min, float z_min, float x_max, float z_max)
+{
+    uint r = 0;
+    for (uint v = 0; v < view_cnt; v++)   {
+        uint bit = 1u << v;
+        if (!(mask & bit))
+            continue;
+
+        switch (views[v].type)  {
+        case SCN_VIEW_FRUSTUM:
+            if (scene_test_rect_frustumxz(x_min, z_min, x_max, z_max, vcs[v].frust2d))
+                r |= bit;
+            break;
+        case SCN_VIEW_SPHERE:
+            if (x_min <= vcs[v].rmax[0] && x_max >= vcs[v].rmin[0] &&
+                z_min <= vcs[v].rmax[1] && z_max >= vcs[v].rmin[1])
+            {
+                r |= bit;
+            }
+            break;
+        default:
+            r |= bit;
+            break;
+        }
+    }
+    return r;
+}
+
+/* returns views of 'mask' that intersect the aabb (scene_cullviews) */
+INLINE uint scene_viewmask_aabb(const struct scn_view* views, const struct scn_view_cull* vcs,
+    uint view_cnt, uint mask, const struct aabb* bb)
+{
+    uint r = 0;
+    for (uint v = 0; v < view_cnt; v++)   {
+        uint bit = 1u << v;
+        if (!(mask & bit))
+            continue;
+
+        int vis;
+        switch (views[v].type)  {
+        case SCN_VIEW_FRUSTUM:
+            vis = scene_test_aabb_frustum(bb, views[v].planes) >= 0;
+            break;
+        case SCN_VIEW_SWEEP:
+            vis = scene_test_aabb_sweep(&vcs[v].fmin, &vcs[v].fmax, &vcs[v].d, bb);
+            break;
+        case SCN_VIEW_SPHERE:
+            vis = scene_test_aabb_sphere(bb, &views[v].sphere);
+            break;
+        default:
+            vis = TRUE;
+            break;
+        }
+
+        if (vis)
+            r |= bit;
+    }
+    return r;
+}
+
+/* adds object to views of 'mask', objects are added to 'objs' once, on their first visit */
+INLINE uint scene_cullviews_addobj(INOUT uint* masks, OUT struct cmp_obj** objs, uint obj_cnt,
+    struct cmp_obj* obj, uint mask)
+{
+    uint* pmask = &masks[obj->id - 1];
+    if (*pmask == 0)
+        objs[obj_cnt++] = obj;
+    *pmask |= mask;
+    return obj_cnt;
+}
+
 /*************************************************************************************************/
 void scn_zero()
 {
@@ -242,7 +1016,10 @@ result_t scn_initmgr()
 	if (IS_FAIL(r))
 		return RET_OUTOFMEMORY;
 
-    r = arr_create(mem_heap(), &g_scn_mgr.vis_objs, sizeof(struct cmp_obj*), 300, 300, MID_SCN);
+    g_scn_mgr.viscache.enabled = TRUE;
+
+    r = arr_create(mem_heap(), &g_scn_mgr.query_chunks, sizeof(struct scn_query_chunk), 8, 8,
+        MID_SCN);
     if (IS_FAIL(r))
         return RET_OUTOFMEMORY;
 
@@ -250,11 +1027,20 @@ result_t scn_initmgr()
     r = arr_create(mem_heap(), &g_scn_mgr.global_objs, sizeof(struct cmp_obj*), 20, 40, MID_SCN);
     if (IS_FAIL(r))
         return RET_OUTOFMEMORY;
+    r = hashtable_chained_create(mem_heap(), mem_heap(), &g_scn_mgr.global_names,
+        SCN_NAME_SLOTCNT, MID_SCN);
+    if (IS_FAIL(r))
+        return RET_OUTOFMEMORY;
 
     /* console */
     if (BIT_CHECK(eng_get_params()->flags, ENG_FLAG_DEV))   {
         con_register_cmd("showgrid", scene_console_debuggrid, NULL, "showgrid [1*/0]");
         con_register_cmd("setcellsize", scene_console_setcellsize, NULL, "setgridsize N");
+        con_register_cmd("setspatial", scene_console_setspatial, NULL, "setspatial [grid/tree/hashgrid]");
+        con_register_cmd("viscache", scene_console_viscache, NULL, "viscache [1*/0]");
+        con_register_cmd("tunecells", scene_console_tunecells, NULL, "tunecells");
+        con_register_cmd("savecellstats", scene_console_savestats, NULL,
+            "savecellstats [json_filepath]");
     }
     con_register_cmd("showcam", scene_console_campos, NULL, "showcam [1*/0]");
 
@@ -281,8 +1067,16 @@ void scn_releasemgr()
 	}
 
 	mem_pool_destroy(&g_scn_mgr.obj_pool);
-    arr_destroy(&g_scn_mgr.vis_objs);
+
+    struct scn_query_chunk* chunks = (struct scn_query_chunk*)g_scn_mgr.query_chunks.buffer;
+    for (int i = 0; i < g_scn_mgr.query_chunks.item_cnt; i++)  {
+        arr_destroy(&chunks[i].models);
+        arr_destroy(&chunks[i].lights);
+        arr_destroy(&chunks[i].mats);
+    }
+    arr_destroy(&g_scn_mgr.query_chunks);
     arr_destroy(&g_scn_mgr.global_objs);
+    hashtable_chained_destroy(&g_scn_mgr.global_names);
 
     struct stack* stack_item;
     while ((stack_item = stack_pop(&g_scn_mgr.free_scenes)) != NULL)    {
@@ -368,6 +1162,18 @@ struct scn_data* scene_create(const char* name)
         scene_destroy(s);
         return NULL;
     }
+    if (IS_FAIL(mem_pool_create(mem_heap(), &s->obj_pool, sizeof(struct cmp_obj),
+        SCN_OBJ_BLOCKSIZE, MID_SCN)))
+    {
+        scene_destroy(s);
+        return NULL;
+    }
+    if (IS_FAIL(hashtable_chained_create(mem_heap(), mem_heap(), &s->name_table,
+        SCN_NAME_SLOTCNT, MID_SCN)))
+    {
+        scene_destroy(s);
+        return NULL;
+    }
 
     /* default scene boundary size */
     vec3_setf(&s->minpt, -250.0f, -10.0f, -250.0f);
@@ -379,6 +1185,9 @@ struct scn_data* scene_create(const char* name)
         return NULL;
     }
 
+    /* tree (empty until scene is switched to SCN_SPATIAL_TREE) */
+    scene_tree_init(&s->tree);
+
     /* create physics scene */
     if (!BIT_CHECK(eng_get_params()->flags, ENG_FLAG_DISABLEPHX))   {
         /* default gravity */
@@ -397,22 +1206,21 @@ struct scn_data* scene_create(const char* name)
 
 void scene_destroy(struct scn_data* s)
 {
-    /* remove all objects */
-    struct cmp_obj** objs = (struct cmp_obj**)s->objs.buffer;
-    for (uint i = 0, cnt = s->objs.item_cnt; i < cnt; i++)  {
-        /* partial object delete */
-        scene_destroy_objcmps(objs[i]);
-        mem_pool_free(&g_scn_mgr.obj_pool, objs[i]);
-    }
+    /* remove all objects, object memory is released with the pool */
+    scene_release_objcmps(s, &s->objs);
 
     /* physics */
     if (s->phx_sceneid != 0)
         phx_destroy_scene(s->phx_sceneid);
 
     /* */
+    scene_hashgrid_release(&s->hgrid);
+    scene_tree_release(&s->tree);
     scene_grid_release(&s->grid);
     arr_destroy(&s->spatial_updates);
+    hashtable_chained_destroy(&s->name_table);
     arr_destroy(&s->objs);
+    mem_pool_destroy(&s->obj_pool);
 
 	FREE(s);
 }
@@ -429,145 +1237,67 @@ struct scn_render_query* scn_create_query(uint scene_id, struct allocator* alloc
 	memset(rq, 0x00, sizeof(struct scn_render_query));
 	rq->alloc = alloc;
 
-    /* get temp-allocator and gather all objects from linked_list */
-    result_t r;
-    struct array tmp_models; /* item: scn_render_model */
-    struct array tmp_lights; /* item: scn_render_light */
-    struct array tmp_mats;  /* item: mat3f */
     int* vis = NULL; /* visible flags for each object */
-    uint obj_idx = 0;     /* object index (sent to query) */
-    uint item_idx = 0;    /* render-item index */
     struct cmp_obj** vis_objs = NULL;  /* non-culled (visible) object list, shrinks in the process*/
     uint vis_cnt;
+    uint cand_cnt;
+    uint64 cull_tick;
 
     struct scn_data* s = scene_get(scene_id);
     if (s->objs.item_cnt == 0)
         return rq;
 
-    /* update spatial partitioning (pull and push objects into the grid) */
-    if (!arr_isempty(&s->spatial_updates))  {
-        scene_grid_pull(&s->grid, (const cmphandle_t*)s->spatial_updates.buffer, 0,
-            s->spatial_updates.item_cnt);
-        scene_grid_push(&s->grid, alloc, (const cmphandle_t*)s->spatial_updates.buffer, 0,
-            s->spatial_updates.item_cnt);
-        arr_clear(&s->spatial_updates);
-    }
-
-    /* create an array buffer, holding all scene objects */
-    memset(&tmp_models, 0x00, sizeof(tmp_models));
-    memset(&tmp_mats, 0x00, sizeof(tmp_mats));
-
-    /* reset visible object cache */
-#if 0
-    for (uint i = 0, cnt = g_scn_mgr.vis_objs.item_cnt; i < cnt; i++) {
-        struct cmp_obj* obj = ((struct cmp_obj**)g_scn_mgr.vis_objs.buffer)[i];
-        BIT_REMOVE(obj->flags, CMP_OBJFLAG_VISIBLE);
-    }
-    arr_clear(&g_scn_mgr.vis_objs);
-#endif
+    /* apply spatial updates that are queued after the spatial stage (scn_flush_spatial) */
+    scene_update_spatial(s, 0);
 
     /* gather objects and cull against the spatial structure */
     vis_cnt = s->objs.item_cnt + g_scn_mgr.global_objs.item_cnt;
     vis_objs = (struct cmp_obj**)A_ALLOC(alloc, sizeof(struct cmp_obj*)*vis_cnt, MID_SCN);
-    vis_cnt = scene_cullgrid(&s->grid, vis_objs, 0, vis_cnt, frust_planes);
+    cull_tick = timer_querytick();
+    switch (s->spatial_type)    {
+    case SCN_SPATIAL_TREE:
+        vis_cnt = scene_culltree(&s->tree, vis_objs, frust_planes);
+        break;
+    case SCN_SPATIAL_HASHGRID:
+        vis_cnt = scene_cullhashgrid(&s->hgrid, vis_objs, frust_planes);
+        break;
+    default:
+        vis_cnt = scene_cullgrid(&s->grid, vis_objs, frust_planes);
+        break;
+    }
+    s->stats.cull_cnt ++;
+    s->stats.cull_tm += timer_calctm(cull_tick, timer_querytick());
+    cand_cnt = vis_cnt;
 
     /* push global objs to visibles */
     struct cmp_obj** global_objs = (struct cmp_obj**)g_scn_mgr.global_objs.buffer;
     for (uint i = 0, cnt = g_scn_mgr.global_objs.item_cnt; i < cnt; i++)
         vis_objs[vis_cnt++] = global_objs[i];
 
-    /* create and get objects bounds */
+    /* get objects bounds and cull against frustum */
     rq->bounds = (struct sphere*)A_ALIGNED_ALLOC(alloc, sizeof(struct sphere)*vis_cnt, MID_SCN);
-    uint* bidxs = (uint*)A_ALLOC(alloc, sizeof(uint)*vis_cnt, MID_SCN);
-    if (rq->bounds == NULL || bidxs == NULL)
-        goto err_cleanup;
-
-    for (uint i = 0; i < vis_cnt; i++) {
-        struct cmp_obj* obj = vis_objs[i];
-        struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(obj->bounds_cmp);
-        sphere_sets(&rq->bounds[i], &b->ws_s);
-        bidxs[i] = i;
-
-        /* reset CMP_OBJFLAG_SPATIALVISIBLE flags */
-        BIT_REMOVE(obj->flags, CMP_OBJFLAG_SPATIALVISIBLE);
-    }
-
-    /* cull against frustum */
     vis = (int*)A_ALLOC(alloc, sizeof(int)*vis_cnt, MID_SCN);
-    if (vis == NULL)
+    if (rq->bounds == NULL || vis == NULL)
         goto err_cleanup;
-    memset(vis, 0x00, sizeof(int)*vis_cnt);
-    scene_cullspheres(vis, frust_planes, rq->bounds, 0, vis_cnt);
+    scene_cullobjs(vis, rq->bounds, vis_objs, vis_cnt, frust_planes);
+    scene_stats_addquery(s, frust_planes, cand_cnt, vis, vis_cnt);
 
-    /* create output buffers (mats, models, lights, etc. - in form of array) */
-    r = arr_create(alloc, &tmp_models, sizeof(struct scn_render_model),
-        vis_cnt + (vis_cnt/2), vis_cnt, MID_SCN);
-    r |= arr_create(alloc, &tmp_lights, sizeof(struct scn_render_light), 60, 100, MID_SCN);
-    if (IS_FAIL(r))
-        goto err_cleanup;
-    r = arr_create(alloc, &tmp_mats, sizeof(struct mat3f), vis_cnt + (vis_cnt/2), vis_cnt, MID_SCN);
-    if (IS_FAIL(r))
+    /* occlusion test and add remaining objects to query */
+    if (IS_FAIL(scene_fill_query(rq, scene_id, vis_objs, vis, vis_cnt, params, TRUE)))
         goto err_cleanup;
 
-    /* draw occluder meshes */
-    scene_draw_occluders(alloc, vis_objs, vis_cnt, vis, params);
-    /* draw potential occludee shapes and test it with occluders */
-    vis_cnt = scene_test_occlusion(vis, vis_objs, bidxs, vis_cnt, params);
+    A_FREE(alloc, vis);
+    A_FREE(alloc, vis_objs);
 
-    for (uint i = 0; i < vis_cnt; i++) {
-        struct cmp_obj* obj = vis_objs[i];
-
-#if 0
-        /* set visible flag for object and also add to visible object cache */
-        BIT_ADD(obj->flags, CMP_OBJFLAG_VISIBLE);
-        struct cmp_obj** pvisobj = arr_add(&g_scn_mgr.vis_objs);
-        *pvisobj = obj;
-#endif
-
-        /* add to proper render-object group */
-        switch (obj->type)  {
-        case CMP_OBJTYPE_MODEL:
-            item_idx += scene_add_model(obj, bidxs[i], item_idx, &tmp_mats, &tmp_models,
-                params, &obj_idx);
-            break;
-
-        case CMP_OBJTYPE_LIGHT:
-            item_idx += scene_add_light(obj, bidxs[i], item_idx, &tmp_mats, &tmp_lights,
-                params, &obj_idx);
-            break;
-
-        default:
-            break;
-        }
-    }
-
-    /* set remaining query data and cleanup */
-    rq->obj_cnt = obj_idx;
-
-    rq->mat_cnt = tmp_mats.item_cnt;
-    rq->mats = (struct mat3f*)tmp_mats.buffer;
-
-    rq->models = (struct scn_render_model*)tmp_models.buffer;
-    rq->model_cnt = tmp_models.item_cnt;
-
-    rq->lights = (struct scn_render_light*)tmp_lights.buffer;
-    rq->light_cnt = tmp_lights.item_cnt;
-
-    A_FREE(alloc, vis);
-    A_FREE(alloc, vis_objs);
-    A_FREE(alloc, bidxs);
-
-    PRF_CLOSESAMPLE(); /* visible query */
+    PRF_CLOSESAMPLE(); /* visible query */
 
     /* debug grid */
-    if (g_scn_mgr.debug_grid)
+    if (g_scn_mgr.debug_grid && s->spatial_type == SCN_SPATIAL_GRID)
         scene_grid_debug(&s->grid, params->cam);
 
     return rq;
 
 err_cleanup:
-    arr_destroy(&tmp_mats);
-    arr_destroy(&tmp_models);
     if (vis_objs != NULL)
          A_FREE(alloc, vis_objs);
     if (rq != NULL)
@@ -593,15 +1323,11 @@ struct scn_render_query* scn_create_query_csm(uint scene_id, struct allocator* a
 
     result_t r;
     struct array tmp_objs; /* item: cmp_obj* */
-    struct array tmp_models; /* item: scn_render_model */
-    struct array tmp_mats;  /* item: mat3f */
     struct scn_data* s = scene_get(scene_id);
     struct cmp_obj** spatial_culled_objs;
     uint spatial_culled_cnt;
     struct aabb* bounds = NULL;
     int* culls = NULL;
-    uint item_idx = 0;
-    uint obj_idx = 0;
 
     /* create an array buffer, holding all scene objects */
     r = arr_create(alloc, &tmp_objs, sizeof(struct cmp_obj*), 100, 500, MID_SCN);
@@ -609,7 +1335,10 @@ struct scn_render_query* scn_create_query_csm(uint scene_id, struct allocator* a
         goto err_cleanup;
 
     /* move through objects and gather objects with model types, used for culling (temp buffer) */
-    scene_gather_models_csm(s, &tmp_objs);
+    if (s->spatial_type == SCN_SPATIAL_TREE)
+        scene_gather_models_csm_tree(s, &tmp_objs, frust_bounds, dir_norm);
+    else
+        scene_gather_models_csm(s, &tmp_objs);
 
     /* spatial cull */
     spatial_culled_cnt = tmp_objs.item_cnt;
@@ -630,43 +1359,25 @@ struct scn_render_query* scn_create_query_csm(uint scene_id, struct allocator* a
         aabb_setb(&bounds[i], &b->ws_aabb);
     }
 
-    /* create models temp array and cull info array */
+    /* create cull info array */
     culls = (int*)A_ALLOC(alloc, sizeof(int)*spatial_culled_cnt, MID_SCN);
     if (culls == NULL)
         goto err_cleanup;
     memset(culls, 0x00, sizeof(int)*spatial_culled_cnt);
 
-    r = arr_create(alloc, &tmp_models, sizeof(struct scn_render_model),
-        spatial_culled_cnt + (spatial_culled_cnt/2), spatial_culled_cnt, MID_SCN);
-    if (IS_FAIL(r))
-        goto err_cleanup;
-    r = arr_create(alloc, &tmp_mats, sizeof(struct mat3f),
-        spatial_culled_cnt + (spatial_culled_cnt/2), spatial_culled_cnt, MID_SCN);
-    if (IS_FAIL(r))
-        goto err_cleanup;
-
     /* sweep cull test */
     scene_cull_aabbs_sweep(culls, frust_bounds, dir_norm, bounds, 0, spatial_culled_cnt);
 
     /* gather */
-    for (uint i = 0; i < spatial_culled_cnt; i++) {
-        if (culls[i]) {
-            struct cmp_obj* obj = spatial_culled_objs[i];
-            item_idx += scene_add_model_shadow(obj, i, item_idx, &tmp_mats, &tmp_models, params,
-                &obj_idx);
-        }  /* endif: not culled */
+    if (IS_FAIL(scene_fill_query_shadow(rq, spatial_culled_objs, culls, spatial_culled_cnt,
+        params)))
+    {
+        goto err_cleanup;
     }
 
-    /* fill data */
-    rq->obj_cnt = obj_idx;
-    rq->mat_cnt = tmp_mats.item_cnt;
-    rq->mats = (struct mat3f*)tmp_mats.buffer;
-    rq->model_cnt = tmp_models.item_cnt;
-    rq->models = (struct scn_render_model*)tmp_models.buffer;
-
     /* */
     A_FREE(alloc, culls);
-    A_FREE(alloc, bounds);
+    A_ALIGNED_FREE(alloc, bounds);
     arr_destroy(&tmp_objs);
 
     PRF_CLOSESAMPLE();
@@ -677,9 +1388,7 @@ err_cleanup:
         A_FREE(alloc, culls);
     if (bounds != NULL)
         A_ALIGNED_FREE(alloc, bounds);
-    arr_destroy(&tmp_models);
     arr_destroy(&tmp_objs);
-    arr_destroy(&tmp_mats);
     if (rq != NULL)
         scn_destroy_query(rq);
     return NULL;
@@ -688,10 +1397,8 @@ err_cleanup:
 struct scn_render_query* scn_create_query_sphere(uint scene_id, struct allocator* alloc,
     const struct sphere* sphere, const struct gfx_view_params* params)
 {
-    result_t r;
     struct scn_data* s = scene_get(scene_id);
-    uint item_idx = 0;
-    uint obj_idx = 0;
+    int* vis = NULL;
 
     /* create query */
     struct scn_render_query* rq = (struct scn_render_query*)A_ALLOC(alloc,
@@ -708,55 +1415,247 @@ struct scn_render_query* scn_create_query_sphere(uint scene_id, struct allocator
 
     /* cull with grid
      * grid is expected to visibility culled before (scn_create_query), in the current frame */
-    uint grid_obj_cnt  = scene_cullgrid_sphere(&s->grid, objs, sphere);
+    uint grid_obj_cnt;
+    switch (s->spatial_type)    {
+    case SCN_SPATIAL_TREE:
+        grid_obj_cnt = scene_culltree_sphere(&s->tree, objs, sphere);
+        break;
+    case SCN_SPATIAL_HASHGRID:
+        grid_obj_cnt = scene_cullhashgrid_sphere(&s->hgrid, objs, sphere);
+        break;
+    default:
+        grid_obj_cnt  = scene_cullgrid_sphere(&s->grid, objs, sphere);
+        break;
+    }
 
-    /* create output buffers (mats, models, lights, etc. - in form of array) */
-    struct array tmp_models;
-    struct array tmp_mats;
-    r = arr_create(alloc, &tmp_models, sizeof(struct scn_render_model),
-        grid_obj_cnt + (grid_obj_cnt/2), grid_obj_cnt, MID_SCN);
-    if (IS_FAIL(r))
+    /* intersect with bounds of objects */
+    vis = (int*)A_ALLOC(alloc, sizeof(int)*grid_obj_cnt, MID_SCN);
+    if (vis == NULL)
         goto err_cleanup;
 
-    /* intersect with bounds of objects */
     for (uint i = 0; i < grid_obj_cnt; i++)   {
         struct cmp_obj* obj = objs[i];
 
         /* filter out all objects except models */
+        vis[i] = FALSE;
         if (obj->type != CMP_OBJTYPE_MODEL)
             continue;
 
         ASSERT(obj->bounds_cmp != INVALID_HANDLE);
         struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(obj->bounds_cmp);
-
-        if (sphere_intersects(sphere, &b->ws_s))    {
-            item_idx += scene_add_model_shadow(obj, i, item_idx, &tmp_mats, &tmp_models, params,
-                &obj_idx);
-        }
+        vis[i] = sphere_intersects(sphere, &b->ws_s);
     }
 
     /* fill data */
-    rq->obj_cnt = obj_idx;
-    rq->mat_cnt = tmp_mats.item_cnt;
-    rq->mats = (struct mat3f*)tmp_mats.buffer;
-    rq->model_cnt = tmp_models.item_cnt;
-    rq->models = (struct scn_render_model*)tmp_models.buffer;
+    if (IS_FAIL(scene_fill_query_shadow(rq, objs, vis, grid_obj_cnt, params)))
+        goto err_cleanup;
 
     /* cleanup */
+    A_FREE(alloc, vis);
     A_FREE(alloc, objs);
 
     return rq;
 
 err_cleanup:
+    if (vis != NULL)
+        A_FREE(alloc, vis);
     if (objs != NULL)
-        A_ALIGNED_FREE(alloc, objs);
-    arr_destroy(&tmp_models);
-    arr_destroy(&tmp_mats);
+        A_FREE(alloc, objs);
     if (rq != NULL)
         scn_destroy_query(rq);
     return NULL;
 }
 
+result_t scn_create_queries(uint scene_id, struct allocator* alloc, const struct scn_view* views,
+    uint view_cnt, const struct gfx_view_params* params, OUT struct scn_render_query** queries)
+{
+    ASSERT(view_cnt <= SCN_VIEW_MAX);
+
+    PRF_OPENSAMPLE("multi-view query");
+
+    struct scn_data* s = scene_get(scene_id);
+    struct scn_view_cull vcs[SCN_VIEW_MAX];
+    struct cmp_obj** objs = NULL; /* spatially unculled objects of all views */
+    struct cmp_obj** view_objs = NULL;  /* objects of a single view (frustum views) */
+    uint* masks = NULL; /* view mask of each scene object, indexed by object id */
+    uint* obj_masks = NULL; /* view mask of each object in 'objs' */
+    struct sphere* spheres = NULL;
+    struct aabb* aabbs = NULL;
+    int* vis = NULL;
+    struct cmp_obj** global_objs = (struct cmp_obj**)g_scn_mgr.global_objs.buffer;
+    uint cnt;
+    uint all_mask = 0;
+    uint sweep_mask = 0;
+    uint64 cull_tick;
+
+    memset(queries, 0x00, sizeof(struct scn_render_query*)*view_cnt);
+    for (uint v = 0; v < view_cnt; v++)   {
+        struct scn_render_query* rq = (struct scn_render_query*)A_ALLOC(alloc,
+            sizeof(struct scn_render_query), MID_SCN);
+        if (rq == NULL)
+            goto err_cleanup;
+        memset(rq, 0x00, sizeof(struct scn_render_query));
+        rq->alloc = alloc;
+        queries[v] = rq;
+
+        all_mask |= 1u << v;
+        if (views[v].type == SCN_VIEW_SWEEP)
+            sweep_mask |= 1u << v;
+    }
+
+    if (s->objs.item_cnt == 0)  {
+        PRF_CLOSESAMPLE();
+        return RET_OK;
+    }
+
+    /* apply spatial updates that are queued after the spatial stage (scn_flush_spatial) */
+    scene_update_spatial(s, 0);
+
+    /* single traversal of the spatial structure for all views */
+    cnt = s->objs.item_cnt + g_scn_mgr.global_objs.item_cnt;
+    objs = (struct cmp_obj**)A_ALLOC(alloc, sizeof(struct cmp_obj*)*cnt, MID_SCN);
+    view_objs = (struct cmp_obj**)A_ALLOC(alloc, sizeof(struct cmp_obj*)*cnt, MID_SCN);
+    masks = (uint*)A_ALLOC(alloc, sizeof(uint)*s->objs.item_cnt, MID_SCN);
+    obj_masks = (uint*)A_ALLOC(alloc, sizeof(uint)*cnt, MID_SCN);
+    vis = (int*)A_ALLOC(alloc, sizeof(int)*cnt, MID_SCN);
+    if (objs == NULL || view_objs == NULL || masks == NULL || obj_masks == NULL || vis == NULL)
+        goto err_cleanup;
+    memset(masks, 0x00, sizeof(uint)*s->objs.item_cnt);
+
+    cull_tick = timer_querytick();
+    scene_prepare_views(vcs, views, view_cnt);
+    cnt = scene_cullviews(s, views, vcs, view_cnt, masks, objs);
+    s->stats.cull_cnt ++;
+    s->stats.cull_tm += timer_calctm(cull_tick, timer_querytick());
+    for (uint i = 0; i < cnt; i++)
+        obj_masks[i] = masks[objs[i]->id - 1];
+
+    /* global objs are in all views */
+    for (uint i = 0, gcnt = g_scn_mgr.global_objs.item_cnt; i < gcnt; i++)    {
+        objs[cnt] = global_objs[i];
+        obj_masks[cnt++] = all_mask;
+    }
+
+    /* fetch bounds of objects once, shared between views */
+    spheres = (struct sphere*)A_ALIGNED_ALLOC(alloc, sizeof(struct sphere)*cnt, MID_SCN);
+    if (sweep_mask)
+        aabbs = (struct aabb*)A_ALIGNED_ALLOC(alloc, sizeof(struct aabb)*cnt, MID_SCN);
+    if (spheres == NULL || (sweep_mask && aabbs == NULL))
+        goto err_cleanup;
+
+    for (uint i = 0; i < cnt; i++)    {
+        struct cmp_obj* obj = objs[i];
+        ASSERT(obj->bounds_cmp != INVALID_HANDLE);
+        struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(obj->bounds_cmp);
+        sphere_sets(&spheres[i], &b->ws_s);
+        if (aabbs != NULL)
+            aabb_setb(&aabbs[i], &b->ws_aabb);
+    }
+
+    /* per-view tests, only objects that passed the spatial test of each view are visited */
+    for (uint v = 0; v < view_cnt; v++)   {
+        const struct scn_view* view = &views[v];
+        struct scn_render_query* rq = queries[v];
+        uint bit = 1u << v;
+        result_t r;
+
+        switch (view->type) {
+        case SCN_VIEW_FRUSTUM:
+        {
+            /* compact objects of the view, query bounds are in the same order */
+            uint vcnt = 0;
+            for (uint i = 0; i < cnt; i++)    {
+                if (obj_masks[i] & bit)
+                    vcnt ++;
+            }
+            rq->bounds = (struct sphere*)A_ALIGNED_ALLOC(alloc, sizeof(struct sphere)*vcnt,
+                MID_SCN);
+            if (rq->bounds == NULL)
+                goto err_cleanup;
+
+            vcnt = 0;
+            for (uint i = 0; i < cnt; i++)    {
+                if (obj_masks[i] & bit)   {
+                    view_objs[vcnt] = objs[i];
+                    sphere_sets(&rq->bounds[vcnt], &spheres[i]);
+                    vcnt ++;
+                }
+            }
+
+            scene_cullobjs(vis, rq->bounds, NULL, vcnt, view->planes);
+            scene_stats_addquery(s, view->planes, vcnt, vis, vcnt);
+            r = scene_fill_query(rq, scene_id, view_objs, vis, vcnt, params, view->occlusion);
+            break;
+        }
+
+        case SCN_VIEW_SWEEP:
+            for (uint i = 0; i < cnt; i++)    {
+                struct cmp_obj* obj = objs[i];
+                vis[i] = FALSE;
+                if (!(obj_masks[i] & bit) || obj->model_cmp == INVALID_HANDLE)
+                    continue;
+                struct cmp_model* m = (struct cmp_model*)cmp_getinstancedata(obj->model_cmp);
+                if (!m->exclude_shadows)    {
+                    vis[i] = scene_test_aabb_sweep(&vcs[v].fmin, &vcs[v].fmax, &vcs[v].d,
+                        &aabbs[i]);
+                }
+            }
+            r = scene_fill_query_shadow(rq, objs, vis, cnt, params);
+            break;
+
+        case SCN_VIEW_SPHERE:
+            for (uint i = 0; i < cnt; i++)    {
+                vis[i] = (obj_masks[i] & bit) && objs[i]->type == CMP_OBJTYPE_MODEL &&
+                    sphere_intersects(&view->sphere, &spheres[i]);
+            }
+            r = scene_fill_query_shadow(rq, objs, vis, cnt, params);
+            break;
+
+        default:
+            r = RET_OK;
+            break;
+        }
+
+        if (IS_FAIL(r))
+            goto err_cleanup;
+    }
+
+    if (aabbs != NULL)
+        A_ALIGNED_FREE(alloc, aabbs);
+    A_ALIGNED_FREE(alloc, spheres);
+    A_FREE(alloc, vis);
+    A_FREE(alloc, obj_masks);
+    A_FREE(alloc, masks);
+    A_FREE(alloc, view_objs);
+    A_FREE(alloc, objs);
+
+    PRF_CLOSESAMPLE(); /* multi-view query */
+    return RET_OK;
+
+err_cleanup:
+    if (aabbs != NULL)
+        A_ALIGNED_FREE(alloc, aabbs);
+    if (spheres != NULL)
+        A_ALIGNED_FREE(alloc, spheres);
+    if (vis != NULL)
+        A_FREE(alloc, vis);
+    if (obj_masks != NULL)
+        A_FREE(alloc, obj_masks);
+    if (masks != NULL)
+        A_FREE(alloc, masks);
+    if (view_objs != NULL)
+        A_FREE(alloc, view_objs);
+    if (objs != NULL)
+        A_FREE(alloc, objs);
+    for (uint v = 0; v < view_cnt; v++)   {
+        if (queries[v] != NULL)
+            scn_destroy_query(queries[v]);
+        queries[v] = NULL;
+    }
+    PRF_CLOSESAMPLE();
+    return RET_OUTOFMEMORY;
+}
+
 
 void scn_destroy_query(struct scn_render_query* query)
 {
@@ -779,7 +1678,22 @@ struct cmp_obj* scn_create_obj(uint scene_id, const char* name, enum cmp_obj_typ
 {
 	ASSERT(scene_id != 0);
 
-	struct cmp_obj* obj = (struct cmp_obj*)mem_pool_alloc(&g_scn_mgr.obj_pool);
+	struct cmp_obj* obj = scene_allocobj(scene_id, name, type);
+	if (obj == NULL)
+		return NULL;
+
+    /* create essential components for the specific object type */
+    scene_create_components(obj);
+
+    if (IS_FAIL(scene_addobj(scene_id, obj)))
+        return NULL;
+
+	return obj;
+}
+
+struct cmp_obj* scene_allocobj(uint scene_id, const char* name, enum cmp_obj_type type)
+{
+	struct cmp_obj* obj = (struct cmp_obj*)mem_pool_alloc(scene_getobjpool(scene_id));
 	if (obj == NULL)
 		return NULL;
 
@@ -787,31 +1701,183 @@ struct cmp_obj* scn_create_obj(uint scene_id, const char* name, enum cmp_obj_typ
 	str_safecpy(obj->name, sizeof(obj->name), name);
 	obj->scene_id = scene_id;
 	obj->type = type;
+    return obj;
+}
 
-    /* create essential components for the specific object type */
-    scene_create_components(obj);
-
-	/* add to scene object bank (or to global list if specified) */
+/* adds object to scene object bank (or to global list if specified) and name index
+ * on failure, object and its components are destroyed */
+result_t scene_addobj(uint scene_id, struct cmp_obj* obj)
+{
     struct array* objarr = scene_getobjarr(scene_id);
     struct cmp_obj** pobj = (struct cmp_obj**)arr_add(objarr);
-    if (pobj == NULL)
-        return NULL;
+    if (pobj == NULL)   {
+        /* object is not in the bank yet, so scn_destroy_obj can't be used */
+        scene_destroy_objcmps(obj);
+        cmp_zeroobj(obj);
+        mem_pool_free(scene_getobjpool(scene_id), obj);
+        return RET_OUTOFMEMORY;
+    }
     *pobj = obj;
     obj->id = objarr->item_cnt;
 
-	return obj;
+    /* name index */
+    obj->name_hash = hash_str(obj->name);
+    if (IS_FAIL(scene_addname(scene_getnametable(scene_id), obj)))  {
+        scn_destroy_obj(obj);
+        return RET_OUTOFMEMORY;
+    }
+
+    return RET_OK;
 }
 
-void scn_clear(uint scene_id)
+struct scn_prefab* scn_create_prefab(const struct cmp_obj* obj)
+{
+    /* chain head is the newest instance, so components are gathered in reverse */
+    cmphandle_t hdls[CMP_OBJ_SLOTCNT];
+    uint cnt = 0;
+    size_t data_sz = 0;
+    struct linked_list* node = obj->chain;
+    while (node != NULL)    {
+        if (cnt == CMP_OBJ_SLOTCNT) {
+            log_printf(LOG_WARNING, "creating prefab failed: object '%s' has too many components",
+                obj->name);
+            return NULL;
+        }
+        hdls[cnt] = ((struct cmp_chain_node*)node->data)->hdl;
+        data_sz += cmp_getstride(cmp_getbyhdl(hdls[cnt]));
+        cnt ++;
+        node = node->next;
+    }
+
+    struct scn_prefab* prefab = (struct scn_prefab*)ALLOC(sizeof(struct scn_prefab), MID_SCN);
+    if (prefab == NULL)
+        return NULL;
+    memset(prefab, 0x00, sizeof(struct scn_prefab));
+    prefab->obj_type = obj->type;
+
+    if (data_sz > 0)    {
+        prefab->data = (uint8*)ALLOC(data_sz, MID_SCN);
+        if (prefab->data == NULL)   {
+            FREE(prefab);
+            return NULL;
+        }
+    }
+
+    uint8* data = prefab->data;
+    for (uint i = 0; i < cnt; i++)  {
+        cmphandle_t hdl = hdls[cnt - i - 1];
+        cmp_t c = cmp_getbyhdl(hdl);
+        uint stride = cmp_getstride(c);
+        memcpy(data, cmp_getinstancedata(hdl), stride);
+
+        prefab->cmps[i].c = c;
+        prefab->cmps[i].data = data;
+        data += stride;
+    }
+    prefab->cmp_cnt = cnt;
+
+    return prefab;
+}
+
+void scn_destroy_prefab(struct scn_prefab* prefab)
 {
+    if (prefab->data != NULL)
+        FREE(prefab->data);
+    FREE(prefab);
+}
+
+uint scn_spawn_prefab(uint scene_id, const struct scn_prefab* prefab, const char* name, uint cnt,
+    OPTIONAL const struct mat3f* mats, OPTIONAL OUT struct cmp_obj** objs)
+{
+    ASSERT(scene_id != 0);
+
+    /* grow component buffers once for all copies */
+    for (uint i = 0; i < prefab->cmp_cnt; i++)  {
+        if (IS_FAIL(cmp_reserve_instances(prefab->cmps[i].c, cnt)))
+            return 0;
+    }
+
+    /* bounds are pushed into spatial structure after all objects are created and modified */
+    struct scn_data* s = (scene_id != SCENE_GLOBAL) ? scene_get(scene_id) : NULL;
+    if (s != NULL)
+        s->defer_push = TRUE;
+
     struct array* objarr = scene_getobjarr(scene_id);
-    struct cmp_obj** objs = (struct cmp_obj**)objarr->buffer;
-    for (uint i = 0, cnt = objarr->item_cnt; i < cnt; i++)  {
-        /* partial object delete */
-        scene_destroy_objcmps(objs[i]);
-        mem_pool_free(&g_scn_mgr.obj_pool, objs[i]);
+    uint first_idx = objarr->item_cnt;
+    uint spawn_cnt = 0;
+    for (uint i = 0; i < cnt; i++)  {
+        struct cmp_obj* obj = scene_spawn_obj(scene_id, prefab, name,
+            mats != NULL ? &mats[i] : NULL);
+        if (obj == NULL)
+            break;
+        if (objs != NULL)
+            objs[spawn_cnt] = obj;
+        spawn_cnt ++;
+    }
+
+    if (s != NULL)  {
+        s->defer_push = FALSE;
+
+        /* world bounds are calculated here, so objects are placed only once */
+        struct cmp_obj** sobjs = (struct cmp_obj**)objarr->buffer;
+        for (uint i = first_idx, obj_cnt = objarr->item_cnt; i < obj_cnt; i++)    {
+            struct cmp_obj* obj = sobjs[i];
+            if (obj->bounds_cmp == INVALID_HANDLE)
+                continue;
+
+            if (obj->xform_cmp != INVALID_HANDLE)   {
+                struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(obj->bounds_cmp);
+                struct cmp_xform* xf = (struct cmp_xform*)cmp_getinstancedata(obj->xform_cmp);
+                sphere_xform(&b->ws_s, &b->s, &xf->ws_mat);
+                aabb_from_sphere(&b->ws_aabb, &b->ws_s);
+            }
+            scn_push_spatial(scene_id, obj->bounds_cmp);
+        }
+    }
+
+    return spawn_cnt;
+}
+
+/* creates an object with copies of prefab components, 'mat' replaces prefab's transform */
+struct cmp_obj* scene_spawn_obj(uint scene_id, const struct scn_prefab* prefab, const char* name,
+    OPTIONAL const struct mat3f* mat)
+{
+    struct cmp_obj* obj = scene_allocobj(scene_id, name, prefab->obj_type);
+    if (obj == NULL)
+        return NULL;
+
+    for (uint i = 0; i < prefab->cmp_cnt; i++)  {
+        const struct scn_prefab_cmp* pc = &prefab->cmps[i];
+        const void* src_data = pc->data;
+
+        struct cmp_xform xf;
+        if (mat != NULL && cmp_gettype(pc->c) == cmp_xform_type)    {
+            memcpy(&xf, pc->data, sizeof(struct cmp_xform));
+            mat3_setm(&xf.mat, mat);
+            src_data = &xf;
+        }
+
+        if (cmp_create_instance_copy(pc->c, obj, src_data) == INVALID_HANDLE)   {
+            log_printf(LOG_WARNING, "spawning object '%s': creating component '%s' failed", name,
+                cmp_getname(pc->c));
+        }
     }
+
+    if (IS_FAIL(scene_addobj(scene_id, obj)))
+        return NULL;
+
+    return obj;
+}
+
+void scn_clear(uint scene_id)
+{
+    struct array* objarr = scene_getobjarr(scene_id);
+    scene_release_objcmps(scene_id != SCENE_GLOBAL ? scene_get(scene_id) : NULL, objarr);
+
+    /* objects are not freed one by one, the whole pool is reset instead */
     arr_clear(objarr);
+    hashtable_chained_clear(scene_getnametable(scene_id));
+    mem_pool_clear(scene_getobjpool(scene_id));
 
     if (scene_id != SCENE_GLOBAL)   {
         struct scn_data* s = scene_get(scene_id);
@@ -823,6 +1889,7 @@ void scn_clear(uint scene_id)
 void scn_destroy_obj(struct cmp_obj* obj)
 {
     scene_destroy_objcmps(obj);
+    scene_removename(scene_getnametable(obj->scene_id), obj);
 
 	/* remove from scene object bank (swap with last one) */
     struct array* objarr = scene_getobjarr(obj->scene_id);
@@ -839,8 +1906,46 @@ void scn_destroy_obj(struct cmp_obj* obj)
     objarr->item_cnt --;
 
     /* reset object and free it from the pool */
+    struct pool_alloc* obj_pool = scene_getobjpool(obj->scene_id);
 	cmp_zeroobj(obj);
-	mem_pool_free(&g_scn_mgr.obj_pool, obj);
+	mem_pool_free(obj_pool, obj);
+}
+
+/* destroys components of all objects in the bank (before the whole bank is released)
+ * spatial structure of the scene is reset at once, instead of pulling objects one by one
+ * note: component data is not owned by the scene, it lives in per-type buffers that are shared
+ * by all scenes, and destroy callbacks have to release gfx/physics resources of each instance.
+ * so this part is still linear in the number of component instances */
+void scene_release_objcmps(OPTIONAL struct scn_data* s, const struct array* objarr)
+{
+    if (s != NULL)  {
+        s->releasing = TRUE;
+        scene_clear_spatial(s);
+
+        switch (s->spatial_type)    {
+        case SCN_SPATIAL_TREE:
+            scene_tree_clear(&s->tree);
+            break;
+        case SCN_SPATIAL_HASHGRID:
+            scene_hashgrid_clear(&s->hgrid);
+            break;
+        default:
+            scene_grid_clear(&s->grid);
+            break;
+        }
+    }
+
+    /* components are destroyed per type, instead of walking each object's chain, objects are
+     * discarded afterwards, so the flag doesn't need to be removed */
+    struct cmp_obj** objs = (struct cmp_obj**)objarr->buffer;
+    uint cnt = objarr->item_cnt;
+    for (uint i = 0; i < cnt; i++)
+        BIT_ADD(objs[i]->tmp_flags, CMP_OBJFLAG_RELEASING);
+    if (cnt > 0)
+        cmp_destroy_hostinstances(CMP_OBJFLAG_RELEASING);
+
+    if (s != NULL)
+        s->releasing = FALSE;
 }
 
 /* destroy components owned by the object */
@@ -892,7 +1997,7 @@ uint scene_add_light(struct cmp_obj* obj, uint bounds_idx, uint item_idx, struct
     struct array* lights, const struct gfx_view_params* params, OUT uint* obj_idx)
 {
     float intensity;
-    cmphandle_t light_hdl = cmp_findinstance(obj->chain, cmp_light_type);
+    cmphandle_t light_hdl = cmp_findinstance_bytype_inobj(obj, cmp_light_type);
     int vis = cmp_light_applylod(light_hdl, &params->cam_pos, &intensity);
     if (!vis)
         return 0;
@@ -903,6 +2008,7 @@ uint scene_add_light(struct cmp_obj* obj, uint bounds_idx, uint item_idx, struct
         return 0;
 
     rlight->light_hdl = light_hdl;
+    rlight->ldata = (struct cmp_light*)cmp_getinstancedata(light_hdl);
     rlight->mat_idx = item_idx;
     rlight->bounds_idx = bounds_idx;
     rlight->intensity_mul = intensity;
@@ -921,7 +2027,7 @@ uint scene_add_model(struct cmp_obj* obj, uint bounds_idx, uint item_idx, struct
 
     /* apply LOD if model is owned by LOD component */
     if (BIT_CHECK(m->flags, CMP_MODELFLAG_ISLOD))   {
-        vis = cmp_lodmodel_applylod(cmp_findinstance(obj->chain, cmp_lodmodel_type),
+        vis = cmp_lodmodel_applylod(cmp_findinstance_bytype_inobj(obj, cmp_lodmodel_type),
             &params->cam_pos);
         if (!vis)
             return 0;
@@ -976,7 +2082,7 @@ uint scene_add_model_shadow(struct cmp_obj* obj, uint bounds_idx, uint item_idx,
 
     /* apply LOD if model is owned by LOD component */
     if (BIT_CHECK(m->flags, CMP_MODELFLAG_ISLOD))   {
-        vis = cmp_lodmodel_applylod_shadow(cmp_findinstance(obj->chain, cmp_lodmodel_type),
+        vis = cmp_lodmodel_applylod_shadow(cmp_findinstance_bytype_inobj(obj, cmp_lodmodel_type),
             &params->cam_pos);
         if (!vis)
             return 0;
@@ -1025,17 +2131,62 @@ uint scene_add_model_shadow(struct cmp_obj* obj, uint bounds_idx, uint item_idx,
 
 uint scn_findobj(uint scene_id, const char* name)
 {
-    struct array* objarr = scene_getobjarr(scene_id);
-    struct cmp_obj** objs = (struct cmp_obj**)objarr->buffer;
+    return scn_findobj_byhash(scene_id, hash_str(name), name);
+}
 
-    for (uint i = 0, cnt = objarr->item_cnt; i < cnt; i++)  {
-        if (str_isequal(objs[i]->name, name))
-            return objs[i]->id;
-    }
+uint scn_findobj_byhash(uint scene_id, uint name_hash, const char* name)
+{
+    struct hashtable_item_chained* item = hashtable_chained_find(scene_getnametable(scene_id),
+        name_hash);
+    if (item == NULL)
+        return 0;
 
+    /* check names too, different names may have the same hash */
+    struct cmp_obj* obj = (struct cmp_obj*)(uptr_t)item->value;
+    while (obj != NULL)  {
+        if (str_isequal(obj->name, name))
+            return obj->id;
+        obj = obj->name_next;
+    }
     return 0;
 }
 
+/* objects with the same name hash are linked by name_next, older objects come first */
+result_t scene_addname(struct hashtable_chained* name_table, struct cmp_obj* obj)
+{
+    struct hashtable_item_chained* item = hashtable_chained_find(name_table, obj->name_hash);
+    if (item == NULL)
+        return hashtable_chained_add(name_table, obj->name_hash, (uptr_t)obj);
+
+    struct cmp_obj* last = (struct cmp_obj*)(uptr_t)item->value;
+    while (last->name_next != NULL)
+        last = last->name_next;
+    last->name_next = obj;
+    return RET_OK;
+}
+
+void scene_removename(struct hashtable_chained* name_table, struct cmp_obj* obj)
+{
+    struct hashtable_item_chained* item = hashtable_chained_find(name_table, obj->name_hash);
+    if (item == NULL)
+        return;
+
+    struct cmp_obj* first = (struct cmp_obj*)(uptr_t)item->value;
+    if (first == obj)   {
+        if (obj->name_next != NULL)
+            item->value = (uptr_t)obj->name_next;
+        else
+            hashtable_chained_remove(name_table, item);
+        return;
+    }
+
+    struct cmp_obj* prev = first;
+    while (prev->name_next != NULL && prev->name_next != obj)
+        prev = prev->name_next;
+    if (prev->name_next == obj)
+        prev->name_next = obj->name_next;
+}
+
 struct cmp_obj* scn_getobj(uint scene_id, uint obj_id)
 {
     ASSERT(obj_id != 0);
@@ -1051,106 +2202,21 @@ void scene_cull_aabbs_sweep(int* vis, const struct aabb* frust_aabb, const struc
     struct vec3f fmin;
     struct vec3f fmax;
     struct vec3f d;
-    struct vec3f tmp;
 
     vec3_setv(&fmin, &frust_aabb->minpt);
     vec3_setv(&fmax, &frust_aabb->maxpt);
     vec3_setv(&d, dir);
 
     for (uint i = startidx; i < endidx; i++) {
-        /* min/max of each object */
-        struct vec3f omin;
-        struct vec3f omax;
-        struct vec3f fcenter;
-        struct vec3f fhalf;
-        struct vec3f ocenter;
-        struct vec3f ohalf;
-
-        vec3_muls(&fcenter, vec3_add(&tmp, &fmin, &fmax), 0.5f);
-        vec3_muls(&fhalf, vec3_sub(&tmp, &fmax, &fmin), 0.5f);
-        float fcenter_proj = vec3_dot(&fcenter, &d);
-
-        /* project frustum AABB half-size */
-        float fh_proj = fhalf.x*fabs(d.x) + fhalf.y*fabs(d.y) + fhalf.z*fabs(d.z);
-        float fp_min = fcenter_proj - fh_proj;
-        float fp_max = fcenter_proj + fh_proj;
-
-        /* project object AABB center point */
-        vec3_setv(&omin, &aabbs[i].minpt);
-        vec3_setv(&omax, &aabbs[i].maxpt);
-        vec3_muls(&ocenter, vec3_add(&tmp, &omin, &omax), 0.5f);
-        vec3_muls(&ohalf, vec3_sub(&tmp, &omax, &omin), 0.5f);
-        float ocenter_proj = vec3_dot(&ocenter, &d);
-
-        /* project object AABB half-size */
-        float oh_proj = ohalf.x*fabs(d.x) + ohalf.y*fabs(d.y) + ohalf.z*fabs(d.z);
-        float op_min = ocenter_proj - oh_proj;
-        float op_max = ocenter_proj + oh_proj;
-
-        /* sweep intersection along dir */
-        float dist_min = fp_min - op_max;
-        float dist_max = fp_max - op_min;
-        if (dist_min > dist_max)
-            swapf(&dist_min, &dist_max);
-
-        if (dist_max < 0.0f)
-            continue;
-
-        /* test x-axis */
-        if (math_iszero(d.x))    {
-            if (fmin.x > omax.x || omin.x > fmax.x)
-                continue;
-        }   else    {
-            float dist_min_new = (fmin.x - omax.x)/d.x;
-            float dist_max_new = (fmax.x - omin.x)/d.x;
-            if (dist_min_new > dist_max_new)
-                swapf(&dist_min_new, &dist_max_new);
-            if (dist_min > dist_max_new || dist_min_new > dist_max)
-                continue;
-            dist_min = maxf(dist_min, dist_min_new);
-            dist_max = maxf(dist_max, dist_max_new);
-        }
-
-        /* test y-axis */
-        if (math_iszero(d.y))    {
-            if (fmin.y > omax.y || omin.y > fmax.y)
-                continue;
-        }   else    {
-            float dist_min_new = (fmin.y - omax.y)/d.y;
-            float dist_max_new = (fmax.y - omin.y)/d.y;
-            if (dist_min_new > dist_max_new)
-                swapf(&dist_min_new, &dist_max_new);
-            if (dist_min > dist_max_new || dist_min_new > dist_max)
-                continue;
-            dist_min = maxf(dist_min, dist_min_new);
-            dist_max = maxf(dist_max, dist_max_new);
-        }
-
-        /* test z-axis */
-        if (math_iszero(d.z))    {
-            if (fmin.z > omax.z || omin.z > fmax.z)
-                continue;
-        }   else    {
-            float dist_min_new = (fmin.z - omax.z)/d.z;
-            float dist_max_new = (fmax.z - omin.z)/d.z;
-            if (dist_min_new > dist_max_new)
-                swapf(&dist_min_new, &dist_max_new);
-            if (dist_min > dist_max_new || dist_min_new > dist_max)
-                continue;
-        }
-
-        /* not culled */
-        vis[i] = TRUE;
+        if (scene_test_aabb_sweep(&fmin, &fmax, &d, &aabbs[i]))
+            vis[i] = TRUE;
     }
-
 }
 
 #if defined(_SIMD_SSE_)
 void scene_cullspheres(int* vis, const struct plane frust[6], const struct sphere* bounds,
 		uint startidx, uint endidx)
 {
-    PRF_OPENSAMPLE("frustum cull");
-
     struct vec4f planes_simd[8];
 
     /* construct SIMD friendly frust planes */
@@ -1204,8 +2270,6 @@ void scene_cullspheres(int* vis, const struct plane frust[6], const struct spher
         _mm_store_ss((float*)&mask, _r);
         vis[i] |= (~mask) & 0x1;
     }
-
-    PRF_CLOSESAMPLE(); /* frustum cull */
 }
 #else
 #error "not implemented"
@@ -1246,10 +2310,306 @@ skip_sphere:
     PRF_CLOSESAMPLE(); /* frustum cull */
 }
 
-/* draw occluders only within occ_far units */
-void scene_draw_occluders(struct allocator* alloc, struct cmp_obj** objs, uint obj_cnt,
-    const int* vis, const struct gfx_view_params* params)
-{
+/**
+ * fills query with models and lights of visible objects
+ * rq->bounds should be filled by caller, with bounds of 'objs' in the same order
+ * @param objs (in/out) inputs objects, outputs shrinked array of visible objects
+ * @param occlusion test visible objects against occluders, with results cached between queries
+ * (primary camera only)
+ */
+result_t scene_fill_query(struct scn_render_query* rq, uint scene_id, INOUT struct cmp_obj** objs,
+    const int* vis, uint obj_cnt, const struct gfx_view_params* params, int occlusion)
+{
+    struct allocator* alloc = rq->alloc;
+    struct array tmp_models; /* item: scn_render_model */
+    struct array tmp_lights; /* item: scn_render_light */
+    struct array tmp_mats;  /* item: mat3f */
+    uint vis_cnt = 0;
+    int* occ_vis = NULL;
+
+    /* bounds indexes of objects, they move with objects when array shrinks */
+    uint* bidxs = (uint*)A_ALLOC(alloc, sizeof(uint)*obj_cnt, MID_SCN);
+    if (bidxs == NULL)
+        return RET_OUTOFMEMORY;
+
+    if (occlusion)  {
+        occ_vis = (int*)A_ALLOC(alloc, sizeof(int)*obj_cnt, MID_SCN);
+        if (occ_vis == NULL)
+            goto err_cleanup;
+
+        /* reuse cached results, rasterize occluders only if there is anything left to test */
+        uint test_cnt = scene_viscache_begin(scene_id, objs, vis, occ_vis, obj_cnt, params);
+        if (test_cnt > 0)  {
+            /* draw occluder meshes */
+            scene_draw_occluders(alloc, objs, obj_cnt, vis, params);
+            /* draw potential occludee shapes and test it with occluders */
+            scene_test_occlusion(occ_vis, objs, obj_cnt, params);
+            gfx_occ_addtests(test_cnt);
+        }
+
+        /* keep results for next queries */
+        for (uint i = 0; i < obj_cnt; i++)    {
+            if (!vis[i])
+                continue;
+            if (occ_vis[i])
+                BIT_ADD(objs[i]->flags, CMP_OBJFLAG_VISIBLE);
+            else
+                BIT_REMOVE(objs[i]->flags, CMP_OBJFLAG_VISIBLE);
+        }
+        vis = occ_vis;
+    }
+
+    for (uint i = 0; i < obj_cnt; i++)    {
+        if (vis[i]) {
+            objs[vis_cnt] = objs[i];
+            bidxs[vis_cnt++] = i;
+        }
+    }
+
+    /* extract render items of visible objects (mats, models, lights, etc. - in form of array) */
+    struct scn_extract_job job;
+    memset(&job, 0x00, sizeof(job));
+    job.objs = objs;
+    job.bidxs = bidxs;
+    job.obj_cnt = vis_cnt;
+    job.params = params;
+    if (IS_FAIL(scene_extract(rq->alloc, &job, &tmp_models, &tmp_lights, &tmp_mats,
+        &rq->obj_cnt)))
+        goto err_cleanup;
+
+    /* set remaining query data */
+    rq->mat_cnt = tmp_mats.item_cnt;
+    rq->mats = (struct mat3f*)tmp_mats.buffer;
+
+    rq->models = (struct scn_render_model*)tmp_models.buffer;
+    rq->model_cnt = tmp_models.item_cnt;
+
+    rq->lights = (struct scn_render_light*)tmp_lights.buffer;
+    rq->light_cnt = tmp_lights.item_cnt;
+
+    if (occ_vis != NULL)
+        A_FREE(alloc, occ_vis);
+    A_FREE(alloc, bidxs);
+    return RET_OK;
+
+err_cleanup:
+    if (occ_vis != NULL)
+        A_FREE(alloc, occ_vis);
+    A_FREE(alloc, bidxs);
+    return RET_OUTOFMEMORY;
+}
+
+/* fills query with shadow models of visible objects, bounds index of each model is the object index */
+result_t scene_fill_query_shadow(struct scn_render_query* rq, struct cmp_obj** objs, const int* vis,
+    uint obj_cnt, const struct gfx_view_params* params)
+{
+    struct array tmp_models; /* item: scn_render_model */
+    struct array tmp_lights; /* item: scn_render_light */
+    struct array tmp_mats;  /* item: mat3f */
+
+    struct scn_extract_job job;
+    memset(&job, 0x00, sizeof(job));
+    job.objs = objs;
+    job.vis = vis;
+    job.obj_cnt = obj_cnt;
+    job.shadow = TRUE;
+    job.params = params;
+    if (IS_FAIL(scene_extract(rq->alloc, &job, &tmp_models, &tmp_lights, &tmp_mats,
+        &rq->obj_cnt)))
+        return RET_OUTOFMEMORY;
+    arr_destroy(&tmp_lights);
+
+    rq->mat_cnt = tmp_mats.item_cnt;
+    rq->mats = (struct mat3f*)tmp_mats.buffer;
+    rq->model_cnt = tmp_models.item_cnt;
+    rq->models = (struct scn_render_model*)tmp_models.buffer;
+
+    return RET_OK;
+}
+
+/**
+ * extracts render items of objects in parallel, each chunk of objects (SCN_QUERY_CHUNK) is
+ * processed by a single thread into its own buffers, then chunks are merged in order, so the
+ * output is the same as extracting the objects one by one
+ * @param models (out) created array of render-models (scn_render_model), allocated from query alloc
+ * @param lights (out) created array of render-lights (scn_render_light)
+ * @param mats (out) created array of world matrices (mat3f)
+ */
+result_t scene_extract(struct allocator* alloc, struct scn_extract_job* job,
+    OUT struct array* models, OUT struct array* lights, OUT struct array* mats, OUT uint* obj_cnt)
+{
+    PRF_OPENSAMPLE("extract");
+
+    result_t r;
+    uint chunk_cnt = (job->obj_cnt + SCN_QUERY_CHUNK - 1)/SCN_QUERY_CHUNK;
+
+    /* grow chunk buffers, only done in main thread */
+    struct array* chunk_arr = &g_scn_mgr.query_chunks;
+    while ((uint)chunk_arr->item_cnt < chunk_cnt)  {
+        struct scn_query_chunk* chunk = (struct scn_query_chunk*)arr_add(chunk_arr);
+        if (chunk == NULL)  {
+            PRF_CLOSESAMPLE();
+            return RET_OUTOFMEMORY;
+        }
+        memset(chunk, 0x00, sizeof(struct scn_query_chunk));
+        r = arr_create(mem_heap(), &chunk->models, sizeof(struct scn_render_model),
+            SCN_QUERY_CHUNK, SCN_QUERY_CHUNK, MID_SCN);
+        r |= arr_create(mem_heap(), &chunk->lights, sizeof(struct scn_render_light), 60, 100,
+            MID_SCN);
+        r |= arr_create(mem_heap(), &chunk->mats, sizeof(struct mat3f), SCN_QUERY_CHUNK,
+            SCN_QUERY_CHUNK, MID_SCN);
+        if (IS_FAIL(r)) {
+            arr_destroy(&chunk->models);
+            arr_destroy(&chunk->lights);
+            arr_destroy(&chunk->mats);
+            chunk_arr->item_cnt --;
+            PRF_CLOSESAMPLE();
+            return RET_OUTOFMEMORY;
+        }
+    }
+
+    job->chunks = (struct scn_query_chunk*)chunk_arr->buffer;
+    fgr_parallel_for(scene_extract_range, chunk_cnt, 1, job, 0);
+
+    /* merge chunks into query buffers, item indexes are offset by previous chunks */
+    uint model_cnt = 0, light_cnt = 0, mat_cnt = 0;
+    *obj_cnt = 0;
+    for (uint c = 0; c < chunk_cnt; c++)  {
+        const struct scn_query_chunk* chunk = &job->chunks[c];
+        model_cnt += chunk->models.item_cnt;
+        light_cnt += chunk->lights.item_cnt;
+        mat_cnt += chunk->mats.item_cnt;
+        *obj_cnt += chunk->obj_cnt;
+    }
+
+    memset(models, 0x00, sizeof(struct array));
+    memset(lights, 0x00, sizeof(struct array));
+    memset(mats, 0x00, sizeof(struct array));
+    r = arr_create(alloc, models, sizeof(struct scn_render_model), model_cnt + 1, 100, MID_SCN);
+    r |= arr_create(alloc, lights, sizeof(struct scn_render_light), light_cnt + 1, 100, MID_SCN);
+    r |= arr_create(alloc, mats, sizeof(struct mat3f), mat_cnt + 1, 100, MID_SCN);
+    if (IS_FAIL(r)) {
+        arr_destroy(models);
+        arr_destroy(lights);
+        arr_destroy(mats);
+        PRF_CLOSESAMPLE();
+        return RET_OUTOFMEMORY;
+    }
+
+    struct scn_render_model* rmodels = (struct scn_render_model*)models->buffer;
+    struct scn_render_light* rlights = (struct scn_render_light*)lights->buffer;
+    struct mat3f* rmats = (struct mat3f*)mats->buffer;
+    for (uint c = 0; c < chunk_cnt; c++)  {
+        const struct scn_query_chunk* chunk = &job->chunks[c];
+        uint mat_offset = mats->item_cnt;
+
+        memcpy(&rmodels[models->item_cnt], chunk->models.buffer,
+            sizeof(struct scn_render_model)*chunk->models.item_cnt);
+        memcpy(&rlights[lights->item_cnt], chunk->lights.buffer,
+            sizeof(struct scn_render_light)*chunk->lights.item_cnt);
+        memcpy(&rmats[mats->item_cnt], chunk->mats.buffer,
+            sizeof(struct mat3f)*chunk->mats.item_cnt);
+
+        for (int i = 0; i < chunk->models.item_cnt; i++)
+            rmodels[models->item_cnt + i].mat_idx += mat_offset;
+        for (int i = 0; i < chunk->lights.item_cnt; i++)
+            rlights[lights->item_cnt + i].mat_idx += mat_offset;
+
+        models->item_cnt += chunk->models.item_cnt;
+        lights->item_cnt += chunk->lights.item_cnt;
+        mats->item_cnt += chunk->mats.item_cnt;
+    }
+
+    PRF_CLOSESAMPLE(); /* extract */
+    return RET_OK;
+}
+
+/* Runs in main thread and task threads, each item is a chunk of objects */
+void scene_extract_range(uint start, uint end, uint thread_id, void* param)
+{
+    struct scn_extract_job* job = (struct scn_extract_job*)param;
+
+    for (uint c = start; c < end; c++)    {
+        struct scn_query_chunk* chunk = &job->chunks[c];
+        uint item_idx = 0;    /* render-item index, local to the chunk */
+
+        arr_clear(&chunk->models);
+        arr_clear(&chunk->lights);
+        arr_clear(&chunk->mats);
+        chunk->obj_cnt = 0;
+
+        for (uint i = c*SCN_QUERY_CHUNK, e = minui(i + SCN_QUERY_CHUNK, job->obj_cnt); i < e; i++)  {
+            if (job->vis != NULL && !job->vis[i])
+                continue;
+
+            struct cmp_obj* obj = job->objs[i];
+            uint bidx = job->bidxs != NULL ? job->bidxs[i] : i;
+
+            /* add to proper render-object group */
+            if (job->shadow)    {
+                item_idx += scene_add_model_shadow(obj, bidx, item_idx, &chunk->mats,
+                    &chunk->models, job->params, &chunk->obj_cnt);
+                continue;
+            }
+
+            switch (obj->type)  {
+            case CMP_OBJTYPE_MODEL:
+                item_idx += scene_add_model(obj, bidx, item_idx, &chunk->mats, &chunk->models,
+                    job->params, &chunk->obj_cnt);
+                break;
+
+            case CMP_OBJTYPE_LIGHT:
+                item_idx += scene_add_light(obj, bidx, item_idx, &chunk->mats, &chunk->lights,
+                    job->params, &chunk->obj_cnt);
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+}
+
+/* fetches bounds of objects (optional) and culls them against frustum, in parallel */
+void scene_cullobjs(int* vis, struct sphere* bounds, OPTIONAL struct cmp_obj** objs, uint obj_cnt,
+    const struct plane frust[6])
+{
+    PRF_OPENSAMPLE("frustum cull");
+
+    struct scn_cull_job job;
+    job.objs = objs;
+    job.bounds = bounds;
+    job.vis = vis;
+    job.frust = frust;
+    fgr_parallel_for(scene_cullobjs_range, obj_cnt, SCN_QUERY_BATCH, &job, 0);
+
+    PRF_CLOSESAMPLE(); /* frustum cull */
+}
+
+/* Runs in main thread and task threads */
+void scene_cullobjs_range(uint start, uint end, uint thread_id, void* param)
+{
+    struct scn_cull_job* job = (struct scn_cull_job*)param;
+
+    if (job->objs != NULL)  {
+        for (uint i = start; i < end; i++)    {
+            struct cmp_obj* obj = job->objs[i];
+            struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(obj->bounds_cmp);
+            sphere_sets(&job->bounds[i], &b->ws_s);
+
+            /* reset CMP_OBJFLAG_SPATIALVISIBLE flags */
+            BIT_REMOVE(obj->flags, CMP_OBJFLAG_SPATIALVISIBLE);
+        }
+    }
+
+    memset(&job->vis[start], 0x00, sizeof(int)*(end - start));
+    scene_cullspheres(job->vis, job->frust, job->bounds, start, end);
+}
+
+/* draw occluders only within occ_far units */
+void scene_draw_occluders(struct allocator* alloc, struct cmp_obj** objs, uint obj_cnt,
+    const int* vis, const struct gfx_view_params* params)
+{
     struct vec3f campos;
 
     PRF_OPENSAMPLE("occ-draw");
@@ -1296,18 +2656,74 @@ void scene_draw_occluders(struct allocator* alloc, struct cmp_obj** objs, uint o
 
 
 /**
- * @param objs (in/out) inputs objects, outputs shrinked (likely) array of visible objects
- * @return visible object count
+ * marks objects that need occlusion test in the current query, and fills the rest from the cache:
+ * last query's visible objects stay visible and occluded ones stay occluded, until their staggered
+ * retest comes up, they move, or the camera moves/rotates fast
+ * @param occ_vis (out) visible flags of objects, SCN_OCC_TEST for objects that need test
+ * @return number of objects that need test
  */
-int scene_test_occlusion(const int* vis, INOUT struct cmp_obj** objs, uint* bound_idxs,
+uint scene_viscache_begin(uint scene_id, struct cmp_obj** objs, const int* vis, OUT int* occ_vis,
     uint obj_cnt, const struct gfx_view_params* params)
+{
+    struct scn_viscache* vc = &g_scn_mgr.viscache;
+    struct vec3f cam_dir;
+    struct vec3f d;
+
+    vec3_setf(&cam_dir, params->view.m13, params->view.m23, params->view.m33);
+    vec3_sub(&d, &params->cam_pos, &vc->cam_pos);
+    float move = vec3_dot(&d, &d);
+    float rot = vec3_dot(&cam_dir, &vc->cam_dir);
+
+    uint prev_frame = vc->frame;
+    uint frame = ++vc->frame;
+    if (frame == 0)
+        frame = vc->frame = 1;
+
+    int coherent = vc->enabled && !vc->reset && prev_frame != 0 && vc->scene_id == scene_id &&
+        move < SCN_VISCACHE_MAXMOVE*SCN_VISCACHE_MAXMOVE && rot > SCN_VISCACHE_MINROT;
+    /* camera is not moved, unchanged objects don't need retest */
+    int still = coherent && math_iszero(move) && rot >= 1.0f - EPSILON;
+
+    vc->reset = FALSE;
+    vc->scene_id = scene_id;
+    vec3_setv(&vc->cam_pos, &params->cam_pos);
+    vec3_setv(&vc->cam_dir, &cam_dir);
+
+    uint test_cnt = 0;
+    for (uint i = 0; i < obj_cnt; i++)    {
+        if (!vis[i])    {
+            occ_vis[i] = FALSE;
+            continue;
+        }
+
+        struct cmp_obj* obj = objs[i];
+        int cached = coherent && obj->vis_frame == prev_frame;
+        /* spread retests of cached results between SCN_VISCACHE_RETEST queries */
+        if (cached && !still && ((obj->id + frame) % SCN_VISCACHE_RETEST) == 0)
+            cached = FALSE;
+
+        if (cached) {
+            occ_vis[i] = BIT_CHECK(obj->flags, CMP_OBJFLAG_VISIBLE) ? TRUE : FALSE;
+        }   else    {
+            occ_vis[i] = SCN_OCC_TEST;
+            test_cnt ++;
+        }
+        obj->vis_frame = frame;
+    }
+
+    return test_cnt;
+}
+
+/**
+ * tests objects that are marked with SCN_OCC_TEST against occluders, in parallel
+ * @param vis (in/out) visible flags of objects, tested ones receive the result
+ */
+void scene_test_occlusion(INOUT int* vis, struct cmp_obj** objs, uint obj_cnt,
+    const struct gfx_view_params* params)
 {
     PRF_OPENSAMPLE("occ-test");
 
-    struct vec3f xaxis;
-    struct vec3f yaxis;
-    struct vec3f campos;
-    int cnt = 0;
+    struct scn_occtest_job job;
 
     /* calculate inverse-view matrix from view */
     struct mat3f view_inv;
@@ -1317,44 +2733,61 @@ int scene_test_occlusion(const int* vis, INOUT struct cmp_obj** objs, uint* boun
         params->view.m13, params->view.m23, params->view.m33,
         params->cam_pos.x, params->cam_pos.y, params->cam_pos.z);
 
-    mat3_get_xaxis(&xaxis, &view_inv);
-    mat3_get_yaxis(&yaxis, &view_inv);
-    mat3_get_trans(&campos, &view_inv);
+    mat3_get_xaxis(&job.xaxis, &view_inv);
+    mat3_get_yaxis(&job.yaxis, &view_inv);
+    mat3_get_trans(&job.campos, &view_inv);
+    job.vis = vis;
+    job.objs = objs;
+
+#if defined(_OCCDEMO_)
+    uint batch_min = obj_cnt;   /* demo draws occludees into a shared buffer, keep it serial */
+#else
+    uint batch_min = SCN_QUERY_BATCH;
+#endif
+    fgr_parallel_for(scene_test_occlusion_range, obj_cnt, batch_min, &job, 0);
+
+    PRF_CLOSESAMPLE();
+}
+
+/* Runs in main thread and task threads */
+void scene_test_occlusion_range(uint start, uint end, uint thread_id, void* param)
+{
+    struct scn_occtest_job* job = (struct scn_occtest_job*)param;
+    int* vis = job->vis;
+    struct cmp_obj** objs = job->objs;
 
     /* draw object quads */
-    for (uint i = 0; i < obj_cnt; i++)    {
-        if (vis[i] && objs[i]->bounds_cmp != INVALID_HANDLE) {
+    for (uint i = start; i < end; i++)    {
+        if (vis[i] != SCN_OCC_TEST)
+            continue;
+
+        vis[i] = FALSE;
+        if (objs[i]->bounds_cmp != INVALID_HANDLE) {
             struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(objs[i]->bounds_cmp);
             struct sphere s;
             struct vec4f d;
 
             sphere_sets(&s, &b->ws_s);
-            vec3_setf(&d, campos.x - s.x, campos.y - s.y, campos.z - s.z);
+            vec3_setf(&d, job->campos.x - s.x, job->campos.y - s.y, job->campos.z - s.z);
             float dot_d = vec3_dot(&d, &d);
 
             /* near objects: add to visible objects */
             float l = SCN_OCC_NEAR_THRESHOLD + s.r;
             if (dot_d < l*l) {
-                cnt = scene_test_occ_addobj(objs, bound_idxs, i, cnt);
+                vis[i] = TRUE;
                 continue;
             }
 
-            if (gfx_occ_testbounds(&s, &xaxis, &yaxis, &campos))
-                cnt = scene_test_occ_addobj(objs, bound_idxs, i, cnt);
+            vis[i] = gfx_occ_testbounds(&s, &job->xaxis, &job->yaxis, &job->campos);
         }   /* foreach unculled object */
     }
 
-    PRF_CLOSESAMPLE();
-    return cnt;
 }
 
 result_t scene_grid_init(struct scn_grid* grid, float cell_size, const struct vec3f* world_min,
     const struct vec3f* world_max)
 {
-    result_t r;
-    r = mem_pool_create(mem_heap(), &grid->item_pool, sizeof(struct scn_grid_item),
-        SCN_GRID_BLOCKSIZE, MID_SCN);
-    if (IS_FAIL(r))
+    if (IS_FAIL(scene_cellalloc_init(&grid->item_alloc)))
         return RET_OUTOFMEMORY;
 
     if (IS_FAIL(scene_grid_createcells(grid, cell_size, world_min, world_max)))
@@ -1366,7 +2799,7 @@ result_t scene_grid_init(struct scn_grid* grid, float cell_size, const struct ve
 void scene_grid_release(struct scn_grid* grid)
 {
     scene_grid_destroycells(grid);
-    mem_pool_destroy(&grid->item_pool);
+    scene_cellalloc_release(&grid->item_alloc);
     memset(grid, 0x00, sizeof(struct scn_grid));
 }
 
@@ -1376,21 +2809,18 @@ result_t scene_grid_resize(uint scene_id, const struct vec3f* world_min,
     struct scn_data* s = scene_get(scene_id);
     struct scn_grid* grid = &s->grid;
 
+    /* grid cells are only allocated in grid mode, they are created later by scn_setspatial */
+    if (s->spatial_type != SCN_SPATIAL_GRID)    {
+        grid->cell_size = cell_size;
+        return RET_OK;
+    }
+
     scene_grid_destroycells(grid);
     result_t r = scene_grid_createcells(grid, cell_size, world_min, world_max);
-    if (IS_OK(r))   {
-        /* re-push objects into grid */
-        cmphandle_t* bounds = (cmphandle_t*)ALLOC(sizeof(cmphandle_t)*s->objs.item_cnt, MID_SCN);
-        uint bcnt = 0;
-        struct cmp_obj** objs = (struct cmp_obj**)s->objs.buffer;
-        for (uint i = 0, cnt = s->objs.item_cnt; i < cnt; i++)  {
-            if (objs[i]->bounds_cmp != INVALID_HANDLE)
-                bounds[bcnt++] = objs[i]->bounds_cmp;
-        }
 
-        scene_grid_push(&s->grid, mem_heap(), bounds, 0, bcnt);
-        FREE(bounds);
-    }
+    /* re-push objects into grid */
+    if (IS_OK(r))
+        scene_push_all(s);
 
     return r;
 }
@@ -1411,10 +2841,17 @@ result_t scene_grid_createcells(struct scn_grid* grid, float cell_size, const st
         row_cnt ++;
     int cell_cnt = col_cnt * row_cnt;
 
-    /* create cell data (count = 2*cell_cnt) */
-    struct vec4f* cells = (struct vec4f*)ALIGNED_ALLOC(sizeof(struct vec4f)*cell_cnt*2, MID_SCN);
+    /* create cell bounds (SoA, each array is padded to 4 cells for SIMD culling) */
+    uint cell_cnt_pad = (cell_cnt + 3) & ~0x3;
+    float* cells = (float*)ALIGNED_ALLOC(sizeof(float)*cell_cnt_pad*4, MID_SCN);
     if (cells == NULL)
         return RET_OUTOFMEMORY;
+    memset(cells, 0x00, sizeof(float)*cell_cnt_pad*4);
+
+    float* xmin = cells;
+    float* zmin = cells + cell_cnt_pad;
+    float* xmax = cells + cell_cnt_pad*2;
+    float* zmax = cells + cell_cnt_pad*3;
 
     /* start from minimum point and move to maximum point */
     struct vec3f pt;
@@ -1425,11 +2862,10 @@ result_t scene_grid_createcells(struct scn_grid* grid, float cell_size, const st
             int idx = k + i*col_cnt;
             float w = (k != col_cnt-1 || last_w < EPSILON) ? cell_size : last_w;
 
-            struct vec4f* r1 = &cells[idx*2];
-            struct vec4f* r2 = &cells[idx*2 + 1];
-
-            vec4_setf(r1, pt.x, pt.z, pt.x, pt.z); /* minpt */
-            vec4_setf(r2, pt.x + w, pt.z + d, pt.x + w, pt.z + d); /* maxpt */
+            xmin[idx] = pt.x;
+            zmin[idx] = pt.z;
+            xmax[idx] = pt.x + w;
+            zmax[idx] = pt.z + d;
 
             pt.x += cell_size;
         }
@@ -1439,12 +2875,12 @@ result_t scene_grid_createcells(struct scn_grid* grid, float cell_size, const st
     }
 
     /* cell items */
-    grid->items = (struct linked_list**)ALLOC(sizeof(struct linked_list*)*cell_cnt, MID_SCN);
+    grid->items = (struct scn_cell_items*)ALLOC(sizeof(struct scn_cell_items)*cell_cnt, MID_SCN);
     if (grid->items == NULL)    {
         ALIGNED_FREE(cells);
         return RET_OUTOFMEMORY;
     }
-    memset(grid->items, 0x00, sizeof(struct linked_list*)*cell_cnt);
+    memset(grid->items, 0x00, sizeof(struct scn_cell_items)*cell_cnt);
 
     /* visible cells (for debugging) */
     grid->vis_cells = (int*)ALLOC(sizeof(int)*cell_cnt, MID_SCN);
@@ -1457,10 +2893,18 @@ result_t scene_grid_createcells(struct scn_grid* grid, float cell_size, const st
 
     /* */
     grid->cells = cells;
+    grid->cells_xmin = xmin;
+    grid->cells_zmin = zmin;
+    grid->cells_xmax = xmax;
+    grid->cells_zmax = zmax;
     grid->cell_cnt = cell_cnt;
     grid->row_cnt = row_cnt;
     grid->col_cnt = col_cnt;
     grid->cell_size = cell_size;
+    grid->x_min = minpt->x;
+    grid->z_min = minpt->z;
+    grid->x_max = maxpt->x;
+    grid->z_max = maxpt->z;
 
     return RET_OK;
 }
@@ -1473,6 +2917,10 @@ void scene_grid_destroycells(struct scn_grid* grid)
     if (grid->cells != NULL)    {
         ALIGNED_FREE(grid->cells);
         grid->cells = NULL;
+        grid->cells_xmin = NULL;
+        grid->cells_zmin = NULL;
+        grid->cells_xmax = NULL;
+        grid->cells_zmax = NULL;
     }
 
     if (grid->items != NULL)    {
@@ -1490,97 +2938,11 @@ void scene_grid_destroycells(struct scn_grid* grid)
     grid->col_cnt = 0;
 }
 
-void scene_grid_push(struct scn_grid* grid, struct allocator* alloc, const cmphandle_t* obj_bounds,
-    uint start_idx, uint end_idx)
-{
-    /* data :
-     * two vec4f hold two rectangles on x-z plane
-     * 1) x1, y1, x2, y2 (min)
-     * 2) x1, y1, x2, y2 (max)
-     */
-    uint init_cnt = end_idx - start_idx;
-    uint cnt = init_cnt;
-    if (cnt % 2 != 0)
-        cnt ++;
-
-    /* make 2d bounding rectangles on x-z plane for each object */
-    struct vec4f* data = (struct vec4f*)A_ALIGNED_ALLOC(alloc, sizeof(struct vec4f)*cnt, MID_SCN);
-    for (uint i = start_idx; i < end_idx; i+=2)    {
-        struct vec4f minpt1;
-        struct vec4f maxpt1;
-        struct vec4f minpt2;
-        struct vec4f maxpt2;
-        struct vec3f p;
-        struct vec3f tmp;
-
-        /* first bound */
-        struct cmp_bounds* b1 = (struct cmp_bounds*)cmp_getinstancedata(obj_bounds[i]);
-        vec3_setf(&p, b1->ws_s.x, b1->ws_s.y, b1->ws_s.z);
-        float r1 = b1->ws_s.r;
-        vec3_setf(&tmp, r1, 0.0f, r1);
-        vec3_sub(&minpt1, &p, &tmp);
-        vec3_add(&maxpt1, &p, &tmp);
-
-        /* second bound (wrap from start if we reach the end, data doesn't matter) */
-        struct cmp_bounds* b2 = (struct cmp_bounds*)cmp_getinstancedata(obj_bounds[(i + 1)%end_idx]);
-        vec3_setf(&p, b2->ws_s.x, b2->ws_s.y, b2->ws_s.z);
-        float r2 = b2->ws_s.r;
-        vec3_setf(&tmp, r2, 0.0f, r2);
-        vec3_sub(&minpt2, &p, &tmp);
-        vec3_add(&maxpt2, &p, &tmp);
-
-        vec4_setf(&data[i-start_idx], minpt1.x, minpt1.z, minpt2.x, minpt2.z);
-        vec4_setf(&data[i-start_idx+1], maxpt1.x, maxpt1.z, maxpt2.x, maxpt2.z);
-    }
-
-    /* cull flags - culls[i] != 0 --> object not in cell (it's culled) */
-    int* culls = (int*)A_ALIGNED_ALLOC(alloc, sizeof(int)*cnt, MID_SCN);
-    ASSERT(culls);
-
-    struct vec4f* cells = grid->cells;
-    for (uint c = 0, cell_cnt = grid->cell_cnt; c < cell_cnt; c++)    {
-        simd_t cmin = _mm_load_ps(cells[2*c].f);
-        simd_t cmax = _mm_load_ps(cells[2*c + 1].f);
-
-        /* process two objects at once
-         * see scene_grid_pushsingle for non-simd implementation */
-        for (uint i = 0; i < cnt; i+=2)    {
-            simd_t vmin = _mm_load_ps(data[i].f);
-            simd_t vmax = _mm_load_ps(data[i+1].f);
-            simd_t r1 = _mm_cmpgt_ps(cmin, vmax); /* cell-min > obj-max ? */
-            simd_t r2 = _mm_cmplt_ps(cmax, vmin); /* cell-max < obj-min ? */
-            simd_t r = _mm_or_ps(r1, r2);
-            int mask = _mm_movemask_ps(r);
-
-            culls[i] = mask & 0x3;
-            culls[i+1] = mask & 0xC;
-        }
-
-        /* save results */
-        for (uint i = start_idx; i < end_idx; i++)    {
-            if (culls[i-start_idx] == 0)
-                scene_grid_addtocell(grid, c, obj_bounds[i]);
-        }
-    }
-
-    A_ALIGNED_FREE(alloc, data);
-    A_ALIGNED_FREE(alloc, culls);
-}
-
-void scene_grid_pull(struct scn_grid* grid, const cmphandle_t* obj_bounds, uint start_idx,
+void scene_grid_push(struct scn_grid* grid, const cmphandle_t* obj_bounds, uint start_idx,
     uint end_idx)
 {
-    for (uint i = start_idx; i < end_idx; i++)    {
-        struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(obj_bounds[i]);
-        struct linked_list* node = b->cell_list;
-        while (node != NULL)    {
-            struct scn_grid_item* item = (struct scn_grid_item*)node->data;
-            struct linked_list* next = node->next;
-            scene_grid_removefromcell(grid, item->cell_id, item);
-            node = next;
-        }
-        b->cell_list = NULL;
-    }
+    for (uint i = start_idx; i < end_idx; i++)
+        scene_grid_pushsingle(grid, obj_bounds[i]);
 }
 
 void scn_push_spatial(uint scene_id, cmphandle_t bounds_hdl)
@@ -1589,7 +2951,24 @@ void scn_push_spatial(uint scene_id, cmphandle_t bounds_hdl)
         return;
 
     struct scn_data* s = scene_get(scene_id);
-    scene_grid_pushsingle(&s->grid, bounds_hdl);
+    if (s->defer_push)
+        return;
+
+    switch (s->spatial_type)    {
+    case SCN_SPATIAL_TREE:
+        /* object stays out of the tree (tree_node = SCN_TREE_NULL), so it's never culled in */
+        if (IS_FAIL(scene_tree_insert(&s->tree, bounds_hdl))) {
+            err_printf(__FILE__, __LINE__, "scene: out of memory, object '%s' is not added to "
+                "spatial tree", cmp_getinstancehost(bounds_hdl)->name);
+        }
+        break;
+    case SCN_SPATIAL_HASHGRID:
+        scene_hashgrid_push(&s->hgrid, bounds_hdl);
+        break;
+    default:
+        scene_grid_pushsingle(&s->grid, bounds_hdl);
+        break;
+    }
 }
 
 void scn_pull_spatial(uint scene_id, cmphandle_t bounds_hdl)
@@ -1598,89 +2977,80 @@ void scn_pull_spatial(uint scene_id, cmphandle_t bounds_hdl)
         return;
 
     struct scn_data* s = scene_get(scene_id);
-    scene_grid_pullsingle(&s->grid, bounds_hdl);
+    if (s->releasing)
+        return;
+
+    /* drop pending update of the object, bounds handle will be invalid after this */
+    struct cmp_obj* obj = cmp_getinstancehost(bounds_hdl);
+    if (BIT_CHECK(obj->tmp_flags, CMP_OBJFLAG_SPATIALUPDATE))   {
+        cmphandle_t* updates = (cmphandle_t*)s->spatial_updates.buffer;
+        uint cnt = s->spatial_updates.item_cnt;
+        for (uint i = 0; i < cnt; i++)    {
+            if (updates[i] == bounds_hdl)   {
+                updates[i] = updates[cnt - 1];
+                s->spatial_updates.item_cnt --;
+                break;
+            }
+        }
+        BIT_REMOVE(obj->tmp_flags, CMP_OBJFLAG_SPATIALUPDATE);
+    }
+
+    /* objects hidden behind a removed occluder must be tested again */
+    if (scene_viscache_invalidate(obj))
+        g_scn_mgr.viscache.reset = TRUE;
+
+    switch (s->spatial_type)    {
+    case SCN_SPATIAL_TREE:
+        scene_tree_remove(&s->tree, bounds_hdl);
+        break;
+    case SCN_SPATIAL_HASHGRID:
+        scene_hashgrid_pull(&s->hgrid, bounds_hdl);
+        break;
+    default:
+        scene_grid_pullsingle(&s->grid, bounds_hdl);
+        break;
+    }
 }
 
 void scene_grid_pushsingle(struct scn_grid* grid, cmphandle_t bounds_hdl)
 {
-    struct vec4f minpt;
-    struct vec4f maxpt;
-    struct vec3f p;
-    struct vec3f tmp;
-    const struct vec4f* cells = grid->cells;
-
-    /* first bound */
     struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
-    vec3_setf(&p, b->ws_s.x, b->ws_s.y, b->ws_s.z);
-    float r = b->ws_s.r;
-    vec3_setf(&tmp, r, 0.0f, r);
-    vec3_sub(&minpt, &p, &tmp);
-    vec3_add(&maxpt, &p, &tmp);
+    struct cmp_obj* obj = cmp_getinstancehost(bounds_hdl);
+    ASSERT(obj);
 
-    for (uint i = 0, cnt = grid->cell_cnt; i < cnt; i++)  {
-        const struct vec4f* cmin = &cells[2*i]; /* = x_min, z_min, x_min, z_min */
-        const struct vec4f* cmax = &cells[2*i + 1]; /* = x_max, z_max, x_max, z_max */
+    /* objects outside the grid are not added to any cell (empty range) */
+    int range[4];
+    scene_grid_cellrange(grid, b, range);
 
-        int x_out = (minpt.x > cmax->x) | (maxpt.x < cmin->x);
-        int z_out = (minpt.z > cmax->y) | (maxpt.z < cmin->y);
-
-        if (x_out | z_out)
-            continue;
-
-        scene_grid_addtocell(grid, i, bounds_hdl);
+    for (int row = range[1]; row <= range[3]; row++)    {
+        for (int col = range[0]; col <= range[2]; col++)
+            scene_cellitems_add(&grid->item_alloc, &grid->items[col + row*grid->col_cnt], obj);
     }
+
+    memcpy(b->cell_range, range, sizeof(range));
 }
 
 void scene_grid_pullsingle(struct scn_grid* grid, cmphandle_t bounds_hdl)
 {
     struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
-    struct linked_list* node = b->cell_list;
-    while (node != NULL)    {
-        struct scn_grid_item* item = (struct scn_grid_item*)node->data;
-        struct linked_list* next = node->next;
-        scene_grid_removefromcell(grid, item->cell_id, item);
-        node = next;
+    struct cmp_obj* obj = cmp_getinstancehost(bounds_hdl);
+
+    for (int row = b->cell_range[1]; row <= b->cell_range[3]; row++)   {
+        for (int col = b->cell_range[0]; col <= b->cell_range[2]; col++)
+            scene_cellitems_remove(&grid->item_alloc, &grid->items[col + row*grid->col_cnt], obj);
     }
-    b->cell_list = NULL;
+
+    scene_cellrange_reset(b);
 }
 
 void scene_grid_clear(struct scn_grid* grid)
 {
     for (uint i = 0; i < grid->cell_cnt; i++) {
-        struct linked_list* node = grid->items[i];
-        while (node != NULL)    {
-            struct scn_grid_item* item = (struct scn_grid_item*)node->data;
-            struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(item->obj->bounds_cmp);
-            b->cell_list = NULL;
-            node = node->next;
-        }
-        grid->items[i] = NULL;
+        struct scn_cell_items* items = &grid->items[i];
+        for (uint k = 0; k < items->cnt; k++)
+            scene_cellrange_reset((struct cmp_bounds*)cmp_getinstancedata(items->objs[k]->bounds_cmp));
+        scene_cellitems_free(&grid->item_alloc, items);
     }
-
-    mem_pool_clear(&grid->item_pool);
-}
-
-void scene_grid_addtocell(struct scn_grid* grid, uint cell_id, cmphandle_t bounds_hdl)
-{
-    struct scn_grid_item* item = (struct scn_grid_item*)mem_pool_alloc(&grid->item_pool);
-    ASSERT(item != NULL);
-    memset(item, 0x00, sizeof(struct scn_grid_item));
-
-    struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
-    item->obj = cmp_getinstancehost(bounds_hdl);
-    item->cell_id = cell_id;
-    ASSERT(item->obj);
-
-    list_add(&grid->items[cell_id], &item->cell_node, item); /* add to cell linked-list */
-    list_add(&b->cell_list, &item->bounds_node, item);    /* add to bounds (obj) linked-list */
-}
-
-void scene_grid_removefromcell(struct scn_grid* grid, uint cell_id, struct scn_grid_item* item)
-{
-    struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(item->obj->bounds_cmp);
-    list_remove(&grid->items[cell_id], &item->cell_node);
-    list_remove(&b->cell_list, &item->bounds_node);
-    mem_pool_free(&grid->item_pool, item);
 }
 
 void scn_update_spatial(uint scene_id, cmphandle_t bounds_hdl)
@@ -1688,65 +3058,94 @@ void scn_update_spatial(uint scene_id, cmphandle_t bounds_hdl)
     if (scene_id == SCENE_GLOBAL)
         return;
 
+    /* objects can be moved multiple times in a frame, but they are queued only once */
+    struct cmp_obj* obj = cmp_getinstancehost(bounds_hdl);
+    if (BIT_CHECK(obj->tmp_flags, CMP_OBJFLAG_SPATIALUPDATE))
+        return;
+
     struct scn_data* s = scene_get(scene_id);
     cmphandle_t* pb_hdl = (cmphandle_t*)arr_add(&s->spatial_updates);
     ASSERT(pb_hdl);
     *pb_hdl = bounds_hdl;
+    BIT_ADD(obj->tmp_flags, CMP_OBJFLAG_SPATIALUPDATE);
+}
+
+void scn_flush_spatial(uint thread_id)
+{
+    for (uint i = 0, cnt = g_scn_mgr.scenes.item_cnt; i < cnt; i++)   {
+        struct scn_data* s = ((struct scn_data**)g_scn_mgr.scenes.buffer)[i];
+        if (s == NULL)
+            continue;
+
+        scene_update_spatial(s, thread_id);
+
+        /* objects that are loaded before tuning request, have their world bounds by now */
+        if (s->tune_pending)
+            scene_tune(s, i + 1);
+    }
 }
 
 /**
- * @param objs (in/out) inputs objects that needs to be tested, outputs shrinked visible array
+ * @param objs (out) receives objects of visible cells
  * @return number of unculled objects
  */
-uint scene_cullgrid(const struct scn_grid* grid, OUT struct cmp_obj** objs, uint start_idx,
-    uint end_idx, const struct plane frust[6])
+uint scene_cullgrid(const struct scn_grid* grid, OUT struct cmp_obj** objs,
+    const struct plane frust[6])
 {
-    union f_t
-    {
-        float f;
-        int i;
-    };
-
     struct plane frust2d[4];
     scene_calc_frustum_projxz(frust2d, frust);
 
-    uint c = 0;
-    const struct vec4f* cells = grid->cells;
-    for (uint i = 0, cnt = grid->cell_cnt; i < cnt; i++)  {
-        const struct vec4f* vmin = &cells[2*i]; /* = x_min, z_min, x_min, z_min */
-        const struct vec4f* vmax = &cells[2*i + 1]; /* = x_max, z_max, x_max, z_max */
-        union f_t d1, d2, d3, d4;
-        const struct linked_list* node;
+    /* broadcast projected planes */
+    simd_t pnx[4], pnz[4], pd[4];
+    for (uint k = 0; k < 4; k++)  {
+        pnx[k] = _mm_set1_ps(frust2d[k].nx);
+        pnz[k] = _mm_set1_ps(frust2d[k].nz);
+        pd[k] = _mm_set1_ps(frust2d[k].d);
+    }
 
-        grid->vis_cells[i] = FALSE;
+    uint c = 0;
+    const float* xmin = grid->cells_xmin;
+    const float* zmin = grid->cells_zmin;
+    const float* xmax = grid->cells_xmax;
+    const float* zmax = grid->cells_zmax;
+
+    /* test four cells at once against four side planes (cell arrays are padded to 4) */
+    for (uint i = 0, cnt = grid->cell_cnt; i < cnt; i += 4)  {
+        simd_t cxmin = _mm_load_ps(&xmin[i]);
+        simd_t czmin = _mm_load_ps(&zmin[i]);
+        simd_t cxmax = _mm_load_ps(&xmax[i]);
+        simd_t czmax = _mm_load_ps(&zmax[i]);
+        int culled = 0;
 
-        /* test against four side planes of each cell */
         for (uint k = 0; k < 4; k++)  {
-            d1.f = frust2d[k].nx*vmin->x + frust2d[k].nz*vmin->y + frust2d[k].d;
-            d2.f = frust2d[k].nx*vmin->x + frust2d[k].nz*vmax->y + frust2d[k].d;
-            d3.f = frust2d[k].nx*vmax->x + frust2d[k].nz*vmin->y + frust2d[k].d;
-            d4.f = frust2d[k].nx*vmax->x + frust2d[k].nz*vmax->y + frust2d[k].d;
-
-            /* if all points of the cell is outside of frustum, then it is definitely outside */
-            if (SIGNBIT(d1) & SIGNBIT(d2) & SIGNBIT(d3) & SIGNBIT(d4))
-                goto skip_cell;
+            simd_t ax = _mm_mul_ps(pnx[k], cxmin);
+            simd_t bx = _mm_mul_ps(pnx[k], cxmax);
+            simd_t az = _mm_add_ps(_mm_mul_ps(pnz[k], czmin), pd[k]);
+            simd_t bz = _mm_add_ps(_mm_mul_ps(pnz[k], czmax), pd[k]);
+
+            /* if all points of the cell is outside of frustum (sign bits), it is definitely outside */
+            simd_t r = _mm_and_ps(_mm_add_ps(ax, az), _mm_add_ps(ax, bz));
+            r = _mm_and_ps(r, _mm_add_ps(bx, az));
+            r = _mm_and_ps(r, _mm_add_ps(bx, bz));
+            culled |= _mm_movemask_ps(r);
         }
 
-        grid->vis_cells[i] = TRUE;
-
         /* intersect/inside: add to unculled objects, set spatial flag for object */
-        node = grid->items[i];
-        while (node != NULL)    {
-            struct scn_grid_item* item = (struct scn_grid_item*)node->data;
-            if (!BIT_CHECK(item->obj->flags, CMP_OBJFLAG_SPATIALVISIBLE))   {
-                objs[c++] = item->obj;
-                BIT_ADD(item->obj->flags, CMP_OBJFLAG_SPATIALVISIBLE);
+        for (uint ci = i, ce = minui(i + 4, cnt); ci < ce; ci++)    {
+            int vis = !(culled & (1 << (ci - i)));
+            grid->vis_cells[ci] = vis;
+            if (!vis)
+                continue;
+
+            const struct scn_cell_items* items = &grid->items[ci];
+            for (uint k = 0; k < items->cnt; k++)  {
+                struct cmp_obj* obj = items->objs[k];
+                if (!BIT_CHECK(obj->flags, CMP_OBJFLAG_SPATIALVISIBLE))   {
+                    objs[c++] = obj;
+                    BIT_ADD(obj->flags, CMP_OBJFLAG_SPATIALVISIBLE);
+                }
             }
-            node = node->next;
         }
-
-skip_cell:
-        ;
     }
 
     return c;
@@ -1757,39 +3156,36 @@ uint scene_cullgrid_sphere(const struct scn_grid* grid, OUT struct cmp_obj** obj
     const struct sphere* sphere)
 {
     /* project spheres into XZ plane */
-    simd_t smin = _mm_set_ps(sphere->z - sphere->r, sphere->x - sphere->r,
-        sphere->z - sphere->r, sphere->x - sphere->r);
-    simd_t smax = _mm_set_ps(sphere->z + sphere->r, sphere->x + sphere->r,
-        sphere->z + sphere->r, sphere->x + sphere->r);
+    simd_t sxmin = _mm_set1_ps(sphere->x - sphere->r);
+    simd_t szmin = _mm_set1_ps(sphere->z - sphere->r);
+    simd_t sxmax = _mm_set1_ps(sphere->x + sphere->r);
+    simd_t szmax = _mm_set1_ps(sphere->z + sphere->r);
 
-    /* check with cells and extract unculled cell objects */
+    /* check with cells (four at once) and extract unculled cell objects */
     uint obj_cnt = 0;
-    struct vec4f* cells = grid->cells;
-    for (uint c = 0, cell_cnt = grid->cell_cnt; c < cell_cnt; c++)    {
-        if (!grid->vis_cells[c])
-            continue;
-
-        simd_t cmin = _mm_load_ps(cells[2*c].f);
-        simd_t cmax = _mm_load_ps(cells[2*c + 1].f);
-
-        simd_t r1 = _mm_cmpgt_ps(cmin, smax); /* cell-min > obj-max ? */
-        simd_t r2 = _mm_cmplt_ps(cmax, smin); /* cell-max < obj-min ? */
-        simd_t r = _mm_or_ps(r1, r2);
-        int mask = _mm_movemask_ps(r);
+    for (uint i = 0, cnt = grid->cell_cnt; i < cnt; i += 4)    {
+        simd_t r = _mm_cmpgt_ps(_mm_load_ps(&grid->cells_xmin[i]), sxmax); /* cell-min > obj-max ? */
+        r = _mm_or_ps(r, _mm_cmpgt_ps(_mm_load_ps(&grid->cells_zmin[i]), szmax));
+        r = _mm_or_ps(r, _mm_cmplt_ps(_mm_load_ps(&grid->cells_xmax[i]), sxmin)); /* cell-max < obj-min ? */
+        r = _mm_or_ps(r, _mm_cmplt_ps(_mm_load_ps(&grid->cells_zmax[i]), szmin));
+        int culled = _mm_movemask_ps(r);
+
+        for (uint ci = i, ce = minui(i + 4, cnt); ci < ce; ci++)    {
+            if ((culled & (1 << (ci - i))) || !grid->vis_cells[ci])
+                continue;
 
-        if ((mask & 0x3) == 0)  {
-            struct linked_list* node = grid->items[c];
-            while (node != NULL)    {
-                struct scn_grid_item* item = (struct scn_grid_item*)node->data;
+            const struct scn_cell_items* items = &grid->items[ci];
+            for (uint k = 0; k < items->cnt; k++)  {
+                struct cmp_obj* obj = items->objs[k];
 
                 /* search in existing objects for duplicates */
-                for (uint i = 0; i < obj_cnt; i++)    {
-                    if (item->obj == objs[i])
+                for (uint j = 0; j < obj_cnt; j++)    {
+                    if (obj == objs[j])
                         goto skip_obj;
                 }
-                objs[obj_cnt++] = item->obj;
+                objs[obj_cnt++] = obj;
 skip_obj:
-                node = node->next;
+                ;
             }
         }
     }
@@ -1797,21 +3193,1397 @@ skip_obj:
     return obj_cnt;
 }
 
-void scene_calc_frustum_projxz(struct plane frust_proj[4], const struct plane frust_planes[6])
+/*************************************************************************************************
+ * cell items (shared by grid and hash grid)
+ */
+result_t scene_cellalloc_init(struct scn_cell_alloc* ca)
 {
-    const struct plane* p;
+    memset(ca, 0x00, sizeof(struct scn_cell_alloc));
+    for (uint i = 0; i < SCN_CELLITEMS_POOLCNT; i++)  {
+        uint item_cnt = SCN_CELLITEMS_MINCNT << i;
+        result_t r = mem_pool_create(mem_heap(), &ca->pools[i], sizeof(struct cmp_obj*)*item_cnt,
+            SCN_CELLITEMS_BLOCKSIZE, MID_SCN);
+        if (IS_FAIL(r)) {
+            scene_cellalloc_release(ca);
+            return RET_OUTOFMEMORY;
+        }
+    }
 
-    p = &frust_planes[CAM_FRUSTUM_RIGHT];
-    plane_setf(&frust_proj[0], p->nx, 0.0f, p->nz, p->d);
+    return RET_OK;
+}
 
-    p = &frust_planes[CAM_FRUSTUM_LEFT];
-    plane_setf(&frust_proj[1], p->nx, 0.0f, p->nz, p->d);
+void scene_cellalloc_release(struct scn_cell_alloc* ca)
+{
+    for (uint i = 0; i < SCN_CELLITEMS_POOLCNT; i++)
+        mem_pool_destroy(&ca->pools[i]);
+    memset(ca, 0x00, sizeof(struct scn_cell_alloc));
+}
+
+/* returns pool index for buffer size, or -1 if it's allocated from heap */
+INLINE int scene_cellalloc_poolidx(uint max)
+{
+    for (int i = 0; i < SCN_CELLITEMS_POOLCNT; i++)   {
+        if (max == (SCN_CELLITEMS_MINCNT << i))
+            return i;
+    }
+    return -1;
+}
+
+INLINE void scene_cellalloc_free(struct scn_cell_alloc* ca, struct cmp_obj** objs, uint max)
+{
+    int pool_idx = scene_cellalloc_poolidx(max);
+    if (pool_idx != -1)
+        mem_pool_free(&ca->pools[pool_idx], objs);
+    else
+        FREE(objs);
+}
+
+void scene_cellitems_add(struct scn_cell_alloc* ca, struct scn_cell_items* items,
+    struct cmp_obj* obj)
+{
+    /* grow: move to the next size class */
+    if (items->cnt == items->max)   {
+        uint max = (items->max != 0) ? items->max*2 : SCN_CELLITEMS_MINCNT;
+        int pool_idx = scene_cellalloc_poolidx(max);
+        struct cmp_obj** objs = (pool_idx != -1) ?
+            (struct cmp_obj**)mem_pool_alloc(&ca->pools[pool_idx]) :
+            (struct cmp_obj**)ALLOC(sizeof(struct cmp_obj*)*max, MID_SCN);
+        ASSERT(objs);
+
+        if (items->objs != NULL)    {
+            memcpy(objs, items->objs, sizeof(struct cmp_obj*)*items->cnt);
+            scene_cellalloc_free(ca, items->objs, items->max);
+        }
+
+        items->objs = objs;
+        items->max = max;
+    }
+
+    items->objs[items->cnt++] = obj;
+}
+
+void scene_cellitems_remove(struct scn_cell_alloc* ca, struct scn_cell_items* items,
+    struct cmp_obj* obj)
+{
+    for (uint i = 0, cnt = items->cnt; i < cnt; i++)  {
+        if (items->objs[i] == obj)  {
+            items->objs[i] = items->objs[cnt - 1];
+            items->cnt --;
+            break;
+        }
+    }
+
+    if (items->cnt == 0)
+        scene_cellitems_free(ca, items);
+}
+
+void scene_cellitems_free(struct scn_cell_alloc* ca, struct scn_cell_items* items)
+{
+    if (items->objs != NULL)
+        scene_cellalloc_free(ca, items->objs, items->max);
+    memset(items, 0x00, sizeof(struct scn_cell_items));
+}
+
+void scene_calc_frustum_projxz(struct plane frust_proj[4], const struct plane frust_planes[6])
+{
+    const struct plane* p;
+
+    p = &frust_planes[CAM_FRUSTUM_RIGHT];
+    plane_setf(&frust_proj[0], p->nx, 0.0f, p->nz, p->d);
+
+    p = &frust_planes[CAM_FRUSTUM_LEFT];
+    plane_setf(&frust_proj[1], p->nx, 0.0f, p->nz, p->d);
 
     p = &frust_planes[CAM_FRUSTUM_NEAR];
     plane_setf(&frust_proj[2], p->nx, 0.0f, p->nz, p->d);
 
-    p = &frust_planes[CAM_FRUSTUM_FAR];
-    plane_setf(&frust_proj[3], p->nx, 0.0f, p->nz, p->d);
+    p = &frust_planes[CAM_FRUSTUM_FAR];
+    plane_setf(&frust_proj[3], p->nx, 0.0f, p->nz, p->d);
+}
+
+/*************************************************************************************************
+ * space partitioning (tree)
+ */
+result_t scene_tree_init(struct scn_tree* tree)
+{
+    memset(tree, 0x00, sizeof(struct scn_tree));
+    tree->root = SCN_TREE_NULL;
+    tree->free_node = SCN_TREE_NULL;
+    return RET_OK;
+}
+
+void scene_tree_release(struct scn_tree* tree)
+{
+    scene_tree_clear(tree);
+    if (tree->nodes != NULL)
+        ALIGNED_FREE(tree->nodes);
+    memset(tree, 0x00, sizeof(struct scn_tree));
+    tree->root = SCN_TREE_NULL;
+    tree->free_node = SCN_TREE_NULL;
+}
+
+void scene_tree_clear(struct scn_tree* tree)
+{
+    /* detach objects from leaves and put all nodes into free list */
+    for (int i = 0; i < tree->node_max; i++)  {
+        struct scn_tree_node* node = &tree->nodes[i];
+        if (node->height == 0 && node->obj != NULL) {
+            struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(node->obj->bounds_cmp);
+            b->tree_node = SCN_TREE_NULL;
+        }
+
+        node->obj = NULL;
+        node->height = -1;
+        node->parent = (i < tree->node_max - 1) ? (i + 1) : SCN_TREE_NULL;
+    }
+
+    tree->root = SCN_TREE_NULL;
+    tree->free_node = tree->node_max > 0 ? 0 : SCN_TREE_NULL;
+    tree->leaf_cnt = 0;
+}
+
+/* grows node buffer, so 'leaf_cnt' more leaves can be inserted without allocation
+ * a tree with n leaves uses 2n-1 nodes (leaves and their parents) */
+result_t scene_tree_reserve(struct scn_tree* tree, int leaf_cnt)
+{
+    int node_cnt = 2*(tree->leaf_cnt + leaf_cnt) - 1;
+    if (node_cnt <= tree->node_max)
+        return RET_OK;
+
+    int block_cnt = (node_cnt - tree->node_max + SCN_TREE_BLOCKSIZE - 1)/SCN_TREE_BLOCKSIZE;
+    int node_max = tree->node_max + block_cnt*SCN_TREE_BLOCKSIZE;
+    struct scn_tree_node* nodes = (struct scn_tree_node*)ALIGNED_ALLOC(
+        sizeof(struct scn_tree_node)*node_max, MID_SCN);
+    if (nodes == NULL)
+        return RET_OUTOFMEMORY;
+    if (tree->nodes != NULL)    {
+        memcpy(nodes, tree->nodes, sizeof(struct scn_tree_node)*tree->node_max);
+        ALIGNED_FREE(tree->nodes);
+    }
+
+    /* new nodes are put in front of the free list */
+    for (int i = tree->node_max; i < node_max; i++)   {
+        memset(&nodes[i], 0x00, sizeof(struct scn_tree_node));
+        nodes[i].height = -1;
+        nodes[i].parent = (i < node_max - 1) ? (i + 1) : tree->free_node;
+    }
+
+    tree->free_node = tree->node_max;
+    tree->nodes = nodes;
+    tree->node_max = node_max;
+    return RET_OK;
+}
+
+/* nodes must be reserved before (scene_tree_reserve) */
+int scene_tree_allocnode(struct scn_tree* tree)
+{
+    ASSERT(tree->free_node != SCN_TREE_NULL);
+    int idx = tree->free_node;
+    struct scn_tree_node* node = &tree->nodes[idx];
+    tree->free_node = node->parent;
+
+    node->obj = NULL;
+    node->parent = SCN_TREE_NULL;
+    node->child1 = SCN_TREE_NULL;
+    node->child2 = SCN_TREE_NULL;
+    node->height = 0;
+    return idx;
+}
+
+void scene_tree_freenode(struct scn_tree* tree, int idx)
+{
+    struct scn_tree_node* node = &tree->nodes[idx];
+    node->obj = NULL;
+    node->height = -1;
+    node->parent = tree->free_node;
+    tree->free_node = idx;
+}
+
+result_t scene_tree_insert(struct scn_tree* tree, cmphandle_t bounds_hdl)
+{
+    /* leaf and it's new parent */
+    if (IS_FAIL(scene_tree_reserve(tree, 1)))
+        return RET_OUTOFMEMORY;
+
+    int leaf = scene_tree_allocnode(tree);
+
+    struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
+    struct scn_tree_node* node = &tree->nodes[leaf];
+    node->obj = cmp_getinstancehost(bounds_hdl);
+    scene_tree_fatbounds(&node->bb, &b->ws_aabb);
+    ASSERT(node->obj);
+
+    b->tree_node = leaf;
+    tree->leaf_cnt ++;
+    scene_tree_insertleaf(tree, leaf);
+    return RET_OK;
+}
+
+void scene_tree_remove(struct scn_tree* tree, cmphandle_t bounds_hdl)
+{
+    struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
+    int leaf = b->tree_node;
+    if (leaf == SCN_TREE_NULL)
+        return;
+
+    scene_tree_removeleaf(tree, leaf);
+    scene_tree_freenode(tree, leaf);
+    b->tree_node = SCN_TREE_NULL;
+    tree->leaf_cnt --;
+}
+
+/* refit: leaf is only re-inserted if object bounds get out of it's fattened bounds */
+void scene_tree_move(struct scn_tree* tree, cmphandle_t bounds_hdl)
+{
+    struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
+    int leaf = b->tree_node;
+    if (leaf == SCN_TREE_NULL)
+        return;
+
+    if (scene_aabb_contains(&tree->nodes[leaf].bb, &b->ws_aabb))
+        return;
+
+    scene_tree_removeleaf(tree, leaf);
+    scene_tree_fatbounds(&tree->nodes[leaf].bb, &b->ws_aabb);
+    scene_tree_insertleaf(tree, leaf);
+}
+
+void scene_tree_insertleaf(struct scn_tree* tree, int leaf)
+{
+    struct scn_tree_node* nodes = tree->nodes;
+
+    if (tree->root == SCN_TREE_NULL)    {
+        tree->root = leaf;
+        nodes[leaf].parent = SCN_TREE_NULL;
+        return;
+    }
+
+    /* find the best sibling for the leaf, by the cost of enlarging parent bounds (SAH) */
+    struct aabb leaf_bb;
+    struct aabb bb;
+    aabb_setb(&leaf_bb, &nodes[leaf].bb);
+
+    int idx = tree->root;
+    while (nodes[idx].height > 0)   {
+        int child1 = nodes[idx].child1;
+        int child2 = nodes[idx].child2;
+
+        float area = scene_aabb_area(&nodes[idx].bb);
+        aabb_merge(&bb, &nodes[idx].bb, &leaf_bb);
+        float combined_area = scene_aabb_area(&bb);
+
+        /* cost of creating a new parent for this node and the new leaf */
+        float cost = 2.0f*combined_area;
+        /* minimum cost of pushing the leaf further down the tree */
+        float inherit_cost = 2.0f*(combined_area - area);
+
+        aabb_merge(&bb, &nodes[child1].bb, &leaf_bb);
+        float cost1 = scene_aabb_area(&bb) + inherit_cost;
+        if (nodes[child1].height > 0)
+            cost1 -= scene_aabb_area(&nodes[child1].bb);
+
+        aabb_merge(&bb, &nodes[child2].bb, &leaf_bb);
+        float cost2 = scene_aabb_area(&bb) + inherit_cost;
+        if (nodes[child2].height > 0)
+            cost2 -= scene_aabb_area(&nodes[child2].bb);
+
+        if (cost < cost1 && cost < cost2)
+            break;
+        idx = (cost1 < cost2) ? child1 : child2;
+    }
+
+    /* create a new parent for sibling and leaf (nodes buffer may be re-allocated) */
+    int sibling = idx;
+    int new_parent = scene_tree_allocnode(tree);
+    nodes = tree->nodes;
+    int old_parent = nodes[sibling].parent;
+
+    nodes[new_parent].parent = old_parent;
+    aabb_merge(&nodes[new_parent].bb, &leaf_bb, &nodes[sibling].bb);
+    nodes[new_parent].height = nodes[sibling].height + 1;
+    nodes[new_parent].child1 = sibling;
+    nodes[new_parent].child2 = leaf;
+    nodes[sibling].parent = new_parent;
+    nodes[leaf].parent = new_parent;
+
+    if (old_parent != SCN_TREE_NULL)    {
+        if (nodes[old_parent].child1 == sibling)
+            nodes[old_parent].child1 = new_parent;
+        else
+            nodes[old_parent].child2 = new_parent;
+    }   else    {
+        tree->root = new_parent;
+    }
+
+    /* walk back up and fix heights and bounds */
+    idx = nodes[leaf].parent;
+    while (idx != SCN_TREE_NULL)    {
+        idx = scene_tree_balance(tree, idx);
+        scene_tree_refitnode(nodes, idx);
+        idx = nodes[idx].parent;
+    }
+}
+
+void scene_tree_removeleaf(struct scn_tree* tree, int leaf)
+{
+    struct scn_tree_node* nodes = tree->nodes;
+
+    if (leaf == tree->root) {
+        tree->root = SCN_TREE_NULL;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grand_parent = nodes[parent].parent;
+    int sibling = (nodes[parent].child1 == leaf) ? nodes[parent].child2 : nodes[parent].child1;
+
+    if (grand_parent != SCN_TREE_NULL)  {
+        /* destroy parent and connect sibling to grand parent */
+        if (nodes[grand_parent].child1 == parent)
+            nodes[grand_parent].child1 = sibling;
+        else
+            nodes[grand_parent].child2 = sibling;
+        nodes[sibling].parent = grand_parent;
+        scene_tree_freenode(tree, parent);
+
+        int idx = grand_parent;
+        while (idx != SCN_TREE_NULL)    {
+            idx = scene_tree_balance(tree, idx);
+            scene_tree_refitnode(nodes, idx);
+            idx = nodes[idx].parent;
+        }
+    }   else    {
+        tree->root = sibling;
+        nodes[sibling].parent = SCN_TREE_NULL;
+        scene_tree_freenode(tree, parent);
+    }
+}
+
+/**
+ * performs a left or right rotation if node 'a' is imbalanced
+ * @return new root index of the sub-tree
+ */
+int scene_tree_balance(struct scn_tree* tree, int ia)
+{
+    struct scn_tree_node* nodes = tree->nodes;
+    struct scn_tree_node* a = &nodes[ia];
+    if (a->height < 2)
+        return ia;
+
+    int ib = a->child1;
+    int ic = a->child2;
+    struct scn_tree_node* b = &nodes[ib];
+    struct scn_tree_node* c = &nodes[ic];
+    int balance = c->height - b->height;
+
+    /* rotate c up */
+    if (balance > 1)    {
+        int i_f = c->child1;
+        int ig = c->child2;
+        struct scn_tree_node* f = &nodes[i_f];
+        struct scn_tree_node* g = &nodes[ig];
+
+        c->child1 = ia;
+        c->parent = a->parent;
+        a->parent = ic;
+
+        if (c->parent != SCN_TREE_NULL) {
+            if (nodes[c->parent].child1 == ia)
+                nodes[c->parent].child1 = ic;
+            else
+                nodes[c->parent].child2 = ic;
+        }   else    {
+            tree->root = ic;
+        }
+
+        if (f->height > g->height)  {
+            c->child2 = i_f;
+            a->child2 = ig;
+            g->parent = ia;
+        }   else    {
+            c->child2 = ig;
+            a->child2 = i_f;
+            f->parent = ia;
+        }
+
+        scene_tree_refitnode(nodes, ia);
+        scene_tree_refitnode(nodes, ic);
+        return ic;
+    }
+
+    /* rotate b up */
+    if (balance < -1)   {
+        int id = b->child1;
+        int ie = b->child2;
+        struct scn_tree_node* d = &nodes[id];
+        struct scn_tree_node* e = &nodes[ie];
+
+        b->child1 = ia;
+        b->parent = a->parent;
+        a->parent = ib;
+
+        if (b->parent != SCN_TREE_NULL) {
+            if (nodes[b->parent].child1 == ia)
+                nodes[b->parent].child1 = ib;
+            else
+                nodes[b->parent].child2 = ib;
+        }   else    {
+            tree->root = ib;
+        }
+
+        if (d->height > e->height)  {
+            b->child2 = id;
+            a->child1 = ie;
+            e->parent = ia;
+        }   else    {
+            b->child2 = ie;
+            a->child1 = id;
+            d->parent = ia;
+        }
+
+        scene_tree_refitnode(nodes, ia);
+        scene_tree_refitnode(nodes, ib);
+        return ib;
+    }
+
+    return ia;
+}
+
+/**
+ * @param objs (out) receives objects of the leaves that intersect the frustum
+ * @return number of unculled objects
+ */
+uint scene_culltree(const struct scn_tree* tree, OUT struct cmp_obj** objs,
+    const struct plane frust[6])
+{
+    if (tree->root == SCN_TREE_NULL)
+        return 0;
+
+    /* stack items: (node_idx << 1) | inside, inside nodes are added without testing planes */
+    int stack[SCN_TREE_STACK_MAX];
+    int stack_cnt = 0;
+    uint c = 0;
+    const struct scn_tree_node* nodes = tree->nodes;
+
+    stack[stack_cnt++] = tree->root << 1;
+    while (stack_cnt > 0)   {
+        int item = stack[--stack_cnt];
+        int idx = item >> 1;
+        int inside = item & 0x1;
+        const struct scn_tree_node* node = &nodes[idx];
+
+        if (!inside)    {
+            int r = scene_test_aabb_frustum(&node->bb, frust);
+            if (r < 0)
+                continue;
+            inside = r;
+        }
+
+        if (node->height == 0)  {
+            objs[c++] = node->obj;
+        }   else    {
+            ASSERT(stack_cnt + 2 <= SCN_TREE_STACK_MAX);
+            stack[stack_cnt++] = (node->child1 << 1) | inside;
+            stack[stack_cnt++] = (node->child2 << 1) | inside;
+        }
+    }
+
+    return c;
+}
+
+uint scene_culltree_sphere(const struct scn_tree* tree, OUT struct cmp_obj** objs,
+    const struct sphere* sphere)
+{
+    if (tree->root == SCN_TREE_NULL)
+        return 0;
+
+    int stack[SCN_TREE_STACK_MAX];
+    int stack_cnt = 0;
+    uint c = 0;
+    const struct scn_tree_node* nodes = tree->nodes;
+
+    stack[stack_cnt++] = tree->root;
+    while (stack_cnt > 0)   {
+        const struct scn_tree_node* node = &nodes[stack[--stack_cnt]];
+        if (!scene_test_aabb_sphere(&node->bb, sphere))
+            continue;
+
+        if (node->height == 0)  {
+            objs[c++] = node->obj;
+        }   else    {
+            ASSERT(stack_cnt + 2 <= SCN_TREE_STACK_MAX);
+            stack[stack_cnt++] = node->child1;
+            stack[stack_cnt++] = node->child2;
+        }
+    }
+
+    return c;
+}
+
+/* same as scene_gather_models_csm, but only collects objects in tree nodes that pass sweep test */
+void scene_gather_models_csm_tree(struct scn_data* s, struct array* objs,
+    const struct aabb* frust_bounds, const struct vec3f* dir_norm)
+{
+    const struct scn_tree* tree = &s->tree;
+    const struct scn_tree_node* nodes = tree->nodes;
+    struct vec3f fmin;
+    struct vec3f fmax;
+    struct vec3f d;
+
+    vec3_setv(&fmin, &frust_bounds->minpt);
+    vec3_setv(&fmax, &frust_bounds->maxpt);
+    vec3_setv(&d, dir_norm);
+
+    int stack[SCN_TREE_STACK_MAX];
+    int stack_cnt = 0;
+    if (tree->root != SCN_TREE_NULL)
+        stack[stack_cnt++] = tree->root;
+
+    while (stack_cnt > 0)   {
+        const struct scn_tree_node* node = &nodes[stack[--stack_cnt]];
+        if (!scene_test_aabb_sweep(&fmin, &fmax, &d, &node->bb))
+            continue;
+
+        if (node->height > 0)   {
+            ASSERT(stack_cnt + 2 <= SCN_TREE_STACK_MAX);
+            stack[stack_cnt++] = node->child1;
+            stack[stack_cnt++] = node->child2;
+            continue;
+        }
+
+        struct cmp_obj* obj = node->obj;
+        if (obj->model_cmp != INVALID_HANDLE) {
+            struct cmp_model* m = (struct cmp_model*)cmp_getinstancedata(obj->model_cmp);
+            if (!m->exclude_shadows)    {
+                struct cmp_obj** pobj = (struct cmp_obj**)arr_add(objs);
+                ASSERT(pobj);
+                *pobj = obj;
+            }
+        }
+    }
+
+    /* globals */
+    struct cmp_obj** global_objs = (struct cmp_obj**)g_scn_mgr.global_objs.buffer;
+    for (uint i = 0, cnt = g_scn_mgr.global_objs.item_cnt; i < cnt; i++)  {
+        struct cmp_obj* obj = global_objs[i];
+        if (obj->model_cmp != INVALID_HANDLE)   {
+            struct cmp_model* m = (struct cmp_model*)cmp_getinstancedata(obj->model_cmp);
+            if (!m->exclude_shadows)    {
+                struct cmp_obj** pobj = (struct cmp_obj**)arr_add(objs);
+                ASSERT(pobj);
+                *pobj = obj;
+            }
+        }
+    }
+}
+
+/*************************************************************************************************
+ * space partitioning (sparse hash grid)
+ */
+result_t scene_hashgrid_init(struct scn_hashgrid* hgrid, float cell_size)
+{
+    result_t r;
+    memset(hgrid, 0x00, sizeof(struct scn_hashgrid));
+    hgrid->cell_size = cell_size;
+    hgrid->cull_id = 1; /* new cells start with zero, so they are not visible until next cull */
+
+    r = arr_create(mem_heap(), &hgrid->cells, sizeof(struct scn_hashgrid_cell),
+        SCN_GRID_BLOCKSIZE, SCN_GRID_BLOCKSIZE, MID_SCN);
+    r |= hashtable_chained_create(mem_heap(), mem_heap(), &hgrid->cell_table,
+        SCN_HASHGRID_SLOTCNT, MID_SCN);
+    r |= scene_cellalloc_init(&hgrid->item_alloc);
+    if (IS_FAIL(r)) {
+        scene_hashgrid_release(hgrid);
+        return RET_OUTOFMEMORY;
+    }
+
+    return RET_OK;
+}
+
+void scene_hashgrid_release(struct scn_hashgrid* hgrid)
+{
+    /* hash grid is only initialized while scene is in SCN_SPATIAL_HASHGRID mode */
+    if (hgrid->cell_size == 0.0f)
+        return;
+
+    scene_hashgrid_clear(hgrid);
+    scene_cellalloc_release(&hgrid->item_alloc);
+    hashtable_chained_destroy(&hgrid->cell_table);
+    arr_destroy(&hgrid->cells);
+    memset(hgrid, 0x00, sizeof(struct scn_hashgrid));
+}
+
+void scene_hashgrid_clear(struct scn_hashgrid* hgrid)
+{
+    struct scn_hashgrid_cell* cells = (struct scn_hashgrid_cell*)hgrid->cells.buffer;
+    for (uint i = 0, cnt = hgrid->cells.item_cnt; i < cnt; i++) {
+        struct scn_cell_items* items = &cells[i].items;
+        for (uint k = 0; k < items->cnt; k++)
+            scene_cellrange_reset((struct cmp_bounds*)cmp_getinstancedata(items->objs[k]->bounds_cmp));
+        scene_cellitems_free(&hgrid->item_alloc, items);
+    }
+
+    arr_clear(&hgrid->cells);
+    hashtable_chained_clear(&hgrid->cell_table);
+}
+
+struct scn_hashgrid_cell* scene_hashgrid_findcell(const struct scn_hashgrid* hgrid, uint key)
+{
+    struct hashtable_item_chained* item = hashtable_chained_find(&hgrid->cell_table, key);
+    if (item == NULL)
+        return NULL;
+    return &((struct scn_hashgrid_cell*)hgrid->cells.buffer)[(uint)item->value];
+}
+
+/* removes empty cell, last cell is moved into it's place to keep the cell array packed */
+void scene_hashgrid_removecell(struct scn_hashgrid* hgrid, uint key)
+{
+    struct hashtable_item_chained* item = hashtable_chained_find(&hgrid->cell_table, key);
+    ASSERT(item);
+    uint idx = (uint)item->value;
+    hashtable_chained_remove(&hgrid->cell_table, item);
+
+    struct scn_hashgrid_cell* cells = (struct scn_hashgrid_cell*)hgrid->cells.buffer;
+    uint last_idx = hgrid->cells.item_cnt - 1;
+    if (idx != last_idx)    {
+        memcpy(&cells[idx], &cells[last_idx], sizeof(struct scn_hashgrid_cell));
+        item = hashtable_chained_find(&hgrid->cell_table,
+            scene_hashgrid_key(cells[idx].x, cells[idx].z));
+        ASSERT(item);
+        item->value = idx;
+    }
+    hgrid->cells.item_cnt --;
+}
+
+void scene_hashgrid_push(struct scn_hashgrid* hgrid, cmphandle_t bounds_hdl)
+{
+    struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
+    struct cmp_obj* obj = cmp_getinstancehost(bounds_hdl);
+    ASSERT(obj);
+
+    int range[4];
+    scene_hashgrid_cellrange(hgrid, b, range);
+
+    for (int z = range[1]; z <= range[3]; z++)  {
+        for (int x = range[0]; x <= range[2]; x++)  {
+            uint key = scene_hashgrid_key(x, z);
+            struct scn_hashgrid_cell* cell = scene_hashgrid_findcell(hgrid, key);
+
+            /* create new cell if it's not occupied yet */
+            if (cell == NULL)   {
+                uint idx = hgrid->cells.item_cnt;
+                cell = (struct scn_hashgrid_cell*)arr_add(&hgrid->cells);
+                ASSERT(cell);
+                memset(cell, 0x00, sizeof(struct scn_hashgrid_cell));
+                cell->x = x;
+                cell->z = z;
+                hashtable_chained_add(&hgrid->cell_table, key, idx);
+            }
+
+            scene_cellitems_add(&hgrid->item_alloc, &cell->items, obj);
+        }
+    }
+
+    memcpy(b->cell_range, range, sizeof(range));
+}
+
+void scene_hashgrid_pull(struct scn_hashgrid* hgrid, cmphandle_t bounds_hdl)
+{
+    struct cmp_bounds* b = (struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
+    struct cmp_obj* obj = cmp_getinstancehost(bounds_hdl);
+
+    for (int z = b->cell_range[1]; z <= b->cell_range[3]; z++)    {
+        for (int x = b->cell_range[0]; x <= b->cell_range[2]; x++)    {
+            uint key = scene_hashgrid_key(x, z);
+            struct scn_hashgrid_cell* cell = scene_hashgrid_findcell(hgrid, key);
+            ASSERT(cell);
+
+            scene_cellitems_remove(&hgrid->item_alloc, &cell->items, obj);
+            if (cell->items.cnt == 0)
+                scene_hashgrid_removecell(hgrid, key);
+        }
+    }
+
+    scene_cellrange_reset(b);
+}
+
+/**
+ * Calculates bounding rectangle of the frustum on XZ plane, by intersecting it's planes
+ * @return FALSE if frustum corners can not be calculated (degenerate planes)
+ */
+int scene_calc_frustum_rectxz(OUT float rmin[2], OUT float rmax[2], const struct plane frust[6])
+{
+    static const uint corner_planes[8][3] = {
+        {CAM_FRUSTUM_NEAR, CAM_FRUSTUM_LEFT, CAM_FRUSTUM_TOP},
+        {CAM_FRUSTUM_NEAR, CAM_FRUSTUM_LEFT, CAM_FRUSTUM_BOTTOM},
+        {CAM_FRUSTUM_NEAR, CAM_FRUSTUM_RIGHT, CAM_FRUSTUM_TOP},
+        {CAM_FRUSTUM_NEAR, CAM_FRUSTUM_RIGHT, CAM_FRUSTUM_BOTTOM},
+        {CAM_FRUSTUM_FAR, CAM_FRUSTUM_LEFT, CAM_FRUSTUM_TOP},
+        {CAM_FRUSTUM_FAR, CAM_FRUSTUM_LEFT, CAM_FRUSTUM_BOTTOM},
+        {CAM_FRUSTUM_FAR, CAM_FRUSTUM_RIGHT, CAM_FRUSTUM_TOP},
+        {CAM_FRUSTUM_FAR, CAM_FRUSTUM_RIGHT, CAM_FRUSTUM_BOTTOM}
+    };
+
+    rmin[0] = rmin[1] = FL32_MAX;
+    rmax[0] = rmax[1] = -FL32_MAX;
+
+    for (uint i = 0; i < 8; i++)  {
+        const struct plane* a = &frust[corner_planes[i][0]];
+        const struct plane* b = &frust[corner_planes[i][1]];
+        const struct plane* c = &frust[corner_planes[i][2]];
+
+        /* p = -(da*(b x c) + db*(c x a) + dc*(a x b)) / (a . (b x c)) */
+        float bc_x = b->ny*c->nz - b->nz*c->ny;
+        float bc_y = b->nz*c->nx - b->nx*c->nz;
+        float bc_z = b->nx*c->ny - b->ny*c->nx;
+        float denom = a->nx*bc_x + a->ny*bc_y + a->nz*bc_z;
+        if (math_iszero(denom))
+            return FALSE;
+
+        float ca_x = c->ny*a->nz - c->nz*a->ny;
+        float ca_z = c->nx*a->ny - c->ny*a->nx;
+        float ab_x = a->ny*b->nz - a->nz*b->ny;
+        float ab_z = a->nx*b->ny - a->ny*b->nx;
+
+        float inv = -1.0f/denom;
+        float x = (a->d*bc_x + b->d*ca_x + c->d*ab_x)*inv;
+        float z = (a->d*bc_z + b->d*ca_z + c->d*ab_z)*inv;
+
+        rmin[0] = minf(rmin[0], x);
+        rmin[1] = minf(rmin[1], z);
+        rmax[0] = maxf(rmax[0], x);
+        rmax[1] = maxf(rmax[1], z);
+    }
+
+    return TRUE;
+}
+
+/**
+ * cull occupied cells with frustum, cells are either looked up within the frustum bounds on XZ
+ * plane, or iterated directly, whichever is less, so the cost stays bound to occupied cells in view
+ * @return number of unculled objects
+ */
+uint scene_cullhashgrid(struct scn_hashgrid* hgrid, OUT struct cmp_obj** objs,
+    const struct plane frust[6])
+{
+    struct plane frust2d[4];
+    scene_calc_frustum_projxz(frust2d, frust);
+
+    uint cell_cnt = hgrid->cells.item_cnt;
+    if (cell_cnt == 0)
+        return 0;
+
+    uint cull_id = ++hgrid->cull_id;
+    struct scn_hashgrid_cell* cells = (struct scn_hashgrid_cell*)hgrid->cells.buffer;
+    float cs = hgrid->cell_size;
+    uint c = 0;
+
+    /* choose between frustum rectangle lookup or occupied cells iteration */
+    float rmin[2], rmax[2];
+    int x_min = 0, x_max = -1, z_min = 0, z_max = -1;
+    int lookup = FALSE;
+    if (scene_calc_frustum_rectxz(rmin, rmax, frust))   {
+        x_min = scene_hashgrid_coord(rmin[0], cs);
+        x_max = scene_hashgrid_coord(rmax[0], cs);
+        z_min = scene_hashgrid_coord(rmin[1], cs);
+        z_max = scene_hashgrid_coord(rmax[1], cs);
+        lookup = ((uint64)(x_max - x_min + 1) * (uint64)(z_max - z_min + 1)) < (uint64)cell_cnt;
+    }
+
+    struct scn_hashgrid_cell* cell;
+    uint i = 0;
+    int x = x_min, z = z_min;
+    while (TRUE)    {
+        /* fetch next cell */
+        if (lookup) {
+            if (z > z_max)
+                break;
+            cell = scene_hashgrid_findcell(hgrid, scene_hashgrid_key(x, z));
+            if (++x > x_max)   {
+                x = x_min;
+                z ++;
+            }
+            if (cell == NULL)
+                continue;
+        }   else    {
+            if (i == cell_cnt)
+                break;
+            cell = &cells[i++];
+        }
+
+        float cx = (float)cell->x*cs;
+        float cz = (float)cell->z*cs;
+        if (!scene_test_rect_frustumxz(cx, cz, cx + cs, cz + cs, frust2d))
+            continue;
+
+        cell->cull_id = cull_id;
+
+        /* intersect/inside: add to unculled objects, set spatial flag for object */
+        const struct scn_cell_items* items = &cell->items;
+        for (uint k = 0; k < items->cnt; k++)  {
+            struct cmp_obj* obj = items->objs[k];
+            if (!BIT_CHECK(obj->flags, CMP_OBJFLAG_SPATIALVISIBLE))   {
+                objs[c++] = obj;
+                BIT_ADD(obj->flags, CMP_OBJFLAG_SPATIALVISIBLE);
+            }
+        }
+    }
+
+    return c;
+}
+
+/* cull with cells that are visible in the last frustum cull (scene_cullhashgrid) only */
+uint scene_cullhashgrid_sphere(const struct scn_hashgrid* hgrid, OUT struct cmp_obj** objs,
+    const struct sphere* sphere)
+{
+    float cs = hgrid->cell_size;
+    int x_min = scene_hashgrid_coord(sphere->x - sphere->r, cs);
+    int x_max = scene_hashgrid_coord(sphere->x + sphere->r, cs);
+    int z_min = scene_hashgrid_coord(sphere->z - sphere->r, cs);
+    int z_max = scene_hashgrid_coord(sphere->z + sphere->r, cs);
+
+    uint cell_cnt = hgrid->cells.item_cnt;
+    const struct scn_hashgrid_cell* cells = (const struct scn_hashgrid_cell*)hgrid->cells.buffer;
+    int lookup = ((uint64)(x_max - x_min + 1) * (uint64)(z_max - z_min + 1)) < (uint64)cell_cnt;
+
+    const struct scn_hashgrid_cell* cell;
+    uint obj_cnt = 0;
+    uint i = 0;
+    int x = x_min, z = z_min;
+    while (TRUE)    {
+        /* fetch next cell, same as scene_cullhashgrid */
+        if (lookup) {
+            if (z > z_max)
+                break;
+            cell = scene_hashgrid_findcell(hgrid, scene_hashgrid_key(x, z));
+            if (++x > x_max)   {
+                x = x_min;
+                z ++;
+            }
+            if (cell == NULL)
+                continue;
+        }   else    {
+            if (i == cell_cnt)
+                break;
+            cell = &cells[i++];
+            if (cell->x < x_min || cell->x > x_max || cell->z < z_min || cell->z > z_max)
+                continue;
+        }
+
+        if (cell->cull_id != hgrid->cull_id)
+            continue;
+
+        const struct scn_cell_items* items = &cell->items;
+        for (uint k = 0; k < items->cnt; k++)  {
+            struct cmp_obj* obj = items->objs[k];
+
+            /* search in existing objects for duplicates */
+            for (uint j = 0; j < obj_cnt; j++)    {
+                if (obj == objs[j])
+                    goto skip_obj;
+            }
+            objs[obj_cnt++] = obj;
+skip_obj:
+            ;
+        }
+    }
+
+    return obj_cnt;
+}
+
+/*************************************************************************************************
+ * multi-view culling (scn_create_queries)
+ */
+void scene_prepare_views(OUT struct scn_view_cull* vcs, const struct scn_view* views,
+    uint view_cnt)
+{
+    for (uint v = 0; v < view_cnt; v++)   {
+        const struct scn_view* view = &views[v];
+        struct scn_view_cull* vc = &vcs[v];
+        memset(vc, 0x00, sizeof(struct scn_view_cull));
+
+        switch (view->type) {
+        case SCN_VIEW_FRUSTUM:
+            scene_calc_frustum_projxz(vc->frust2d, view->planes);
+            break;
+        case SCN_VIEW_SWEEP:
+            vec3_setv(&vc->fmin, &view->bounds.minpt);
+            vec3_setv(&vc->fmax, &view->bounds.maxpt);
+            vec3_setv(&vc->d, &view->dir);
+            break;
+        case SCN_VIEW_SPHERE:
+            vc->rmin[0] = view->sphere.x - view->sphere.r;
+            vc->rmin[1] = view->sphere.z - view->sphere.r;
+            vc->rmax[0] = view->sphere.x + view->sphere.r;
+            vc->rmax[1] = view->sphere.z + view->sphere.r;
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+/**
+ * traverses the spatial structure once for all views, each cell/node is fetched once and tested
+ * with the views that are still intersecting its parent
+ * @param masks (in/out) zeroed array of view masks, indexed by object id, receives views of objects
+ * @param objs (out) unculled objects of all views, each object is added once
+ * @return number of unculled objects
+ */
+uint scene_cullviews(struct scn_data* s, const struct scn_view* views,
+    const struct scn_view_cull* vcs, uint view_cnt, INOUT uint* masks, OUT struct cmp_obj** objs)
+{
+    uint all_mask = 0;
+    uint frust_mask = 0;
+    for (uint v = 0; v < view_cnt; v++)   {
+        all_mask |= 1u << v;
+        if (views[v].type == SCN_VIEW_FRUSTUM)
+            frust_mask |= 1u << v;
+    }
+
+    uint c = 0;
+    switch (s->spatial_type)    {
+    case SCN_SPATIAL_TREE:
+    {
+        const struct scn_tree* tree = &s->tree;
+        const struct scn_tree_node* nodes = tree->nodes;
+        int stack[SCN_TREE_STACK_MAX];
+        uint stack_masks[SCN_TREE_STACK_MAX];
+        int stack_cnt = 0;
+
+        if (tree->root != SCN_TREE_NULL)    {
+            stack_masks[stack_cnt] = all_mask;
+            stack[stack_cnt++] = tree->root;
+        }
+
+        while (stack_cnt > 0)   {
+            stack_cnt --;
+            const struct scn_tree_node* node = &nodes[stack[stack_cnt]];
+            uint mask = scene_viewmask_aabb(views, vcs, view_cnt, stack_masks[stack_cnt],
+                &node->bb);
+            if (mask == 0)
+                continue;
+
+            if (node->height == 0)  {
+                c = scene_cullviews_addobj(masks, objs, c, node->obj, mask);
+            }   else    {
+                ASSERT(stack_cnt + 2 <= SCN_TREE_STACK_MAX);
+                stack_masks[stack_cnt] = mask;
+                stack[stack_cnt++] = node->child1;
+                stack_masks[stack_cnt] = mask;
+                stack[stack_cnt++] = node->child2;
+            }
+        }
+        break;
+    }
+
+    case SCN_SPATIAL_HASHGRID:
+    {
+        /* occupied cells are iterated directly, views may be scattered in the world */
+        struct scn_hashgrid* hgrid = &s->hgrid;
+        struct scn_hashgrid_cell* cells = (struct scn_hashgrid_cell*)hgrid->cells.buffer;
+        float cs = hgrid->cell_size;
+        uint cull_id = frust_mask ? ++hgrid->cull_id : 0;
+
+        for (uint i = 0, cnt = hgrid->cells.item_cnt; i < cnt; i++)   {
+            struct scn_hashgrid_cell* cell = &cells[i];
+            float cx = (float)cell->x*cs;
+            float cz = (float)cell->z*cs;
+            uint mask = scene_viewmask_rect(views, vcs, view_cnt, all_mask, cx, cz, cx + cs,
+                cz + cs);
+            if (mask & frust_mask)
+                cell->cull_id = cull_id;
+            if (mask == 0)
+                continue;
+
+            const struct scn_cell_items* items = &cell->items;
+            for (uint k = 0; k < items->cnt; k++)
+                c = scene_cullviews_addobj(masks, objs, c, items->objs[k], mask);
+        }
+        break;
+    }
+
+    default:
+    {
+        /* visible cells of frustum views are kept for sphere queries (scene_cullgrid_sphere) */
+        struct scn_grid* grid = &s->grid;
+        for (uint i = 0, cnt = grid->cell_cnt; i < cnt; i++)  {
+            uint mask = scene_viewmask_rect(views, vcs, view_cnt, all_mask,
+                grid->cells_xmin[i], grid->cells_zmin[i], grid->cells_xmax[i],
+                grid->cells_zmax[i]);
+            if (frust_mask)
+                grid->vis_cells[i] = (mask & frust_mask) != 0;
+            if (mask == 0)
+                continue;
+
+            const struct scn_cell_items* items = &grid->items[i];
+            for (uint k = 0; k < items->cnt; k++)
+                c = scene_cullviews_addobj(masks, objs, c, items->objs[k], mask);
+        }
+        break;
+    }
+    }
+
+    return c;
+}
+
+/* apply queued spatial updates (scn_update_spatial) to the scene's spatial structure
+ * queued objects are tested in parallel, only the ones that leave their cells (or fat tree leaf)
+ * are moved in the spatial structure, which is serial */
+void scene_update_spatial(struct scn_data* s, uint thread_id)
+{
+    uint cnt = s->spatial_updates.item_cnt;
+    if (cnt == 0)
+        return;
+
+    const cmphandle_t* updates = (const cmphandle_t*)s->spatial_updates.buffer;
+    struct allocator* tmp_alloc = tsk_get_tmpalloc(thread_id);
+    A_SAVE(tmp_alloc);
+
+    /* if temp memory runs out, objects are tested serially in the loop below */
+    uint8* results = (uint8*)A_ALLOC(tmp_alloc, sizeof(uint8)*cnt, MID_SCN);
+    if (results != NULL)    {
+        struct scn_spatial_job job;
+        job.s = s;
+        job.updates = updates;
+        job.results = results;
+        fgr_parallel_for(scene_update_spatial_range, cnt, SCN_SPATIAL_BATCH, &job, thread_id);
+    }
+
+    for (uint i = 0; i < cnt; i++)  {
+        cmphandle_t hdl = updates[i];
+        struct cmp_obj* obj = cmp_getinstancehost(hdl);
+        uint r = results != NULL ? results[i] : scene_test_spatial(s, hdl);
+        BIT_REMOVE(obj->tmp_flags, CMP_OBJFLAG_SPATIALUPDATE);
+
+        if (BIT_CHECK(r, SCN_SPATIAL_OCCLUDER))
+            g_scn_mgr.viscache.reset = TRUE;
+        if (!BIT_CHECK(r, SCN_SPATIAL_MOVE))
+            continue;
+
+        switch (s->spatial_type)    {
+        case SCN_SPATIAL_TREE:
+            scene_tree_move(&s->tree, hdl);
+            break;
+        case SCN_SPATIAL_HASHGRID:
+            scene_hashgrid_pull(&s->hgrid, hdl);
+            scene_hashgrid_push(&s->hgrid, hdl);
+            break;
+        default:
+            scene_grid_pullsingle(&s->grid, hdl);
+            scene_grid_pushsingle(&s->grid, hdl);
+            break;
+        }
+    }
+
+    A_LOAD(tmp_alloc);
+    arr_clear(&s->spatial_updates);
+}
+
+/* Runs in main thread and task threads */
+void scene_update_spatial_range(uint start, uint end, uint thread_id, void* param)
+{
+    struct scn_spatial_job* job = (struct scn_spatial_job*)param;
+    for (uint i = start; i < end; i++)
+        job->results[i] = (uint8)scene_test_spatial(job->s, job->updates[i]);
+}
+
+/* tests a queued object against it's current place in the spatial structure, read-only (except
+ * object's cached occlusion result) so it can be run in parallel
+ * tree leafs are only changed by their own move, and updates are unique, so testing all objects
+ * before moving any of them is valid
+ * @return combination of SCN_SPATIAL_xxx */
+uint scene_test_spatial(const struct scn_data* s, cmphandle_t bounds_hdl)
+{
+    const struct cmp_bounds* b = (const struct cmp_bounds*)cmp_getinstancedata(bounds_hdl);
+    struct cmp_obj* obj = cmp_getinstancehost(bounds_hdl);
+
+    /* moved objects are retested for occlusion */
+    uint r = scene_viscache_invalidate(obj) ? SCN_SPATIAL_OCCLUDER : 0;
+
+    int range[4];
+    switch (s->spatial_type)    {
+    case SCN_SPATIAL_TREE:
+        if (b->tree_node != SCN_TREE_NULL &&
+            !scene_aabb_contains(&s->tree.nodes[b->tree_node].bb, &b->ws_aabb))
+        {
+            r |= SCN_SPATIAL_MOVE;
+        }
+        break;
+    case SCN_SPATIAL_HASHGRID:
+        scene_hashgrid_cellrange(&s->hgrid, b, range);
+        if (!scene_cellrange_isequal(range, b->cell_range))
+            r |= SCN_SPATIAL_MOVE;
+        break;
+    default:
+        scene_grid_cellrange(&s->grid, b, range);
+        if (!scene_cellrange_isequal(range, b->cell_range))
+            r |= SCN_SPATIAL_MOVE;
+        break;
+    }
+
+    return r;
+}
+
+/* drop queued spatial updates without applying them */
+void scene_clear_spatial(struct scn_data* s)
+{
+    const cmphandle_t* updates = (const cmphandle_t*)s->spatial_updates.buffer;
+    for (uint i = 0, cnt = s->spatial_updates.item_cnt; i < cnt; i++)
+        BIT_REMOVE(cmp_getinstancehost(updates[i])->tmp_flags, CMP_OBJFLAG_SPATIALUPDATE);
+    arr_clear(&s->spatial_updates);
+}
+
+void scn_run_probes(uint scene_id, const struct scn_probe* probes, uint probe_cnt,
+    uint max_hits, OUT struct scn_probe_hit* hits, OUT uint* hit_cnts, uint thread_id)
+{
+    ASSERT(scene_id != SCENE_GLOBAL);
+    if (probe_cnt == 0)
+        return;
+
+    /* there is no room to report hits, nothing to test */
+    if (max_hits == 0)  {
+        memset(hit_cnts, 0x00, sizeof(uint)*probe_cnt);
+        return;
+    }
+
+    struct scn_data* s = scene_get(scene_id);
+
+    /* probes must see objects at their current place, but this is no-op after spatial stage */
+    if (thread_id == 0)
+        scene_update_spatial(s, 0);
+
+    struct scn_probe_job job;
+    job.s = s;
+    job.probes = probes;
+    job.max_hits = max_hits;
+    job.hits = hits;
+    job.hit_cnts = hit_cnts;
+    fgr_parallel_for(scene_run_probes_range, probe_cnt, SCN_PROBE_BATCH, &job, thread_id);
+}
+
+/* Runs in main thread and task threads */
+void scene_run_probes_range(uint start, uint end, uint thread_id, void* param)
+{
+    struct scn_probe_job* job = (struct scn_probe_job*)param;
+    for (uint i = start; i < end; i++)  {
+        job->hit_cnts[i] = scene_run_probe(job->s, &job->probes[i], job->max_hits,
+            &job->hits[i*job->max_hits]);
+    }
+}
+
+/* read-only traversal of the spatial structure, so probes can run in parallel
+ * objects that span multiple cells are only tested in the first cell that is shared by the probe
+ * range and object's cell range, which dismisses duplicates without writing object flags */
+uint scene_run_probe(const struct scn_data* s, const struct scn_probe* p, uint max_hits,
+    OUT struct scn_probe_hit* hits)
+{
+    struct aabb bb;
+    int range[4];
+    uint hit_cnt = 0;
+
+    scene_probe_bounds(&bb, p);
+
+    switch (s->spatial_type)    {
+    case SCN_SPATIAL_TREE:
+    {
+        const struct scn_tree* tree = &s->tree;
+        const struct scn_tree_node* nodes = tree->nodes;
+        int stack[SCN_TREE_STACK_MAX];
+        int stack_cnt = 0;
+        if (tree->root != SCN_TREE_NULL)
+            stack[stack_cnt++] = tree->root;
+
+        while (stack_cnt > 0)   {
+            const struct scn_tree_node* node = &nodes[stack[--stack_cnt]];
+            if (!scene_aabb_overlaps(&node->bb, &bb))
+                continue;
+            if (p->type == SCN_PROBE_RAY &&
+                !scene_test_aabb_ray(&node->bb, &p->pt, &p->dir, p->len))
+            {
+                continue;
+            }
+
+            if (node->height == 0)  {
+                hit_cnt = scene_probe_obj(p, node->obj,
+                    (const struct cmp_bounds*)cmp_getinstancedata(node->obj->bounds_cmp),
+                    max_hits, hits, hit_cnt);
+            }   else    {
+                ASSERT(stack_cnt + 2 <= SCN_TREE_STACK_MAX);
+                stack[stack_cnt++] = node->child1;
+                stack[stack_cnt++] = node->child2;
+            }
+        }
+        break;
+    }
+
+    case SCN_SPATIAL_HASHGRID:
+    {
+        const struct scn_hashgrid* hgrid = &s->hgrid;
+        float cs = hgrid->cell_size;
+        range[0] = scene_hashgrid_coord(bb.minpt.x, cs);
+        range[1] = scene_hashgrid_coord(bb.minpt.z, cs);
+        range[2] = scene_hashgrid_coord(bb.maxpt.x, cs);
+        range[3] = scene_hashgrid_coord(bb.maxpt.z, cs);
+
+        /* large probes walk occupied cells instead of looking up every cell in range */
+        uint64 range_cnt = (uint64)(range[2] - range[0] + 1)*(uint64)(range[3] - range[1] + 1);
+        if (range_cnt > (uint64)hgrid->cells.item_cnt)    {
+            const struct scn_hashgrid_cell* cells =
+                (const struct scn_hashgrid_cell*)hgrid->cells.buffer;
+            for (uint i = 0, cnt = hgrid->cells.item_cnt; i < cnt; i++)   {
+                const struct scn_hashgrid_cell* cell = &cells[i];
+                if (cell->x < range[0] || cell->x > range[2] || cell->z < range[1] ||
+                    cell->z > range[3])
+                {
+                    continue;
+                }
+                hit_cnt = scene_probe_items(p, &cell->items, cell->x, cell->z, range, max_hits,
+                    hits, hit_cnt);
+            }
+        }   else    {
+            for (int z = range[1]; z <= range[3]; z++)    {
+                for (int x = range[0]; x <= range[2]; x++)    {
+                    const struct scn_hashgrid_cell* cell =
+                        scene_hashgrid_findcell(hgrid, scene_hashgrid_key(x, z));
+                    if (cell != NULL)   {
+                        hit_cnt = scene_probe_items(p, &cell->items, x, z, range, max_hits,
+                            hits, hit_cnt);
+                    }
+                }
+            }
+        }
+        break;
+    }
+
+    default:
+    {
+        const struct scn_grid* grid = &s->grid;
+        if (grid->cell_cnt == 0 || bb.minpt.x > grid->x_max || bb.maxpt.x < grid->x_min ||
+            bb.minpt.z > grid->z_max || bb.maxpt.z < grid->z_min)
+        {
+            break;
+        }
+
+        float cs = grid->cell_size;
+        range[0] = clampi((int)floorf((bb.minpt.x - grid->x_min)/cs), 0, (int)grid->col_cnt - 1);
+        range[1] = clampi((int)floorf((bb.minpt.z - grid->z_min)/cs), 0, (int)grid->row_cnt - 1);
+        range[2] = clampi((int)floorf((bb.maxpt.x - grid->x_min)/cs), 0, (int)grid->col_cnt - 1);
+        range[3] = clampi((int)floorf((bb.maxpt.z - grid->z_min)/cs), 0, (int)grid->row_cnt - 1);
+        for (int row = range[1]; row <= range[3]; row++)  {
+            for (int col = range[0]; col <= range[2]; col++)  {
+                hit_cnt = scene_probe_items(p, &grid->items[col + row*grid->col_cnt], col, row,
+                    range, max_hits, hits, hit_cnt);
+            }
+        }
+        break;
+    }
+    }
+
+    return hit_cnt;
+}
+
+/* tests objects of a grid/hash-grid cell against a probe, range is the cell range of the probe */
+uint scene_probe_items(const struct scn_probe* p, const struct scn_cell_items* items,
+    int cell_x, int cell_z, const int range[4], uint max_hits, INOUT struct scn_probe_hit* hits,
+    uint hit_cnt)
+{
+    for (uint i = 0; i < items->cnt; i++)   {
+        const struct cmp_obj* obj = items->objs[i];
+        const struct cmp_bounds* b = (const struct cmp_bounds*)cmp_getinstancedata(obj->bounds_cmp);
+
+        /* first cell of the object in probe range, other cells have the same object */
+        if (maxi(b->cell_range[0], range[0]) != cell_x ||
+            maxi(b->cell_range[1], range[1]) != cell_z)
+        {
+            continue;
+        }
+
+        hit_cnt = scene_probe_obj(p, obj, b, max_hits, hits, hit_cnt);
+    }
+    return hit_cnt;
+}
+
+uint scene_count_bounds(const struct scn_data* s)
+{
+    uint bcnt = 0;
+    const struct cmp_obj** objs = (const struct cmp_obj**)s->objs.buffer;
+    for (uint i = 0, cnt = s->objs.item_cnt; i < cnt; i++)  {
+        if (objs[i]->bounds_cmp != INVALID_HANDLE)
+            bcnt ++;
+    }
+    return bcnt;
+}
+
+/* push all scene objects into the current spatial structure
+ * tree nodes must be reserved for the objects before (scene_tree_reserve) */
+void scene_push_all(struct scn_data* s)
+{
+    struct cmp_obj** objs = (struct cmp_obj**)s->objs.buffer;
+    for (uint i = 0, cnt = s->objs.item_cnt; i < cnt; i++)  {
+        cmphandle_t bounds_hdl = objs[i]->bounds_cmp;
+        if (bounds_hdl == INVALID_HANDLE)
+            continue;
+
+        switch (s->spatial_type)    {
+        case SCN_SPATIAL_TREE:
+            scene_tree_insert(&s->tree, bounds_hdl);
+            break;
+        case SCN_SPATIAL_HASHGRID:
+            scene_hashgrid_push(&s->hgrid, bounds_hdl);
+            break;
+        default:
+            scene_grid_pushsingle(&s->grid, bounds_hdl);
+            break;
+        }
+    }
+}
+
+result_t scn_setspatial(uint scene_id, enum scn_spatial_type type)
+{
+    struct scn_data* s = scene_get(scene_id);
+    if (s->spatial_type == type)
+        return RET_OK;
+
+    /* create new structure first, so we can keep the old one if it fails
+     * tree nodes are reserved for all objects, so pushing them into the tree can't fail */
+    result_t r = RET_OK;
+    if (type == SCN_SPATIAL_GRID)
+        r = scene_grid_createcells(&s->grid, s->grid.cell_size, &s->minpt, &s->maxpt);
+    else if (type == SCN_SPATIAL_HASHGRID)
+        r = scene_hashgrid_init(&s->hgrid, s->grid.cell_size);
+    else
+        r = scene_tree_reserve(&s->tree, (int)scene_count_bounds(s));
+
+    if (IS_FAIL(r)) {
+        err_print(__FILE__, __LINE__, "scene: could not create spatial structure");
+        return r;
+    }
+
+    /* pending updates don't matter, all objects are pushed into the new structure
+     * memory of the old structure is freed, except tree nodes which are reused */
+    scene_clear_spatial(s);
+    switch (s->spatial_type)    {
+    case SCN_SPATIAL_TREE:
+        scene_tree_clear(&s->tree);
+        break;
+    case SCN_SPATIAL_HASHGRID:
+        scene_hashgrid_release(&s->hgrid);
+        break;
+    default:
+        scene_grid_destroycells(&s->grid);
+        break;
+    }
+
+    s->spatial_type = type;
+    memset(&s->stats, 0x00, sizeof(s->stats));
+    scene_push_all(s);
+    return RET_OK;
+}
+
+enum scn_spatial_type scn_getspatial(uint scene_id)
+{
+    return scene_get(scene_id)->spatial_type;
 }
 
 result_t scene_console_debuggrid(uint argc, const char** argv, void* param)
@@ -1849,9 +4621,9 @@ void scene_grid_debug(struct scn_grid* grid, const struct camera* cam)
     color_setf(&tmp_color, 0.7f, 0.7f, 0.7f, 1.0f);
 
     rect2di_shrink(&grc, &rc, 3);
-    rect2df_setf(&src_coord, grid->cells[0].x, grid->cells[0].y,
-        grid->cells[2*cell_cnt-1].x - grid->cells[0].x,
-        grid->cells[2*cell_cnt-1].y - grid->cells[0].y);
+    rect2df_setf(&src_coord, grid->cells_xmin[0], grid->cells_zmin[0],
+        grid->cells_xmax[cell_cnt-1] - grid->cells_xmin[0],
+        grid->cells_zmax[cell_cnt-1] - grid->cells_zmin[0]);
     rect2df_setf(&res_coord, (float)grc.x, (float)grc.y, (float)grc.w, (float)grc.h);
     gfx_canvas_setlinecolor(&tmp_color);
     uint cnt_x = grid->col_cnt;
@@ -1859,18 +4631,18 @@ void scene_grid_debug(struct scn_grid* grid, const struct camera* cam)
     struct rect2di rc1;
     for (uint y = 0; y < cnt_y; y++)    {
         uint idx = y * cnt_x;
-        struct vec4f* minpt = &grid->cells[idx*2];
-        struct vec4f* maxpt = &grid->cells[(idx + cnt_x - 1)*2 + 1];
-        scene_conv_coord(&rc1, minpt->x, minpt->y, maxpt->x, maxpt->y, &src_coord, &res_coord);
+        uint last_idx = idx + cnt_x - 1;
+        scene_conv_coord(&rc1, grid->cells_xmin[idx], grid->cells_zmin[idx],
+            grid->cells_xmax[last_idx], grid->cells_zmax[last_idx], &src_coord, &res_coord);
         if (y == 0)
             gfx_canvas_line2d(rc1.x, rc1.y + rc1.h, rc1.x + rc1.w, rc1.y + rc1.h, 1);
         gfx_canvas_line2d(rc1.x, rc1.y, rc1.x + rc1.w, rc1.y, 1);
     }
 
     for (uint x = 0; x < cnt_x; x++)  {
-        struct vec4f* minpt = &grid->cells[x*2];
-        struct vec4f* maxpt = &grid->cells[(x + (cnt_y-1)*cnt_x)*2 + 1];
-        scene_conv_coord(&rc1, minpt->x, minpt->y, maxpt->x, maxpt->y, &src_coord, &res_coord);
+        uint last_idx = x + (cnt_y-1)*cnt_x;
+        scene_conv_coord(&rc1, grid->cells_xmin[x], grid->cells_zmin[x],
+            grid->cells_xmax[last_idx], grid->cells_zmax[last_idx], &src_coord, &res_coord);
         gfx_canvas_line2d(rc1.x, rc1.y, rc1.x, rc1.y + rc1.h, 1);
     }
     gfx_canvas_line2d(rc1.x + rc1.w, rc1.y, rc1.x + rc1.w, rc1.y + rc1.h, 1);
@@ -1879,12 +4651,11 @@ void scene_grid_debug(struct scn_grid* grid, const struct camera* cam)
     gfx_canvas_setlinecolor(&g_color_yellow);
     for (uint i = 0; i < cell_cnt; i++)   {
         struct color c;
-        struct vec4f* minpt = &grid->cells[i*2];
-        struct vec4f* maxpt = &grid->cells[i*2 + 1];
-        scene_conv_coord(&rc1, minpt->x, minpt->y, maxpt->x, maxpt->y, &src_coord, &res_coord);
+        scene_conv_coord(&rc1, grid->cells_xmin[i], grid->cells_zmin[i], grid->cells_xmax[i],
+            grid->cells_zmax[i], &src_coord, &res_coord);
 
         rect2di_shrink(&rc1, &rc1, 1);
-        scene_get_densitycolor(&c, grid->items[i], grid);
+        scene_get_densitycolor(&c, grid->items[i].cnt, grid);
         if (math_iszero(c.a))
             continue;
         gfx_canvas_setfillcolor_solid(&c);
@@ -1936,8 +4707,7 @@ struct vec2i* scene_conv_coordpt(struct vec2i* pt, float x, float y,
     return vec2i_seti(pt, (int)target_x, (int)target_y);
 }
 
-struct color* scene_get_densitycolor(struct color* c, const struct linked_list* cell,
-    const struct scn_grid* grid)
+struct color* scene_get_densitycolor(struct color* c, uint item_cnt, const struct scn_grid* grid)
 {
 #ifdef _GNUC_
     static const struct color cs[] = {
@@ -1954,14 +4724,7 @@ struct color* scene_get_densitycolor(struct color* c, const struct linked_list*
 #endif
 
 
-    /* count items in the linked-list */
-    float cnt = 0;
-    const struct linked_list* node = cell;
-    while (node != NULL)    {
-        cnt++;
-        node = node->next;
-    }
-
+    float cnt = (float)item_cnt;
     float cmax = grid->cell_size*3.0f;
 
     /* resolve density color */
@@ -2012,7 +4775,16 @@ uint scn_getactive()
 void scn_setcellsize(uint scene_id, float cell_size)
 {
     struct scn_data* s = scene_get(scene_id);
-    scene_grid_resize(scene_id, &s->minpt, &s->maxpt, clampf(cell_size, 10.0f, 1000.0f));
+    cell_size = clampf(cell_size, SCN_GRID_MINCELLSIZE, SCN_GRID_MAXCELLSIZE);
+    memset(&s->stats, 0x00, sizeof(s->stats));
+    scene_grid_resize(scene_id, &s->minpt, &s->maxpt, cell_size);
+
+    /* re-push objects into hash grid with new cell size */
+    if (s->spatial_type == SCN_SPATIAL_HASHGRID)    {
+        scene_hashgrid_clear(&s->hgrid);
+        s->hgrid.cell_size = cell_size;
+        scene_push_all(s);
+    }
 }
 
 float scn_getcellsize(uint scene_id)
@@ -2030,6 +4802,319 @@ result_t scene_console_setcellsize(uint argc, const char** argv, void* param)
     return RET_OK;
 }
 
+void scn_tunecellsize(uint scene_id)
+{
+    scene_get(scene_id)->tune_pending = TRUE;
+}
+
+void scene_tune(struct scn_data* s, uint scene_id)
+{
+    s->tune_pending = FALSE;
+    if (s->spatial_type == SCN_SPATIAL_TREE || s->objs.item_cnt == 0)
+        return;
+
+    float cost;
+    float cur_size = s->grid.cell_size;
+    float cell_size = scene_tune_cellsize(s, NULL, &cost);
+    if (cost >= scene_tune_estimate(s, cur_size)*SCN_TUNE_MINGAIN)
+        return;
+
+    scn_setcellsize(scene_id, cell_size);
+    log_printf(LOG_INFO, "scene '%s': cell size %.1f -> %.1f", s->name, cur_size, cell_size);
+}
+
+/* estimated query cost of a cell size, objects are assumed to be evenly spread over the area
+ * cost = visited cells*SCN_TUNE_CELLCOST + object refs in visited cells*SCN_TUNE_OBJCOST */
+INLINE float scene_tune_cost(float cell_size, float area, float query_side, uint64 ref_cnt)
+{
+    float side_cnt = query_side/cell_size + 1.0f;
+    float visited = side_cnt*side_cnt;
+    float obj_refs = (float)ref_cnt*minf(visited*cell_size*cell_size/area, 1.0f);
+    return visited*SCN_TUNE_CELLCOST + obj_refs*SCN_TUNE_OBJCOST;
+}
+
+float scene_tune_estimate(const struct scn_data* s, float cell_size)
+{
+    float area;
+    float query_side;
+    scene_tune_area(s, &area, &query_side);
+    return scene_tune_cost(cell_size, area, query_side, scene_tune_refcnt(s, cell_size));
+}
+
+/**
+ * Picks the cell size with lowest estimated query cost, from geometric steps of cell size range
+ * @param jcosts Optional json array that receives estimated cost of each tested cell size
+ */
+float scene_tune_cellsize(const struct scn_data* s, OPTIONAL json_t jcosts, OUT float* cost)
+{
+    float area;
+    float query_side;
+    float best_size = s->grid.cell_size;
+    float best_cost = FL32_MAX;
+
+    scene_tune_area(s, &area, &query_side);
+    float w = s->maxpt.x - s->minpt.x;
+    float d = s->maxpt.z - s->minpt.z;
+
+    for (float cs = SCN_GRID_MINCELLSIZE; cs <= SCN_GRID_MAXCELLSIZE; cs *= SCN_TUNE_STEP)  {
+        /* grid cells are preallocated, hash-grid only allocates occupied cells */
+        if (s->spatial_type == SCN_SPATIAL_GRID && ceilf(w/cs)*ceilf(d/cs) > SCN_TUNE_MAXCELLS)
+            continue;
+
+        float c = scene_tune_cost(cs, area, query_side, scene_tune_refcnt(s, cs));
+        if (c < best_cost)  {
+            best_cost = c;
+            best_size = cs;
+        }
+
+        if (jcosts != NULL) {
+            json_t jcost = json_create_obj();
+            json_additem_toobj(jcost, "cell-size", json_create_num((fl64)cs));
+            json_additem_toobj(jcost, "cost", json_create_num((fl64)c));
+            json_additem_toarr(jcosts, jcost);
+        }
+    }
+
+    *cost = best_cost;
+    return best_size;
+}
+
+/* area that objects are spread over (XZ) and side of the average recorded query rectangle */
+void scene_tune_area(const struct scn_data* s, OUT float* area, OUT float* query_side)
+{
+    float x_min = s->minpt.x;
+    float z_min = s->minpt.z;
+    float x_max = s->maxpt.x;
+    float z_max = s->maxpt.z;
+
+    /* hash-grid has no scene size, objects define the area */
+    if (s->spatial_type == SCN_SPATIAL_HASHGRID)    {
+        const struct cmp_obj** objs = (const struct cmp_obj**)s->objs.buffer;
+        x_min = z_min = FL32_MAX;
+        x_max = z_max = -FL32_MAX;
+        for (uint i = 0, cnt = s->objs.item_cnt; i < cnt; i++)    {
+            if (objs[i]->bounds_cmp == INVALID_HANDLE)
+                continue;
+            const struct cmp_bounds* b =
+                (const struct cmp_bounds*)cmp_getinstancedata(objs[i]->bounds_cmp);
+            x_min = minf(x_min, b->ws_s.x - b->ws_s.r);
+            z_min = minf(z_min, b->ws_s.z - b->ws_s.r);
+            x_max = maxf(x_max, b->ws_s.x + b->ws_s.r);
+            z_max = maxf(z_max, b->ws_s.z + b->ws_s.r);
+        }
+    }
+
+    *area = maxf((x_max - x_min)*(z_max - z_min), 1.0f);
+
+    float query_area = SCN_TUNE_QUERYAREA;
+    if (s->stats.area_cnt > 0)
+        query_area = (float)(s->stats.area_sum/(fl64)s->stats.area_cnt);
+    *query_side = sqrtf(minf(query_area, *area));
+}
+
+/* number of object references in cells, if objects are pushed into cells of the given size */
+uint64 scene_tune_refcnt(const struct scn_data* s, float cell_size)
+{
+    const struct cmp_obj** objs = (const struct cmp_obj**)s->objs.buffer;
+    uint64 ref_cnt = 0;
+    for (uint i = 0, cnt = s->objs.item_cnt; i < cnt; i++)    {
+        if (objs[i]->bounds_cmp == INVALID_HANDLE)
+            continue;
+        const struct cmp_bounds* b =
+            (const struct cmp_bounds*)cmp_getinstancedata(objs[i]->bounds_cmp);
+        float r = b->ws_s.r;
+        uint64 x_cnt = (uint64)(floorf((b->ws_s.x + r)/cell_size) -
+            floorf((b->ws_s.x - r)/cell_size)) + 1;
+        uint64 z_cnt = (uint64)(floorf((b->ws_s.z + r)/cell_size) -
+            floorf((b->ws_s.z - r)/cell_size)) + 1;
+        ref_cnt += x_cnt*z_cnt;
+    }
+    return ref_cnt;
+}
+
+/* occupancy histogram bucket of a cell: 0, 1, 2-3, 4-7, .. */
+INLINE uint scene_stats_histidx(uint item_cnt)
+{
+    uint idx = 0;
+    while (item_cnt > 0 && idx < SCN_STATS_HISTCNT - 1) {
+        item_cnt >>= 1;
+        idx ++;
+    }
+    return idx;
+}
+
+json_t scene_stats_json(const struct scn_data* s)
+{
+    static const char* spatial_names[] = {"grid", "tree", "hashgrid"};
+    const struct scn_spatial_stats* stats = &s->stats;
+    json_t jroot = json_create_obj();
+
+    json_additem_toobj(jroot, "scene", json_create_str(s->name));
+    json_additem_toobj(jroot, "spatial", json_create_str(spatial_names[s->spatial_type]));
+    json_additem_toobj(jroot, "cell-size", json_create_num((fl64)s->grid.cell_size));
+    json_additem_toobj(jroot, "obj-count", json_create_num((fl64)s->objs.item_cnt));
+
+    /* cell occupancy */
+    const struct scn_cell_items* items = NULL;
+    uint items_stride = 0;
+    uint cell_cnt = 0;
+    if (s->spatial_type == SCN_SPATIAL_GRID)    {
+        items = s->grid.items;
+        items_stride = sizeof(struct scn_cell_items);
+        cell_cnt = s->grid.cell_cnt;
+    }   else if (s->spatial_type == SCN_SPATIAL_HASHGRID && s->hgrid.cells.item_cnt > 0)  {
+        items = &((const struct scn_hashgrid_cell*)s->hgrid.cells.buffer)->items;
+        items_stride = sizeof(struct scn_hashgrid_cell);
+        cell_cnt = s->hgrid.cells.item_cnt;
+    }
+
+    if (items != NULL)  {
+        uint hist[SCN_STATS_HISTCNT];
+        uint occupied_cnt = 0;
+        uint max_cnt = 0;
+        uint64 ref_cnt = 0;
+        memset(hist, 0x00, sizeof(hist));
+
+        for (uint i = 0; i < cell_cnt; i++)   {
+            const struct scn_cell_items* ci =
+                (const struct scn_cell_items*)((const uint8*)items + i*items_stride);
+            hist[scene_stats_histidx(ci->cnt)] ++;
+            ref_cnt += ci->cnt;
+            max_cnt = maxui(max_cnt, ci->cnt);
+            if (ci->cnt > 0)
+                occupied_cnt ++;
+        }
+
+        json_t jcells = json_create_obj();
+        json_additem_toobj(jcells, "count", json_create_num((fl64)cell_cnt));
+        json_additem_toobj(jcells, "occupied", json_create_num((fl64)occupied_cnt));
+        json_additem_toobj(jcells, "refs", json_create_num((fl64)ref_cnt));
+        json_additem_toobj(jcells, "refs-per-obj", json_create_num(s->objs.item_cnt > 0 ?
+            (fl64)ref_cnt/(fl64)s->objs.item_cnt : 0.0));
+        json_additem_toobj(jcells, "max-items", json_create_num((fl64)max_cnt));
+        json_additem_toobj(jcells, "avg-items", json_create_num(occupied_cnt > 0 ?
+            (fl64)ref_cnt/(fl64)occupied_cnt : 0.0));
+
+        json_t jhist = json_create_arr();
+        for (uint i = 0; i < SCN_STATS_HISTCNT; i++)
+            json_additem_toarr(jhist, json_create_num((fl64)hist[i]));
+        json_additem_toobj(jcells, "histogram", jhist);
+        json_additem_toobj(jroot, "cells", jcells);
+    }   else if (s->spatial_type == SCN_SPATIAL_TREE)   {
+        json_t jtree = json_create_obj();
+        json_additem_toobj(jtree, "leafs", json_create_num((fl64)s->tree.leaf_cnt));
+        json_additem_toobj(jtree, "height", json_create_num(s->tree.root != SCN_TREE_NULL ?
+            (fl64)s->tree.nodes[s->tree.root].height : 0.0));
+        json_additem_toobj(jroot, "tree", jtree);
+    }
+
+    /* recorded query costs */
+    json_t jqueries = json_create_obj();
+    fl64 query_cnt = (fl64)maxui(stats->query_cnt, 1);
+    json_additem_toobj(jqueries, "count", json_create_num((fl64)stats->query_cnt));
+    json_additem_toobj(jqueries, "traversals", json_create_num((fl64)stats->cull_cnt));
+    json_additem_toobj(jqueries, "traversal-ms-avg",
+        json_create_num(stats->cull_cnt > 0 ? stats->cull_tm*1000.0/(fl64)stats->cull_cnt : 0.0));
+    json_additem_toobj(jqueries, "candidates-avg",
+        json_create_num((fl64)stats->cand_cnt/query_cnt));
+    json_additem_toobj(jqueries, "visible-avg", json_create_num((fl64)stats->vis_cnt/query_cnt));
+    json_additem_toobj(jqueries, "area-avg", json_create_num(stats->area_cnt > 0 ?
+        stats->area_sum/(fl64)stats->area_cnt : 0.0));
+    json_additem_toobj(jroot, "queries", jqueries);
+
+    /* estimated costs of other cell sizes */
+    if (s->spatial_type != SCN_SPATIAL_TREE)    {
+        float cost;
+        json_t jcosts = json_create_arr();
+        float cell_size = scene_tune_cellsize(s, jcosts, &cost);
+        json_additem_toobj(jroot, "estimates", jcosts);
+        json_additem_toobj(jroot, "cost", json_create_num((fl64)scene_tune_estimate(s,
+            s->grid.cell_size)));
+        json_additem_toobj(jroot, "best-cell-size", json_create_num((fl64)cell_size));
+        json_additem_toobj(jroot, "best-cost", json_create_num((fl64)cost));
+    }
+
+    return jroot;
+}
+
+result_t scn_savestats(uint scene_id, const char* json_filepath)
+{
+    struct scn_data* s = scene_get(scene_id);
+    json_t jroot = scene_stats_json(s);
+    if (jroot == NULL)
+        return RET_OUTOFMEMORY;
+
+    size_t json_size;
+    char* json_data = json_savetobuffer(jroot, &json_size, FALSE);
+    json_destroy(jroot);
+    if (json_data == NULL)
+        return RET_OUTOFMEMORY;
+
+    FILE* f = fopen(json_filepath, "wt");
+    if (f == NULL)  {
+        json_deletebuffer(json_data);
+        err_printf(__FILE__, __LINE__, "scene: could not open file '%s'", json_filepath);
+        return RET_FAIL;
+    }
+    fwrite(json_data, 1, json_size, f);
+    fclose(f);
+    json_deletebuffer(json_data);
+
+    log_printf(LOG_INFO, "scene: stats of '%s' saved to '%s'", s->name, json_filepath);
+    return RET_OK;
+}
+
+result_t scene_console_tunecells(uint argc, const char** argv, void* param)
+{
+    if (argc != 0)
+        return RET_INVALIDARG;
+
+    struct scn_data* s = scene_get(g_scn_mgr.active_scene_id);
+    scene_tune(s, g_scn_mgr.active_scene_id);
+    return RET_OK;
+}
+
+result_t scene_console_savestats(uint argc, const char** argv, void* param)
+{
+    if (argc > 1)
+        return RET_INVALIDARG;
+
+    return scn_savestats(g_scn_mgr.active_scene_id, argc == 1 ? argv[0] : "cell-stats.json");
+}
+
+result_t scene_console_setspatial(uint argc, const char** argv, void* param)
+{
+    if (argc != 1)
+        return RET_INVALIDARG;
+
+    if (str_isequal_nocase(argv[0], "tree"))
+        return scn_setspatial(g_scn_mgr.active_scene_id, SCN_SPATIAL_TREE);
+    else if (str_isequal_nocase(argv[0], "grid"))
+        return scn_setspatial(g_scn_mgr.active_scene_id, SCN_SPATIAL_GRID);
+    else if (str_isequal_nocase(argv[0], "hashgrid"))
+        return scn_setspatial(g_scn_mgr.active_scene_id, SCN_SPATIAL_HASHGRID);
+    else
+        return RET_INVALIDARG;
+}
+
+void scn_reset_viscache()
+{
+    g_scn_mgr.viscache.reset = TRUE;
+}
+
+result_t scene_console_viscache(uint argc, const char** argv, void* param)
+{
+    int enable = TRUE;
+    if (argc == 1)
+        enable = str_tobool(argv[0]);
+    else if (argc > 1)
+        return RET_INVALIDARG;
+
+    g_scn_mgr.viscache.enabled = enable;
+    g_scn_mgr.viscache.reset = TRUE;
+    return RET_OK;
+}
+
 result_t scene_console_campos(uint argc, const char** argv, void* param)
 {
     int show = TRUE;
@@ -2092,7 +5177,7 @@ cmphandle_t scene_add_component(struct cmp_obj* obj, cmptype_t type)
     if (c == NULL)
         return INVALID_HANDLE;
 
-    cmphandle_t hdl = cmp_findinstance(obj->chain, cmp_gettype(c));
+    cmphandle_t hdl = cmp_findinstance_bytype_inobj(obj, cmp_gettype(c));
     if (hdl != INVALID_HANDLE)
         return hdl;
 
@@ -14,6 +14,7 @@
  ***********************************************************************************/
 
 #include <stdio.h>
+#include <math.h>
 
 #include "dhcore/core.h"
 #include "dhcore/json.h"
@@ -48,10 +49,37 @@ struct anim_ext
     struct h3d_anim_clip* clips;
 };
 
+/* data for measuring key reduction error of position/scale tracks */
+struct anim_keyvalues
+{
+    const float* values;    /* original values */
+    const float* qvalues;   /* quantized (decoded) values */
+    uint stride;    /* components per frame */
+};
+
+/* data for measuring key reduction error of rotation tracks */
+struct anim_keyrots
+{
+    const struct quat4f* rots;
+    const struct quat4f* qrots;
+};
+
+/* returns error of reconstructing frame 'i' by interpolating keys on frames 'a' and 'b' */
+typedef float (*pfn_anim_keyerror)(const void* data, uint a, uint b, uint i);
+
 /*************************************************************************************************
  * fwd declarations
  */
-int import_writeanim(const char* filepath, const struct anim_ext* anim);
+int import_writeanim(const char* filepath, const struct anim_ext* anim, int compress,
+    float max_err);
+void import_writectrack(FILE* f, const struct anim_channel_ext* channel, uint frame_cnt,
+    int has_scale, float max_err);
+uint import_reducekeys(uint16* frames, uint frame_cnt, pfn_anim_keyerror error_fn,
+    const void* data, float max_err);
+float import_valueerror(const void* data, uint a, uint b, uint i);
+float import_roterror(const void* data, uint a, uint b, uint i);
+void import_encoderot(uint16 key[3], const struct quat4f* q);
+void import_decoderot(struct quat4f* q, const uint16 key[3]);
 struct h3d_anim_clip* import_loadclips(const char* json_filepath, uint frame_cnt,
     OUT uint* clip_cnt);
 struct h3d_anim_clip* import_defaultclip(uint frame_cnt);
@@ -177,8 +205,14 @@ int import_anim(const struct import_params* params)
     /* parse json clip file */
     h3danim.clips = import_loadclips(params->clips_json_filepath, frame_cnt, &h3danim.a.clip_cnt);
 
-    /* write */
-    int r = import_writeanim(params->out_filepath, &h3danim);
+    /* write, frame indexes of compressed keys are 16 bits */
+    int compress = params->anim_compress;
+    if (compress && frame_cnt > 0xffff + 1)   {
+        printf(TERM_BOLDYELLOW "Warning: too many frames (%d) for compression, writing raw data\n"
+            TERM_RESET, frame_cnt);
+        compress = FALSE;
+    }
+    int r = import_writeanim(params->out_filepath, &h3danim, compress, params->anim_error);
 
     /* report */
     if (r)  {
@@ -191,11 +225,13 @@ int import_anim(const struct import_params* params)
                 "  frame count: %d\n"
                 "  channel count: %d\n"
                 "  has_scale: %s\n"
+                "  compressed: %s\n"
                 "  fps: %d\n",
                 scene->mNumAnimations,
                 frame_cnt,
                 channel_cnt,
                 has_scale ? "yes" : "no",
+                compress ? "yes" : "no",
                 fps);
             printf(TERM_RESET);
         }
@@ -215,7 +251,8 @@ int import_anim(const struct import_params* params)
     return r;
 }
 
-int import_writeanim(const char* filepath, const struct anim_ext* anim)
+int import_writeanim(const char* filepath, const struct anim_ext* anim, int compress,
+    float max_err)
 {
     /* write to temp file and move it later */
     char filepath_tmp[DH_PATH_MAX];
@@ -230,7 +267,7 @@ int import_writeanim(const char* filepath, const struct anim_ext* anim)
     struct h3d_header header;
     header.sign = H3D_SIGN;
     header.type = H3D_ANIM;
-    header.version = H3D_VERSION_11;
+    header.version = compress ? H3D_VERSION_12 : H3D_VERSION_11;
     header.data_offset = sizeof(struct h3d_header);
     fwrite(&header, sizeof(header), 1, f);
 
@@ -246,8 +283,13 @@ int import_writeanim(const char* filepath, const struct anim_ext* anim)
         fwrite(&anim->channels[i].c, sizeof(struct h3d_anim_channel), 1, f);
 
         /* channel data */
-        fwrite(anim->channels[i].pos_scale, sizeof(struct vec4f), anim->a.frame_cnt, f);
-        fwrite(anim->channels[i].rot, sizeof(struct quat4f), anim->a.frame_cnt, f);
+        if (compress)   {
+            import_writectrack(f, &anim->channels[i], anim->a.frame_cnt, anim->a.has_scale,
+                max_err);
+        }   else    {
+            fwrite(anim->channels[i].pos_scale, sizeof(struct vec4f), anim->a.frame_cnt, f);
+            fwrite(anim->channels[i].rot, sizeof(struct quat4f), anim->a.frame_cnt, f);
+        }
     }
 
     a.clips_offset = ftell(f);
@@ -265,6 +307,242 @@ int import_writeanim(const char* filepath, const struct anim_ext* anim)
     return util_movefile(filepath, filepath_tmp);
 }
 
+/* compresses channel into h3d_anim_ctrack and it's key arrays:
+ * positions/scales are quantized in the range of the track, rotations are quantized with
+ * smallest-three, then keys that can be interpolated from neighbours within max_err are removed */
+void import_writectrack(FILE* f, const struct anim_channel_ext* channel, uint frame_cnt,
+    int has_scale, float max_err)
+{
+    struct h3d_anim_ctrack t;
+    memset(&t, 0x00, sizeof(t));
+
+    float* pos = (float*)ALLOC(sizeof(float)*frame_cnt*3, 0);
+    float* qpos = (float*)ALLOC(sizeof(float)*frame_cnt*3, 0);
+    uint16* pos_keys = (uint16*)ALLOC(sizeof(uint16)*frame_cnt*3, 0);
+    float* scale = (float*)ALLOC(sizeof(float)*frame_cnt, 0);
+    float* qscale = (float*)ALLOC(sizeof(float)*frame_cnt, 0);
+    uint16* scale_keys = (uint16*)ALLOC(sizeof(uint16)*frame_cnt, 0);
+    struct quat4f* rot = (struct quat4f*)ALLOC(sizeof(struct quat4f)*frame_cnt, 0);
+    struct quat4f* qrot = (struct quat4f*)ALLOC(sizeof(struct quat4f)*frame_cnt, 0);
+    uint16* rot_keys = (uint16*)ALLOC(sizeof(uint16)*frame_cnt*3, 0);
+    uint16* frames = (uint16*)ALLOC(sizeof(uint16)*frame_cnt, 0);
+    ASSERT(pos && qpos && pos_keys && scale && qscale && scale_keys);
+    ASSERT(rot && qrot && rot_keys && frames);
+
+    /* quantization ranges */
+    float pos_max[3];
+    for (uint i = 0; i < 3; i++)  {
+        t.pos_min[i] = channel->pos_scale[0].f[i];
+        pos_max[i] = t.pos_min[i];
+    }
+    float scale_max = channel->pos_scale[0].w;
+    t.scale_min = scale_max;
+
+    for (uint i = 0; i < frame_cnt; i++)  {
+        const struct vec4f* ps = &channel->pos_scale[i];
+        for (uint k = 0; k < 3; k++)  {
+            pos[i*3 + k] = ps->f[k];
+            t.pos_min[k] = minf(t.pos_min[k], ps->f[k]);
+            pos_max[k] = maxf(pos_max[k], ps->f[k]);
+        }
+        scale[i] = ps->w;
+        t.scale_min = minf(t.scale_min, ps->w);
+        scale_max = maxf(scale_max, ps->w);
+    }
+
+    for (uint k = 0; k < 3; k++)
+        t.pos_extent[k] = pos_max[k] - t.pos_min[k];
+    t.scale_extent = scale_max - t.scale_min;
+
+    /* quantized keys are off by up to half a step (extent/H3D_ANIM_QPOS_MAX) from the source, so
+     * keeping every key still exceeds max_err if the track's range is too large */
+    float pos_qerr = 0.0f;
+    for (uint k = 0; k < 3; k++)  {
+        float e = 0.5f*t.pos_extent[k]/H3D_ANIM_QPOS_MAX;
+        pos_qerr += e*e;
+    }
+    pos_qerr = sqrtf(pos_qerr);
+    float scale_qerr = has_scale ? 0.5f*t.scale_extent/H3D_ANIM_QPOS_MAX : 0.0f;
+    if (pos_qerr > max_err || scale_qerr > max_err) {
+        printf(TERM_BOLDYELLOW "Warning: channel '%s' range is too large for 16 bit keys, "
+            "quantization error (%g) exceeds max error (%g)\n" TERM_RESET, channel->c.bindto,
+            maxf(pos_qerr, scale_qerr), max_err);
+    }
+
+    /* quantize, and keep decoded values for measuring the error of interpolated keys */
+    for (uint i = 0; i < frame_cnt; i++)  {
+        for (uint k = 0; k < 3; k++)  {
+            float ext = t.pos_extent[k];
+            float n = ext > 0.0f ? (pos[i*3 + k] - t.pos_min[k])/ext : 0.0f;
+            pos_keys[i*3 + k] = (uint16)(n*H3D_ANIM_QPOS_MAX + 0.5f);
+            qpos[i*3 + k] = t.pos_min[k] + ext*((float)pos_keys[i*3 + k]/H3D_ANIM_QPOS_MAX);
+        }
+
+        float n = t.scale_extent > 0.0f ? (scale[i] - t.scale_min)/t.scale_extent : 0.0f;
+        scale_keys[i] = (uint16)(n*H3D_ANIM_QPOS_MAX + 0.5f);
+        qscale[i] = t.scale_min + t.scale_extent*((float)scale_keys[i]/H3D_ANIM_QPOS_MAX);
+
+        quat_setq(&rot[i], &channel->rot[i]);
+        quat_norm(&rot[i], &rot[i]);
+        import_encoderot(&rot_keys[i*3], &rot[i]);
+        import_decoderot(&qrot[i], &rot_keys[i*3]);
+    }
+
+    /* reduce keys and write them, each track writes it's frame indexes followed by keys */
+    long hdr_offset = ftell(f);
+    fseek(f, sizeof(t), SEEK_CUR);
+
+    struct anim_keyvalues pos_data = {pos, qpos, 3};
+    t.pos_cnt = import_reducekeys(frames, frame_cnt, import_valueerror, &pos_data, max_err);
+    fwrite(frames, sizeof(uint16), t.pos_cnt, f);
+    for (uint i = 0; i < t.pos_cnt; i++)
+        fwrite(&pos_keys[frames[i]*3], sizeof(uint16), 3, f);
+
+    struct anim_keyrots rot_data = {rot, qrot};
+    t.rot_cnt = import_reducekeys(frames, frame_cnt, import_roterror, &rot_data, max_err);
+    fwrite(frames, sizeof(uint16), t.rot_cnt, f);
+    for (uint i = 0; i < t.rot_cnt; i++)
+        fwrite(&rot_keys[frames[i]*3], sizeof(uint16), 3, f);
+
+    if (has_scale)  {
+        struct anim_keyvalues scale_data = {scale, qscale, 1};
+        t.scale_cnt = import_reducekeys(frames, frame_cnt, import_valueerror, &scale_data,
+            max_err);
+        fwrite(frames, sizeof(uint16), t.scale_cnt, f);
+        for (uint i = 0; i < t.scale_cnt; i++)
+            fwrite(&scale_keys[frames[i]], sizeof(uint16), 1, f);
+    }
+
+    /* track header */
+    long end_offset = ftell(f);
+    fseek(f, hdr_offset, SEEK_SET);
+    fwrite(&t, sizeof(t), 1, f);
+    fseek(f, end_offset, SEEK_SET);
+
+    FREE(pos);
+    FREE(qpos);
+    FREE(pos_keys);
+    FREE(scale);
+    FREE(qscale);
+    FREE(scale_keys);
+    FREE(rot);
+    FREE(qrot);
+    FREE(rot_keys);
+    FREE(frames);
+}
+
+/* fills frame indexes of the keys that must be kept and returns the count
+ * tracks that stay within max_err of the first frame are reduced to one key, others keep their
+ * first and last frames and extend each segment until an in-between frame exceeds max_err */
+uint import_reducekeys(uint16* frames, uint frame_cnt, pfn_anim_keyerror error_fn,
+    const void* data, float max_err)
+{
+    uint i;
+    for (i = 1; i < frame_cnt; i++)   {
+        if (error_fn(data, 0, 0, i) > max_err)
+            break;
+    }
+    if (i == frame_cnt) {
+        frames[0] = 0;
+        return 1;
+    }
+
+    uint cnt = 0;
+    uint a = 0;
+    frames[cnt++] = 0;
+    for (uint b = 2; b < frame_cnt; b++)  {
+        for (i = a + 1; i < b; i++)   {
+            if (error_fn(data, a, b, i) > max_err)
+                break;
+        }
+
+        if (i != b) {
+            a = b - 1;
+            frames[cnt++] = (uint16)a;
+        }
+    }
+
+    if (a != frame_cnt - 1)
+        frames[cnt++] = (uint16)(frame_cnt - 1);
+    return cnt;
+}
+
+float import_valueerror(const void* data, uint a, uint b, uint i)
+{
+    const struct anim_keyvalues* d = (const struct anim_keyvalues*)data;
+    float t = (b != a) ? (float)(i - a)/(float)(b - a) : 0.0f;
+    uint stride = d->stride;
+
+    float err = 0.0f;
+    for (uint k = 0; k < stride; k++) {
+        float va = d->qvalues[a*stride + k];
+        float vb = d->qvalues[b*stride + k];
+        float e = va + (vb - va)*t - d->values[i*stride + k];
+        err += e*e;
+    }
+    return sqrtf(err);
+}
+
+/* error is the angle between original rotation and nlerped keys (same as runtime in anim.c) */
+float import_roterror(const void* data, uint a, uint b, uint i)
+{
+    const struct anim_keyrots* d = (const struct anim_keyrots*)data;
+    float t = (b != a) ? (float)(i - a)/(float)(b - a) : 0.0f;
+    const struct quat4f* qa = &d->qrots[a];
+    const struct quat4f* qb = &d->qrots[b];
+
+    float tb = (qa->x*qb->x + qa->y*qb->y + qa->z*qb->z + qa->w*qb->w) < 0.0f ? -t : t;
+    float ta = 1.0f - t;
+    struct quat4f q;
+    quat_setf(&q, qa->x*ta + qb->x*tb, qa->y*ta + qb->y*tb, qa->z*ta + qb->z*tb,
+        qa->w*ta + qb->w*tb);
+    quat_norm(&q, &q);
+
+    /* float precision (of acos and normalized quaternions) is too coarse near dot=1 for error
+     * bounds of ~0.001 radians */
+    const struct quat4f* r = &d->rots[i];
+    double qq = (double)q.x*q.x + (double)q.y*q.y + (double)q.z*q.z + (double)q.w*q.w;
+    double rr = (double)r->x*r->x + (double)r->y*r->y + (double)r->z*r->z + (double)r->w*r->w;
+    double dot = fabs((double)q.x*r->x + (double)q.y*r->y + (double)q.z*r->z + (double)q.w*r->w) /
+        sqrt(qq*rr);
+    return (float)(2.0*acos(dot < 1.0 ? dot : 1.0));
+}
+
+/* smallest-three: largest component is dropped (and made positive by negating the quaternion),
+ * the other three are quantized to 15 bits and the dropped index goes to bit 15 of key[0]/key[1] */
+void import_encoderot(uint16 key[3], const struct quat4f* q)
+{
+    uint m = 0;
+    for (uint i = 1; i < 4; i++)  {
+        if (fabsf(q->f[i]) > fabsf(q->f[m]))
+            m = i;
+    }
+
+    float s = q->f[m] < 0.0f ? -1.0f : 1.0f;
+    for (uint i = 0, k = 0; i < 4; i++)   {
+        if (i == m)
+            continue;
+        float c = clampf(q->f[i]*s, -0.70710678f, 0.70710678f);
+        key[k++] = (uint16)((c + 0.70710678f)/1.41421356f*H3D_ANIM_QROT_MAX + 0.5f);
+    }
+
+    key[0] |= (uint16)((m & 1) << 15);
+    key[1] |= (uint16)((m >> 1) << 15);
+}
+
+void import_decoderot(struct quat4f* q, const uint16 key[3])
+{
+    const float scale = 1.41421356f / H3D_ANIM_QROT_MAX;
+    uint m = (key[0] >> 15) | ((key[1] >> 15) << 1);
+    float c[3];
+    for (uint i = 0; i < 3; i++)
+        c[i] = (float)(key[i] & 0x7fff)*scale - 0.70710678f;
+
+    float w = sqrtf(maxf(0.0f, 1.0f - c[0]*c[0] - c[1]*c[1] - c[2]*c[2]));
+    for (uint i = 0, k = 0; i < 4; i++)
+        q->f[i] = (i == m) ? w : c[k++];
+}
+
 struct h3d_anim_clip* import_loadclips(const char* json_filepath, uint frame_cnt,
     OUT uint* clip_cnt)
 {
@@ -119,6 +119,10 @@ static void cmdline_calctangents(command_t* cmd, void* param)
 {  ((struct import_params*)cmd->data)->calc_tangents = TRUE; }
 static void cmdline_animfps(command_t* cmd, void* param)
 {  ((struct import_params*)cmd->data)->anim_fps = str_toint32(cmd->arg); }
+static void cmdline_animcompress(command_t* cmd, void* param)
+{  ((struct import_params*)cmd->data)->anim_compress = TRUE; }
+static void cmdline_animerror(command_t* cmd, void* param)
+{  ((struct import_params*)cmd->data)->anim_error = str_tofl32(cmd->arg); }
 static void cmdline_zup(command_t* cmd, void* param)
 {  ((struct import_params*)cmd->data)->coord = COORD_RH_ZUP; }
 static void cmdline_zinv(command_t* cmd, void* param)
@@ -158,6 +162,7 @@ int main(int argc, char** argv)
     struct import_params params;
     memset(&params, 0x00, sizeof(params));
     params.scale = 1.0f;
+    params.anim_error = 0.001f;
 
     command_t cmd;
     command_init(&cmd, argv[0], FULL_VERSION);    
@@ -186,6 +191,10 @@ int main(int argc, char** argv)
     command_option(&cmd, "-D", "--texture-alias-dir <path>", "texture alias directory "
         "(relative path inside h3dm file)", cmdline_tdiralias);
     command_option(&cmd, "-C", "--clips <clip_file>", "animation clips JSON file", cmdline_clips);
+    command_option(&cmd, "-z", "--compress", "compress animation (quantize keys and remove "
+        "keys that can be interpolated)", cmdline_animcompress);
+    command_option(&cmd, "-e", "--anim-error <error>", "max error of compressed animation keys, "
+        "units for positions and radians for rotations (default=0.001)", cmdline_animerror);
     command_option(&cmd, "-Y", "--zup", "Z is up (3dsmax default coords)", cmdline_zup);
     command_option(&cmd, "-Z", "--zinv", "Z is inverse (OpenGL default coords)", cmdline_zinv);
     command_option(&cmd, "-F", "--tfast", "fast texture compression", cmdline_tfast);
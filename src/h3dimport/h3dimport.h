@@ -60,6 +60,8 @@ struct import_params
     enum coord_type coord;
 	struct import_params_texture tex_params;
     uint anim_fps;
+    int anim_compress;  /* write compressed animation (H3D_VERSION_12) */
+    float anim_error;   /* max error of compressed keys (positions: units, rotations: radians) */
     enum h3d_texture_type ttype;    /* texture type for texture only conversion */
     char occ_name[32];  /* empty if we have no occluder */
 };